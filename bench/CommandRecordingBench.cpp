@@ -0,0 +1,94 @@
+//
+//  CommandRecordingBench.cpp
+//
+//	Partitioning and recording a draw list. The recorder spins in
+//	proportion to the cost of a range, in place of the D3D11 calls.
+//
+
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "CommandRecording.h"
+#include "JobSystem.h"
+
+class SpinRecorder : public CommandRecorder
+{
+public:
+	SpinRecorder(const std::vector<unsigned>& costs, unsigned nbr_contexts) : costs(costs), sums(nbr_contexts) { }
+
+	unsigned GetContextCount() const override { return (unsigned)sums.size(); }
+
+	void Record(unsigned context, const DrawRange& range) override
+	{
+		sums[context] = RecordRange(range);
+	}
+
+	void Submit(unsigned context) override
+	{
+		benchmark::DoNotOptimize(sums[context]);
+	}
+
+	float RecordRange(const DrawRange& range) const
+	{
+		float sum = 0;
+		for (unsigned i = range.begin; i < range.end; i++)
+			for (unsigned k = 0; k < costs[i] * 64; k++)
+				sum += std::sqrt((float)k);
+		return sum;
+	}
+
+private:
+	const std::vector<unsigned>& costs;
+	std::vector<float> sums;
+};
+
+static std::vector<unsigned> DrawCosts(unsigned nbr_draws)
+{
+	std::vector<unsigned> costs(nbr_draws);
+	for (unsigned i = 0; i < nbr_draws; i++)
+		costs[i] = 1 + (i * 7) % 13;
+	return costs;
+}
+
+static void BM_RecordSerial(benchmark::State& state)
+{
+	const std::vector<unsigned> costs = DrawCosts((unsigned)state.range(0));
+	SpinRecorder recorder(costs, 1);
+	DrawRange all;
+	all.end = (unsigned)costs.size();
+	for (auto _ : state)
+	{
+		recorder.Record(0, all);
+		recorder.Submit(0);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RecordSerial)->Arg(64)->Arg(1024)->UseRealTime();
+
+// Draws as the first argument, threads as the second
+static void BM_RecordAndSubmit(benchmark::State& state)
+{
+	const std::vector<unsigned> costs = DrawCosts((unsigned)state.range(0));
+	const unsigned nbr_threads = (unsigned)state.range(1);
+	JobSystem jobs(nbr_threads);
+	SpinRecorder recorder(costs, nbr_threads);
+	for (auto _ : state)
+	{
+		const std::vector<DrawRange> ranges = PartitionDraws(costs.data(), (unsigned)costs.size(), nbr_threads, 16);
+		RecordAndSubmit(jobs, recorder, ranges);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RecordAndSubmit)->ArgsProduct({ { 64, 1024 }, { 1, 2, 4, 8 } })->UseRealTime();
+
+static void BM_PartitionDraws(benchmark::State& state)
+{
+	const std::vector<unsigned> costs = DrawCosts((unsigned)state.range(0));
+	for (auto _ : state)
+	{
+		std::vector<DrawRange> ranges = PartitionDraws(costs.data(), (unsigned)costs.size(), 8, 16);
+		benchmark::DoNotOptimize(ranges.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PartitionDraws)->Arg(1024)->Arg(65536);
@@ -0,0 +1,245 @@
+//
+//  CullingBench.cpp
+//
+//	Frustum culling, BVH build/refit/query and occlusion culling
+//
+
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "vec/math.h"
+#include "BVH.h"
+#include "Culling.h"
+#include "OcclusionCuller.h"
+#include "Primitives.h"
+
+static std::vector<AABB> RandomBoxes(size_t n, float extent, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-extent, extent), size(0.1f, 2.0f);
+	std::vector<AABB> boxes(n);
+	for (AABB& box : boxes)
+	{
+		const vec3f c(position(rng), position(rng), position(rng));
+		const float s = size(rng);
+		box.Expand(c - vec3f(s, s, s));
+		box.Expand(c + vec3f(s, s, s));
+	}
+	return boxes;
+}
+
+static Frustum BenchFrustum()
+{
+	const mat4f P = mat4f::projection(45 * fTO_RAD, 1.5f, 0.1f, 100.0f);
+	return Frustum::FromMatrix(P * mat4f::rotation(0.3f, 0, 1, 0));
+}
+
+// Boxes spread so that about a tenth of them is inside the frustum
+static float Extent(size_t n)
+{
+	return 100.0f * std::cbrt(n / 10000.0f);
+}
+
+static void BM_FrustumCullPerVolume(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), 100, 1);
+	const Frustum frustum = BenchFrustum();
+	std::vector<unsigned char> visible(boxes.size());
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < boxes.size(); i++)
+			visible[i] = frustum.TestAABB(boxes[i]);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FrustumCullPerVolume)->Arg(10000)->Arg(100000);
+
+static void BM_FrustumCullSoA(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), 100, 1);
+	const Frustum frustum = BenchFrustum();
+	BoundsSoA bounds;
+	for (const AABB& box : boxes)
+	{
+		BoundingSphere sphere;
+		sphere.center = box.Center();
+		sphere.radius = box.Extents().norm2();
+		bounds.Add(box, sphere);
+	}
+	std::vector<unsigned char> visible(boxes.size());
+	unsigned nbr_visible = 0;
+	for (auto _ : state)
+	{
+		nbr_visible = FrustumCull(frustum, bounds, visible.data());
+		benchmark::ClobberMemory();
+	}
+	state.counters["visible"] = nbr_visible;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FrustumCullSoA)->Arg(10000)->Arg(100000);
+
+static void BM_BVHBuild(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), Extent(state.range(0)), 2);
+	BVH bvh;
+	for (auto _ : state)
+	{
+		bvh.Build(boxes.data(), boxes.size());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BVHBuild)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_BVHRefit(benchmark::State& state)
+{
+	std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), Extent(state.range(0)), 3);
+	BVH bvh;
+	bvh.Build(boxes.data(), boxes.size());
+	for (AABB& box : boxes)
+	{
+		box.min += vec3f(0.5f, 0, 0);
+		box.max += vec3f(0.5f, 0, 0);
+	}
+	for (auto _ : state)
+	{
+		bvh.Refit(boxes.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BVHRefit)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_BVHQueryFrustum(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), Extent(state.range(0)), 4);
+	const Frustum frustum = BenchFrustum();
+	BVH bvh;
+	bvh.Build(boxes.data(), boxes.size());
+	std::vector<unsigned> items;
+	for (auto _ : state)
+	{
+		items.clear();
+		bvh.QueryFrustum(frustum, items);
+		benchmark::DoNotOptimize(items.data());
+	}
+	state.counters["visible"] = (double)items.size();
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BVHQueryFrustum)->RangeMultiplier(10)->Range(10000, 1000000);
+
+// The same query without the hierarchy
+static void BM_BruteForceQueryFrustum(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), Extent(state.range(0)), 4);
+	const Frustum frustum = BenchFrustum();
+	std::vector<unsigned> items;
+	for (auto _ : state)
+	{
+		items.clear();
+		for (unsigned i = 0; i < boxes.size(); i++)
+			if (frustum.TestAABB(boxes[i]))
+				items.push_back(i);
+		benchmark::DoNotOptimize(items.data());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BruteForceQueryFrustum)->RangeMultiplier(10)->Range(10000, 1000000);
+
+static void BM_BVHRaycast(benchmark::State& state)
+{
+	const std::vector<AABB> boxes = RandomBoxes((size_t)state.range(0), Extent(state.range(0)), 5);
+	BVH bvh;
+	bvh.Build(boxes.data(), boxes.size());
+
+	std::mt19937 rng(6);
+	std::uniform_real_distribution<float> u(-1, 1);
+	std::vector<vec3f> dirs(256);
+	for (vec3f& dir : dirs)
+		dir = normalize(vec3f(u(rng), u(rng), u(rng)));
+
+	unsigned hits = 0;
+	for (auto _ : state)
+		for (const vec3f& dir : dirs)
+		{
+			unsigned item;
+			float t;
+			hits += bvh.Raycast(vec3f(0, 0, 0), dir, 1000, item, t);
+		}
+	benchmark::DoNotOptimize(hits);
+	state.SetItemsProcessed(state.iterations() * dirs.size());
+}
+BENCHMARK(BM_BVHRaycast)->RangeMultiplier(10)->Range(10000, 1000000);
+
+//
+// Occlusion culling: 10k occluder triangles in front of the camera, at the
+// default 320x160 resolution
+//
+
+struct OcclusionScene
+{
+	OccluderMesh mesh;
+	mat4f P = mat4f::projection(0.785f, 2.0f, 0.5f, 200.0f);
+	std::vector<AABB> boxes;
+
+	OcclusionScene()
+	{
+		// A 50x100 cell grid is 10000 triangles, stood up to face the camera
+		const PrimitiveCounts counts = GridCounts(50, 100);
+		std::vector<Vertex> vertices(counts.vertices);
+		std::vector<unsigned> indices(counts.indices);
+		GenerateGrid(40, 40, 50, 100, vertices.data(), indices.data());
+		for (Vertex& v : vertices)
+			v.Pos = vec3f(v.Pos.x, v.Pos.z * 0.5f, -30 + v.Pos.y);
+		mesh.AppendRange(&vertices[0].Pos, sizeof(Vertex), indices.data(), indices.size());
+
+		// Boxes in front of and behind the occluder
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> x(-40, 40), y(-20, 20), z(-60, -5);
+		for (int i = 0; i < 4096; i++)
+		{
+			const vec3f c(x(rng), y(rng), z(rng));
+			AABB box;
+			box.Expand(c - vec3f(1, 1, 1));
+			box.Expand(c + vec3f(1, 1, 1));
+			boxes.push_back(box);
+		}
+	}
+};
+
+static void BM_OcclusionRenderOccluders(benchmark::State& state)
+{
+	OcclusionScene scene;
+	OcclusionCuller culler;
+	for (auto _ : state)
+	{
+		culler.BeginFrame();
+		culler.RenderOccluder(scene.mesh, scene.P);
+		culler.EndFrame();
+	}
+	state.counters["tris"] = culler.GetRasterizedTriangleCount();
+	state.SetItemsProcessed(state.iterations() * scene.mesh.indices.size() / 3);
+}
+BENCHMARK(BM_OcclusionRenderOccluders)->Unit(benchmark::kMicrosecond);
+
+static void BM_OcclusionTestAABB(benchmark::State& state)
+{
+	OcclusionScene scene;
+	OcclusionCuller culler;
+	culler.BeginFrame();
+	culler.RenderOccluder(scene.mesh, scene.P);
+	culler.EndFrame();
+
+	unsigned visible = 0;
+	for (auto _ : state)
+	{
+		visible = 0;
+		for (const AABB& box : scene.boxes)
+			visible += culler.TestAABB(box, scene.P);
+		benchmark::DoNotOptimize(visible);
+	}
+	state.counters["visible"] = visible;
+	state.SetItemsProcessed(state.iterations() * scene.boxes.size());
+}
+BENCHMARK(BM_OcclusionTestAABB);
@@ -0,0 +1,200 @@
+//
+//  FrameLoopBench.cpp
+//
+//	A headless frame: entity update, culling, a sorted draw list and its
+//	parallel recording, with the frame's scratch in a FrameAllocator. After
+//	warm-up frames MemoryTracker asserts that no frame allocates from the
+//	heap; the run fails if one does.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "BVH.h"
+#include "CommandRecording.h"
+#include "Culling.h"
+#include "EntityStore.h"
+#include "FrameAllocator.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+// Frames that may allocate, e.g. while the profiler's trace fills up
+static const unsigned WarmupFrames = 2 * Profiler::TraceFrames;
+
+static const unsigned Contexts = 8;
+
+// Sort key and cost of a visible entity
+struct DrawPacket
+{
+	unsigned long long key;		// Material in the high bits, then depth
+	unsigned entity;
+	unsigned cost;
+};
+
+// Sums the keys of the recorded draws, as a stand-in for the API calls
+class SumRecorder : public CommandRecorder
+{
+public:
+	const DrawPacket* packets = nullptr;
+	unsigned long long sums[Contexts] = {};
+	std::atomic<unsigned long long> submitted{ 0 };
+
+	unsigned GetContextCount() const override { return Contexts; }
+
+	void Record(unsigned context, const DrawRange& range) override
+	{
+		for (unsigned i = range.begin; i < range.end; i++)
+			sums[context] += packets[i].key;
+	}
+
+	void Submit(unsigned context) override { submitted += sums[context]; }
+};
+
+class FrameLoop
+{
+public:
+	explicit FrameLoop(unsigned n) :
+		jobs(4),
+		rng(1),
+		frustum(Frustum::FromMatrix(mat4f::projection(45 * fTO_RAD, 1.5f, 0.1f, 100.0f)))
+	{
+		std::uniform_real_distribution<float> u(-50, 50);
+		AABB unit;
+		unit.Expand(vec3f(-0.5f, -0.5f, -0.5f));
+		unit.Expand(vec3f(0.5f, 0.5f, 0.5f));
+
+		entities.Reserve(n);
+		for (unsigned i = 0; i < n; i++)
+		{
+			// Small trees of ten entities
+			const EntityHandle parent = i % 10 ? handles[i - i % 10] : EntityHandle();
+			handles.push_back(entities.Create(nullptr, unit, parent));
+			entities.SetLocal(handles.back(), vec3f(u(rng), u(rng), -u(rng) - 50), quatf::rotation(0, vec3f(0, 1, 0)), vec3f(1, 1, 1));
+		}
+		entities.Update(&jobs);
+
+		item_bounds.resize(n);
+		for (unsigned i = 0; i < n; i++)
+			item_bounds[i] = entities.GetWorldBounds(i);
+		bvh.Build(item_bounds.data(), n);
+		visible.reserve(n);
+	}
+
+	void Frame()
+	{
+		frame_allocator.BeginFrame();
+		const unsigned n = entities.Size();
+
+		{
+			// Move a percent of the entities
+			PROFILE_ZONE("Frame update");
+			const float y = (float)(frame % 100) * 0.01f;
+			for (unsigned i = 0; i < n / 100; i++)
+				entities.SetPosition(handles[rng() % n], vec3f(0, y, -60));
+			entities.Update(&jobs);
+		}
+
+		{
+			PROFILE_ZONE("Frame cull");
+			for (unsigned i = 0; i < n; i++)
+				item_bounds[i] = entities.GetWorldBounds(i);
+			bvh.Refit(item_bounds.data());
+			visible.clear();
+			bvh.QueryFrustum(frustum, visible);
+		}
+
+		const unsigned nbr_visible = (unsigned)visible.size();
+		DrawPacket* packets = frame_allocator.AllocateArray<DrawPacket>(nbr_visible);
+		unsigned* costs = frame_allocator.AllocateArray<unsigned>(nbr_visible);
+		{
+			PROFILE_ZONE("Frame draw list");
+			for (unsigned i = 0; i < nbr_visible; i++)
+			{
+				const unsigned entity = visible[i];
+				const float depth = -entities.GetWorldBounds(entity).Center().z;
+				packets[i].key = (unsigned long long)(entity % 32) << 32 | (unsigned)(std::max(depth, 0.0f) * 1000);
+				packets[i].entity = entity;
+				packets[i].cost = 1 + entity % 4;
+			}
+			std::sort(packets, packets + nbr_visible,
+				[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+			for (unsigned i = 0; i < nbr_visible; i++)
+				costs[i] = packets[i].cost;
+		}
+
+		{
+			PROFILE_ZONE("Frame record");
+			DrawRange* ranges = frame_allocator.AllocateArray<DrawRange>(Contexts);
+			const unsigned nbr_ranges = PartitionDraws(costs, nbr_visible, Contexts, 64, ranges);
+			recorder.packets = packets;
+			RecordAndSubmit(jobs, recorder, ranges, nbr_ranges, frame_allocator);
+		}
+
+		Profiler::Instance().EndFrame();
+		frame_stats.AddFrame(1.0f / 60);
+		if (frame % 60 == 0)
+			benchmark::DoNotOptimize(frame_stats.GetSummary());
+		frame++;
+
+		// Throws when asserting and the frame allocated
+		MemoryTracker::Instance().EndFrame();
+	}
+
+	unsigned GetVisibleCount() const { return (unsigned)visible.size(); }
+
+	size_t GetFrameBytes() const { return frame_allocator.GetFrameBytes(); }
+
+private:
+	JobSystem jobs;
+	std::mt19937 rng;
+	const Frustum frustum;
+	EntityStore entities;
+	std::vector<EntityHandle> handles;
+	std::vector<AABB> item_bounds;
+	std::vector<unsigned> visible;
+	BVH bvh;
+	FrameAllocator frame_allocator;
+	SumRecorder recorder;
+	FrameStats frame_stats;
+	unsigned frame = 0;
+};
+
+// Entities as the argument
+static void BM_FrameLoop(benchmark::State& state)
+{
+	FrameLoop loop((unsigned)state.range(0));
+	for (unsigned i = 0; i < WarmupFrames; i++)
+		loop.Frame();
+
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.SetAssertNoHeapAllocations(true);
+	bool allocated = false;
+	for (auto _ : state)
+	{
+		try
+		{
+			loop.Frame();
+		}
+		catch (const std::runtime_error&)
+		{
+			allocated = true;
+			break;
+		}
+	}
+	tracker.SetAssertNoHeapAllocations(false);
+
+	if (allocated)
+	{
+		state.SkipWithError("a frame allocated from the heap");
+		return;
+	}
+	state.counters["heap_allocs"] = (double)tracker.GetFrameHeapAllocations();
+	state.counters["visible"] = loop.GetVisibleCount();
+	state.counters["scratch_kb"] = loop.GetFrameBytes() / 1024.0;
+}
+BENCHMARK(BM_FrameLoop)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
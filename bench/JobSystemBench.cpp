@@ -0,0 +1,69 @@
+//
+//  JobSystemBench.cpp
+//
+//	Job system scaling
+//
+
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "JobSystem.h"
+
+static const unsigned NbrElements = 4 << 20;
+
+// Some arithmetic per element, so the loop is not bound by memory alone
+static void Work(float* data, unsigned begin, unsigned end)
+{
+	for (unsigned i = begin; i < end; i++)
+		data[i] = std::sqrt(data[i] * 1.0001f + 1.0f);
+}
+
+static void BM_SerialFor(benchmark::State& state)
+{
+	std::vector<float> data(NbrElements, 1.0f);
+	for (auto _ : state)
+	{
+		Work(data.data(), 0, NbrElements);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrElements);
+}
+BENCHMARK(BM_SerialFor)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Threads as the argument
+static void BM_ParallelFor(benchmark::State& state)
+{
+	JobSystem jobs((unsigned)state.range(0));
+	std::vector<float> data(NbrElements, 1.0f);
+	float* p = data.data();
+	for (auto _ : state)
+	{
+		jobs.ParallelFor(0, NbrElements, 16384, [p](unsigned begin, unsigned end) { Work(p, begin, end); });
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrElements);
+}
+BENCHMARK(BM_ParallelFor)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void EmptyJob(void* data)
+{
+	static_cast<std::atomic<unsigned>*>(data)->fetch_add(1, std::memory_order_relaxed);
+}
+
+// Jobs per second for trivial jobs, run from the calling thread
+static void BM_JobThroughput(benchmark::State& state)
+{
+	JobSystem jobs((unsigned)state.range(0));
+	const unsigned nbr_jobs = 4096;
+	std::atomic<unsigned> executed(0);
+	for (auto _ : state)
+	{
+		JobCounter counter;
+		for (unsigned i = 0; i < nbr_jobs; i++)
+			jobs.Run(&EmptyJob, &executed, &counter);
+		jobs.Wait(counter);
+	}
+	state.SetItemsProcessed(state.iterations() * nbr_jobs);
+}
+BENCHMARK(BM_JobThroughput)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
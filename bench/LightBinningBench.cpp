@@ -0,0 +1,74 @@
+//
+//  LightBinningBench.cpp
+//
+//	Binning of point and spot lights into the clusters of a camera's frustum
+//
+
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "vec/math.h"
+#include "LightClusters.h"
+
+// Lights around and in front of the camera, a third of them spot lights
+static std::vector<Light> BenchLights(unsigned n)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-50, 50), range(1, 6), unit(-1, 1);
+	std::vector<Light> lights;
+	for (unsigned i = 0; i < n; i++)
+	{
+		const vec3f p(position(rng), position(rng) * 0.2f, position(rng) - 40);
+		if (i % 3)
+			lights.push_back(Light::Point(p, range(rng), vec3f(1, 1, 1)));
+		else
+			lights.push_back(Light::Spot(p, vec3f(unit(rng), -1, unit(rng)), range(rng) * 2, 0.3f, 0.6f, vec3f(1, 1, 1)));
+	}
+	return lights;
+}
+
+static Camera BenchCamera()
+{
+	Camera camera(45 * fTO_RAD, 16.0f / 9, 0.1f, 500);
+	camera.rotate({ -0.1f, 0.2f, 0 });
+	return camera;
+}
+
+static void SetCounters(benchmark::State& state, const LightClusters& clusters)
+{
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.counters["binned"] = clusters.GetBinnedLightCount();
+	state.counters["indices"] = clusters.GetLightIndexCount();
+}
+
+// Lights as the argument
+static void BM_LightBinningSerial(benchmark::State& state)
+{
+	const std::vector<Light> lights = BenchLights((unsigned)state.range(0));
+	const Camera camera = BenchCamera();
+	LightClusters clusters;
+	for (auto _ : state)
+	{
+		clusters.Build(lights.data(), (unsigned)lights.size(), camera);
+		benchmark::ClobberMemory();
+	}
+	SetCounters(state, clusters);
+}
+BENCHMARK(BM_LightBinningSerial)->Arg(1024)->Arg(4096)->Arg(16384)->Unit(benchmark::kMicrosecond);
+
+// Lights as the argument, binned on all hardware threads
+static void BM_LightBinningParallel(benchmark::State& state)
+{
+	const std::vector<Light> lights = BenchLights((unsigned)state.range(0));
+	const Camera camera = BenchCamera();
+	LightClusters clusters;
+	JobSystem jobs;
+	for (auto _ : state)
+	{
+		clusters.Build(lights.data(), (unsigned)lights.size(), camera, &jobs);
+		benchmark::ClobberMemory();
+	}
+	SetCounters(state, clusters);
+	state.counters["threads"] = jobs.GetThreadCount();
+}
+BENCHMARK(BM_LightBinningParallel)->Arg(1024)->Arg(4096)->Arg(16384)->Unit(benchmark::kMicrosecond)->UseRealTime();
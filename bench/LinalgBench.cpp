@@ -0,0 +1,446 @@
+//
+//  LinalgBench.cpp
+//
+//	Matrix, quaternion and batch transform throughput, SIMD against
+//	scalar references. Max errors against the references are reported
+//	as counters.
+//
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
+#include "vec/batch.h"
+
+using namespace linalg;
+
+static const unsigned NbrMatrices = 1024;
+
+static std::vector<mat4f> RandomMatrices(unsigned n, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(-1, 1);
+	std::vector<mat4f> matrices(n);
+	for (mat4f& M : matrices)
+		for (int i = 0; i < 16; i++)
+			M.array[i] = u(rng);
+	return matrices;
+}
+
+static std::vector<mat4f> RandomAffines(unsigned n, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(-1, 1);
+	std::vector<mat4f> matrices(n);
+	for (mat4f& M : matrices)
+		M = TRS(vec3f(u(rng), u(rng), u(rng)) * 10.0f,
+			quatf::rotation(u(rng) * 3, vec3f(u(rng), u(rng), u(rng)).normalize()),
+			vec3f(1.5f + u(rng), 1.5f + u(rng), 1.5f + u(rng)));
+	return matrices;
+}
+
+static float MaxDiff(const mat4f& a, const mat4f& b)
+{
+	float diff = 0;
+	for (int i = 0; i < 16; i++)
+		diff = std::max(diff, std::abs(a.array[i] - b.array[i]));
+	return diff;
+}
+
+// Scalar references, as the templates compute without SIMD
+
+static mat4f ScalarProduct(const mat4f& a, const mat4f& b)
+{
+	mat4f r;
+	for (int j = 0; j < 4; j++)
+		for (int i = 0; i < 4; i++)
+		{
+			float sum = a.mat[0][i] * b.mat[j][0];
+			for (int k = 1; k < 4; k++)
+				sum += a.mat[k][i] * b.mat[j][k];
+			r.mat[j][i] = sum;
+		}
+	return r;
+}
+
+static vec4f ScalarTransform(const mat4f& M, const vec4f& v)
+{
+	vec4f r;
+	for (int i = 0; i < 4; i++)
+		r.vec[i] = M.mat[0][i] * v.x + M.mat[1][i] * v.y + M.mat[2][i] * v.z + M.mat[3][i] * v.w;
+	return r;
+}
+
+static mat4f DoubleInverse(const mat4f& M)
+{
+	mat4<double> Md;
+	for (int i = 0; i < 16; i++)
+		Md.array[i] = M.array[i];
+	const mat4<double> Id = Md.inverse();
+	mat4f I;
+	for (int i = 0; i < 16; i++)
+		I.array[i] = (float)Id.array[i];
+	return I;
+}
+
+static void BM_MatrixProduct(benchmark::State& state)
+{
+	const std::vector<mat4f> a = RandomMatrices(NbrMatrices, 1), b = RandomMatrices(NbrMatrices, 2);
+	std::vector<mat4f> r(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			r[i] = a[i] * b[i];
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+		err = std::max(err, MaxDiff(r[i], ScalarProduct(a[i], b[i])));
+	state.counters["max_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_MatrixProduct);
+
+static void BM_MatrixProductScalar(benchmark::State& state)
+{
+	const std::vector<mat4f> a = RandomMatrices(NbrMatrices, 1), b = RandomMatrices(NbrMatrices, 2);
+	std::vector<mat4f> r(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			r[i] = ScalarProduct(a[i], b[i]);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_MatrixProductScalar);
+
+static void BM_MatrixVector(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomMatrices(NbrMatrices, 3);
+	std::vector<vec4f> v(NbrMatrices, vec4f(1, 2, 3, 1)), r(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			r[i] = M[i] * v[i];
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+	{
+		const vec4f d = r[i] - ScalarTransform(M[i], v[i]);
+		err = std::max(err, std::max(std::max(std::abs(d.x), std::abs(d.y)), std::max(std::abs(d.z), std::abs(d.w))));
+	}
+	state.counters["max_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_MatrixVector);
+
+static void BM_MatrixVectorScalar(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomMatrices(NbrMatrices, 3);
+	std::vector<vec4f> v(NbrMatrices, vec4f(1, 2, 3, 1)), r(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			r[i] = ScalarTransform(M[i], v[i]);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_MatrixVectorScalar);
+
+static void BM_Transpose(benchmark::State& state)
+{
+	std::vector<mat4f> M = RandomMatrices(NbrMatrices, 4);
+	for (auto _ : state)
+	{
+		for (mat4f& m : M)
+			m.transpose();
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_Transpose);
+
+static void BM_DotNormalize(benchmark::State& state)
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> u(-10, 10);
+	std::vector<vec4f> v(NbrMatrices);
+	for (vec4f& x : v)
+		x = vec4f(u(rng), u(rng), u(rng), u(rng));
+
+	std::vector<vec4f> n(NbrMatrices);
+	float sum = 0;
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+		{
+			n[i] = normalize(v[i]);
+			sum += dot(n[i], v[i]);
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+	{
+		const vec4f& x = v[i];
+		const float length = std::sqrt(x.x * x.x + x.y * x.y + x.z * x.z + x.w * x.w);
+		err = std::max(err, std::abs(dot(n[i], x) - length) / length);
+	}
+	state.counters["max_rel_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_DotNormalize);
+
+static void BM_Inverse(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomMatrices(NbrMatrices, 6);
+	std::vector<mat4f> I(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			I[i] = inverse(M[i]);
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+	{
+		const mat4f ref = DoubleInverse(M[i]);
+		err = std::max(err, MaxDiff(I[i], ref) / std::max(1.0f, MaxDiff(ref, mat4f_zero)));
+	}
+	state.counters["max_rel_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_Inverse);
+
+static void BM_InverseDouble(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomMatrices(NbrMatrices, 6);
+	std::vector<mat4f> I(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			I[i] = DoubleInverse(M[i]);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_InverseDouble);
+
+static void BM_AffineInverse(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomAffines(NbrMatrices, 7);
+	std::vector<mat4f> I(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			I[i] = affine_inverse(M[i]);
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+		err = std::max(err, MaxDiff(I[i], DoubleInverse(M[i])));
+	state.counters["max_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_AffineInverse);
+
+static void BM_NormalMatrix(benchmark::State& state)
+{
+	const std::vector<mat4f> M = RandomAffines(NbrMatrices, 8);
+	std::vector<mat4f> N(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			N[i] = normal_matrix(M[i]);
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+		err = std::max(err, MaxDiff(N[i], mat4f(transpose(DoubleInverse(M[i])).get_3x3())));
+	state.counters["max_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_NormalMatrix);
+
+struct RandomTRS
+{
+	std::vector<vec3f> t, s, axes;
+	std::vector<float> angles;
+	std::vector<quatf> q;
+
+	explicit RandomTRS(unsigned n)
+	{
+		std::mt19937 rng(9);
+		std::uniform_real_distribution<float> u(-1, 1);
+		for (unsigned i = 0; i < n; i++)
+		{
+			t.push_back(vec3f(u(rng), u(rng), u(rng)) * 5.0f);
+			s.push_back(vec3f(2 + u(rng), 2 + u(rng), 2 + u(rng)));
+			axes.push_back(vec3f(u(rng), u(rng), u(rng)).normalize());
+			angles.push_back(u(rng) * 3);
+			q.push_back(quatf::rotation(angles.back(), axes.back()));
+		}
+	}
+};
+
+static void BM_TRSQuaternion(benchmark::State& state)
+{
+	const RandomTRS trs(NbrMatrices);
+	std::vector<mat4f> M(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			M[i] = TRS(trs.t[i], trs.q[i], trs.s[i]);
+		benchmark::ClobberMemory();
+	}
+	float err = 0;
+	for (unsigned i = 0; i < NbrMatrices; i++)
+		err = std::max(err, MaxDiff(M[i], mat4f::TRS(trs.t[i], trs.angles[i], trs.axes[i], trs.s[i])));
+	state.counters["max_err"] = err;
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_TRSQuaternion);
+
+static void BM_TRSAxisAngle(benchmark::State& state)
+{
+	const RandomTRS trs(NbrMatrices);
+	std::vector<mat4f> M(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			M[i] = mat4f::TRS(trs.t[i], trs.angles[i], trs.axes[i], trs.s[i]);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_TRSAxisAngle);
+
+// The camera's view matrix, as it was built before quaternions
+static void BM_TRSRotationProduct(benchmark::State& state)
+{
+	const RandomTRS trs(NbrMatrices);
+	std::vector<mat4f> M(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			M[i] = mat4f::translation(trs.t[i]) * mat4f::rotation(trs.angles[i], 0, 1, 0) * mat4f::rotation(trs.s[i].x, 1, 0, 0);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_TRSRotationProduct);
+
+static void BM_Slerp(benchmark::State& state)
+{
+	const RandomTRS trs(NbrMatrices + 1);
+	std::vector<quatf> q(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			q[i] = slerp(trs.q[i], trs.q[i + 1], 0.3f);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_Slerp);
+
+static void BM_Nlerp(benchmark::State& state)
+{
+	const RandomTRS trs(NbrMatrices + 1);
+	std::vector<quatf> q(NbrMatrices);
+	for (auto _ : state)
+	{
+		for (unsigned i = 0; i < NbrMatrices; i++)
+			q[i] = nlerp(trs.q[i], trs.q[i + 1], 0.3f);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * NbrMatrices);
+}
+BENCHMARK(BM_Nlerp);
+
+//
+// Batch transforms of points, against a loop of matrix-vector products
+//
+
+struct PointSet
+{
+	mat4f M = RandomMatrices(1, 10)[0];
+	std::vector<vec3f> points, out;
+	std::vector<float> x, y, z, ox, oy, oz;
+
+	struct Vertex
+	{
+		vec3f Pos, Normal, Tangent, Binormal;
+		vec2f TexCoord;
+	};
+	std::vector<Vertex> vertices;
+
+	explicit PointSet(size_t n) : points(n), out(n), x(n), y(n), z(n), ox(n), oy(n), oz(n), vertices(n)
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> u(-10, 10);
+		for (size_t i = 0; i < n; i++)
+		{
+			points[i] = vec3f(u(rng), u(rng), u(rng));
+			x[i] = points[i].x;
+			y[i] = points[i].y;
+			z[i] = points[i].z;
+			vertices[i].Pos = points[i];
+		}
+	}
+};
+
+static void BM_TransformPointsLoop(benchmark::State& state)
+{
+	PointSet set((size_t)state.range(0));
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < set.points.size(); i++)
+			set.out[i] = (set.M * set.points[i].xyz1()).xyz();
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsLoop)->Arg(1 << 16);
+
+static void BM_TransformPointsAoS(benchmark::State& state)
+{
+	PointSet set((size_t)state.range(0));
+	for (auto _ : state)
+	{
+		transform_points(set.M, set.points.data(), set.out.data(), set.points.size());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsAoS)->Arg(1 << 16);
+
+static void BM_TransformPointsStrided(benchmark::State& state)
+{
+	PointSet set((size_t)state.range(0));
+	for (auto _ : state)
+	{
+		transform_points(set.M, &set.vertices[0].Pos, sizeof(PointSet::Vertex), set.out.data(), sizeof(vec3f), set.points.size());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsStrided)->Arg(1 << 16);
+
+static void BM_TransformPointsSoA(benchmark::State& state)
+{
+	PointSet set((size_t)state.range(0));
+	for (auto _ : state)
+	{
+		transform_points(set.M, set.x.data(), set.y.data(), set.z.data(), set.ox.data(), set.oy.data(), set.oz.data(), set.x.size());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsSoA)->Arg(1 << 16);
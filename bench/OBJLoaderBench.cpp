@@ -0,0 +1,172 @@
+//
+//  OBJLoaderBench.cpp
+//
+//	OBJ loading, per phase, and texture decoding, with their memory use.
+//	No OBJ meshes ship with the repository, so spheres are written to OBJ
+//	text in memory; the scene's meshes are loaded too when present.
+//
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "MemoryTracker.h"
+#include "OBJLoader.h"
+#include "Primitives.h"
+#include "Profiler.h"
+#include "Texture.h"
+
+enum OBJForm
+{
+	OBJ_PositionsTexcoordsNormals,	// f v/vt/vn
+	OBJ_PositionsNormals,			// f v//vn
+	OBJ_Positions					// f v, normals generated
+};
+
+// A UV sphere of about 2 * slices * slices triangles as OBJ text
+static std::string SphereOBJ(unsigned slices, OBJForm form)
+{
+	const PrimitiveCounts counts = SphereCounts(slices, slices);
+	std::vector<Vertex> vertices(counts.vertices);
+	std::vector<unsigned> indices(counts.indices);
+	GenerateSphere(1, slices, slices, vertices.data(), indices.data());
+
+	std::ostringstream obj;
+	for (const Vertex& v : vertices)
+		obj << "v " << v.Pos.x << " " << v.Pos.y << " " << v.Pos.z << "\n";
+	if (form == OBJ_PositionsTexcoordsNormals)
+		for (const Vertex& v : vertices)
+			obj << "vt " << v.TexCoord.x << " " << v.TexCoord.y << "\n";
+	if (form != OBJ_Positions)
+		for (const Vertex& v : vertices)
+			obj << "vn " << v.Normal.x << " " << v.Normal.y << " " << v.Normal.z << "\n";
+
+	obj << "g sphere\n";
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		obj << "f";
+		for (size_t k = 0; k < 3; k++)
+		{
+			const unsigned vi = indices[i + k] + 1;
+			if (form == OBJ_PositionsTexcoordsNormals)
+				obj << " " << vi << "/" << vi << "/" << vi;
+			else if (form == OBJ_PositionsNormals)
+				obj << " " << vi << "//" << vi;
+			else
+				obj << " " << vi;
+		}
+		obj << "\n";
+	}
+	return obj.str();
+}
+
+// Average time per load of the loader's phases, from its profiler zones
+static void ReportPhases(benchmark::State& state)
+{
+	Profiler::ZoneStats stats;
+	for (const char* zone : { "OBJ parse", "OBJ normals", "OBJ weld" })
+		if (Profiler::Instance().GetZoneStats(zone, stats))
+			state.counters[std::string(zone + 4) + "_ms"] = stats.avg;
+}
+
+// Peak bytes and allocations per iteration of a tag, since the returned stats
+static MemoryTracker::TagStats BeginMemory(MemoryTag tag)
+{
+	MemoryTracker::Instance().ResetPeaks();
+	return MemoryTracker::Instance().GetStats(tag);
+}
+
+static void ReportMemory(benchmark::State& state, MemoryTag tag, const MemoryTracker::TagStats& begin)
+{
+	const MemoryTracker::TagStats end = MemoryTracker::Instance().GetStats(tag);
+	state.counters["peak_kb"] = (end.peak_bytes - begin.current_bytes) / 1024.0;
+	if (state.iterations())
+		state.counters["allocs"] = (double)(end.allocations - begin.allocations) / state.iterations();
+}
+
+// Form as the first argument, slices as the second
+static void BM_OBJLoadGenerated(benchmark::State& state)
+{
+	const std::string obj = SphereOBJ((unsigned)state.range(1), (OBJForm)state.range(0));
+	Profiler& profiler = Profiler::Instance();
+	profiler.EndFrame();
+	profiler.ResetStats();
+	const MemoryTracker::TagStats memory = BeginMemory(MemoryTag::MeshLoad);
+
+	size_t nbr_vertices = 0;
+	for (auto _ : state)
+	{
+		std::istringstream in(obj);
+		OBJLoader loader;
+		loader.verbose = false;
+		loader.Load(in, "");
+		nbr_vertices = loader.vertices.size();
+
+		state.PauseTiming();
+		profiler.EndFrame();
+		state.ResumeTiming();
+	}
+	ReportPhases(state);
+	ReportMemory(state, MemoryTag::MeshLoad, memory);
+	state.counters["vertices"] = (double)nbr_vertices;
+	state.SetBytesProcessed(state.iterations() * obj.size());
+}
+BENCHMARK(BM_OBJLoadGenerated)
+	->ArgsProduct({ { OBJ_PositionsTexcoordsNormals, OBJ_PositionsNormals, OBJ_Positions }, { 64, 512 } })
+	->Unit(benchmark::kMillisecond);
+
+static const char* SceneMeshes[] = { "Trojan/Trojan.obj", "crytek-sponza/sponza.obj", "sphere/sphere.obj" };
+
+static void BM_OBJLoadAsset(benchmark::State& state)
+{
+	const std::string filename = std::string(EDUREND_ASSET_DIR) + SceneMeshes[state.range(0)];
+	state.SetLabel(SceneMeshes[state.range(0)]);
+	if (!std::ifstream(filename))
+	{
+		state.SkipWithError("mesh not found");
+		return;
+	}
+
+	Profiler& profiler = Profiler::Instance();
+	profiler.EndFrame();
+	profiler.ResetStats();
+	const MemoryTracker::TagStats memory = BeginMemory(MemoryTag::MeshLoad);
+	for (auto _ : state)
+	{
+		OBJLoader loader;
+		loader.verbose = false;
+		loader.Load(filename);
+
+		state.PauseTiming();
+		profiler.EndFrame();
+		state.ResumeTiming();
+	}
+	ReportPhases(state);
+	ReportMemory(state, MemoryTag::MeshLoad, memory);
+}
+BENCHMARK(BM_OBJLoadAsset)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+static const char* Textures[] = { "textures/brick_diffuse.png", "textures/0001CD_diffuse.jpg" };
+
+static void BM_ImageDecode(benchmark::State& state)
+{
+	const std::string filename = std::string(EDUREND_ASSET_DIR) + Textures[state.range(0)];
+	state.SetLabel(Textures[state.range(0)]);
+
+	Image image;
+	size_t nbr_pixels = 0;
+	const MemoryTracker::TagStats memory = BeginMemory(MemoryTag::Textures);
+	for (auto _ : state)
+	{
+		if (!image.Load(filename.c_str()))
+		{
+			state.SkipWithError("image not found");
+			break;
+		}
+		nbr_pixels = (size_t)image.GetWidth() * image.GetHeight();
+	}
+	ReportMemory(state, MemoryTag::Textures, memory);
+	state.SetItemsProcessed(state.iterations() * nbr_pixels);
+}
+BENCHMARK(BM_ImageDecode)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
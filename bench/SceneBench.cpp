@@ -0,0 +1,233 @@
+//
+//  SceneBench.cpp
+//
+//	Transform hierarchy updates, primitive generation, material binding,
+//	profiler overhead and camera path replay
+//
+
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "CameraPath.h"
+#include "FrameStats.h"
+#include "MaterialBinder.h"
+#include "MemoryTracker.h"
+#include "Primitives.h"
+#include "Profiler.h"
+#include "TransformHierarchy.h"
+
+//
+// Transform hierarchy of 1M nodes in random trees. The argument is the
+// fraction of nodes moved per frame, in units of 0.1%; 1000 is all of them.
+//
+
+static void BuildHierarchy(TransformHierarchy& h, unsigned n)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> u(-1, 1);
+	h.Reserve(n);
+	for (unsigned i = 0; i < n; i++)
+	{
+		const unsigned parent = i % 1000 == 0 ? TransformHierarchy::InvalidIndex : (unsigned)(rng() % i);
+		const unsigned node = h.AddNode(parent);
+		h.SetLocal(node, vec3f(u(rng), u(rng), u(rng)), quatf::rotation(u(rng) * 3, vec3f(0, 1, 0)), vec3f(1, 1, 1));
+	}
+	h.Update();
+}
+
+static void BM_TransformHierarchyUpdate(benchmark::State& state)
+{
+	const unsigned N = 1000000;
+	TransformHierarchy h;
+	BuildHierarchy(h, N);
+
+	const unsigned nbr_moved = (unsigned)((unsigned long long)N * state.range(0) / 1000);
+	std::mt19937 rng(2);
+	std::vector<unsigned> moved(nbr_moved);
+	unsigned nbr_updated = 0;
+	float y = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		for (unsigned& node : moved)
+			node = rng() % N;
+		state.ResumeTiming();
+
+		y += 0.01f;
+		for (unsigned node : moved)
+			h.SetPosition(node, vec3f(0, y, 0));
+		nbr_updated = h.Update();
+	}
+	state.counters["updated"] = nbr_updated;
+	state.counters["scene_mb"] = MemoryTracker::Instance().GetStats(MemoryTag::Scene).current_bytes / (1024.0 * 1024.0);
+	state.SetItemsProcessed(state.iterations() * nbr_updated);
+}
+BENCHMARK(BM_TransformHierarchyUpdate)->Arg(1)->Arg(10)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+//
+// Primitive generation, about 1M triangles each
+//
+
+static void BM_GenerateGrid(benchmark::State& state)
+{
+	const PrimitiveCounts counts = GridCounts(1000, 500);
+	std::vector<Vertex> vertices(counts.vertices);
+	std::vector<unsigned> indices(counts.indices);
+	for (auto _ : state)
+	{
+		GenerateGrid(10, 10, 1000, 500, vertices.data(), indices.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * counts.indices / 3);
+}
+BENCHMARK(BM_GenerateGrid)->Unit(benchmark::kMillisecond);
+
+static void BM_GenerateSphere(benchmark::State& state)
+{
+	const PrimitiveCounts counts = SphereCounts(1000, 500);
+	std::vector<Vertex> vertices(counts.vertices);
+	std::vector<unsigned> indices(counts.indices);
+	for (auto _ : state)
+	{
+		GenerateSphere(1, 1000, 500, vertices.data(), indices.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * counts.indices / 3);
+}
+BENCHMARK(BM_GenerateSphere)->Unit(benchmark::kMillisecond);
+
+//
+// Per-draw material binding with MaterialBinder: N draws sorted by material,
+// k materials. The backend copies the parameters to a buffer in place of
+// Map/Unmap on the Phong CBuffer, so these time the binder's own work per
+// draw; the uploads counter is what a skip saves on a device.
+//
+
+class CopyingBinder : public MaterialBinder
+{
+protected:
+	void UploadPhong(const PhongParams& phong) override
+	{
+		buffer = phong;
+		nbr_uploads++;
+	}
+
+	void SetTexture(unsigned, ID3D11ShaderResourceView*) override { }
+
+	void SetPixelShader(unsigned) override { }
+
+public:
+	PhongParams buffer = {};
+	unsigned nbr_uploads = 0;
+};
+
+static std::vector<PhongParams> SortedDraws(unsigned nbr_draws, unsigned nbr_materials)
+{
+	std::vector<PhongParams> draws(nbr_draws);
+	for (unsigned i = 0; i < nbr_draws; i++)
+	{
+		const float k = (float)((unsigned long long)i * nbr_materials / nbr_draws);
+		draws[i] = { vec4f(0, 0, 0, 1), vec4f(k, k, k, 1), vec4f(1, 1, 1, 1), k };
+	}
+	return draws;
+}
+
+// Repeats of the bound material are skipped
+static void BM_MaterialBinder(benchmark::State& state)
+{
+	const std::vector<PhongParams> draws = SortedDraws((unsigned)state.range(0), (unsigned)state.range(1));
+	CopyingBinder binder;
+	for (auto _ : state)
+	{
+		binder.BeginFrame();
+		binder.nbr_uploads = 0;
+		for (const PhongParams& params : draws)
+			binder.BindPhong(params.ambient, params.diffuse, params.specular, params.shininess);
+		benchmark::DoNotOptimize(binder.buffer);
+	}
+	state.counters["uploads"] = binder.nbr_uploads;
+	state.counters["skipped"] = binder.GetSkippedCount();
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MaterialBinder)->ArgsProduct({ { 1000, 100000 }, { 1, 32 } });
+
+// Every draw uploads, as before MaterialBinder: the cached state is
+// forgotten before each draw
+static void BM_MaterialBinderNoSkip(benchmark::State& state)
+{
+	const std::vector<PhongParams> draws = SortedDraws((unsigned)state.range(0), (unsigned)state.range(1));
+	CopyingBinder binder;
+	for (auto _ : state)
+	{
+		binder.nbr_uploads = 0;
+		for (const PhongParams& params : draws)
+		{
+			binder.BeginFrame();
+			binder.BindPhong(params.ambient, params.diffuse, params.specular, params.shininess);
+		}
+		benchmark::DoNotOptimize(binder.buffer);
+	}
+	state.counters["uploads"] = binder.nbr_uploads;
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MaterialBinderNoSkip)->ArgsProduct({ { 1000, 100000 }, { 1, 32 } });
+
+//
+// Profiler zones
+//
+
+static void BM_ProfileZone(benchmark::State& state)
+{
+	Profiler& profiler = Profiler::Instance();
+	unsigned n = 0;
+	for (auto _ : state)
+	{
+		for (int i = 0; i < 1000; i++)
+		{
+			PROFILE_ZONE("Bench zone");
+			benchmark::DoNotOptimize(n++);
+		}
+		state.PauseTiming();
+		profiler.EndFrame();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_ProfileZone);
+
+static void BM_NoZone(benchmark::State& state)
+{
+	unsigned n = 0;
+	for (auto _ : state)
+		for (int i = 0; i < 1000; i++)
+			benchmark::DoNotOptimize(n++);
+	state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_NoZone);
+
+//
+// Camera path replay and frame statistics
+//
+
+static void BM_CameraReplay(benchmark::State& state)
+{
+	CameraPath path;
+	for (int i = 0; i < 3600; i++)
+		path.Add(vec3f(i * 0.1f, 1, -i * 0.05f), vec3f(0.01f * i, 0.02f * i, 0), 1.0f / 60);
+
+	vec3f position, rotation;
+	unsigned frames = 0;
+	for (auto _ : state)
+	{
+		CameraReplay replay(path, 1.0f / 60);
+		while (replay.NextFrame(position, rotation))
+		{
+			replay.AddFrameTime(0.016f);
+			frames++;
+		}
+		FrameStats::Summary summary = replay.GetStats().GetSummary();
+		benchmark::DoNotOptimize(summary);
+	}
+	state.SetItemsProcessed(frames);
+}
+BENCHMARK(BM_CameraReplay)->Unit(benchmark::kMicrosecond);
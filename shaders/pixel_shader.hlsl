@@ -1,13 +1,46 @@
 
+// Optional features, compiled in by defines; each set of them is a permutation (see ShaderPermutation.h)
+//	HAS_DIFFUSE_MAP		diffuse color from t0
+//	HAS_NORMAL_MAP		tangent-space normal map in t1
+//	HAS_SPECULAR_MAP	specular color from t2
+//	ALPHA_TEST			discard where the mask in t3 is below one half
+
+#ifdef HAS_DIFFUSE_MAP
 Texture2D texDiffuse : register(t0);
+#endif
+#ifdef HAS_NORMAL_MAP
+Texture2D texNormal : register(t1);
+#endif
+#ifdef HAS_SPECULAR_MAP
+Texture2D texSpecular : register(t2);
+#endif
+#ifdef ALPHA_TEST
+Texture2D texMask : register(t3);
+#endif
 SamplerState texSampler : register(s0);
 
-cbuffer LightPosition : register(b0)
+cbuffer LightBuffer : register(b0)
 {
-	float4 lightPosition;
 	float4 cameraPosition;
+	uint4 clusterDims;			// Tiles in x and y, depth slices
+	float4 clusterParams;		// Slice scale and bias, 1 / viewport width and height
+};
+
+// Point and spot lights, binned into clusters by LightClusters on the CPU
+struct Light
+{
+	float3 position;
+	float range;
+	float3 color;
+	float spotCosOuter;			// -1 for point lights
+	float3 direction;
+	float spotCosInner;
 };
 
+StructuredBuffer<Light> lights : register(t4);
+StructuredBuffer<uint2> clusters : register(t5);		// Offset and count in lightIndices
+StructuredBuffer<uint> lightIndices : register(t6);
+
 cbuffer PhongValues : register(b1)
 {
 	float4 ambient;
@@ -24,6 +57,47 @@ struct PSIn
 	float2 TexCoord : TEX;
 };
 
+#ifdef HAS_NORMAL_MAP
+// Bend N by the normal map. The tangent frame comes from the screen-space derivatives
+// of the position and texture coordinates, so meshes need no tangents.
+float3 PerturbNormal(float3 N, float3 P, float2 uv)
+{
+	float3 dp1 = ddx(P);
+	float3 dp2 = ddy(P);
+	float2 duv1 = ddx(uv);
+	float2 duv2 = ddy(uv);
+
+	float3 dp2perp = cross(dp2, N);
+	float3 dp1perp = cross(N, dp1);
+	float3 T = dp2perp * duv1.x + dp1perp * duv2.x;
+	float3 B = dp2perp * duv1.y + dp1perp * duv2.y;
+	float invmax = rsqrt(max(max(dot(T, T), dot(B, B)), 1e-20));
+	float3x3 TBN = float3x3(T * invmax, B * invmax, N);
+
+	float3 n = texNormal.Sample(texSampler, uv).xyz * 2 - 1;
+	return normalize(mul(n, TBN));
+}
+#endif
+
+// Lights of the cluster of a pixel: its screen tile and depth slice. Pos.w is the view depth.
+uint2 GetCluster(float4 pos)
+{
+	uint2 tile = min(uint2(pos.xy * clusterParams.zw * clusterDims.xy), clusterDims.xy - 1);
+	uint slice = (uint)clamp(log(pos.w) * clusterParams.x + clusterParams.y, 0, clusterDims.z - 1);
+	return clusters[(slice * clusterDims.y + tile.y) * clusterDims.x + tile.x];
+}
+
+// Fades to zero at the light's range, and at the edge of a spot light's cone
+float Attenuation(Light light, float dist, float3 L)
+{
+	float x = dist / light.range;
+	float falloff = saturate(1 - x * x * x * x);
+	float attenuation = falloff * falloff;
+	if (light.spotCosOuter > -1)
+		attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, dot(-L, light.direction));
+	return attenuation;
+}
+
 //-----------------------------------------------------------------------------------------
 // Pixel Shader
 //-----------------------------------------------------------------------------------------
@@ -34,18 +108,51 @@ float4 PS_main(PSIn input) : SV_Target
 	// The 4:th component is opacity and should be = 1
 //	return float4(input.Normal * 0.5 + 0.5, 1);
 
+	float2 uv = input.TexCoord * 100;
+
+#ifdef ALPHA_TEST
+	clip(texMask.Sample(texSampler, uv).r - 0.5);
+#endif
+
 	float3 N = input.Normal;
-	float3 L = normalize(lightPosition.xyz - input.WorldPos);
-	
-	float diffValue = max(dot(L, N), 0);
-	
-	float3 R = normalize(reflect(-L, N));
+#ifdef HAS_NORMAL_MAP
+	N = PerturbNormal(normalize(N), input.WorldPos, uv);
+#endif
+
 	float3 V = normalize(cameraPosition.xyz - input.WorldPos);
 
-	float specValue = pow(max(dot(R, V), 0), shininess);
+#ifdef HAS_DIFFUSE_MAP
+	float4 texColor = texDiffuse.Sample(texSampler, uv);
+#else
+	float4 texColor = 1;
+#endif
+
+#ifdef HAS_SPECULAR_MAP
+	float4 specColor = specular * texSpecular.Sample(texSampler, uv);
+#else
+	float4 specColor = specular;
+#endif
+
+	// The lights of this pixel's cluster
+	float3 color = (ambient * texColor).rgb;
+	uint2 cluster = GetCluster(input.Pos);
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+		float3 toLight = light.position - input.WorldPos;
+		float dist = length(toLight);
+		float3 L = toLight / dist;
+
+		float diffValue = max(dot(L, N), 0);
+
+		float3 R = normalize(reflect(-L, N));
+
+		float specValue = pow(max(dot(R, V), 0), shininess);
+
+		color += light.color * Attenuation(light, dist, L) * ((texColor * diffuse * diffValue) + (specColor * specValue)).rgb;
+	}
 
-	float4 texColor = texDiffuse.Sample(texSampler, input.TexCoord * 100);
-	return (ambient * texColor) + (texColor * diffuse * diffValue) + (specular * specValue);
+	return float4(color, 1);
 
 	// Debug shading #2: map and return texture coordinates as a color (blue = 0)
 //	return float4(input.TexCoord, 0, 1);
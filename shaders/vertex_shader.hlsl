@@ -4,6 +4,7 @@ cbuffer TransformationBuffer : register(b0)
 	matrix ModelToWorldMatrix;
 	matrix WorldToViewMatrix;
 	matrix ProjectionMatrix;
+	matrix NormalMatrix;
 };
 
 struct VSIn
@@ -41,7 +42,9 @@ PSIn VS_main(VSIn input)
 	// Perform transformations and send to output
 	output.Pos = mul(MVP, float4(input.Pos, 1));
 	output.WorldPos = mul(ModelToWorldMatrix, float4(input.Pos, 1)).xyz;
-	output.Normal = normalize( mul(ModelToWorldMatrix, float4(input.Normal, 0)).xyz );
+	// NormalMatrix is the inverse-transpose of ModelToWorldMatrix, precomputed on the CPU,
+	// so normals stay perpendicular to surfaces under non-uniform scaling
+	output.Normal = normalize( mul(NormalMatrix, float4(input.Normal, 0)).xyz );
 	output.TexCoord = input.TexCoord;
 		
 	return output;
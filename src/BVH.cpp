@@ -0,0 +1,463 @@
+//
+//  BVH.cpp
+//
+//	Bounding volume hierarchy over axis-aligned bounding boxes
+//
+
+#include <cassert>
+#include <utility>
+#include "BVH.h"
+
+static inline float SurfaceArea(const AABB& box)
+{
+	if (box.IsEmpty())
+		return 0.0f;
+	const vec3f d = box.max - box.min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static inline bool SameBox(const AABB& a, const AABB& b)
+{
+	return a.min == b.min && a.max == b.max;
+}
+
+//
+// Slab test. Returns the entry distance in tnear if the ray hits the box within [0, tmax].
+//
+static inline bool IntersectRayAABB(const vec3f& origin, const vec3f& inv_dir, float tmax, const AABB& box, float& tnear)
+{
+	float t0 = 0.0f, t1 = tmax;
+	for (int a = 0; a < 3; a++)
+	{
+		float ta = (box.min.vec[a] - origin.vec[a]) * inv_dir.vec[a];
+		float tb = (box.max.vec[a] - origin.vec[a]) * inv_dir.vec[a];
+		if (ta > tb)
+			std::swap(ta, tb);
+		// Comparisons are written so that NaNs (0 * inf) don't reject the box
+		t0 = ta > t0 ? ta : t0;
+		t1 = tb < t1 ? tb : t1;
+		if (t0 > t1)
+			return false;
+	}
+	tnear = t0;
+	return true;
+}
+
+static inline vec3f SafeInverse(const vec3f& d)
+{
+	return vec3f(
+		d.x != 0.0f ? 1.0f / d.x : FLT_MAX,
+		d.y != 0.0f ? 1.0f / d.y : FLT_MAX,
+		d.z != 0.0f ? 1.0f / d.z : FLT_MAX);
+}
+
+void BVH::Clear()
+{
+	nodes.clear();
+	item_indices.clear();
+	item_leaf.clear();
+	item_bounds.clear();
+}
+
+void BVH::Build(const AABB* bounds, size_t nbr_items)
+{
+	Clear();
+	if (nbr_items == 0)
+		return;
+
+	item_bounds.assign(bounds, bounds + nbr_items);
+	item_indices.resize(nbr_items);
+	item_leaf.resize(nbr_items);
+
+	std::vector<vec3f> centroids(nbr_items);
+	for (size_t i = 0; i < nbr_items; i++)
+	{
+		item_indices[i] = (unsigned)i;
+		centroids[i] = item_bounds[i].Center();
+	}
+
+	// A binary tree with n leaves has at most 2n-1 nodes
+	nodes.reserve(2 * nbr_items);
+
+	Node root;
+	root.first = 0;
+	root.count = (unsigned)nbr_items;
+	root.parent = InvalidIndex;
+	RecomputeLeaf(root);
+	nodes.push_back(root);
+
+	// Depth-first subdivision. Children are always appended after their
+	// parent, which Refit() relies on.
+	struct Entry { unsigned node; unsigned depth; };
+	std::vector<Entry> stack;
+	stack.push_back({ 0, 0 });
+	while (!stack.empty())
+	{
+		const Entry e = stack.back();
+		stack.pop_back();
+
+		Subdivide(e.node, e.depth, centroids);
+
+		if (!nodes[e.node].IsLeaf())
+		{
+			stack.push_back({ nodes[e.node].first, e.depth + 1 });
+			stack.push_back({ nodes[e.node].first + 1, e.depth + 1 });
+		}
+	}
+
+	for (unsigned i = 0; i < (unsigned)nodes.size(); i++)
+	{
+		const Node& node = nodes[i];
+		for (unsigned j = 0; j < node.count; j++)
+			item_leaf[item_indices[node.first + j]] = i;
+	}
+}
+
+void BVH::Subdivide(unsigned node_index, unsigned depth, std::vector<vec3f>& centroids)
+{
+	const unsigned first = nodes[node_index].first;
+	const unsigned count = nodes[node_index].count;
+
+	if (count <= MaxLeafSize)
+		return;
+
+	AABB centroid_bounds;
+	for (unsigned i = first; i < first + count; i++)
+		centroid_bounds.Expand(centroids[item_indices[i]]);
+
+	// Find the cheapest split plane using binned SAH.
+	// All three axes are binned in a single pass over the items.
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = FLT_MAX;
+
+	const vec3f cmin = centroid_bounds.min;
+	const vec3f cext = centroid_bounds.max - centroid_bounds.min;
+	const vec3f scale(
+		cext.x > 0.0f ? NbrBins / cext.x : 0.0f,
+		cext.y > 0.0f ? NbrBins / cext.y : 0.0f,
+		cext.z > 0.0f ? NbrBins / cext.z : 0.0f);
+
+	if (depth < MaxSAHDepth)
+	{
+		AABB bin_box[3][NbrBins];
+		unsigned bin_count[3][NbrBins] = { { 0 } };
+
+		for (unsigned i = first; i < first + count; i++)
+		{
+			const unsigned item = item_indices[i];
+			const vec3f& c = centroids[item];
+			const AABB& box = item_bounds[item];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int b = (int)((c.vec[axis] - cmin.vec[axis]) * scale.vec[axis]);
+				b = b < NbrBins - 1 ? b : NbrBins - 1;
+				bin_count[axis][b]++;
+				bin_box[axis][b].Expand(box);
+			}
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (cext.vec[axis] <= 0.0f)
+				continue;
+
+			// Sweep from both sides to get the area & count left/right of each plane
+			float left_area[NbrBins - 1], right_area[NbrBins - 1];
+			unsigned left_count[NbrBins - 1], right_count[NbrBins - 1];
+			AABB left_box, right_box;
+			unsigned left_sum = 0, right_sum = 0;
+			for (int i = 0; i < NbrBins - 1; i++)
+			{
+				left_sum += bin_count[axis][i];
+				left_count[i] = left_sum;
+				left_box.Expand(bin_box[axis][i]);
+				left_area[i] = SurfaceArea(left_box);
+
+				right_sum += bin_count[axis][NbrBins - 1 - i];
+				right_count[NbrBins - 2 - i] = right_sum;
+				right_box.Expand(bin_box[axis][NbrBins - 1 - i]);
+				right_area[NbrBins - 2 - i] = SurfaceArea(right_box);
+			}
+
+			for (int i = 0; i < NbrBins - 1; i++)
+			{
+				if (!left_count[i] || !right_count[i])
+					continue;
+				const float cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_split = i;
+				}
+			}
+		}
+	}
+
+	unsigned mid;
+	if (best_axis >= 0)
+	{
+		// Stop if splitting is more expensive than intersecting all items
+		const float leaf_cost = count * SurfaceArea(nodes[node_index].box);
+		if (best_cost >= leaf_cost && count <= 4 * MaxLeafSize)
+			return;
+
+		// Partition items in place by bin
+		const float axis_min = cmin.vec[best_axis];
+		const float axis_scale = scale.vec[best_axis];
+		unsigned* begin = item_indices.data() + first;
+		unsigned* end = begin + count;
+		unsigned* split = std::partition(begin, end, [&](unsigned item)
+			{
+				int b = (int)((centroids[item].vec[best_axis] - axis_min) * axis_scale);
+				b = b < NbrBins - 1 ? b : NbrBins - 1;
+				return b <= best_split;
+			});
+		mid = (unsigned)(split - item_indices.data());
+	}
+	else
+	{
+		// Too deep, or all centroids coincide: split at the object median
+		// along the widest centroid axis, which halves the item count
+		const int axis = cext.x >= cext.y && cext.x >= cext.z ? 0 : (cext.y >= cext.z ? 1 : 2);
+		mid = first + count / 2;
+		std::nth_element(
+			item_indices.begin() + first,
+			item_indices.begin() + mid,
+			item_indices.begin() + first + count,
+			[&](unsigned a, unsigned b) { return centroids[a].vec[axis] < centroids[b].vec[axis]; });
+	}
+
+	const unsigned left_index = (unsigned)nodes.size();
+
+	Node left, right;
+	left.first = first;
+	left.count = mid - first;
+	left.parent = node_index;
+	RecomputeLeaf(left);
+
+	right.first = mid;
+	right.count = first + count - mid;
+	right.parent = node_index;
+	RecomputeLeaf(right);
+
+	nodes.push_back(left);
+	nodes.push_back(right);
+
+	nodes[node_index].first = left_index;
+	nodes[node_index].count = 0;
+}
+
+void BVH::RecomputeLeaf(Node& node) const
+{
+	node.box = AABB();
+	for (unsigned i = node.first; i < node.first + node.count; i++)
+		node.box.Expand(item_bounds[item_indices[i]]);
+}
+
+void BVH::Refit(const AABB* bounds)
+{
+	item_bounds.assign(bounds, bounds + item_bounds.size());
+
+	// Children are stored after their parents, so a reverse sweep
+	// visits all children before their parent
+	for (size_t i = nodes.size(); i-- > 0; )
+	{
+		Node& node = nodes[i];
+		if (node.IsLeaf())
+			RecomputeLeaf(node);
+		else
+		{
+			node.box = nodes[node.first].box;
+			node.box.Expand(nodes[node.first + 1].box);
+		}
+	}
+}
+
+void BVH::UpdateItem(unsigned item, const AABB& box)
+{
+	item_bounds[item] = box;
+
+	unsigned node_index = item_leaf[item];
+	RecomputeLeaf(nodes[node_index]);
+
+	// Propagate towards the root until a box is unchanged
+	node_index = nodes[node_index].parent;
+	while (node_index != InvalidIndex)
+	{
+		Node& node = nodes[node_index];
+		AABB new_box = nodes[node.first].box;
+		new_box.Expand(nodes[node.first + 1].box);
+		if (SameBox(new_box, node.box))
+			break;
+		node.box = new_box;
+		node_index = node.parent;
+	}
+}
+
+void BVH::QueryFrustum(const Frustum& frustum, std::vector<unsigned>& items) const
+{
+	if (nodes.empty())
+		return;
+
+	// Each stack entry carries the planes the node may still straddle;
+	// planes that fully contain a parent also contain its children
+	struct Entry { unsigned node; unsigned plane_mask; };
+	Entry stack[StackSize];
+	int sp = 0;
+	stack[sp++] = { 0, 0x3f };
+
+	while (sp > 0)
+	{
+		const Entry e = stack[--sp];
+		const Node& node = nodes[e.node];
+
+		unsigned mask = e.plane_mask;
+		if (mask)
+		{
+			const vec3f c = node.box.Center(), ext = node.box.Extents();
+			bool outside = false;
+			for (int k = 0; k < 6 && !outside; k++)
+			{
+				if (!(mask & (1u << k)))
+					continue;
+				const vec4f& p = frustum.planes[k];
+				const float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+				const float r = std::abs(p.x) * ext.x + std::abs(p.y) * ext.y + std::abs(p.z) * ext.z;
+				if (d + r < 0.0f)
+					outside = true;
+				else if (d - r >= 0.0f)
+					mask &= ~(1u << k);
+			}
+			if (outside)
+				continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			for (unsigned i = 0; i < node.count; i++)
+			{
+				const unsigned item = item_indices[node.first + i];
+				if (!mask || frustum.TestAABB(item_bounds[item]))
+					items.push_back(item);
+			}
+		}
+		else
+		{
+			assert(sp + 2 <= (int)StackSize);
+			stack[sp++] = { node.first + 1, mask };
+			stack[sp++] = { node.first, mask };
+		}
+	}
+}
+
+void BVH::QueryRay(const vec3f& origin, const vec3f& dir, float tmax, std::vector<unsigned>& items) const
+{
+	if (nodes.empty())
+		return;
+
+	const vec3f inv_dir = SafeInverse(dir);
+	unsigned stack[StackSize];
+	int sp = 0;
+	stack[sp++] = 0;
+
+	while (sp > 0)
+	{
+		const Node& node = nodes[stack[--sp]];
+		float t;
+		if (!IntersectRayAABB(origin, inv_dir, tmax, node.box, t))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			for (unsigned i = 0; i < node.count; i++)
+			{
+				const unsigned item = item_indices[node.first + i];
+				if (IntersectRayAABB(origin, inv_dir, tmax, item_bounds[item], t))
+					items.push_back(item);
+			}
+		}
+		else
+		{
+			assert(sp + 2 <= (int)StackSize);
+			stack[sp++] = node.first + 1;
+			stack[sp++] = node.first;
+		}
+	}
+}
+
+bool BVH::Raycast(const vec3f& origin, const vec3f& dir, float tmax, unsigned& item, float& t) const
+{
+	if (nodes.empty())
+		return false;
+
+	const vec3f inv_dir = SafeInverse(dir);
+	float tbest = tmax;
+	unsigned best = InvalidIndex;
+
+	float troot;
+	if (!IntersectRayAABB(origin, inv_dir, tbest, nodes[0].box, troot))
+		return false;
+
+	// Front-to-back traversal; entries store the distance at which their box is entered
+	struct Entry { unsigned node; float t; };
+	Entry stack[StackSize];
+	int sp = 0;
+	stack[sp++] = { 0, troot };
+
+	while (sp > 0)
+	{
+		const Entry e = stack[--sp];
+		if (e.t > tbest)
+			continue;
+		const Node& node = nodes[e.node];
+
+		if (node.IsLeaf())
+		{
+			for (unsigned i = 0; i < node.count; i++)
+			{
+				const unsigned it = item_indices[node.first + i];
+				float ti;
+				// Inclusive of tmax, as the slab test is, until the first hit
+				if (IntersectRayAABB(origin, inv_dir, tbest, item_bounds[it], ti) && (best == InvalidIndex || ti < tbest))
+				{
+					tbest = ti;
+					best = it;
+				}
+			}
+			continue;
+		}
+
+		float tl = 0.0f, tr = 0.0f;
+		const bool hit_l = IntersectRayAABB(origin, inv_dir, tbest, nodes[node.first].box, tl);
+		const bool hit_r = IntersectRayAABB(origin, inv_dir, tbest, nodes[node.first + 1].box, tr);
+
+		// Push the farther child first so that the nearer is visited first
+		assert(sp + 2 <= (int)StackSize);
+		if (hit_l && hit_r)
+		{
+			if (tl <= tr)
+			{
+				stack[sp++] = { node.first + 1, tr };
+				stack[sp++] = { node.first, tl };
+			}
+			else
+			{
+				stack[sp++] = { node.first, tl };
+				stack[sp++] = { node.first + 1, tr };
+			}
+		}
+		else if (hit_l)
+			stack[sp++] = { node.first, tl };
+		else if (hit_r)
+			stack[sp++] = { node.first + 1, tr };
+	}
+
+	if (best == InvalidIndex)
+		return false;
+
+	item = best;
+	t = tbest;
+	return true;
+}
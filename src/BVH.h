@@ -0,0 +1,102 @@
+//
+//  BVH.h
+//
+//	Bounding volume hierarchy over axis-aligned bounding boxes
+//
+
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include "Culling.h"
+
+//
+// Binary BVH built with binned SAH (Wald 2007) over a set of items,
+// each represented by its AABB. Items are referred to by their index
+// in the array passed to Build().
+//
+// Supports refitting, either of the whole tree or per item, so that
+// moving items can be updated without a rebuild. Tree quality degrades
+// as items move far from where they were at build time; rebuild then.
+//
+class BVH
+{
+public:
+	struct Node
+	{
+		AABB box;
+		// Leaf: index of the first item in item_indices
+		// Interior: index of the left child (the right child follows it)
+		unsigned first;
+		// Number of items for leaves, 0 for interior nodes
+		unsigned count;
+		unsigned parent;
+
+		bool IsLeaf() const { return count > 0; }
+	};
+
+	static const unsigned InvalidIndex = ~0u;
+
+	// Number of SAH bins per axis
+	static const int NbrBins = 16;
+
+	// Leaves are not split below this number of items
+	static const unsigned MaxLeafSize = 4;
+
+	// Depth after which nodes are split at the object median instead of by SAH.
+	// Bounds the depth to MaxSAHDepth + 32, which sizes the traversal stacks.
+	static const unsigned MaxSAHDepth = 96;
+	static const unsigned StackSize = 128;
+
+	//
+	// Build the hierarchy from scratch
+	//
+	void Build(const AABB* item_bounds, size_t nbr_items);
+
+	//
+	// Recompute all node boxes from new item bounds (same items as in Build)
+	//
+	void Refit(const AABB* item_bounds);
+
+	//
+	// Update the bounds of a single item and propagate the change towards
+	// the root. Cost is proportional to the depth of the item's leaf.
+	//
+	void UpdateItem(unsigned item, const AABB& box);
+
+	//
+	// Append all items whose boxes intersect the frustum. Subtrees fully
+	// inside the frustum are appended without further plane tests.
+	//
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned>& items) const;
+
+	//
+	// Append all items whose boxes are hit by the ray within [0, tmax]
+	//
+	void QueryRay(const vec3f& origin, const vec3f& dir, float tmax, std::vector<unsigned>& items) const;
+
+	//
+	// Find the item whose box is hit first by the ray within [0, tmax]. Returns
+	// false if no box is hit.
+	//
+	bool Raycast(const vec3f& origin, const vec3f& dir, float tmax, unsigned& item, float& t) const;
+
+	const std::vector<Node>& GetNodes() const { return nodes; }
+
+	size_t GetItemCount() const { return item_bounds.size(); }
+
+	void Clear();
+
+private:
+	std::vector<Node> nodes;
+	std::vector<unsigned> item_indices;	// Items, ordered by leaf
+	std::vector<unsigned> item_leaf;	// Leaf node of each item
+	std::vector<AABB> item_bounds;		// Current bounds of each item
+
+	void Subdivide(unsigned node_index, unsigned depth, std::vector<vec3f>& centroids);
+
+	void RecomputeLeaf(Node& node) const;
+};
+
+#endif
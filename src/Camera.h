@@ -9,8 +9,9 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include "vec\vec.h"
-#include "vec\mat.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
 
 using namespace linalg;
 
@@ -53,13 +54,7 @@ public:
 	//
 	void move(const vec3f& v)
 	{
-		mat4f TR = mat4f::translation(position) *
-			mat4f::rotation(rotation.y, 0, 1, 0) *
-			mat4f::rotation(rotation.x, 1, 0, 0);
-
-		vec4f fwd = TR * vec4f(v.x, v.y, v.z, 0);
-
-		position += vec3f(fwd.x, fwd.y, fwd.z);
+		position += get_Orientation().rotate(v);
 	}
 
 	void rotate(const vec3f& r)
@@ -76,9 +71,16 @@ public:
 		rotation.y = std::fmod(rotation.y + r.y, fPI * 2);
 	}
 
+	// Orientation: yaw (rotation.y) around y after pitch (rotation.x) around x
+	//
+	quatf get_Orientation() const
+	{
+		return quatf::rotation(rotation.y, 0, 1, 0) * quatf::rotation(rotation.x, 1, 0, 0);
+	}
+
 	// Return World-to-View matrix for this camera
 	//
-	mat4f get_WorldToViewMatrix()
+	mat4f get_WorldToViewMatrix() const
 	{
 		// Assuming a camera's position and rotation is defined by matrices T(p) and R,
 		// the View-to-World transform is T(p)*R (for a first-person style camera).
@@ -87,16 +89,17 @@ public:
 		//		inverse(T(p)*R) = inverse(R)*inverse(T(p)) = transpose(R)*T(-p)
 		// Since now there is no rotation, this matrix is simply T(-p)
 
-		mat4f rotMat = mat4f::rotation(rotation.y, 0, 1, 0) * mat4f::rotation(rotation.x, 1, 0, 0);
-		rotMat.transpose();
-		return rotMat * mat4f::translation(-position);
+		// transpose(R) is the conjugate rotation, and transpose(R)*T(-p) has the
+		// translation transpose(R)*(-p)
+		const quatf q = get_Orientation().conjugate();
+		return TRS(q.rotate(-position), q, vec3f(1, 1, 1));
 	}
 
 	// Matrix transforming from View space to Clip space
 	// In a performance sensitive situation this matrix should be precomputed
 	// if possible
 	//
-	mat4f get_ProjectionMatrix()
+	mat4f get_ProjectionMatrix() const
 	{
 		return mat4f::projection(vfov, aspect, zNear, zFar);
 	}
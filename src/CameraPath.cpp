@@ -0,0 +1,172 @@
+//
+//  CameraPath.cpp
+//
+//	Recorded camera paths, replayed with a fixed timestep for benchmarking
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "vec/math.h"
+#include "CameraPath.h"
+
+static const char Magic[4] = { 'E', 'R', 'C', 'P' };
+static const unsigned Version = 1;
+static const unsigned FloatsPerKey = 7;
+
+static void WriteU32(std::ostream& out, unsigned value)
+{
+	const char bytes[4] = { (char)(value & 0xff), (char)((value >> 8) & 0xff), (char)((value >> 16) & 0xff), (char)(value >> 24) };
+	out.write(bytes, 4);
+}
+
+static unsigned ReadU32(std::istream& in)
+{
+	unsigned char bytes[4];
+	if (!in.read((char*)bytes, 4))
+		throw std::runtime_error("CameraPath: unexpected end of file");
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned)bytes[3] << 24);
+}
+
+static void WriteFloat(std::ostream& out, float value)
+{
+	unsigned bits;
+	std::memcpy(&bits, &value, 4);
+	WriteU32(out, bits);
+}
+
+static float ReadFloat(std::istream& in)
+{
+	const unsigned bits = ReadU32(in);
+	float value;
+	std::memcpy(&value, &bits, 4);
+	return value;
+}
+
+void CameraPath::Add(const vec3f& position, const vec3f& rotation, float dt)
+{
+	CameraKey key;
+	key.position = position;
+	key.rotation = rotation;
+	key.dt = dt;
+	keys.push_back(key);
+
+	// The first key starts the path, whatever its dt
+	times.push_back(times.empty() ? 0 : times.back() + dt);
+}
+
+void CameraPath::Clear()
+{
+	keys.clear();
+	times.clear();
+}
+
+void CameraPath::Sample(float t, vec3f& position, vec3f& rotation) const
+{
+	if (keys.empty())
+		return;
+
+	// First key after t
+	const size_t next = std::upper_bound(times.begin(), times.end(), t) - times.begin();
+	if (next == 0 || next == keys.size())
+	{
+		const CameraKey& key = keys[next == 0 ? 0 : keys.size() - 1];
+		position = key.position;
+		rotation = key.rotation;
+		return;
+	}
+
+	const CameraKey& a = keys[next - 1];
+	const CameraKey& b = keys[next];
+	const float span = times[next] - times[next - 1];
+	const float x = span > 0 ? (t - times[next - 1]) / span : 1.0f;
+
+	// Yaw is kept in (-2pi, 2pi) by Camera: take the shorter way around
+	float yaw = std::fmod(b.rotation.y - a.rotation.y, 2 * fPI);
+	if (yaw > fPI)
+		yaw -= 2 * fPI;
+	else if (yaw < -fPI)
+		yaw += 2 * fPI;
+
+	position = lerp(a.position, b.position, x);
+	rotation = vec3f(
+		lerp(a.rotation.x, b.rotation.x, x),
+		a.rotation.y + yaw * x,
+		lerp(a.rotation.z, b.rotation.z, x));
+}
+
+void CameraPath::Save(std::ostream& out) const
+{
+	out.write(Magic, 4);
+	WriteU32(out, Version);
+	WriteU32(out, (unsigned)keys.size());
+	for (const CameraKey& key : keys)
+	{
+		const float values[FloatsPerKey] = { key.position.x, key.position.y, key.position.z, key.rotation.x, key.rotation.y, key.rotation.z, key.dt };
+		for (float value : values)
+			WriteFloat(out, value);
+	}
+}
+
+void CameraPath::Load(std::istream& in)
+{
+	char magic[4];
+	if (!in.read(magic, 4) || std::memcmp(magic, Magic, 4) != 0)
+		throw std::runtime_error("CameraPath: not a camera path file");
+	if (ReadU32(in) != Version)
+		throw std::runtime_error("CameraPath: unsupported version");
+
+	const unsigned nbr_keys = ReadU32(in);
+	Clear();
+	for (unsigned i = 0; i < nbr_keys; i++)
+	{
+		float values[FloatsPerKey];
+		for (float& value : values)
+			value = ReadFloat(in);
+		Add(vec3f(values[0], values[1], values[2]), vec3f(values[3], values[4], values[5]), values[6]);
+	}
+}
+
+void CameraPath::Save(const std::string& filename) const
+{
+	std::ofstream out(filename, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("CameraPath: cannot write " + filename);
+	Save(out);
+}
+
+void CameraPath::Load(const std::string& filename)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("CameraPath: cannot read " + filename);
+	Load(in);
+}
+
+// Frames at 0, timestep, 2 timestep, ... up to the end of the path
+static unsigned ReplayFrameCount(const CameraPath& path, float timestep)
+{
+	if (!(timestep > 0))
+		throw std::runtime_error("CameraReplay: the timestep must be positive");
+	return path.Size() ? (unsigned)std::floor(path.GetDuration() / timestep) + 1 : 0;
+}
+
+CameraReplay::CameraReplay(const CameraPath& path, float timestep) :
+	path(path),
+	timestep(timestep),
+	nbr_frames(ReplayFrameCount(path, timestep)),
+	stats(std::max<unsigned>(nbr_frames, 1))
+{ }
+
+bool CameraReplay::NextFrame(vec3f& position, vec3f& rotation)
+{
+	if (IsDone())
+		return false;
+
+	// Multiplied rather than accumulated, so that long paths do not drift
+	path.Sample(frame * timestep, position, rotation);
+	frame++;
+	return true;
+}
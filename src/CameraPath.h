@@ -0,0 +1,101 @@
+//
+//  CameraPath.h
+//
+//	Recorded camera paths, replayed with a fixed timestep for benchmarking
+//
+
+#pragma once
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "vec/vec.h"
+#include "FrameStats.h"
+
+using namespace linalg;
+
+//
+// Camera position and rotation (as in Camera) of a frame, and the time
+// since the previous frame
+//
+struct CameraKey
+{
+	vec3f position;
+	vec3f rotation;
+	float dt = 0;
+};
+
+//
+// A sequence of camera keys. The binary format is a header (magic "ERCP",
+// version, key count as 32-bit integers) followed by 7 floats per key,
+// little-endian. Load errors throw std::runtime_error.
+//
+class CameraPath
+{
+	std::vector<CameraKey> keys;
+	std::vector<float> times;		// Time of each key since the first
+
+public:
+	void Add(const vec3f& position, const vec3f& rotation, float dt);
+
+	void Clear();
+
+	unsigned Size() const { return (unsigned)keys.size(); }
+
+	const CameraKey& GetKey(unsigned i) const { return keys[i]; }
+
+	// Time from the first key to the last
+	float GetDuration() const { return times.empty() ? 0 : times.back(); }
+
+	//
+	// Interpolated camera at time t since the first key, clamped to the
+	// path. Yaw is interpolated the short way around.
+	//
+	void Sample(float t, vec3f& position, vec3f& rotation) const;
+
+	void Save(std::ostream& out) const;
+
+	void Load(std::istream& in);
+
+	void Save(const std::string& filename) const;
+
+	void Load(const std::string& filename);
+};
+
+//
+// Plays a path back at a fixed timestep, one frame per NextFrame(), and
+// collects the measured time of each frame
+//
+class CameraReplay
+{
+	const CameraPath& path;
+	const float timestep;
+	unsigned frame = 0;
+	unsigned nbr_frames;
+	FrameStats stats;
+
+public:
+	CameraReplay(const CameraPath& path, float timestep);
+
+	//
+	// Camera of the next frame; false once the whole path has been played.
+	// The simulation should advance by GetTimestep() per frame.
+	//
+	bool NextFrame(vec3f& position, vec3f& rotation);
+
+	// Measured time of a replayed frame, in seconds
+	void AddFrameTime(float dt) { stats.AddFrame(dt); }
+
+	bool IsDone() const { return frame >= nbr_frames; }
+
+	float GetTimestep() const { return timestep; }
+
+	unsigned GetFrameCount() const { return nbr_frames; }
+
+	const FrameStats& GetStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,114 @@
+//
+//  CommandRecording.cpp
+//
+//	Backend-neutral parallel recording of a draw list
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include "CommandRecording.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+
+std::vector<DrawRange> PartitionDraws(
+	const unsigned* costs,
+	unsigned nbr_draws,
+	unsigned max_ranges,
+	unsigned min_range_cost)
+{
+	std::vector<DrawRange> ranges(std::min(max_ranges, nbr_draws));
+	ranges.resize(PartitionDraws(costs, nbr_draws, max_ranges, min_range_cost, ranges.data()));
+	return ranges;
+}
+
+unsigned PartitionDraws(
+	const unsigned* costs,
+	unsigned nbr_draws,
+	unsigned max_ranges,
+	unsigned min_range_cost,
+	DrawRange* ranges)
+{
+	if (!nbr_draws || !max_ranges)
+		return 0;
+
+	unsigned long long total = 0;
+	for (unsigned i = 0; i < nbr_draws; i++)
+		total += costs[i];
+
+	// Fewer ranges if they would fall below the minimum cost
+	unsigned long long nbr_ranges = max_ranges;
+	if (min_range_cost > 1)
+		nbr_ranges = std::min<unsigned long long>(nbr_ranges, total / min_range_cost);
+	nbr_ranges = std::max<unsigned long long>(1, std::min<unsigned long long>(nbr_ranges, nbr_draws));
+
+	// Cut where the running cost passes each multiple of total/nbr_ranges,
+	// keeping at least one draw per range
+	DrawRange range;
+	unsigned count = 0;
+	unsigned long long cost = 0;
+	for (unsigned i = 0; i < nbr_draws; i++)
+	{
+		cost += costs[i];
+		range.end = i + 1;
+
+		const unsigned long long ranges_left = nbr_ranges - count - 1;
+		const unsigned draws_left = nbr_draws - range.end;
+		if (ranges_left &&
+			(cost * nbr_ranges >= total * (count + 1) || draws_left == ranges_left))
+		{
+			ranges[count++] = range;
+			range.begin = range.end;
+		}
+	}
+	ranges[count++] = range;
+
+	return count;
+}
+
+// One recording job
+struct RecordJob
+{
+	CommandRecorder* recorder;
+	unsigned context;
+	const DrawRange* range;
+
+	static void Execute(void* data)
+	{
+		RecordJob& job = *(RecordJob*)data;
+		job.recorder->Record(job.context, *job.range);
+	}
+};
+
+// Record and submit, with room for a job per range in record_jobs
+static void RecordAndSubmit(JobSystem& jobs, CommandRecorder& recorder, const DrawRange* ranges, unsigned nbr_ranges, RecordJob* record_jobs)
+{
+	JobCounter counter;
+	for (unsigned i = 0; i < nbr_ranges; i++)
+	{
+		record_jobs[i].recorder = &recorder;
+		record_jobs[i].context = i;
+		record_jobs[i].range = &ranges[i];
+		jobs.Run(&RecordJob::Execute, &record_jobs[i], &counter);
+	}
+	jobs.Wait(counter);
+
+	for (unsigned i = 0; i < nbr_ranges; i++)
+		recorder.Submit(i);
+}
+
+void RecordAndSubmit(JobSystem& jobs, CommandRecorder& recorder, const std::vector<DrawRange>& ranges)
+{
+	if (ranges.size() > recorder.GetContextCount())
+		throw std::runtime_error("RecordAndSubmit: more ranges than contexts");
+
+	std::vector<RecordJob> record_jobs(ranges.size());
+	RecordAndSubmit(jobs, recorder, ranges.data(), (unsigned)ranges.size(), record_jobs.data());
+}
+
+void RecordAndSubmit(JobSystem& jobs, CommandRecorder& recorder, const DrawRange* ranges, unsigned nbr_ranges, FrameAllocator& scratch)
+{
+	if (nbr_ranges > recorder.GetContextCount())
+		throw std::runtime_error("RecordAndSubmit: more ranges than contexts");
+
+	RecordAndSubmit(jobs, recorder, ranges, nbr_ranges, scratch.AllocateArray<RecordJob>(nbr_ranges));
+}
@@ -0,0 +1,86 @@
+//
+//  CommandRecording.h
+//
+//	Backend-neutral parallel recording of a draw list
+//
+
+#pragma once
+#ifndef COMMANDRECORDING_H
+#define COMMANDRECORDING_H
+
+#include <vector>
+
+class FrameAllocator;
+class JobSystem;
+
+//
+// Draws [begin, end) of a draw list
+//
+struct DrawRange
+{
+	unsigned begin = 0;
+	unsigned end = 0;
+
+	unsigned Size() const { return end - begin; }
+};
+
+//
+// Split a draw list into at most max_ranges contiguous ranges of about
+// equal total cost, in draw list order. costs[i] is the cost of draw i,
+// e.g. its number of drawcalls. Ranges cost at least min_range_cost where
+// possible, so short lists are not spread thinly over many contexts.
+// An empty list gives no ranges.
+//
+std::vector<DrawRange> PartitionDraws(
+	const unsigned* costs,
+	unsigned nbr_draws,
+	unsigned max_ranges,
+	unsigned min_range_cost = 1);
+
+//
+// As above, into ranges, which has room for min(max_ranges, nbr_draws)
+// ranges. Returns the number of ranges.
+//
+unsigned PartitionDraws(
+	const unsigned* costs,
+	unsigned nbr_draws,
+	unsigned max_ranges,
+	unsigned min_range_cost,
+	DrawRange* ranges);
+
+//
+// Records draw ranges into separate command streams (e.g. D3D11 deferred
+// contexts) and submits them. Implemented per backend; a backend that just
+// logs the calls makes the scheduling testable without a GPU.
+//
+class CommandRecorder
+{
+public:
+	virtual unsigned GetContextCount() const = 0;
+
+	//
+	// Record a range into command stream context. Called concurrently for
+	// different contexts, at most once per context and frame.
+	//
+	virtual void Record(unsigned context, const DrawRange& range) = 0;
+
+	//
+	// Submit what was recorded into context. Called on the thread that
+	// called RecordAndSubmit, in context order.
+	//
+	virtual void Submit(unsigned context) = 0;
+
+	virtual ~CommandRecorder() { }
+};
+
+//
+// Record range i into context i as jobs, then submit all contexts in order
+// on the calling thread once recording has finished. There may not be more
+// ranges than contexts.
+//
+void RecordAndSubmit(JobSystem& jobs, CommandRecorder& recorder, const std::vector<DrawRange>& ranges);
+
+// As above, with the jobs in frame scratch memory
+void RecordAndSubmit(JobSystem& jobs, CommandRecorder& recorder, const DrawRange* ranges, unsigned nbr_ranges, FrameAllocator& scratch);
+
+#endif
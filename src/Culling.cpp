@@ -0,0 +1,227 @@
+//
+//  Culling.cpp
+//
+//	Bounding volumes and view-frustum culling
+//
+
+#include "Culling.h"
+
+void ComputeBounds(
+	const vec3f* positions,
+	size_t stride,
+	const unsigned* indices,
+	size_t index_count,
+	AABB& box,
+	BoundingSphere& sphere)
+{
+	const unsigned char* base = (const unsigned char*)positions;
+
+	box = AABB();
+	for (size_t i = 0; i < index_count; i++)
+		box.Expand(*(const vec3f*)(base + indices[i] * stride));
+
+	sphere.center = box.Center();
+	float radius_sq = 0.0f;
+	for (size_t i = 0; i < index_count; i++)
+	{
+		const vec3f& p = *(const vec3f*)(base + indices[i] * stride);
+		radius_sq = std::max<float>(radius_sq, (p - sphere.center).norm2squared());
+	}
+	sphere.radius = std::sqrt(radius_sq);
+}
+
+AABB TransformAABB(const mat4f& M, const AABB& box)
+{
+	// Arvo's method: the transformed extents are |M3x3| * extents
+	const vec3f c = box.Center(), e = box.Extents();
+	const vec4f tc = M * c.xyz1();
+
+	const vec3f te(
+		std::abs(M.m11) * e.x + std::abs(M.m12) * e.y + std::abs(M.m13) * e.z,
+		std::abs(M.m21) * e.x + std::abs(M.m22) * e.y + std::abs(M.m23) * e.z,
+		std::abs(M.m31) * e.x + std::abs(M.m32) * e.y + std::abs(M.m33) * e.z);
+
+	AABB res;
+	res.min = tc.xyz() - te;
+	res.max = tc.xyz() + te;
+	return res;
+}
+
+Frustum Frustum::FromMatrix(const mat4f& M)
+{
+	const vec4f r1(M.m11, M.m12, M.m13, M.m14);
+	const vec4f r2(M.m21, M.m22, M.m23, M.m24);
+	const vec4f r3(M.m31, M.m32, M.m33, M.m34);
+	const vec4f r4(M.m41, M.m42, M.m43, M.m44);
+
+	// The projection matrix maps depth to [-w,w] (GL convention), so the
+	// near plane is r4+r3. This is conservative w.r.t. the [0,w] clip volume
+	// used by the rasterizer.
+	Frustum f;
+	f.planes[0] = r4 + r1;	// left
+	f.planes[1] = r4 - r1;	// right
+	f.planes[2] = r4 + r2;	// bottom
+	f.planes[3] = r4 - r2;	// top
+	f.planes[4] = r4 + r3;	// near
+	f.planes[5] = r4 - r3;	// far
+
+	for (auto& p : f.planes)
+	{
+		const float len = p.xyz().norm2();
+		if (len > 1e-8f)
+			p = p * (1.0f / len);
+	}
+	return f;
+}
+
+bool Frustum::TestAABB(const AABB& box) const
+{
+	const vec3f c = box.Center(), e = box.Extents();
+
+	for (const auto& p : planes)
+	{
+		const float d = p.x * c.x + p.y * c.y + p.z * c.z + p.w;
+		const float r = std::abs(p.x) * e.x + std::abs(p.y) * e.y + std::abs(p.z) * e.z;
+		if (d + r < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool Frustum::TestSphere(const BoundingSphere& sphere) const
+{
+	const vec3f& c = sphere.center;
+
+	for (const auto& p : planes)
+	{
+		if (p.x * c.x + p.y * c.y + p.z * c.z + p.w < -sphere.radius)
+			return false;
+	}
+	return true;
+}
+
+void BoundsSoA::Add(const AABB& box, const BoundingSphere& sphere)
+{
+	const vec3f c = box.Center(), e = box.Extents();
+
+	cx.push_back(c.x); cy.push_back(c.y); cz.push_back(c.z);
+	ex.push_back(e.x); ey.push_back(e.y); ez.push_back(e.z);
+	sx.push_back(sphere.center.x); sy.push_back(sphere.center.y); sz.push_back(sphere.center.z);
+	r.push_back(sphere.radius);
+}
+
+void BoundsSoA::Set(size_t i, const AABB& box, const BoundingSphere& sphere)
+{
+	const vec3f c = box.Center(), e = box.Extents();
+
+	cx[i] = c.x; cy[i] = c.y; cz[i] = c.z;
+	ex[i] = e.x; ey[i] = e.y; ez[i] = e.z;
+	sx[i] = sphere.center.x; sy[i] = sphere.center.y; sz[i] = sphere.center.z;
+	r[i] = sphere.radius;
+}
+
+AABB BoundsSoA::GetAABB(size_t i) const
+{
+	AABB box;
+	box.min = vec3f(cx[i] - ex[i], cy[i] - ey[i], cz[i] - ez[i]);
+	box.max = vec3f(cx[i] + ex[i], cy[i] + ey[i], cz[i] + ez[i]);
+	return box;
+}
+
+void BoundsSoA::Clear()
+{
+	for (auto* v : { &cx, &cy, &cz, &ex, &ey, &ez, &sx, &sy, &sz, &r })
+		v->clear();
+}
+
+void BoundsSoA::Reserve(size_t n)
+{
+	for (auto* v : { &cx, &cy, &cz, &ex, &ey, &ez, &sx, &sy, &sz, &r })
+		v->reserve(n);
+}
+
+//
+// Scalar test of volume i, used for the tail of the SIMD loop
+//
+static inline bool TestBoundsScalar(const Frustum& frustum, const BoundsSoA& b, size_t i)
+{
+	for (const auto& p : frustum.planes)
+	{
+		const float d = p.x * b.cx[i] + p.y * b.cy[i] + p.z * b.cz[i] + p.w;
+		const float e = std::abs(p.x) * b.ex[i] + std::abs(p.y) * b.ey[i] + std::abs(p.z) * b.ez[i];
+		const float ds = p.x * b.sx[i] + p.y * b.sy[i] + p.z * b.sz[i] + p.w;
+		if (d + e < 0.0f || ds + b.r[i] < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+unsigned FrustumCull(
+	const Frustum& frustum,
+	const BoundsSoA& bounds,
+	unsigned char* visible)
+{
+	const size_t n = bounds.Size();
+	unsigned nbr_visible = 0;
+	size_t i = 0;
+
+#ifdef LINALG_SSE
+	// Broadcast plane components once
+	__m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	for (int k = 0; k < 6; k++)
+	{
+		px[k] = _mm_set1_ps(frustum.planes[k].x);
+		py[k] = _mm_set1_ps(frustum.planes[k].y);
+		pz[k] = _mm_set1_ps(frustum.planes[k].z);
+		pw[k] = _mm_set1_ps(frustum.planes[k].w);
+		ax[k] = _mm_andnot_ps(sign_mask, px[k]);
+		ay[k] = _mm_andnot_ps(sign_mask, py[k]);
+		az[k] = _mm_andnot_ps(sign_mask, pz[k]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(&bounds.cx[i]);
+		const __m128 cy = _mm_loadu_ps(&bounds.cy[i]);
+		const __m128 cz = _mm_loadu_ps(&bounds.cz[i]);
+		const __m128 ex = _mm_loadu_ps(&bounds.ex[i]);
+		const __m128 ey = _mm_loadu_ps(&bounds.ey[i]);
+		const __m128 ez = _mm_loadu_ps(&bounds.ez[i]);
+		const __m128 sx = _mm_loadu_ps(&bounds.sx[i]);
+		const __m128 sy = _mm_loadu_ps(&bounds.sy[i]);
+		const __m128 sz = _mm_loadu_ps(&bounds.sz[i]);
+		const __m128 sr = _mm_loadu_ps(&bounds.r[i]);
+
+		__m128 outside = zero;
+		for (int k = 0; k < 6; k++)
+		{
+			// Box: signed distance of the center plus the projected extents
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[k], cx), _mm_mul_ps(py[k], cy)), _mm_add_ps(_mm_mul_ps(pz[k], cz), pw[k]));
+			__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[k], ex), _mm_mul_ps(ay[k], ey)), _mm_mul_ps(az[k], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, e), zero));
+
+			// Sphere: signed distance of the center plus the radius
+			__m128 ds = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[k], sx), _mm_mul_ps(py[k], sy)), _mm_add_ps(_mm_mul_ps(pz[k], sz), pw[k]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(ds, sr), zero));
+		}
+
+		const int mask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; j++)
+		{
+			const unsigned char v = (mask >> j) & 1 ? 0 : 1;
+			visible[i + j] = v;
+			nbr_visible += v;
+		}
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		visible[i] = TestBoundsScalar(frustum, bounds, i) ? 1 : 0;
+		nbr_visible += visible[i];
+	}
+
+	return nbr_visible;
+}
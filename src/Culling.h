@@ -0,0 +1,144 @@
+//
+//  Culling.h
+//
+//	Bounding volumes and view-frustum culling
+//
+
+#pragma once
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <cfloat>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/simd.h"
+
+using namespace linalg;
+
+//
+// Axis-aligned bounding box
+//
+struct AABB
+{
+	vec3f min = vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
+	vec3f max = vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	void Expand(const vec3f& p)
+	{
+		min = vec3f(std::min<float>(min.x, p.x), std::min<float>(min.y, p.y), std::min<float>(min.z, p.z));
+		max = vec3f(std::max<float>(max.x, p.x), std::max<float>(max.y, p.y), std::max<float>(max.z, p.z));
+	}
+
+	void Expand(const AABB& b)
+	{
+		Expand(b.min);
+		Expand(b.max);
+	}
+
+	bool IsEmpty() const { return min.x > max.x; }
+
+	vec3f Center() const { return (min + max) * 0.5f; }
+
+	vec3f Extents() const { return (max - min) * 0.5f; }
+};
+
+//
+// Bounding sphere
+//
+struct BoundingSphere
+{
+	vec3f center = vec3f_zero;
+	float radius = 0.0f;
+};
+
+//
+// Computes the AABB and bounding sphere of the vertices referenced by an index range.
+// Positions are read with a byte stride so that e.g. Vertex arrays can be passed directly.
+// The sphere is centered at the box center, with the radius of the farthest vertex.
+//
+void ComputeBounds(
+	const vec3f* positions,
+	size_t stride,
+	const unsigned* indices,
+	size_t index_count,
+	AABB& box,
+	BoundingSphere& sphere);
+
+//
+// Transforms a box and returns the AABB enclosing the result
+//
+AABB TransformAABB(const mat4f& M, const AABB& box);
+
+//
+// View frustum as six planes (left, right, bottom, top, near, far).
+// A plane (a,b,c,d) holds points p where a*p.x + b*p.y + c*p.z + d >= 0.
+//
+struct Frustum
+{
+	vec4f planes[6];
+
+	//
+	// Extract normalized planes from a clip matrix (Gribb & Hartmann).
+	// For M = Projection * View the planes are in world space; for
+	// M = Projection * View * Model they are in the model's local space,
+	// so local bounds can be tested directly.
+	//
+	static Frustum FromMatrix(const mat4f& M);
+
+	bool TestAABB(const AABB& box) const;
+
+	bool TestSphere(const BoundingSphere& sphere) const;
+};
+
+//
+// Bounding volumes in Structure-of-Arrays layout, so that the culling
+// kernel can test four volumes per iteration
+//
+struct BoundsSoA
+{
+	// Box centers & half-extents
+	std::vector<float> cx, cy, cz;
+	std::vector<float> ex, ey, ez;
+	// Sphere centers & radii
+	std::vector<float> sx, sy, sz, r;
+
+	void Add(const AABB& box, const BoundingSphere& sphere);
+
+	void Set(size_t i, const AABB& box, const BoundingSphere& sphere);
+
+	AABB GetAABB(size_t i) const;
+
+	void Clear();
+
+	void Reserve(size_t n);
+
+	size_t Size() const { return cx.size(); }
+};
+
+//
+// Per-frame culling counters
+//
+struct CullStats
+{
+	unsigned tested = 0;
+	unsigned visible = 0;
+	unsigned occluded = 0;	// Passed the frustum test but hidden by occluders
+
+	unsigned Culled() const { return tested - visible; }
+
+	void Reset() { tested = visible = occluded = 0; }
+};
+
+//
+// Tests all bounds against the frustum and writes 1 (potentially visible)
+// or 0 (culled) per volume to visible[]. A volume is culled if either its
+// sphere or its box is fully outside one of the planes.
+// Returns the number of potentially visible volumes.
+//
+unsigned FrustumCull(
+	const Frustum& frustum,
+	const BoundsSoA& bounds,
+	unsigned char* visible);
+
+#endif
@@ -0,0 +1,97 @@
+//
+//  D3D11MaterialBinder.cpp
+//
+//	Uploads per-drawcall material parameters to the pixel shader
+//
+
+#include <stdexcept>
+#include "D3D11MaterialBinder.h"
+
+PixelShaderPermutations::PixelShaderPermutations(
+	ID3D11Device* dxdevice,
+	const char* path,
+	const char* entrypoint)
+{
+	for (unsigned i = 0; i < ShaderPermutationCount; i++)
+	{
+		define_strings[i] = GetPermutationDefines(i);
+		for (const auto& define : define_strings[i])
+			defines[i].push_back({ define.first.c_str(), define.second.c_str() });
+		defines[i].push_back({ nullptr, nullptr });
+
+		if (create_shader_with_defines(dxdevice, path, entrypoint, SHADER_PIXEL, defines[i].data(), nullptr, 0, &shaders[i]) != SR_OK)
+		{
+			for (unsigned k = 0; k < i; k++)
+				delete_shader(shaders[k]);
+			throw std::runtime_error(std::string("Failed to compile ") + path + " with features " + GetPermutationName(i));
+		}
+	}
+}
+
+void PixelShaderPermutations::HotReload(ID3D11Device* dxdevice)
+{
+	bind_shader(dxdevice, nullptr, shaders[next_reload]);
+	next_reload = (next_reload + 1) % ShaderPermutationCount;
+}
+
+PixelShaderPermutations::~PixelShaderPermutations()
+{
+	for (shader_data* shader : shaders)
+		delete_shader(shader);
+}
+
+D3D11MaterialBinder::D3D11MaterialBinder(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context)
+	: dxdevice_context(dxdevice_context)
+{
+	HRESULT hr;
+	D3D11_BUFFER_DESC phongBuffer_Desc = { 0 };
+	phongBuffer_Desc.Usage = D3D11_USAGE_DYNAMIC;
+	phongBuffer_Desc.ByteWidth = sizeof(PhongBuffer);
+	phongBuffer_Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	phongBuffer_Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	phongBuffer_Desc.MiscFlags = 0;
+	phongBuffer_Desc.StructureByteStride = 0;
+	ASSERT(hr = dxdevice->CreateBuffer(&phongBuffer_Desc, nullptr, &phong_buffer));
+}
+
+void D3D11MaterialBinder::BeginFrame()
+{
+	dxdevice_context->PSSetConstantBuffers(1, 1, &phong_buffer);
+	MaterialBinder::BeginFrame();
+}
+
+void D3D11MaterialBinder::SetPixelShaders(const PixelShaderPermutations* pixel_shaders)
+{
+	this->pixel_shaders = pixel_shaders;
+	SelectPermutations(pixel_shaders != nullptr);
+}
+
+void D3D11MaterialBinder::UploadPhong(const PhongParams& phong)
+{
+	D3D11_MAPPED_SUBRESOURCE resource;
+	dxdevice_context->Map(phong_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	PhongBuffer* materialBuffer = (PhongBuffer*)resource.pData;
+	materialBuffer->ambientColor = phong.ambient;
+	materialBuffer->diffuseColor = phong.diffuse;
+	materialBuffer->specularColor = phong.specular;
+	materialBuffer->shininess = phong.shininess;
+	dxdevice_context->Unmap(phong_buffer, 0);
+}
+
+void D3D11MaterialBinder::SetTexture(unsigned slot, ID3D11ShaderResourceView* SRV)
+{
+	// Slot ti of the PS
+	dxdevice_context->PSSetShaderResources(slot, 1, &SRV);
+}
+
+void D3D11MaterialBinder::SetPixelShader(unsigned permutation)
+{
+	bind_shader(nullptr, dxdevice_context, pixel_shaders->Get(permutation));
+}
+
+D3D11MaterialBinder::~D3D11MaterialBinder()
+{
+	SAFE_RELEASE(phong_buffer);
+}
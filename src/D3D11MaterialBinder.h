@@ -0,0 +1,98 @@
+//
+//  D3D11MaterialBinder.h
+//
+//	Uploads per-drawcall material parameters to the pixel shader
+//
+
+#pragma once
+#ifndef D3D11MATERIALBINDER_H
+#define D3D11MATERIALBINDER_H
+
+#include "stdafx.h"
+#include "Shader.h"
+#include "MaterialBinder.h"
+
+//
+// The pixel shader compiled once per permutation, or loaded from the shader
+// cache. Shared by the material binders of all contexts.
+//
+class PixelShaderPermutations
+{
+	shader_data* shaders[ShaderPermutationCount] = {};
+
+	// Defines per permutation, kept for recompiling on hot reload
+	std::vector<std::pair<std::string, std::string>> define_strings[ShaderPermutationCount];
+	std::vector<shader_define> defines[ShaderPermutationCount];
+
+	unsigned next_reload = 0;
+
+public:
+	// Throws std::runtime_error if a permutation fails to compile
+	PixelShaderPermutations(
+		ID3D11Device* dxdevice,
+		const char* path,
+		const char* entrypoint);
+
+	PixelShaderPermutations(const PixelShaderPermutations&) = delete;
+
+	PixelShaderPermutations& operator=(const PixelShaderPermutations&) = delete;
+
+	shader_data* Get(unsigned permutation) const { return shaders[permutation]; }
+
+	//
+	// Recompile a permutation if its source changed. Checks one permutation
+	// per call, in turn, to keep the file checks per frame down. Not while
+	// binders record.
+	//
+	void HotReload(ID3D11Device* dxdevice);
+
+	~PixelShaderPermutations();
+};
+
+//
+// Material binder of a D3D11 device context. Owns the Phong CBuffer (slot
+// b1 of the PS) and sets the material texture slots (t0-t3) and, with
+// pixel shader permutations set, the pixel shader.
+//
+class D3D11MaterialBinder : public MaterialBinder
+{
+	ID3D11DeviceContext* const dxdevice_context;
+
+	ID3D11Buffer* phong_buffer = nullptr;
+
+	const PixelShaderPermutations* pixel_shaders = nullptr;
+
+protected:
+	void UploadPhong(const PhongParams& phong) override;
+
+	void SetTexture(unsigned slot, ID3D11ShaderResourceView* SRV) override;
+
+	void SetPixelShader(unsigned permutation) override;
+
+public:
+	//
+	// CBuffer client-side definition
+	// Must match the corresponding shader definition
+	//
+	struct alignas(16) PhongBuffer
+	{
+		vec4f ambientColor;
+		vec4f diffuseColor;
+		vec4f specularColor;
+		alignas(16) float shininess;
+	};
+
+	D3D11MaterialBinder(
+		ID3D11Device* dxdevice,
+		ID3D11DeviceContext* dxdevice_context);
+
+	// Also binds the CBuffer to its slot
+	void BeginFrame() override;
+
+	// Null to leave the pixel shader alone
+	void SetPixelShaders(const PixelShaderPermutations* pixel_shaders);
+
+	~D3D11MaterialBinder();
+};
+
+#endif
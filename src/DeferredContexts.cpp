@@ -0,0 +1,147 @@
+//
+//  DeferredContexts.cpp
+//
+//	D3D11 deferred contexts for recording drawcalls on worker threads
+//
+
+#include "DeferredContexts.h"
+
+void PipelineState::Capture(ID3D11DeviceContext* context)
+{
+	Release();
+
+	context->IAGetInputLayout(&input_layout);
+	context->IAGetPrimitiveTopology(&topology);
+	context->VSGetShader(&vertex_shader, nullptr, nullptr);
+	context->PSGetShader(&pixel_shader, nullptr, nullptr);
+	context->VSGetConstantBuffers(0, MaxConstantBuffers, vs_constant_buffers);
+	context->PSGetConstantBuffers(0, MaxConstantBuffers, ps_constant_buffers);
+	context->PSGetSamplers(0, MaxSamplers, ps_samplers);
+	context->PSGetShaderResources(0, MaxShaderResources, ps_shader_resources);
+	context->RSGetState(&rasterizer_state);
+	nbr_viewports = MaxViewports;
+	context->RSGetViewports(&nbr_viewports, viewports);
+	context->OMGetRenderTargets(1, &render_target, &depth_stencil);
+	context->OMGetDepthStencilState(&depth_stencil_state, &stencil_ref);
+	context->OMGetBlendState(&blend_state, blend_factor, &sample_mask);
+}
+
+void PipelineState::Apply(ID3D11DeviceContext* context) const
+{
+	context->IASetInputLayout(input_layout);
+	context->IASetPrimitiveTopology(topology);
+	context->VSSetShader(vertex_shader, nullptr, 0);
+	context->PSSetShader(pixel_shader, nullptr, 0);
+	context->VSSetConstantBuffers(0, MaxConstantBuffers, vs_constant_buffers);
+	context->PSSetConstantBuffers(0, MaxConstantBuffers, ps_constant_buffers);
+	context->PSSetSamplers(0, MaxSamplers, ps_samplers);
+	context->PSSetShaderResources(0, MaxShaderResources, ps_shader_resources);
+	context->RSSetState(rasterizer_state);
+	context->RSSetViewports(nbr_viewports, viewports);
+	context->OMSetRenderTargets(1, &render_target, depth_stencil);
+	context->OMSetDepthStencilState(depth_stencil_state, stencil_ref);
+	context->OMSetBlendState(blend_state, blend_factor, sample_mask);
+}
+
+void PipelineState::Release()
+{
+	SAFE_RELEASE(input_layout);
+	SAFE_RELEASE(vertex_shader);
+	SAFE_RELEASE(pixel_shader);
+	for (unsigned i = 0; i < MaxConstantBuffers; i++)
+	{
+		SAFE_RELEASE(vs_constant_buffers[i]);
+		SAFE_RELEASE(ps_constant_buffers[i]);
+	}
+	for (unsigned i = 0; i < MaxSamplers; i++)
+		SAFE_RELEASE(ps_samplers[i]);
+	for (unsigned i = 0; i < MaxShaderResources; i++)
+		SAFE_RELEASE(ps_shader_resources[i]);
+	SAFE_RELEASE(rasterizer_state);
+	SAFE_RELEASE(render_target);
+	SAFE_RELEASE(depth_stencil);
+	SAFE_RELEASE(depth_stencil_state);
+	SAFE_RELEASE(blend_state);
+}
+
+DeferredContexts::DeferredContexts(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* immediate_context,
+	unsigned nbr_contexts)
+	: immediate_context(immediate_context),
+	contexts(nbr_contexts)
+{
+	HRESULT hr;
+	for (Context& c : contexts)
+	{
+		ASSERT(hr = dxdevice->CreateDeferredContext(0, &c.context));
+		SETNAME(c.context, "DeferredContext");
+		c.material_binder = new D3D11MaterialBinder(dxdevice, c.context);
+	}
+}
+
+ID3D11DeviceContext* DeferredContexts::Begin(unsigned i)
+{
+	Context& c = contexts[i];
+	state.Apply(c.context);
+	c.material_binder->BeginFrame();
+	return c.context;
+}
+
+void DeferredContexts::Finish(unsigned i)
+{
+	Context& c = contexts[i];
+	HRESULT hr;
+	SAFE_RELEASE(c.command_list);
+	ASSERT(hr = c.context->FinishCommandList(FALSE, &c.command_list));
+}
+
+void DeferredContexts::Execute(unsigned i)
+{
+	Context& c = contexts[i];
+	if (!c.command_list)
+		return;
+
+	immediate_context->ExecuteCommandList(c.command_list, TRUE);
+	SAFE_RELEASE(c.command_list);
+}
+
+unsigned DeferredContexts::GetUploadCount() const
+{
+	unsigned count = 0;
+	for (const Context& c : contexts)
+		count += c.material_binder->GetUploadCount();
+	return count;
+}
+
+unsigned DeferredContexts::GetSkippedCount() const
+{
+	unsigned count = 0;
+	for (const Context& c : contexts)
+		count += c.material_binder->GetSkippedCount();
+	return count;
+}
+
+unsigned DeferredContexts::GetShaderSwitchCount() const
+{
+	unsigned count = 0;
+	for (const Context& c : contexts)
+		count += c.material_binder->GetShaderSwitchCount();
+	return count;
+}
+
+void DeferredContexts::SetPixelShaders(const PixelShaderPermutations* pixel_shaders)
+{
+	for (Context& c : contexts)
+		c.material_binder->SetPixelShaders(pixel_shaders);
+}
+
+DeferredContexts::~DeferredContexts()
+{
+	for (Context& c : contexts)
+	{
+		SAFE_RELEASE(c.command_list);
+		SAFE_DELETE(c.material_binder);
+		SAFE_RELEASE(c.context);
+	}
+}
@@ -0,0 +1,110 @@
+//
+//  DeferredContexts.h
+//
+//	D3D11 deferred contexts for recording drawcalls on worker threads
+//
+
+#pragma once
+#ifndef DEFERREDCONTEXTS_H
+#define DEFERREDCONTEXTS_H
+
+#include <vector>
+#include "stdafx.h"
+#include "D3D11MaterialBinder.h"
+
+//
+// The pipeline state the scene renders with, captured from the immediate
+// context. Deferred contexts start from the default state, so each
+// command list begins by applying it.
+//
+struct PipelineState
+{
+	static const unsigned MaxConstantBuffers = 4;
+	static const unsigned MaxSamplers = 4;
+	static const unsigned MaxShaderResources = 8;
+	static const unsigned MaxViewports = 4;
+
+	ID3D11InputLayout* input_layout = nullptr;
+	D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	ID3D11VertexShader* vertex_shader = nullptr;
+	ID3D11PixelShader* pixel_shader = nullptr;
+	ID3D11Buffer* vs_constant_buffers[MaxConstantBuffers] = {};
+	ID3D11Buffer* ps_constant_buffers[MaxConstantBuffers] = {};
+	ID3D11SamplerState* ps_samplers[MaxSamplers] = {};
+	ID3D11ShaderResourceView* ps_shader_resources[MaxShaderResources] = {};	// e.g. the light clusters
+	ID3D11RasterizerState* rasterizer_state = nullptr;
+	D3D11_VIEWPORT viewports[MaxViewports];
+	UINT nbr_viewports = 0;
+	ID3D11RenderTargetView* render_target = nullptr;
+	ID3D11DepthStencilView* depth_stencil = nullptr;
+	ID3D11DepthStencilState* depth_stencil_state = nullptr;
+	UINT stencil_ref = 0;
+	ID3D11BlendState* blend_state = nullptr;
+	float blend_factor[4] = {};
+	UINT sample_mask = 0xffffffff;
+
+	// Release the previous capture and take references to the current state
+	void Capture(ID3D11DeviceContext* context);
+
+	void Apply(ID3D11DeviceContext* context) const;
+
+	void Release();
+
+	~PipelineState() { Release(); }
+};
+
+//
+// A set of deferred contexts, each with its own material binder, recorded
+// into command lists that are executed on the immediate context.
+//
+// Per frame: Capture() on the thread that owns the immediate context, then
+// Begin(i) ... Finish(i) on one thread per context, then Execute(i) for all
+// contexts in order, again on the immediate context's thread.
+//
+class DeferredContexts
+{
+	struct Context
+	{
+		ID3D11DeviceContext* context = nullptr;
+		D3D11MaterialBinder* material_binder = nullptr;
+		ID3D11CommandList* command_list = nullptr;
+	};
+
+	ID3D11DeviceContext* const immediate_context;
+	std::vector<Context> contexts;
+	PipelineState state;
+
+public:
+	DeferredContexts(
+		ID3D11Device* dxdevice,
+		ID3D11DeviceContext* immediate_context,
+		unsigned nbr_contexts);
+
+	unsigned Size() const { return (unsigned)contexts.size(); }
+
+	void Capture() { state.Capture(immediate_context); }
+
+	// Start recording: applies the captured state and returns the context
+	ID3D11DeviceContext* Begin(unsigned i);
+
+	MaterialBinder* GetMaterialBinder(unsigned i) const { return contexts[i].material_binder; }
+
+	void Finish(unsigned i);
+
+	// Execute the command list of context i, and keep the immediate state
+	void Execute(unsigned i);
+
+	// Material binder counters, summed over the contexts
+	unsigned GetUploadCount() const;
+
+	unsigned GetSkippedCount() const;
+
+	unsigned GetShaderSwitchCount() const;
+
+	// Pixel shader permutations for the material binders of all contexts
+	void SetPixelShaders(const PixelShaderPermutations* pixel_shaders);
+
+	~DeferredContexts();
+};
+
+#endif
@@ -10,22 +10,16 @@
 #define MATERIAL_H
 
 #include <iostream>
+#include <string>
 #include <vector>
 #include <unordered_map>
-#include "stdafx.h"
 #include "vec/vec.h"
 
+#include "Vertex.h"
 #include "Texture.h"
 
 using namespace linalg;
 
-struct Vertex
-{
-	vec3f Pos;
-	vec3f Normal, Tangent, Binormal;
-	vec2f TexCoord;
-};
-
 //
 // Phong-esque material
 //
@@ -40,10 +34,15 @@ struct Material
 	// File paths to textures
 	std::string Kd_texture_filename;
 	std::string normal_texture_filename;
+	std::string Ks_texture_filename;
+	std::string mask_texture_filename;		// Alpha mask (map_d)
 	// + more texture types (extend OBJLoader::LoadMaterials if needed)
 
-	// Device textures
+	// Device textures, each enabling a pixel shader feature (see ShaderPermutation.h)
 	Texture diffuse_texture;
+	Texture normal_texture;
+	Texture specular_texture;
+	Texture mask_texture;
 	// + other texture types
 };
 
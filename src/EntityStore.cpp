@@ -0,0 +1,151 @@
+//
+//  EntityStore.cpp
+//
+//	Scene entities stored as Structure-of-Arrays components
+//
+
+#include <stdexcept>
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+EntityHandle EntityStore::Create(Model* model, const AABB& bounds, EntityHandle parent)
+{
+	const unsigned parent_index = parent.IsNull() ? TransformHierarchy::InvalidIndex : GetIndex(parent);
+
+	// Reuse a free slot that comes after the parent, or append one
+	unsigned index = TransformHierarchy::InvalidIndex;
+	for (size_t i = 0; i < free_slots.size(); i++)
+	{
+		if (parent_index == TransformHierarchy::InvalidIndex || free_slots[i] > parent_index)
+		{
+			index = free_slots[i];
+			free_slots[i] = free_slots.back();
+			free_slots.pop_back();
+			break;
+		}
+	}
+
+	if (index == TransformHierarchy::InvalidIndex)
+	{
+		index = transforms.AddNode(parent_index);
+		local_bounds.push_back(bounds);
+		world_bounds.push_back(AABB());
+		normal_matrices.push_back(mat4f_identity);
+		models.push_back(model);
+		generations.push_back(0);
+		alive.push_back(1);
+	}
+	else
+	{
+		transforms.SetParent(index, parent_index);
+		transforms.SetLocal(index, vec3f_zero, quatf_identity, vec3f(1, 1, 1));
+		local_bounds[index] = bounds;
+		world_bounds[index] = AABB();
+		normal_matrices[index] = mat4f_identity;
+		models[index] = model;
+		alive[index] = 1;
+	}
+
+	EntityHandle entity;
+	entity.index = index;
+	entity.generation = generations[index];
+	return entity;
+}
+
+void EntityStore::Destroy(EntityHandle entity)
+{
+	const unsigned index = GetIndex(entity);
+
+	auto release = [this](unsigned i)
+	{
+		alive[i] = 0;
+		models[i] = nullptr;
+		world_bounds[i] = AABB();
+		generations[i]++;
+		free_slots.push_back(i);
+	};
+	release(index);
+
+	// Descendants come after their parents: one forward sweep finds them all
+	for (unsigned i = index + 1; i < Size(); i++)
+	{
+		const unsigned p = transforms.GetParent(i);
+		if (alive[i] && p != TransformHierarchy::InvalidIndex && !alive[p])
+			release(i);
+	}
+}
+
+bool EntityStore::IsAlive(EntityHandle entity) const
+{
+	return !entity.IsNull() &&
+		entity.index < Size() &&
+		alive[entity.index] &&
+		generations[entity.index] == entity.generation;
+}
+
+unsigned EntityStore::GetIndex(EntityHandle entity) const
+{
+	if (!IsAlive(entity))
+		throw std::runtime_error("EntityStore: stale or null entity handle");
+	return entity.index;
+}
+
+void EntityStore::SetLocal(EntityHandle entity, const vec3f& position, const quatf& rotation, const vec3f& scale)
+{
+	transforms.SetLocal(GetIndex(entity), position, rotation, scale);
+}
+
+void EntityStore::SetPosition(EntityHandle entity, const vec3f& position)
+{
+	transforms.SetPosition(GetIndex(entity), position);
+}
+
+void EntityStore::SetRotation(EntityHandle entity, const quatf& rotation)
+{
+	transforms.SetRotation(GetIndex(entity), rotation);
+}
+
+void EntityStore::SetScale(EntityHandle entity, const vec3f& scale)
+{
+	transforms.SetScale(GetIndex(entity), scale);
+}
+
+// Entities per job when updating normal matrices and bounds
+static const unsigned UpdateGrain = 256;
+
+void EntityStore::Update(JobSystem* jobs)
+{
+	PROFILE_ZONE("Entity transforms");
+
+	if (!transforms.Update())
+		return;
+
+	auto update_range = [this](unsigned begin, unsigned end)
+	{
+		for (unsigned i = begin; i < end; i++)
+		{
+			if (!transforms.WasUpdated(i) || !alive[i])
+				continue;
+			normal_matrices[i] = normal_matrix(transforms.GetWorldMatrix(i));
+			if (!local_bounds[i].IsEmpty())
+				world_bounds[i] = TransformAABB(transforms.GetWorldMatrix(i), local_bounds[i]);
+		}
+	};
+
+	if (jobs)
+		jobs->ParallelFor(0, Size(), UpdateGrain, update_range);
+	else
+		update_range(0, Size());
+}
+
+void EntityStore::Reserve(size_t n)
+{
+	transforms.Reserve(n);
+	local_bounds.reserve(n);
+	world_bounds.reserve(n);
+	normal_matrices.reserve(n);
+	models.reserve(n);
+	generations.reserve(n);
+	alive.reserve(n);
+}
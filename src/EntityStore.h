@@ -0,0 +1,115 @@
+//
+//  EntityStore.h
+//
+//	Scene entities stored as Structure-of-Arrays components
+//
+
+#pragma once
+#ifndef ENTITYSTORE_H
+#define ENTITYSTORE_H
+
+#include <vector>
+#include "Culling.h"
+#include "TransformHierarchy.h"
+#include "MemoryTracker.h"
+
+class Model;
+class JobSystem;
+
+//
+// Stable reference to an entity. The generation tells a live entity
+// apart from an earlier one that occupied the same slot.
+//
+struct EntityHandle
+{
+	unsigned index = ~0u;
+	unsigned generation = 0;
+
+	bool IsNull() const { return index == ~0u; }
+};
+
+//
+// Entities with a transform, a world matrix, world-space bounds and a render
+// handle. Each component is a contiguous array indexed by entity slot, so
+// per-frame loops stream through the hot data (transforms, bounds) without
+// touching the models. Slots coincide with the nodes of the transform
+// hierarchy; a parent's slot always precedes its children's.
+//
+// References to world matrices stay valid until entities are created.
+//
+class EntityStore
+{
+public:
+	//
+	// Create an entity. bounds are the model-space bounds of the model, which
+	// may be null (with empty bounds) for pure transform nodes. A destroyed
+	// slot is reused if it comes after the parent's.
+	//
+	EntityHandle Create(Model* model, const AABB& bounds, EntityHandle parent = EntityHandle());
+
+	//
+	// Destroy an entity and all its descendants
+	//
+	void Destroy(EntityHandle entity);
+
+	bool IsAlive(EntityHandle entity) const;
+
+	//
+	// Slot of a live entity; throws if the handle is stale
+	//
+	unsigned GetIndex(EntityHandle entity) const;
+
+	void SetLocal(EntityHandle entity, const vec3f& position, const quatf& rotation, const vec3f& scale);
+	void SetPosition(EntityHandle entity, const vec3f& position);
+	void SetRotation(EntityHandle entity, const quatf& rotation);
+	void SetScale(EntityHandle entity, const vec3f& scale);
+
+	//
+	// Update world matrices of moved entities, then their normal matrices
+	// and world bounds; the latter in parallel if jobs is given
+	//
+	void Update(JobSystem* jobs = nullptr);
+
+	//
+	// Per-slot access, for linear loops over all slots
+	//
+	unsigned Size() const { return (unsigned)models.size(); }
+
+	bool IsAlive(unsigned index) const { return alive[index] != 0; }
+
+	Model* GetModel(unsigned index) const { return models[index]; }
+
+	const mat4f& GetWorldMatrix(unsigned index) const { return transforms.GetWorldMatrix(index); }
+
+	const AABB& GetWorldBounds(unsigned index) const { return world_bounds[index]; }
+
+	//
+	// Inverse-transpose of the world matrix, for transforming normals
+	//
+	const mat4f& GetNormalMatrix(unsigned index) const { return normal_matrices[index]; }
+
+	//
+	// True if the entity moved in the last Update()
+	//
+	bool WasUpdated(unsigned index) const { return transforms.WasUpdated(index); }
+
+	const mat4f& GetWorldMatrix(EntityHandle entity) const { return GetWorldMatrix(GetIndex(entity)); }
+
+	const mat4f& GetNormalMatrix(EntityHandle entity) const { return GetNormalMatrix(GetIndex(entity)); }
+
+	const TransformHierarchy& GetTransforms() const { return transforms; }
+
+	void Reserve(size_t n);
+
+private:
+	TransformHierarchy transforms;
+	TaggedVector<AABB, MemoryTag::Scene> local_bounds;
+	TaggedVector<AABB, MemoryTag::Scene> world_bounds;
+	TaggedVector<mat4f, MemoryTag::Scene> normal_matrices;
+	TaggedVector<Model*, MemoryTag::Scene> models;
+	TaggedVector<unsigned, MemoryTag::Scene> generations;
+	TaggedVector<unsigned char, MemoryTag::Scene> alive;
+	TaggedVector<unsigned, MemoryTag::Scene> free_slots;
+};
+
+#endif
@@ -0,0 +1,150 @@
+//
+//  FrameAllocator.cpp
+//
+//	Double-buffered linear allocator for per-frame scratch data
+//
+
+#include <algorithm>
+#include <new>
+#include "FrameAllocator.h"
+#include "MemoryTracker.h"
+
+// Ids of frame allocators, so that a thread's cached sub-arena is never used
+// with another allocator at the same address
+static std::atomic<unsigned> next_allocator_id(1);
+
+// The sub-arena of the current thread in the allocator it last allocated from
+static thread_local unsigned cached_allocator = 0;
+static thread_local void* cached_arena = nullptr;
+
+FrameAllocator::FrameAllocator(size_t block_size) :
+	id(next_allocator_id.fetch_add(1, std::memory_order_relaxed)),
+	block_size(block_size)
+{ }
+
+FrameAllocator::~FrameAllocator()
+{
+	for (SubArena* arena : arenas)
+	{
+		for (Buffer& buffer : arena->buffers)
+			for (const Block& block : buffer.blocks)
+				TaggedFree(MemoryTag::Transient, block.data);
+		delete arena;
+	}
+}
+
+void FrameAllocator::BeginFrame()
+{
+	frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* FrameAllocator::Allocate(size_t bytes, size_t alignment)
+{
+	SubArena& arena = GetThreadArena();
+	const unsigned long long current = frame.load(std::memory_order_relaxed);
+	Buffer& buffer = arena.buffers[current % FramesInFlight];
+	if (buffer.frame != current)
+	{
+		Reset(buffer);
+		buffer.frame = current;
+	}
+
+	// Bump within the last block, or chain one that fits
+	size_t offset = 0;
+	if (!buffer.blocks.empty())
+	{
+		const size_t base = (size_t)buffer.blocks.back().data;
+		offset = ((base + buffer.used + alignment - 1) & ~(alignment - 1)) - base;
+	}
+	if (buffer.blocks.empty() || offset + bytes > buffer.blocks.back().size)
+	{
+		AddBlock(buffer, bytes + alignment);
+		const size_t base = (size_t)buffer.blocks.back().data;
+		offset = ((base + alignment - 1) & ~(alignment - 1)) - base;
+	}
+
+	buffer.used = offset + bytes;
+	buffer.frame_bytes += bytes;
+	return buffer.blocks.back().data + offset;
+}
+
+size_t FrameAllocator::GetFrameBytes() const
+{
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	const unsigned long long current = frame.load(std::memory_order_relaxed);
+	size_t bytes = 0;
+	for (const SubArena* arena : arenas)
+	{
+		const Buffer& buffer = arena->buffers[current % FramesInFlight];
+		if (buffer.frame == current)
+			bytes += buffer.frame_bytes;
+	}
+	return bytes;
+}
+
+size_t FrameAllocator::GetCapacity() const
+{
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	size_t bytes = 0;
+	for (const SubArena* arena : arenas)
+		for (const Buffer& buffer : arena->buffers)
+			for (const Block& block : buffer.blocks)
+				bytes += block.size;
+	return bytes;
+}
+
+FrameAllocator::SubArena& FrameAllocator::GetThreadArena()
+{
+	if (cached_allocator != id)
+	{
+		std::lock_guard<std::mutex> lock(arenas_mutex);
+
+		const std::thread::id thread = std::this_thread::get_id();
+		SubArena* found = nullptr;
+		for (SubArena* arena : arenas)
+			if (arena->thread == thread)
+				found = arena;
+
+		if (!found)
+		{
+			found = new SubArena;
+			found->thread = thread;
+			arenas.push_back(found);
+		}
+
+		cached_allocator = id;
+		cached_arena = found;
+	}
+
+	return *static_cast<SubArena*>(cached_arena);
+}
+
+void FrameAllocator::Reset(Buffer& buffer)
+{
+	// Merge the blocks the last use of the buffer needed into one
+	if (buffer.blocks.size() > 1)
+	{
+		size_t total = 0;
+		for (const Block& block : buffer.blocks)
+		{
+			total += block.size;
+			TaggedFree(MemoryTag::Transient, block.data);
+		}
+		buffer.blocks.clear();
+		AddBlock(buffer, total);
+	}
+
+	buffer.used = 0;
+	buffer.frame_bytes = 0;
+}
+
+void FrameAllocator::AddBlock(Buffer& buffer, size_t min_size)
+{
+	Block block;
+	block.size = std::max(block_size, min_size);
+	block.data = static_cast<char*>(TaggedMalloc(MemoryTag::Transient, block.size));
+	if (!block.data)
+		throw std::bad_alloc();
+	buffer.blocks.push_back(block);
+	buffer.used = 0;
+}
@@ -0,0 +1,132 @@
+//
+//  FrameAllocator.h
+//
+//	Double-buffered linear allocator for per-frame scratch data
+//
+
+#pragma once
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//
+// Scratch memory that lives for a frame, e.g. draw lists, culling results
+// and sort keys. Allocation bumps a pointer in a sub-arena of the calling
+// thread, so threads do not contend. Nothing is freed on its own: memory
+// allocated in a frame stays valid through the next frame, so a frame may
+// be updated while the previous one is rendered, and is reused by the
+// second BeginFrame() after it.
+//
+// A sub-arena that runs out chains another block from the heap. When it is
+// reused, its blocks are merged into one of their total size, so once the
+// frames stop growing a frame does not allocate from the heap.
+//
+// Only for trivially destructible data: destructors are not run.
+//
+class FrameAllocator
+{
+public:
+	static const unsigned FramesInFlight = 2;
+
+	explicit FrameAllocator(size_t block_size = 64 * 1024);
+
+	~FrameAllocator();
+
+	FrameAllocator(const FrameAllocator&) = delete;
+
+	FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+	//
+	// Start a new frame. Not concurrently with Allocate(); the memory of the
+	// frame FramesInFlight frames back is reused.
+	//
+	void BeginFrame();
+
+	// Alignment is a power of two
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	template <class T>
+	T* AllocateArray(size_t n) { return static_cast<T*>(Allocate(n * sizeof(T), alignof(T))); }
+
+	unsigned long long GetFrame() const { return frame.load(std::memory_order_relaxed); }
+
+	// Bytes allocated this frame by all threads. Not concurrently with Allocate().
+	size_t GetFrameBytes() const;
+
+	// Bytes of the blocks of all sub-arenas
+	size_t GetCapacity() const;
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	// The memory of one frame of a sub-arena
+	struct Buffer
+	{
+		std::vector<Block> blocks;		// The last is allocated from
+		size_t used = 0;				// Bytes used of the last block
+		size_t frame_bytes = 0;			// Bytes allocated this frame
+		unsigned long long frame = ~0ull;	// Frame the buffer was last reset for
+	};
+
+	struct SubArena
+	{
+		std::thread::id thread;
+		Buffer buffers[FramesInFlight];
+	};
+
+	const unsigned id;		// Tells apart the allocators cached by threads
+	const size_t block_size;
+	std::atomic<unsigned long long> frame{ 0 };
+
+	mutable std::mutex arenas_mutex;
+	std::vector<SubArena*> arenas;
+
+	SubArena& GetThreadArena();
+
+	void Reset(Buffer& buffer);
+
+	void AddBlock(Buffer& buffer, size_t min_size);
+};
+
+//
+// Standard library allocator on a FrameAllocator. Containers using it must
+// be recreated every frame, not cleared, since their memory expires.
+//
+template <class T>
+struct FrameStlAllocator
+{
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+
+	FrameAllocator* frame_allocator;
+
+	FrameStlAllocator(FrameAllocator& frame_allocator) : frame_allocator(&frame_allocator) { }
+
+	template <class U>
+	FrameStlAllocator(const FrameStlAllocator<U>& other) : frame_allocator(other.frame_allocator) { }
+
+	T* allocate(size_t n) { return frame_allocator->AllocateArray<T>(n); }
+
+	void deallocate(T*, size_t) { }
+
+	template <class U>
+	bool operator==(const FrameStlAllocator<U>& other) const { return frame_allocator == other.frame_allocator; }
+
+	template <class U>
+	bool operator!=(const FrameStlAllocator<U>& other) const { return frame_allocator != other.frame_allocator; }
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+
+#endif
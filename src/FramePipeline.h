@@ -0,0 +1,79 @@
+//
+//  FramePipeline.h
+//
+//	Overlaps the update of the next frame with rendering of the current one
+//
+
+#pragma once
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include "JobSystem.h"
+
+//
+// Snapshots of the state rendering needs, one per frame in flight: the
+// update of frame N+1 writes one while frame N is rendered from the other.
+// Per frame, on the rendering thread:
+//
+//	BeginFrame()	starts the update of the next frame, writing GetUpdated()
+//	...				renders the current frame from GetRendered()
+//	EndFrame()		waits for the update; its snapshot is rendered next frame
+//
+// The update runs as a job on a worker thread, so that it overlaps the
+// rendering between BeginFrame() and EndFrame(). With a single-threaded job
+// system or none it runs before BeginFrame() returns. Either way the same
+// snapshots are rendered in the same order.
+// Before the first frame, GetRendered() holds the initial state.
+//
+template <class Snapshot>
+class FramePipeline
+{
+public:
+	// The frame being updated and the frame being rendered
+	static const unsigned FramesInFlight = 2;
+
+	//
+	// Start update(data), which writes GetUpdated() and must not touch
+	// GetRendered(). jobs may be null.
+	//
+	void BeginFrame(JobSystem* jobs, JobFunction update, void* data)
+	{
+		if (jobs)
+		{
+			this->jobs = jobs;
+			jobs->RunOnWorker(update, data, &updating);
+		}
+		else
+			update(data);
+	}
+
+	// Wait for the update and hand its snapshot over to rendering
+	void EndFrame()
+	{
+		if (jobs)
+			jobs->Wait(updating);
+		jobs = nullptr;
+
+		rendered = (rendered + 1) % FramesInFlight;
+		nbr_frames++;
+	}
+
+	const Snapshot& GetRendered() const { return snapshots[rendered]; }
+
+	Snapshot& GetRendered() { return snapshots[rendered]; }
+
+	Snapshot& GetUpdated() { return snapshots[(rendered + 1) % FramesInFlight]; }
+
+	// Frames completed by EndFrame()
+	unsigned GetFrameCount() const { return nbr_frames; }
+
+private:
+	Snapshot snapshots[FramesInFlight];
+	unsigned rendered = 0;
+	unsigned nbr_frames = 0;
+
+	JobSystem* jobs = nullptr;
+	JobCounter updating;
+};
+
+#endif
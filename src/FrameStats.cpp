@@ -0,0 +1,94 @@
+//
+//  FrameStats.cpp
+//
+//	Frame-time percentiles and hitch counts over a ring of recent frames
+//
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "FrameStats.h"
+
+// Weight of the latest frame in the moving average
+static const float AverageWeight = 0.1f;
+
+FrameStats::FrameStats(unsigned capacity, float hitch_factor) :
+	capacity(capacity),
+	hitch_factor(hitch_factor)
+{
+	if (!capacity)
+		throw std::runtime_error("FrameStats: capacity must be at least one frame");
+	times.reserve(capacity);
+	hitch.reserve(capacity);
+	sorted.reserve(capacity);
+}
+
+void FrameStats::AddFrame(float dt)
+{
+	const float ms = dt * 1000.0f;
+
+	// The first frame only starts the average
+	const bool is_hitch = nbr_frames > 0 && ms > hitch_factor * average;
+	average = nbr_frames > 0 ? average + (ms - average) * AverageWeight : ms;
+
+	if (times.size() < capacity)
+	{
+		times.push_back(ms);
+		hitch.push_back(is_hitch ? 1 : 0);
+	}
+	else
+	{
+		times[next] = ms;
+		hitch[next] = is_hitch ? 1 : 0;
+	}
+	next = (next + 1) % capacity;
+
+	nbr_frames++;
+	if (is_hitch)
+		nbr_hitches++;
+}
+
+FrameStats::Summary FrameStats::GetSummary() const
+{
+	Summary summary;
+	if (times.empty())
+		return summary;
+
+	sorted.assign(times.begin(), times.end());
+	std::sort(sorted.begin(), sorted.end());
+
+	// Nearest-rank percentile
+	auto percentile = [this](double p)
+	{
+		const size_t rank = (size_t)std::ceil(p * sorted.size());
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	};
+
+	double sum = 0;
+	for (float t : sorted)
+		sum += t;
+
+	summary.frames = (unsigned)sorted.size();
+	summary.avg = (float)(sum / sorted.size());
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	summary.max = sorted.back();
+	for (unsigned char h : hitch)
+		summary.hitches += h;
+	return summary;
+}
+
+void FrameStats::WriteCSV(std::ostream& out) const
+{
+	const unsigned n = (unsigned)times.size();
+	const unsigned oldest = n < capacity ? 0 : next;
+	const unsigned first_frame = nbr_frames - n;
+
+	out << "frame,ms,hitch" << std::endl;
+	for (unsigned i = 0; i < n; i++)
+	{
+		const unsigned j = (oldest + i) % n;
+		out << first_frame + i << "," << times[j] << "," << (unsigned)hitch[j] << std::endl;
+	}
+}
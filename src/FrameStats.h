@@ -0,0 +1,62 @@
+//
+//  FrameStats.h
+//
+//	Frame-time percentiles and hitch counts over a ring of recent frames
+//
+
+#pragma once
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <ostream>
+#include <vector>
+
+//
+// Frame times of the last capacity frames. A frame is a hitch if it takes
+// longer than hitch_factor times the moving average of the frames before.
+//
+class FrameStats
+{
+public:
+	// Milliseconds, over the frames in the ring
+	struct Summary
+	{
+		unsigned frames = 0;
+		float avg = 0;
+		float p50 = 0;
+		float p95 = 0;
+		float p99 = 0;
+		float max = 0;
+		unsigned hitches = 0;
+	};
+
+	explicit FrameStats(unsigned capacity = 4096, float hitch_factor = 2.0f);
+
+	// Add a frame time, in seconds
+	void AddFrame(float dt);
+
+	// Frames and hitches since construction, including those out of the ring
+	unsigned GetFrameCount() const { return nbr_frames; }
+
+	unsigned GetHitchCount() const { return nbr_hitches; }
+
+	Summary GetSummary() const;
+
+	// The frames in the ring, oldest first, as "frame,ms,hitch" lines with a header
+	void WriteCSV(std::ostream& out) const;
+
+private:
+	const unsigned capacity;
+	const float hitch_factor;
+
+	std::vector<float> times;				// ms, a ring once full
+	std::vector<unsigned char> hitch;		// Per entry of times
+	mutable std::vector<float> sorted;		// Scratch of GetSummary(), kept to not allocate per call
+	unsigned next = 0;
+
+	float average = 0;						// Moving average in ms
+	unsigned nbr_frames = 0;
+	unsigned nbr_hitches = 0;
+};
+
+#endif
@@ -0,0 +1,141 @@
+//
+//  GpuProfiler.cpp
+//
+//	GPU zones timed with D3D11 timestamp queries
+//
+
+#include <thread>
+#include "GpuProfiler.h"
+
+// Zone index of BeginZone() calls past MaxZones, which are not timed
+static const unsigned DroppedZone = ~0u;
+
+GpuProfiler::GpuProfiler(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context,
+	Profiler& profiler)
+	: dxdevice_context(dxdevice_context),
+	profiler(profiler)
+{
+	for (Frame& frame : frames)
+	{
+		frame.disjoint = CreateQuery(dxdevice, D3D11_QUERY_TIMESTAMP_DISJOINT);
+		frame.begin = CreateQuery(dxdevice, D3D11_QUERY_TIMESTAMP);
+		for (Zone& zone : frame.zones)
+		{
+			zone.begin = CreateQuery(dxdevice, D3D11_QUERY_TIMESTAMP);
+			zone.end = CreateQuery(dxdevice, D3D11_QUERY_TIMESTAMP);
+		}
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (Frame& frame : frames)
+	{
+		SAFE_RELEASE(frame.disjoint);
+		SAFE_RELEASE(frame.begin);
+		for (Zone& zone : frame.zones)
+		{
+			SAFE_RELEASE(zone.begin);
+			SAFE_RELEASE(zone.end);
+		}
+	}
+}
+
+ID3D11Query* GpuProfiler::CreateQuery(ID3D11Device* dxdevice, D3D11_QUERY type)
+{
+	HRESULT hr;
+	D3D11_QUERY_DESC desc = { type, 0 };
+	ID3D11Query* query = nullptr;
+	ASSERT(hr = dxdevice->CreateQuery(&desc, &query));
+	return query;
+}
+
+void GpuProfiler::BeginFrame()
+{
+	// The queries of this slot are reused: wait for the frame that used them
+	Frame& frame = frames[current];
+	if (frame.pending)
+		Collect(frame, true);
+
+	frame.nbr_zones = 0;
+	frame.cpu_begin = profiler.Now();
+	open_zones.clear();
+
+	dxdevice_context->Begin(frame.disjoint);
+	dxdevice_context->End(frame.begin);
+}
+
+void GpuProfiler::BeginZone(const char* name)
+{
+	Frame& frame = frames[current];
+	if (frame.nbr_zones == MaxZones)
+	{
+		open_zones.push_back(DroppedZone);
+		return;
+	}
+
+	Zone& zone = frame.zones[frame.nbr_zones];
+	zone.name = name;
+	dxdevice_context->End(zone.begin);
+	open_zones.push_back(frame.nbr_zones++);
+}
+
+void GpuProfiler::EndZone()
+{
+	const unsigned index = open_zones.back();
+	open_zones.pop_back();
+	if (index != DroppedZone)
+		dxdevice_context->End(frames[current].zones[index].end);
+}
+
+void GpuProfiler::EndFrame()
+{
+	dxdevice_context->End(frames[current].disjoint);
+	frames[current].pending = true;
+	current = (current + 1) % FramesInFlight;
+
+	// Read back the frames the GPU has finished, oldest first
+	for (unsigned i = 0; i < FramesInFlight; i++)
+	{
+		Frame& frame = frames[(current + i) % FramesInFlight];
+		if (frame.pending && !Collect(frame, false))
+			break;
+	}
+}
+
+bool GpuProfiler::Collect(Frame& frame, bool wait)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	HRESULT hr;
+	while ((hr = dxdevice_context->GetData(frame.disjoint, &disjoint, sizeof(disjoint), wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH)) == S_FALSE)
+	{
+		if (!wait)
+			return false;
+		std::this_thread::yield();
+	}
+	frame.pending = false;
+
+	// The timestamps are complete once the disjoint query is
+	UINT64 frame_begin;
+	if (FAILED(hr) || disjoint.Disjoint ||
+		dxdevice_context->GetData(frame.begin, &frame_begin, sizeof(frame_begin), 0) != S_OK)
+		return true;
+
+	const double ns_per_tick = 1e9 / disjoint.Frequency;
+	for (unsigned i = 0; i < frame.nbr_zones; i++)
+	{
+		const Zone& zone = frame.zones[i];
+		UINT64 begin, end;
+		if (dxdevice_context->GetData(zone.begin, &begin, sizeof(begin), 0) != S_OK ||
+			dxdevice_context->GetData(zone.end, &end, sizeof(end), 0) != S_OK)
+			continue;
+
+		profiler.RecordGpu(
+			zone.name,
+			frame.cpu_begin + (unsigned long long)((begin - frame_begin) * ns_per_tick),
+			frame.cpu_begin + (unsigned long long)((end - frame_begin) * ns_per_tick));
+	}
+	return true;
+}
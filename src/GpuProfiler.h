@@ -0,0 +1,105 @@
+//
+//  GpuProfiler.h
+//
+//	GPU zones timed with D3D11 timestamp queries
+//
+
+#pragma once
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vector>
+#include "stdafx.h"
+#include "Profiler.h"
+
+//
+// Times zones of the immediate context on the GPU and records them to a
+// Profiler. Per frame, on the immediate context's thread:
+//
+//	BeginFrame()
+//	BeginZone("Pass") ... EndZone()		nested, up to MaxZones per frame
+//	EndFrame()
+//
+// Results are read FramesInFlight frames later, without stalling unless
+// the GPU is that far behind. GPU times are placed on the profiler's clock
+// by aligning the start of each frame with the CPU time of BeginFrame().
+// Frames in which the GPU clock was disjoint are skipped.
+//
+class GpuProfiler
+{
+public:
+	static const unsigned MaxZones = 16;
+	static const unsigned FramesInFlight = 4;
+
+	GpuProfiler(
+		ID3D11Device* dxdevice,
+		ID3D11DeviceContext* dxdevice_context,
+		Profiler& profiler = Profiler::Instance());
+
+	~GpuProfiler();
+
+	void BeginFrame();
+
+	void BeginZone(const char* name);
+
+	void EndZone();
+
+	void EndFrame();
+
+private:
+	struct Zone
+	{
+		const char* name = nullptr;
+		ID3D11Query* begin = nullptr;
+		ID3D11Query* end = nullptr;
+	};
+
+	struct Frame
+	{
+		ID3D11Query* disjoint = nullptr;
+		ID3D11Query* begin = nullptr;		// Timestamp at BeginFrame()
+		Zone zones[MaxZones];
+		unsigned nbr_zones = 0;
+		unsigned long long cpu_begin = 0;	// Profiler time at BeginFrame()
+		bool pending = false;				// Issued but not yet read back
+	};
+
+	ID3D11DeviceContext* const dxdevice_context;
+	Profiler& profiler;
+
+	Frame frames[FramesInFlight];
+	unsigned current = 0;
+	std::vector<unsigned> open_zones;		// Stack of zones begun but not ended
+
+	ID3D11Query* CreateQuery(ID3D11Device* dxdevice, D3D11_QUERY type);
+
+	// Read back a pending frame; false if its data is not ready and !wait
+	bool Collect(Frame& frame, bool wait);
+};
+
+//
+// Times the enclosing scope as a GPU zone
+//
+class GpuProfileZone
+{
+	GpuProfiler* profiler;
+
+public:
+	// A null profiler does nothing
+	GpuProfileZone(GpuProfiler* profiler, const char* name) : profiler(profiler)
+	{
+		if (profiler)
+			profiler->BeginZone(name);
+	}
+
+	~GpuProfileZone()
+	{
+		if (profiler)
+			profiler->EndZone();
+	}
+
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+};
+
+#endif
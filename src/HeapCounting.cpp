@@ -0,0 +1,137 @@
+//
+//  HeapCounting.cpp
+//
+//	Replacements of the global operator new and delete that count heap
+//	allocations for MemoryTracker
+//
+//	Opt-in: only executables that compile or link this file get the
+//	replacements, e.g. the tests and benchmarks through the CMake target
+//	edurend_heap_counting, and eduRend for ASSERT_NO_HEAP_ALLOCATIONS.
+//	It is not part of edurend_core.
+//
+
+#include <cstdlib>
+#include <new>
+#include "MemoryTracker.h"
+
+static void* HeapAllocate(size_t size)
+{
+	return std::malloc(size ? size : 1);
+}
+
+static void* HeapAllocateAligned(size_t size, std::align_val_t alignment)
+{
+	const size_t align = (size_t)alignment;
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	return std::aligned_alloc(align, size ? (size + align - 1) / align * align : align);
+#endif
+}
+
+static void HeapFreeAligned(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+//
+// As the standard requires of a replacement: on failure, call the new
+// handler and retry, or throw std::bad_alloc if there is none
+//
+static void* HeapAllocateOrThrow(size_t size)
+{
+	CountHeapAllocation();
+	for (;;)
+	{
+		if (void* p = HeapAllocate(size))
+			return p;
+		const std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+static void* HeapAllocateAlignedOrThrow(size_t size, std::align_val_t alignment)
+{
+	CountHeapAllocation();
+	for (;;)
+	{
+		if (void* p = HeapAllocateAligned(size, alignment))
+			return p;
+		const std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+// The nothrow forms return null where the others throw
+static void* HeapAllocateOrNull(size_t size) noexcept
+{
+	try
+	{
+		return HeapAllocateOrThrow(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+static void* HeapAllocateAlignedOrNull(size_t size, std::align_val_t alignment) noexcept
+{
+	try
+	{
+		return HeapAllocateAlignedOrThrow(size, alignment);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new(size_t size) { return HeapAllocateOrThrow(size); }
+
+void* operator new[](size_t size) { return HeapAllocateOrThrow(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return HeapAllocateOrNull(size); }
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return HeapAllocateOrNull(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void* operator new(size_t size, std::align_val_t alignment) { return HeapAllocateAlignedOrThrow(size, alignment); }
+
+void* operator new[](size_t size, std::align_val_t alignment) { return HeapAllocateAlignedOrThrow(size, alignment); }
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return HeapAllocateAlignedOrNull(size, alignment); }
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return HeapAllocateAlignedOrNull(size, alignment); }
+
+void operator delete(void* p, std::align_val_t) noexcept { HeapFreeAligned(p); }
+
+void operator delete[](void* p, std::align_val_t) noexcept { HeapFreeAligned(p); }
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept { HeapFreeAligned(p); }
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { HeapFreeAligned(p); }
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { HeapFreeAligned(p); }
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { HeapFreeAligned(p); }
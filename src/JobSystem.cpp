@@ -0,0 +1,344 @@
+//
+//  JobSystem.cpp
+//
+//	Work-stealing job scheduler with parallel-for and task graphs
+//
+
+#include <chrono>
+#include <stdexcept>
+#include "JobSystem.h"
+
+// The job system and deque index of the current thread
+static thread_local const JobSystem* current_job_system = nullptr;
+static thread_local unsigned current_thread_index = 0;
+
+// Failed attempts to find a job before an idle worker goes to sleep
+static const unsigned IdleSpinCount = 64;
+
+void WorkStealingDeque::Write(long long i, const Job& job)
+{
+	Slot& slot = slots[i & (Capacity - 1)];
+	slot.function.store(job.function, std::memory_order_relaxed);
+	slot.data.store(job.data, std::memory_order_relaxed);
+	slot.counter.store(job.counter, std::memory_order_relaxed);
+}
+
+Job WorkStealingDeque::Read(long long i) const
+{
+	const Slot& slot = slots[i & (Capacity - 1)];
+	Job job;
+	job.function = slot.function.load(std::memory_order_relaxed);
+	job.data = slot.data.load(std::memory_order_relaxed);
+	job.counter = slot.counter.load(std::memory_order_relaxed);
+	return job;
+}
+
+bool WorkStealingDeque::Push(const Job& job)
+{
+	const long long b = bottom.load(std::memory_order_relaxed);
+	const long long t = top.load(std::memory_order_acquire);
+	if (b - t >= (long long)Capacity)
+		return false;
+
+	Write(b, job);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool WorkStealingDeque::Pop(Job& job)
+{
+	const long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = Read(b);
+	if (t == b)
+	{
+		// Last job: race thieves for it
+		const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+bool WorkStealingDeque::Steal(Job& job)
+{
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const long long b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return false;
+
+	job = Read(t);
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem(unsigned nbr_threads)
+	: running(true),
+	nbr_worker_jobs(0),
+	nbr_sleeping(0)
+{
+	if (current_job_system)
+		throw std::runtime_error("JobSystem: this thread already has a job system");
+
+	if (nbr_threads == 0)
+		nbr_threads = std::thread::hardware_concurrency();
+	if (nbr_threads == 0)
+		nbr_threads = 1;
+
+	deques.resize(nbr_threads);
+	for (WorkStealingDeque*& deque : deques)
+		deque = new WorkStealingDeque();
+
+	current_job_system = this;
+	current_thread_index = 0;
+
+	workers.reserve(nbr_threads - 1);
+	for (unsigned i = 1; i < nbr_threads; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	running.store(false);
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		wake.notify_all();
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+
+	for (WorkStealingDeque* deque : deques)
+		delete deque;
+
+	if (current_job_system == this)
+		current_job_system = nullptr;
+}
+
+unsigned JobSystem::GetThreadIndex() const
+{
+	if (current_job_system != this)
+		throw std::runtime_error("JobSystem: jobs can only be queued from its creating thread or its jobs");
+	return current_thread_index;
+}
+
+bool JobSystem::HasQueuedJobs() const
+{
+	if (nbr_worker_jobs.load(std::memory_order_seq_cst) > 0)
+		return true;
+	for (const WorkStealingDeque* deque : deques)
+		if (!deque->IsEmpty())
+			return true;
+	return false;
+}
+
+void JobSystem::Run(JobFunction function, void* data, JobCounter* counter)
+{
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.counter = counter;
+
+	if (counter)
+		counter->Add();
+
+	if (!deques[GetThreadIndex()]->Push(job))
+	{
+		Execute(job);
+		return;
+	}
+	WakeWorker();
+}
+
+void JobSystem::RunOnWorker(JobFunction function, void* data, JobCounter* counter)
+{
+	GetThreadIndex();	// Throws for threads outside the job system, as Run() does
+
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.counter = counter;
+
+	if (counter)
+		counter->Add();
+
+	if (workers.empty())
+	{
+		Execute(job);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(worker_jobs_mutex);
+		worker_jobs.push_back(job);
+		nbr_worker_jobs.fetch_add(1, std::memory_order_relaxed);
+	}
+	WakeWorker();
+}
+
+void JobSystem::WakeWorker()
+{
+	// Pairs with the fence in WorkerLoop: either the worker sees the job,
+	// or this thread sees the worker going to sleep and wakes it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (nbr_sleeping.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		wake.notify_one();
+	}
+}
+
+bool JobSystem::TryTakeWorkerJob(Job& job)
+{
+	if (nbr_worker_jobs.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	std::lock_guard<std::mutex> lock(worker_jobs_mutex);
+	if (worker_jobs.empty())
+		return false;
+	job = worker_jobs.front();
+	worker_jobs.pop_front();
+	nbr_worker_jobs.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	const unsigned thread_index = GetThreadIndex();
+	unsigned random_state = thread_index * 7919 + 1;
+	while (!counter.IsDone())
+	{
+		if (!TryExecute(thread_index, random_state))
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::TryExecute(unsigned thread_index, unsigned& random_state)
+{
+	Job job;
+
+	// Worker jobs first: the thread that queued one is waiting to overlap with it
+	if (thread_index != 0 && TryTakeWorkerJob(job))
+	{
+		Execute(job);
+		return true;
+	}
+
+	if (deques[thread_index]->Pop(job))
+	{
+		Execute(job);
+		return true;
+	}
+
+	// Steal, starting from a random victim
+	const unsigned nbr_threads = GetThreadCount();
+	random_state = random_state * 1664525 + 1013904223;
+	const unsigned first = (random_state >> 16) % nbr_threads;
+	for (unsigned i = 0; i < nbr_threads; i++)
+	{
+		const unsigned victim = (first + i) % nbr_threads;
+		if (victim != thread_index && deques[victim]->Steal(job))
+		{
+			Execute(job);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	job.function(job.data);
+	if (job.counter)
+		job.counter->Done();
+}
+
+void JobSystem::WorkerLoop(unsigned thread_index)
+{
+	current_job_system = this;
+	current_thread_index = thread_index;
+
+	unsigned random_state = thread_index * 7919 + 1;
+	unsigned idle = 0;
+	while (running.load(std::memory_order_acquire))
+	{
+		if (TryExecute(thread_index, random_state))
+		{
+			idle = 0;
+			continue;
+		}
+		if (++idle < IdleSpinCount)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		nbr_sleeping.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (running.load(std::memory_order_acquire) && !HasQueuedJobs())
+			wake.wait_for(lock, std::chrono::milliseconds(10));
+		nbr_sleeping.fetch_sub(1, std::memory_order_relaxed);
+		idle = 0;
+	}
+}
+
+unsigned TaskGraph::AddTask(JobFunction function, void* data)
+{
+	Task task;
+	task.function = function;
+	task.data = data;
+	task.graph = this;
+	task.nbr_predecessors = 0;
+	tasks.push_back(task);
+	return (unsigned)tasks.size() - 1;
+}
+
+void TaskGraph::AddDependency(unsigned task, unsigned depends_on)
+{
+	if (task >= tasks.size() || depends_on >= task)
+		throw std::runtime_error("TaskGraph: a task can only depend on tasks added before it");
+
+	tasks[depends_on].successors.push_back(task);
+	tasks[task].nbr_predecessors++;
+}
+
+void TaskGraph::Run(JobSystem& jobs)
+{
+	this->jobs = &jobs;
+	if (pending.size() != tasks.size())
+		pending = std::vector<std::atomic<unsigned>>(tasks.size());
+	for (unsigned i = 0; i < tasks.size(); i++)
+		pending[i].store(tasks[i].nbr_predecessors, std::memory_order_relaxed);
+
+	for (Task& task : tasks)
+		if (task.nbr_predecessors == 0)
+			jobs.Run(&TaskGraph::Execute, &task, &counter);
+
+	jobs.Wait(counter);
+}
+
+void TaskGraph::Execute(void* data)
+{
+	Task& task = *(Task*)data;
+	task.function(task.data);
+
+	// Queue the successors this was the last predecessor of. They are
+	// counted before this task is, so the counter cannot reach zero early.
+	TaskGraph& graph = *task.graph;
+	for (unsigned successor : task.successors)
+	{
+		if (graph.pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			graph.jobs->Run(&TaskGraph::Execute, &graph.tasks[successor], &graph.counter);
+	}
+}
@@ -0,0 +1,272 @@
+//
+//  JobSystem.h
+//
+//	Work-stealing job scheduler with parallel-for and task graphs
+//
+
+#pragma once
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*JobFunction)(void* data);
+
+//
+// Number of unfinished jobs. Jobs run with a counter increment it when
+// queued and decrement it when done; JobSystem::Wait() waits for zero.
+//
+class JobCounter
+{
+	std::atomic<unsigned> count;
+
+public:
+	JobCounter() : count(0) { }
+
+	void Add(unsigned n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+
+	void Done() { count.fetch_sub(1, std::memory_order_release); }
+
+	bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	JobFunction function = nullptr;
+	void* data = nullptr;
+	JobCounter* counter = nullptr;
+};
+
+//
+// Fixed-size Chase-Lev deque (Chase & Lev 2005, with the C11 memory orders
+// of Le et al. 2013). The owning thread pushes and pops at the bottom, other
+// threads steal from the top.
+//
+class WorkStealingDeque
+{
+public:
+	static const unsigned Capacity = 4096;
+
+	WorkStealingDeque() : top(0), bottom(0) { }
+
+	// Owner only. False if the deque is full.
+	bool Push(const Job& job);
+
+	// Owner only: the most recently pushed job
+	bool Pop(Job& job);
+
+	// Any thread: the oldest job. False if empty or lost to another thread.
+	bool Steal(Job& job);
+
+	bool IsEmpty() const
+	{
+		return bottom.load(std::memory_order_seq_cst) <= top.load(std::memory_order_seq_cst);
+	}
+
+private:
+	// Fields are atomic so that a steal racing with a push to the same slot
+	// is not a data race; such a steal fails on the top CAS anyway
+	struct Slot
+	{
+		std::atomic<JobFunction> function;
+		std::atomic<void*> data;
+		std::atomic<JobCounter*> counter;
+	};
+
+	void Write(long long i, const Job& job);
+	Job Read(long long i) const;
+
+	// Kept on separate cache lines: thieves write top, the owner bottom
+	std::atomic<long long> top;
+	char pad0[64];
+	std::atomic<long long> bottom;
+	char pad1[64];
+	Slot slots[Capacity];
+};
+
+//
+// A pool of worker threads plus the thread that created it, each with a
+// deque of jobs. Idle threads steal from the others.
+//
+// Jobs may be queued from the creating thread and from jobs, and must not
+// throw. A thread waiting for a counter executes other jobs meanwhile, so
+// jobs may queue and wait for jobs of their own.
+//
+class JobSystem
+{
+public:
+	//
+	// nbr_threads includes the calling thread; 0 uses one thread per
+	// hardware thread. Only one JobSystem per creating thread.
+	//
+	explicit JobSystem(unsigned nbr_threads = 0);
+
+	~JobSystem();
+
+	unsigned GetThreadCount() const { return (unsigned)deques.size(); }
+
+	//
+	// Queue function(data) on the calling thread's deque. A full deque
+	// runs the job immediately instead.
+	//
+	void Run(JobFunction function, void* data, JobCounter* counter = nullptr);
+
+	//
+	// Queue function(data) for the worker threads only, so that it runs
+	// while the calling thread does other work instead of being popped by
+	// its Wait(). Without workers the job runs immediately.
+	//
+	void RunOnWorker(JobFunction function, void* data, JobCounter* counter = nullptr);
+
+	// Execute jobs until the counter reaches zero
+	void Wait(const JobCounter& counter);
+
+	//
+	// Call body(chunk_begin, chunk_end) for chunks of at most grain
+	// indices covering [begin, end), in parallel. Returns when all chunks
+	// are done.
+	//
+	template <class Body>
+	void ParallelFor(unsigned begin, unsigned end, unsigned grain, const Body& body);
+
+private:
+	std::vector<WorkStealingDeque*> deques;		// Deque 0 belongs to the creating thread
+	std::vector<std::thread> workers;			// Worker i owns deque i+1
+	std::atomic<bool> running;
+
+	// Jobs of RunOnWorker(), taken by workers before their own deque
+	std::mutex worker_jobs_mutex;
+	std::deque<Job> worker_jobs;
+	std::atomic<unsigned> nbr_worker_jobs;
+
+	// Idle workers sleep until a job is queued
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<unsigned> nbr_sleeping;
+
+	unsigned GetThreadIndex() const;
+
+	bool HasQueuedJobs() const;
+
+	void WakeWorker();
+
+	bool TryTakeWorkerJob(Job& job);
+
+	// Pop a job of this thread or steal one, and execute it
+	bool TryExecute(unsigned thread_index, unsigned& random_state);
+
+	void Execute(const Job& job);
+
+	void WorkerLoop(unsigned thread_index);
+};
+
+//
+// Shared state of a ParallelFor: chunks are claimed in order by the
+// calling thread and the helper jobs, whichever gets to them first
+//
+template <class Body>
+struct ParallelForRange
+{
+	const Body* body;
+	unsigned begin;
+	unsigned end;
+	unsigned grain;
+	unsigned nbr_chunks;
+	std::atomic<unsigned> next_chunk;
+
+	static void Execute(void* data)
+	{
+		ParallelForRange& range = *(ParallelForRange*)data;
+		for (;;)
+		{
+			const unsigned chunk = range.next_chunk.fetch_add(1, std::memory_order_relaxed);
+			if (chunk >= range.nbr_chunks)
+				return;
+
+			const unsigned chunk_begin = range.begin + chunk * range.grain;
+			const unsigned chunk_end = range.end - chunk_begin > range.grain ? chunk_begin + range.grain : range.end;
+			(*range.body)(chunk_begin, chunk_end);
+		}
+	}
+};
+
+template <class Body>
+void JobSystem::ParallelFor(unsigned begin, unsigned end, unsigned grain, const Body& body)
+{
+	if (begin >= end)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	const unsigned nbr_chunks = (end - begin - 1) / grain + 1;
+	if (nbr_chunks == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	ParallelForRange<Body> range;
+	range.body = &body;
+	range.begin = begin;
+	range.end = end;
+	range.grain = grain;
+	range.nbr_chunks = nbr_chunks;
+	range.next_chunk.store(0, std::memory_order_relaxed);
+
+	// One helper per other thread, as far as there are chunks for them
+	JobCounter counter;
+	const unsigned nbr_helpers = (nbr_chunks < GetThreadCount() ? nbr_chunks : GetThreadCount()) - 1;
+	for (unsigned i = 0; i < nbr_helpers; i++)
+		Run(&ParallelForRange<Body>::Execute, &range, &counter);
+
+	ParallelForRange<Body>::Execute(&range);
+	Wait(counter);
+}
+
+//
+// Tasks with dependencies, built once and run e.g. every frame. A task is
+// queued when all tasks it depends on have finished.
+//
+class TaskGraph
+{
+public:
+	// Returns the index of the task
+	unsigned AddTask(JobFunction function, void* data);
+
+	//
+	// Make task wait for depends_on. Tasks can only depend on tasks added
+	// before them, so the graph is acyclic by construction.
+	//
+	void AddDependency(unsigned task, unsigned depends_on);
+
+	// Run all tasks and wait for them to finish
+	void Run(JobSystem& jobs);
+
+	unsigned Size() const { return (unsigned)tasks.size(); }
+
+private:
+	struct Task
+	{
+		JobFunction function;
+		void* data;
+		TaskGraph* graph;
+		std::vector<unsigned> successors;
+		unsigned nbr_predecessors;
+	};
+
+	std::vector<Task> tasks;
+
+	// State of the current Run()
+	std::vector<std::atomic<unsigned>> pending;		// Unfinished predecessors per task
+	JobSystem* jobs = nullptr;
+	JobCounter counter;
+
+	static void Execute(void* data);
+};
+
+#endif
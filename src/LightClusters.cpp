@@ -0,0 +1,319 @@
+//
+//  LightClusters.cpp
+//
+//	Point and spot lights binned into the froxels of the view frustum,
+//	for clustered forward shading
+//
+
+#include <algorithm>
+#include <cmath>
+#include "LightClusters.h"
+
+// Lights per job when transforming, a multiple of four
+static const unsigned TransformGrain = 256;
+
+static_assert(sizeof(Light) == 48, "Light must match its layout in pixel_shader.hlsl");
+
+Light Light::Point(const vec3f& position, float range, const vec3f& color)
+{
+	Light light;
+	light.position = position;
+	light.range = range;
+	light.color = color;
+	light.spot_cos_outer = -1;
+	light.direction = vec3f(0, 0, -1);
+	light.spot_cos_inner = -1;
+	return light;
+}
+
+Light Light::Spot(const vec3f& position, const vec3f& direction, float range, float inner_angle, float outer_angle, const vec3f& color)
+{
+	Light light;
+	light.position = position;
+	light.range = range;
+	light.color = color;
+	light.spot_cos_outer = std::cos(outer_angle);
+	light.direction = vec3f(direction).normalize();
+	light.spot_cos_inner = std::cos(inner_angle);
+	return light;
+}
+
+void Light::GetBoundingSphere(vec3f& center, float& radius) const
+{
+	const float c = spot_cos_outer;
+	if (c <= 0)
+	{
+		// A point light, or a cone wider than a half-sphere
+		center = position;
+		radius = range;
+	}
+	else if (c <= 0.70710678f)
+	{
+		// Wider than 45 degrees: the sphere around the cap's rim
+		center = position + direction * (range * c);
+		radius = range * std::sqrt(1 - c * c);
+	}
+	else
+	{
+		// The sphere through the apex and the cap's rim
+		radius = range / (2 * c);
+		center = position + direction * radius;
+	}
+}
+
+LightClusters::LightClusters(unsigned tiles_x, unsigned tiles_y, unsigned slices) :
+	tiles_x(tiles_x),
+	tiles_y(tiles_y),
+	slices(slices),
+	slice_depths(slices + 1),
+	slice_entries(slices),
+	clusters(tiles_x * tiles_y * slices)
+{
+}
+
+void LightClusters::Build(
+	const Light* lights,
+	unsigned nbr_lights,
+	const Camera& camera,
+	JobSystem* jobs)
+{
+	Build(lights, nbr_lights, camera.get_WorldToViewMatrix(), camera.get_ProjectionMatrix(), jobs);
+}
+
+void LightClusters::Build(
+	const Light* lights,
+	unsigned nbr_lights,
+	const mat4f& Mview,
+	const mat4f& Mproj,
+	JobSystem* jobs)
+{
+	SetFrustum(Mproj);
+
+	view_x.resize(nbr_lights);
+	view_y.resize(nbr_lights);
+	view_depth.resize(nbr_lights);
+	radius.resize(nbr_lights);
+	first_slice.resize(nbr_lights);
+	last_slice.resize(nbr_lights);
+
+	// Bounding spheres to view space, four lights at a time
+	auto transform = [&](unsigned begin, unsigned end) { TransformLights(lights, Mview, begin, end); };
+	if (jobs)
+		jobs->ParallelFor(0, nbr_lights, TransformGrain, transform);
+	else
+		transform(0, nbr_lights);
+
+	nbr_binned_lights = 0;
+	for (unsigned i = 0; i < nbr_lights; i++)
+		nbr_binned_lights += first_slice[i] <= last_slice[i];
+
+	// Count the lights per cluster; each slice is binned by one job
+	auto bin = [&](unsigned begin, unsigned end)
+	{
+		for (unsigned slice = begin; slice < end; slice++)
+			BinSlice(slice, nbr_lights);
+	};
+	if (jobs)
+		jobs->ParallelFor(0, slices, 1, bin);
+	else
+		bin(0, slices);
+
+	// Place the lists of the clusters one after the other
+	unsigned offset = 0;
+	for (LightCluster& cluster : clusters)
+	{
+		cluster.offset = offset;
+		offset += cluster.count;
+	}
+	nbr_light_indices = offset;
+	if (light_indices.size() < nbr_light_indices)
+		light_indices.resize(nbr_light_indices);
+
+	auto fill = [&](unsigned begin, unsigned end)
+	{
+		for (unsigned slice = begin; slice < end; slice++)
+			FillSlice(slice);
+	};
+	if (jobs)
+		jobs->ParallelFor(0, slices, 1, fill);
+	else
+		fill(0, slices);
+}
+
+unsigned LightClusters::GetSlice(float depth) const
+{
+	if (depth <= znear)
+		return 0;
+	const float slice = std::log(depth) * slice_scale + slice_bias;
+	return std::min((unsigned)slice, slices - 1);
+}
+
+void LightClusters::SetFrustum(const mat4f& Mproj)
+{
+	// Near and far from the depth row of a GL perspective projection
+	znear = Mproj.m34 / (Mproj.m33 - 1);
+	zfar = Mproj.m34 / (Mproj.m33 + 1);
+	proj_x = Mproj.m11;
+	proj_y = Mproj.m22;
+
+	const float log_ratio = std::log(zfar / znear);
+	slice_scale = slices / log_ratio;
+	slice_bias = -std::log(znear) * slice_scale;
+	for (unsigned i = 0; i <= slices; i++)
+		slice_depths[i] = znear * std::exp(log_ratio * i / slices);
+	slice_depths[slices] = zfar;
+}
+
+void LightClusters::TransformLights(const Light* lights, const mat4f& Mview, unsigned begin, unsigned end)
+{
+	// World-space spheres first, as SoA
+	for (unsigned i = begin; i < end; i++)
+	{
+		vec3f center;
+		lights[i].GetBoundingSphere(center, radius[i]);
+		view_x[i] = center.x;
+		view_y[i] = center.y;
+		view_depth[i] = center.z;
+	}
+
+	unsigned i = begin;
+
+#ifdef LINALG_SSE
+	// Broadcast the rows of the view matrix once; depth is minus view z
+	const __m128 m11 = _mm_set1_ps(Mview.m11), m12 = _mm_set1_ps(Mview.m12), m13 = _mm_set1_ps(Mview.m13), m14 = _mm_set1_ps(Mview.m14);
+	const __m128 m21 = _mm_set1_ps(Mview.m21), m22 = _mm_set1_ps(Mview.m22), m23 = _mm_set1_ps(Mview.m23), m24 = _mm_set1_ps(Mview.m24);
+	const __m128 m31 = _mm_set1_ps(-Mview.m31), m32 = _mm_set1_ps(-Mview.m32), m33 = _mm_set1_ps(-Mview.m33), m34 = _mm_set1_ps(-Mview.m34);
+	const __m128 near4 = _mm_set1_ps(znear), far4 = _mm_set1_ps(zfar);
+	const __m128 one4 = _mm_set1_ps(1), minus_one4 = _mm_set1_ps(-1);
+
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&view_x[i]);
+		const __m128 y = _mm_loadu_ps(&view_y[i]);
+		const __m128 z = _mm_loadu_ps(&view_depth[i]);
+		const __m128 r = _mm_loadu_ps(&radius[i]);
+
+		const __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, x), _mm_mul_ps(m12, y)), _mm_add_ps(_mm_mul_ps(m13, z), m14));
+		const __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m21, x), _mm_mul_ps(m22, y)), _mm_add_ps(_mm_mul_ps(m23, z), m24));
+		const __m128 vd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m31, x), _mm_mul_ps(m32, y)), _mm_add_ps(_mm_mul_ps(m33, z), m34));
+		_mm_storeu_ps(&view_x[i], vx);
+		_mm_storeu_ps(&view_y[i], vy);
+		_mm_storeu_ps(&view_depth[i], vd);
+
+		// Slices of the nearest and farthest depth: the slice boundaries
+		// at or in front of them, counted. The counts are floats, exact for
+		// any slice count, so that SSE1 is enough.
+		const __m128 dmin = _mm_max_ps(_mm_sub_ps(vd, r), near4);
+		const __m128 dmax = _mm_min_ps(_mm_add_ps(vd, r), far4);
+		__m128 first = _mm_setzero_ps(), last = _mm_setzero_ps();
+		for (unsigned k = 1; k < slices; k++)
+		{
+			const __m128 boundary = _mm_set1_ps(slice_depths[k]);
+			first = _mm_add_ps(first, _mm_and_ps(_mm_cmple_ps(boundary, dmin), one4));
+			last = _mm_add_ps(last, _mm_and_ps(_mm_cmple_ps(boundary, dmax), one4));
+		}
+
+		// Outside the depth range: an empty range
+		const __m128 outside = _mm_cmpgt_ps(dmin, dmax);
+		last = _mm_or_ps(_mm_andnot_ps(outside, last), _mm_and_ps(outside, minus_one4));
+
+		float first4[4], last4[4];
+		_mm_storeu_ps(first4, first);
+		_mm_storeu_ps(last4, last);
+		for (unsigned j = 0; j < 4; j++)
+		{
+			first_slice[i + j] = (int)first4[j];
+			last_slice[i + j] = (int)last4[j];
+		}
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		const vec3f center(view_x[i], view_y[i], view_depth[i]);
+		const vec4f v = Mview * center.xyz1();
+		view_x[i] = v.x;
+		view_y[i] = v.y;
+		view_depth[i] = -v.z;
+
+		const float dmin = std::max(view_depth[i] - radius[i], znear);
+		const float dmax = std::min(view_depth[i] + radius[i], zfar);
+		int first = 0, last = 0;
+		for (unsigned k = 1; k < slices; k++)
+		{
+			first += slice_depths[k] <= dmin;
+			last += slice_depths[k] <= dmax;
+		}
+		first_slice[i] = first;
+		last_slice[i] = dmin > dmax ? -1 : last;
+	}
+}
+
+void LightClusters::BinSlice(unsigned slice, unsigned nbr_lights)
+{
+	TaggedVector<SliceEntry, MemoryTag::Scene>& entries = slice_entries[slice];
+	entries.clear();
+
+	LightCluster* slice_clusters = &clusters[GetClusterIndex(0, 0, slice)];
+	for (unsigned c = 0; c < tiles_x * tiles_y; c++)
+		slice_clusters[c].count = 0;
+
+	const float s0 = slice_depths[slice];
+	const float s1 = slice_depths[slice + 1];
+	for (unsigned i = 0; i < nbr_lights; i++)
+	{
+		if (first_slice[i] > (int)slice || last_slice[i] < (int)slice)
+			continue;
+
+		// Largest cross-section of the sphere within the slice
+		const float d = view_depth[i];
+		const float r = radius[i];
+		const float dz = d < s0 ? s0 - d : (d > s1 ? d - s1 : 0.0f);
+		const float r2 = r * r - dz * dz;
+		if (r2 < 0)
+			continue;
+		const float rc = std::sqrt(r2);
+
+		// Project the box around the sphere's part in the slice: the extreme
+		// x / depth of each side is at its nearest or farthest depth
+		const float z0 = std::max(d - r, s0);
+		const float z1 = std::min(d + r, s1);
+		const float x0 = view_x[i] - rc, x1 = view_x[i] + rc;
+		const float y0 = view_y[i] - rc, y1 = view_y[i] + rc;
+		const float ndc_x0 = x0 * proj_x / (x0 < 0 ? z0 : z1);
+		const float ndc_x1 = x1 * proj_x / (x1 > 0 ? z0 : z1);
+		const float ndc_y0 = y0 * proj_y / (y0 < 0 ? z0 : z1);
+		const float ndc_y1 = y1 * proj_y / (y1 > 0 ? z0 : z1);
+		if (ndc_x1 < -1 || ndc_x0 > 1 || ndc_y1 < -1 || ndc_y0 > 1)
+			continue;
+
+		// Tiles, with y from the top of the screen
+		SliceEntry entry;
+		entry.light = i;
+		entry.x0 = (unsigned short)std::max(0.0f, (ndc_x0 + 1) * 0.5f * tiles_x);
+		entry.x1 = (unsigned short)std::min((float)(tiles_x - 1), (ndc_x1 + 1) * 0.5f * tiles_x);
+		entry.y0 = (unsigned short)std::max(0.0f, (1 - ndc_y1) * 0.5f * tiles_y);
+		entry.y1 = (unsigned short)std::min((float)(tiles_y - 1), (1 - ndc_y0) * 0.5f * tiles_y);
+		entries.push_back(entry);
+
+		for (unsigned y = entry.y0; y <= entry.y1; y++)
+			for (unsigned x = entry.x0; x <= entry.x1; x++)
+				slice_clusters[y * tiles_x + x].count++;
+	}
+}
+
+void LightClusters::FillSlice(unsigned slice)
+{
+	LightCluster* slice_clusters = &clusters[GetClusterIndex(0, 0, slice)];
+	for (unsigned c = 0; c < tiles_x * tiles_y; c++)
+		slice_clusters[c].count = 0;
+
+	// In light order, as the lights were listed
+	for (const SliceEntry& entry : slice_entries[slice])
+		for (unsigned y = entry.y0; y <= entry.y1; y++)
+			for (unsigned x = entry.x0; x <= entry.x1; x++)
+			{
+				LightCluster& cluster = slice_clusters[y * tiles_x + x];
+				light_indices[cluster.offset + cluster.count++] = entry.light;
+			}
+}
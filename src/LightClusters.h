@@ -0,0 +1,166 @@
+//
+//  LightClusters.h
+//
+//	Point and spot lights binned into the froxels of the view frustum,
+//	for clustered forward shading
+//
+
+#pragma once
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <vector>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/simd.h"
+#include "Camera.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+
+using namespace linalg;
+
+//
+// A point or spot light. Laid out as Light in pixel_shader.hlsl, which
+// reads them from a structured buffer.
+//
+struct Light
+{
+	vec3f position;
+	float range;			// Distance where the light has faded to zero
+	vec3f color;			// Color times intensity
+	float spot_cos_outer;	// Cosine of the cone's half-angle; -1 for point lights
+	vec3f direction;		// Of the cone, normalized
+	float spot_cos_inner;	// Cosine of the angle where the cone starts to fade
+
+	static Light Point(const vec3f& position, float range, const vec3f& color);
+
+	// Angles are half-angles of the cone, in radians; inner <= outer
+	static Light Spot(const vec3f& position, const vec3f& direction, float range, float inner_angle, float outer_angle, const vec3f& color);
+
+	//
+	// Sphere around everything the light reaches: the range sphere for point
+	// lights, the smallest sphere around the cone for spot lights
+	//
+	void GetBoundingSphere(vec3f& center, float& radius) const;
+};
+
+//
+// Range of a cluster in the light index list. Laid out as the uint2 per
+// cluster in pixel_shader.hlsl.
+//
+struct LightCluster
+{
+	unsigned offset;
+	unsigned count;
+};
+
+//
+// The view frustum divided into a grid of clusters (froxels): screen tiles
+// in x and y, and slices in depth that grow exponentially from the near to
+// the far plane, so clusters are about as deep as they are wide. Build()
+// lists the lights that may reach each cluster, so the pixel shader loops
+// over the lights of its cluster only.
+//
+// Binning is conservative: a cluster lists every light whose bounding
+// sphere may overlap it, and some that just miss it.
+//
+class LightClusters
+{
+public:
+	LightClusters(unsigned tiles_x = 16, unsigned tiles_y = 9, unsigned slices = 24);
+
+	//
+	// Bin lights into the clusters of the frustum of Mview and Mproj, a
+	// symmetric perspective projection as from Camera. With jobs, depth
+	// slices are binned in parallel. Once the lists stop growing, a build
+	// does not allocate from the heap.
+	//
+	void Build(
+		const Light* lights,
+		unsigned nbr_lights,
+		const mat4f& Mview,
+		const mat4f& Mproj,
+		JobSystem* jobs = nullptr);
+
+	void Build(
+		const Light* lights,
+		unsigned nbr_lights,
+		const Camera& camera,
+		JobSystem* jobs = nullptr);
+
+	unsigned GetTilesX() const { return tiles_x; }
+
+	unsigned GetTilesY() const { return tiles_y; }
+
+	unsigned GetSlices() const { return slices; }
+
+	unsigned GetClusterCount() const { return tiles_x * tiles_y * slices; }
+
+	// Tile x from the left, tile y from the top, as in screen coordinates
+	unsigned GetClusterIndex(unsigned x, unsigned y, unsigned slice) const { return (slice * tiles_y + y) * tiles_x + x; }
+
+	//
+	// Slice of a view-space depth (distance in front of the camera) is
+	// log(depth) * scale + bias, clamped to the slices
+	//
+	float GetSliceScale() const { return slice_scale; }
+
+	float GetSliceBias() const { return slice_bias; }
+
+	unsigned GetSlice(float depth) const;
+
+	// Near depth of slice i; i == GetSlices() gives the far plane
+	float GetSliceDepth(unsigned i) const { return slice_depths[i]; }
+
+	const LightCluster* GetClusters() const { return clusters.data(); }
+
+	const unsigned* GetLightIndices() const { return light_indices.data(); }
+
+	unsigned GetLightIndexCount() const { return nbr_light_indices; }
+
+	// Lights in front of the near plane and inside the far plane, last build
+	unsigned GetBinnedLightCount() const { return nbr_binned_lights; }
+
+private:
+	// A light that overlaps a slice, and the tiles it covers there
+	struct SliceEntry
+	{
+		unsigned light;
+		unsigned short x0, x1, y0, y1;		// Inclusive
+	};
+
+	const unsigned tiles_x;
+	const unsigned tiles_y;
+	const unsigned slices;
+
+	// Frustum of the last build
+	float znear = 0, zfar = 0;
+	float proj_x = 0, proj_y = 0;	// View-space x / depth to NDC, and y
+	float slice_scale = 0, slice_bias = 0;
+	TaggedVector<float, MemoryTag::Scene> slice_depths;
+
+	// Bounding spheres of the lights in view space, and their slices (SoA)
+	TaggedVector<float, MemoryTag::Scene> view_x, view_y, view_depth, radius;
+	TaggedVector<int, MemoryTag::Scene> first_slice, last_slice;
+	unsigned nbr_binned_lights = 0;
+
+	// Per slice, written by the job that bins the slice
+	std::vector<TaggedVector<SliceEntry, MemoryTag::Scene>> slice_entries;
+
+	TaggedVector<LightCluster, MemoryTag::Scene> clusters;
+	TaggedVector<unsigned, MemoryTag::Scene> light_indices;		// Grows only
+	unsigned nbr_light_indices = 0;
+
+	void SetFrustum(const mat4f& Mproj);
+
+	// View-space bounding spheres and slice ranges of lights [begin, end)
+	void TransformLights(const Light* lights, const mat4f& Mview, unsigned begin, unsigned end);
+
+	// List the lights that overlap slice, and count them per cluster
+	void BinSlice(unsigned slice, unsigned nbr_lights);
+
+	// Write the light indices of the clusters of slice
+	void FillSlice(unsigned slice);
+};
+
+#endif
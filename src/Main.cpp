@@ -16,6 +16,9 @@
 #define VSYNC
 #define USECONSOLE
 
+// Frames the CPU may queue ahead of the GPU
+#define MAX_FRAME_LATENCY 2
+
 #include "stdafx.h"
 #include "shader.h"
 #include "Window.h"
@@ -24,6 +27,10 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Scene.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include <fstream>
 
 //--------------------------------------------------------------------------------------
 // Global Variables
@@ -39,6 +46,7 @@ ID3D11RasterizerState*	g_RasterState			= nullptr;
 shader_data*			g_VertexShader			= nullptr;
 shader_data*			g_PixelShader			= nullptr;
 InputHandler*			g_InputHandler			= nullptr;
+GpuProfiler*			g_GpuProfiler			= nullptr;
 
 #ifdef _DEBUG
 ID3D11Debug*			g_DebugController		= nullptr;
@@ -128,6 +136,8 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 				g_InitialWinWidth,
 				g_InitialWinHeight);
 			scene->Init();
+
+			g_GpuProfiler = new GpuProfiler(g_Device, g_DeviceContext);
 		}
 	}
 
@@ -145,22 +155,36 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 	
 	while (g_Window->Update())
 	{
-		if (g_Window->SizeChanged())
 		{
-			WinResize();
-		}
+			PROFILE_ZONE("Frame");
+
+			if (g_Window->SizeChanged())
+			{
+				WinResize();
+			}
 
-		__int64 currTimeStamp = 0;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTimeStamp);
-		const float dt = (currTimeStamp - prevTimeStamp) * secsPerCnt;
-		g_InputHandler->Update();
+			__int64 currTimeStamp = 0;
+			QueryPerformanceCounter((LARGE_INTEGER*)&currTimeStamp);
+			const float dt = (currTimeStamp - prevTimeStamp) * secsPerCnt;
+			g_InputHandler->Update();
 		
-		Update(dt);
-		Render(dt);
+			// The next frame is updated while this one is rendered and presented
+			Update(dt);
+			Render(dt);
+			scene->EndUpdate();
 
-		prevTimeStamp = currTimeStamp;
+			prevTimeStamp = currTimeStamp;
+		}
+		Profiler::Instance().EndFrame();
+		MemoryTracker::Instance().EndFrame();
 	}
 
+	// Zone statistics, and a trace of the last frames for chrome://tracing
+	Profiler::Instance().Report(std::cout);
+	MemoryTracker::Instance().Report(std::cout);
+	std::ofstream trace("profile.json");
+	Profiler::Instance().WriteChromeTrace(trace);
+
 	Release();
 #ifdef USECONSOLE
 	FreeConsole();
@@ -281,6 +305,15 @@ HRESULT InitDirect3DAndSwapChain(int width, int height)
 			&initiatedFeatureLevel,
 			&g_DeviceContext);
 	}
+	if (SUCCEEDED(hr))
+	{
+		IDXGIDevice1* dxgi_device = nullptr;
+		if (SUCCEEDED(g_Device->QueryInterface(&dxgi_device)))
+		{
+			dxgi_device->SetMaximumFrameLatency(MAX_FRAME_LATENCY);
+			dxgi_device->Release();
+		}
+	}
 #ifdef _DEBUG
 	g_Device->QueryInterface(&g_DebugController);
 	//g_DebugController->ReportLiveDeviceObjects(D3D11_RLDO_DETAIL);
@@ -371,20 +404,27 @@ void SetViewport(int width, int height)
 
 HRESULT Update(float deltaTime)
 {
-	scene->Update(deltaTime, g_InputHandler);
+	scene->BeginUpdate(deltaTime, g_InputHandler);
 
 	return S_OK;
 }
 
 HRESULT Render(float deltaTime)
 {
-	// Clear color in RGBA
-	static float ClearColor[4] = { 0, 0, 0, 1 };
-	// Clear back buffer
-	g_DeviceContext->ClearRenderTargetView( g_RenderTargetView, ClearColor );
+	PROFILE_ZONE("Render");
+	g_GpuProfiler->BeginFrame();
+
+	{
+		GpuProfileZone gpu_zone(g_GpuProfiler, "Clear");
+
+		// Clear color in RGBA
+		static float ClearColor[4] = { 0, 0, 0, 1 };
+		// Clear back buffer
+		g_DeviceContext->ClearRenderTargetView( g_RenderTargetView, ClearColor );
 	
-	// Clear depth and stencil buffer
-	g_DeviceContext->ClearDepthStencilView( g_DepthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+		// Clear depth and stencil buffer
+		g_DeviceContext->ClearDepthStencilView( g_DepthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+	}
 	
 	// Set topology
 	g_DeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -399,9 +439,15 @@ HRESULT Render(float deltaTime)
 	//g_DeviceContext->PSSetShader(g_PixelShader, nullptr, 0);
 	
 	// Time for the current scene to render
-	scene->Render();
+	{
+		GpuProfileZone gpu_zone(g_GpuProfiler, "Scene");
+		scene->Render();
+	}
+
+	g_GpuProfiler->EndFrame();
 
 	// Swap front and back buffer
+	PROFILE_ZONE("Present");
 #ifdef VSYNC
 	// Swapping synchronized with monitor
 	return g_SwapChain->Present(1, 0);
@@ -416,6 +462,7 @@ void Release()
 	SAFE_RELEASE(scene);
 
 	SAFE_DELETE(g_InputHandler);
+	SAFE_DELETE(g_GpuProfiler);
 
 	delete_shader(g_VertexShader);
 	delete_shader(g_PixelShader);
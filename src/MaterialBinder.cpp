@@ -0,0 +1,84 @@
+//
+//  MaterialBinder.cpp
+//
+//	Per-drawcall material state, bound only when it changes
+//
+
+#include "MaterialBinder.h"
+
+void MaterialBinder::BeginFrame()
+{
+	phong_bound = false;
+	phong_override = false;
+	for (bool& bound : SRV_bound)
+		bound = false;
+	permutation_bound = false;
+	nbr_uploads = 0;
+	nbr_skipped = 0;
+	nbr_shader_switches = 0;
+}
+
+void MaterialBinder::BindPhong(
+	const vec4f& ambient,
+	const vec4f& diffuse,
+	const vec4f& specular,
+	float shininess)
+{
+	if (phong_override)
+		return;
+
+	if (phong_bound &&
+		phong.ambient == ambient &&
+		phong.diffuse == diffuse &&
+		phong.specular == specular &&
+		phong.shininess == shininess)
+	{
+		nbr_skipped++;
+		return;
+	}
+
+	phong = { ambient, diffuse, specular, shininess };
+	UploadPhong(phong);
+	phong_bound = true;
+	nbr_uploads++;
+}
+
+void MaterialBinder::SetPhongOverride(const PhongParams& phong)
+{
+	phong_override = false;
+	BindPhong(phong.ambient, phong.diffuse, phong.specular, phong.shininess);
+	phong_override = true;
+}
+
+void MaterialBinder::BindMaterial(const Material& material)
+{
+	const unsigned material_permutation = GetMaterialPermutation(material);
+	if (select_permutations && !(permutation_bound && permutation == material_permutation))
+	{
+		SetPixelShader(material_permutation);
+		permutation = material_permutation;
+		permutation_bound = true;
+		nbr_shader_switches++;
+	}
+
+	const Texture* textures[ShaderFeatureCount] =
+	{
+		&material.diffuse_texture,
+		&material.normal_texture,
+		&material.specular_texture,
+		&material.mask_texture
+	};
+	for (unsigned i = 0; i < ShaderFeatureCount; i++)
+		if (material_permutation & (1 << i))
+			BindTexture(i, textures[i]->texture_SRV);
+}
+
+void MaterialBinder::BindTexture(unsigned slot, ID3D11ShaderResourceView* SRV)
+{
+	if (SRV_bound[slot] && SRVs[slot] == SRV)
+		return;
+
+	SetTexture(slot, SRV);
+	SRVs[slot] = SRV;
+	SRV_bound[slot] = true;
+}
@@ -0,0 +1,119 @@
+//
+//  MaterialBinder.h
+//
+//	Per-drawcall material state, bound only when it changes
+//
+
+#pragma once
+#ifndef MATERIALBINDER_H
+#define MATERIALBINDER_H
+
+#include "vec/vec.h"
+#include "Drawcall.h"
+#include "ShaderPermutation.h"
+
+using namespace linalg;
+
+//
+// Phong parameters as uploaded to the pixel shader
+//
+struct PhongParams
+{
+	vec4f ambient;
+	vec4f diffuse;
+	vec4f specular;
+	float shininess;
+};
+
+//
+// Tracks the Phong parameters, the material texture slots (in ShaderFeature
+// order) and the pixel shader permutation that a device context holds.
+// Models call it directly while rendering, once per drawcall. Values equal
+// to the ones already bound are skipped, so consecutive drawcalls with the
+// same material cost a compare instead of a Map/Unmap.
+//
+// The device calls are made through the virtual functions below, and only
+// for values that changed. Implemented per backend (D3D11MaterialBinder); a
+// backend that counts the calls makes the binder testable without a GPU.
+//
+class MaterialBinder
+{
+	// What the device currently holds
+	PhongParams phong = {};
+	bool phong_bound = false;
+	bool phong_override = false;
+
+	ID3D11ShaderResourceView* SRVs[ShaderFeatureCount] = {};
+	bool SRV_bound[ShaderFeatureCount] = {};
+
+	unsigned permutation = 0;
+	bool permutation_bound = false;
+	bool select_permutations = false;
+
+	// Counters since the last BeginFrame()
+	unsigned nbr_uploads = 0;
+	unsigned nbr_skipped = 0;
+	unsigned nbr_shader_switches = 0;
+
+	void BindTexture(unsigned slot, ID3D11ShaderResourceView* SRV);
+
+protected:
+	virtual void UploadPhong(const PhongParams& phong) = 0;
+
+	// A null SRV unbinds the slot
+	virtual void SetTexture(unsigned slot, ID3D11ShaderResourceView* SRV) = 0;
+
+	virtual void SetPixelShader(unsigned permutation) = 0;
+
+	//
+	// With permutations selected, BindMaterial() also sets the pixel shader
+	// permutation of the material's textures
+	//
+	void SelectPermutations(bool select) { select_permutations = select; }
+
+public:
+	MaterialBinder() = default;
+
+	MaterialBinder(const MaterialBinder&) = delete;
+
+	MaterialBinder& operator=(const MaterialBinder&) = delete;
+
+	//
+	// Forget the cached state, since other code may have changed the slots
+	// since the last frame
+	//
+	virtual void BeginFrame();
+
+	void BindPhong(
+		const vec4f& ambient,
+		const vec4f& diffuse,
+		const vec4f& specular,
+		float shininess);
+
+	//
+	// Bind phong and ignore BindPhong() until the override is cleared,
+	// e.g. to draw a model in a fixed color instead of its materials
+	//
+	void SetPhongOverride(const PhongParams& phong);
+
+	void ClearPhongOverride() { phong_override = false; }
+
+	void BindDiffuseTexture(ID3D11ShaderResourceView* SRV) { BindTexture(0, SRV); }
+
+	//
+	// Bind the loaded textures of material, and the pixel shader permutation
+	// that samples just those if permutations are selected. Slots of missing
+	// textures keep what they hold, as the permutation ignores them.
+	//
+	void BindMaterial(const Material& material);
+
+	unsigned GetUploadCount() const { return nbr_uploads; }
+
+	unsigned GetSkippedCount() const { return nbr_skipped; }
+
+	unsigned GetShaderSwitchCount() const { return nbr_shader_switches; }
+
+	virtual ~MaterialBinder() { }
+};
+
+#endif
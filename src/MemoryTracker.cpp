@@ -0,0 +1,172 @@
+//
+//  MemoryTracker.cpp
+//
+//	Per-subsystem accounting of heap memory, and allocators that report to it
+//
+
+#include <cstdlib>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include "MemoryTracker.h"
+
+// Size header in front of TaggedMalloc blocks, keeping their alignment
+static const size_t HeaderSize = alignof(std::max_align_t);
+
+// Heap allocations since the last EndFrame(), counted while enabled. Plain
+// globals, as operator new may run before the tracker is constructed.
+static std::atomic<bool> count_heap_allocations(false);
+static std::atomic<unsigned long long> heap_allocations(0);
+
+void CountHeapAllocation()
+{
+	if (count_heap_allocations.load(std::memory_order_relaxed))
+		heap_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+MemoryTracker& MemoryTracker::Instance()
+{
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MemoryTag::MeshLoad: return "mesh-load";
+	case MemoryTag::Textures: return "textures";
+	case MemoryTag::Scene: return "scene";
+	case MemoryTag::Transient: return "transient";
+	default: return "unknown";
+	}
+}
+
+void MemoryTracker::OnAllocate(MemoryTag tag, size_t bytes)
+{
+	Counters& c = counters[(int)tag];
+	const size_t current = c.current_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	size_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+	while (current > peak && !c.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+	c.allocations.fetch_add(1, std::memory_order_relaxed);
+	frame_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::OnFree(MemoryTag tag, size_t bytes)
+{
+	Counters& c = counters[(int)tag];
+	c.current_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+	c.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+MemoryTracker::TagStats MemoryTracker::GetStats(MemoryTag tag) const
+{
+	const Counters& c = counters[(int)tag];
+	TagStats stats;
+	stats.current_bytes = c.current_bytes.load(std::memory_order_relaxed);
+	stats.peak_bytes = c.peak_bytes.load(std::memory_order_relaxed);
+	stats.allocations = c.allocations.load(std::memory_order_relaxed);
+	stats.frees = c.frees.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void MemoryTracker::ResetPeaks()
+{
+	for (Counters& c : counters)
+		c.peak_bytes.store(c.current_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void MemoryTracker::EndFrame()
+{
+	last_frame_allocations.store(frame_allocations.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+
+	const unsigned long long heap = heap_allocations.exchange(0, std::memory_order_relaxed);
+	last_frame_heap_allocations.store(heap, std::memory_order_relaxed);
+	if (assert_no_heap && heap)
+		throw std::runtime_error("MemoryTracker: " + std::to_string(heap) + " heap allocations in a frame");
+}
+
+void MemoryTracker::SetCountHeapAllocations(bool enable)
+{
+	count_heap = enable;
+	count_heap_allocations.store(count_heap || assert_no_heap, std::memory_order_relaxed);
+	heap_allocations.store(0, std::memory_order_relaxed);
+}
+
+void MemoryTracker::SetAssertNoHeapAllocations(bool enable)
+{
+	assert_no_heap = enable;
+	count_heap_allocations.store(count_heap || assert_no_heap, std::memory_order_relaxed);
+	heap_allocations.store(0, std::memory_order_relaxed);
+}
+
+void MemoryTracker::Report(std::ostream& out) const
+{
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+
+	for (int i = 0; i < (int)MemoryTag::Count; i++)
+	{
+		const TagStats stats = GetStats((MemoryTag)i);
+		out << GetTagName((MemoryTag)i)
+			<< ": " << stats.current_bytes / 1024.0
+			<< " KB, peak " << stats.peak_bytes / 1024.0
+			<< " KB, " << stats.allocations << " allocations, "
+			<< stats.frees << " frees" << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void* TaggedMalloc(MemoryTag tag, size_t size)
+{
+	CountHeapAllocation();
+	char* block = static_cast<char*>(std::malloc(HeaderSize + size));
+	if (!block)
+		return nullptr;
+	*reinterpret_cast<size_t*>(block) = size;
+	MemoryTracker::Instance().OnAllocate(tag, size);
+	return block + HeaderSize;
+}
+
+void* TaggedRealloc(MemoryTag tag, void* p, size_t size)
+{
+	if (!p)
+		return TaggedMalloc(tag, size);
+
+	CountHeapAllocation();
+	char* block = static_cast<char*>(p) - HeaderSize;
+	const size_t old_size = *reinterpret_cast<size_t*>(block);
+	char* resized = static_cast<char*>(std::realloc(block, HeaderSize + size));
+	if (!resized)
+		return nullptr;
+	*reinterpret_cast<size_t*>(resized) = size;
+
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.OnFree(tag, old_size);
+	tracker.OnAllocate(tag, size);
+	return resized + HeaderSize;
+}
+
+void TaggedFree(MemoryTag tag, void* p)
+{
+	if (!p)
+		return;
+	char* block = static_cast<char*>(p) - HeaderSize;
+	MemoryTracker::Instance().OnFree(tag, *reinterpret_cast<size_t*>(block));
+	std::free(block);
+}
+
+void* TaggedMemoryResource::do_allocate(size_t bytes, size_t alignment)
+{
+	MemoryTracker::Instance().OnAllocate(tag, bytes);
+	return ::operator new(bytes, std::align_val_t(alignment));
+}
+
+void TaggedMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	MemoryTracker::Instance().OnFree(tag, bytes);
+	::operator delete(p, std::align_val_t(alignment));
+}
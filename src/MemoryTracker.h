@@ -0,0 +1,178 @@
+//
+//  MemoryTracker.h
+//
+//	Per-subsystem accounting of heap memory, and allocators that report to it
+//
+
+#pragma once
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <vector>
+
+//
+// What an allocation is for
+//
+enum class MemoryTag
+{
+	MeshLoad,		// Intermediate data of the OBJ loader
+	Textures,		// Decoded images
+	Scene,			// Transforms, bounds and other per-entity data
+	Transient,		// Rebuilt every frame, e.g. draw lists
+	Count
+};
+
+//
+// Current and peak bytes and allocation counts per tag. The counters are
+// atomic, so allocations may be reported from any thread.
+//
+class MemoryTracker
+{
+public:
+	struct TagStats
+	{
+		size_t current_bytes = 0;
+		size_t peak_bytes = 0;
+		unsigned long long allocations = 0;
+		unsigned long long frees = 0;
+	};
+
+	// The tracker used by the tagged allocators
+	static MemoryTracker& Instance();
+
+	static const char* GetTagName(MemoryTag tag);
+
+	void OnAllocate(MemoryTag tag, size_t bytes);
+
+	void OnFree(MemoryTag tag, size_t bytes);
+
+	TagStats GetStats(MemoryTag tag) const;
+
+	// Let the peaks start over from the current sizes, e.g. between benchmark runs
+	void ResetPeaks();
+
+	// Close the frame: the allocations counted since the previous call become the frame's
+	void EndFrame();
+
+	// Tagged allocations, of all tags, in the last frame closed by EndFrame()
+	unsigned long long GetFrameAllocations() const { return last_frame_allocations.load(std::memory_order_relaxed); }
+
+	//
+	// Count all heap allocations through operator new and TaggedMalloc, on
+	// any thread, whatever their tag. Off by default, as it costs an atomic
+	// increment per allocation. operator new is only counted in executables
+	// that link HeapCounting.cpp.
+	//
+	void SetCountHeapAllocations(bool enable);
+
+	// Heap allocations in the last frame closed by EndFrame(), while counting
+	unsigned long long GetFrameHeapAllocations() const { return last_frame_heap_allocations.load(std::memory_order_relaxed); }
+
+	//
+	// Steady-state check: while set, heap allocations are counted and
+	// EndFrame() throws std::runtime_error if the frame made any
+	//
+	void SetAssertNoHeapAllocations(bool enable);
+
+	// One line per tag
+	void Report(std::ostream& out) const;
+
+private:
+	struct Counters
+	{
+		std::atomic<size_t> current_bytes{ 0 };
+		std::atomic<size_t> peak_bytes{ 0 };
+		std::atomic<unsigned long long> allocations{ 0 };
+		std::atomic<unsigned long long> frees{ 0 };
+	};
+
+	Counters counters[(int)MemoryTag::Count];
+	std::atomic<unsigned long long> frame_allocations{ 0 };
+	std::atomic<unsigned long long> last_frame_allocations{ 0 };
+	std::atomic<unsigned long long> last_frame_heap_allocations{ 0 };
+	bool count_heap = false;
+	bool assert_no_heap = false;
+};
+
+// Count a heap allocation while counting is on
+void CountHeapAllocation();
+
+//
+// malloc/realloc/free that report to MemoryTracker::Instance(). The size is
+// kept in front of the block, so free does not need it. They count as heap
+// allocations too.
+//
+void* TaggedMalloc(MemoryTag tag, size_t size);
+
+void* TaggedRealloc(MemoryTag tag, void* p, size_t size);
+
+void TaggedFree(MemoryTag tag, void* p);
+
+//
+// Standard library allocator that reports to MemoryTracker::Instance()
+//
+template <class T, MemoryTag Tag>
+struct TaggedAllocator
+{
+	typedef T value_type;
+
+	template <class U>
+	struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+	TaggedAllocator() = default;
+
+	template <class U>
+	TaggedAllocator(const TaggedAllocator<U, Tag>&) { }
+
+	T* allocate(size_t n)
+	{
+		MemoryTracker::Instance().OnAllocate(Tag, n * sizeof(T));
+		if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		MemoryTracker::Instance().OnFree(Tag, n * sizeof(T));
+		if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			::operator delete(p, std::align_val_t(alignof(T)));
+		else
+			::operator delete(p);
+	}
+
+	template <class U>
+	bool operator==(const TaggedAllocator<U, Tag>&) const { return true; }
+
+	template <class U>
+	bool operator!=(const TaggedAllocator<U, Tag>&) const { return false; }
+};
+
+template <class T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+//
+// Memory resource that reports to MemoryTracker::Instance(), e.g. as the
+// upstream of an arena
+//
+class TaggedMemoryResource : public std::pmr::memory_resource
+{
+public:
+	explicit TaggedMemoryResource(MemoryTag tag) : tag(tag) { }
+
+private:
+	const MemoryTag tag;
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+#endif
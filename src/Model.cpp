@@ -4,57 +4,100 @@
 //  CJ Gribel 2016, cjgribel@gmail.com
 //
 
+#include <algorithm>
+#include <sstream>
 #include "Model.h"
 
+void Model::AddDrawcallBounds(const AABB& box, const BoundingSphere& sphere)
+{
+	drawcall_bounds.Add(box, sphere);
+	drawcall_visible.push_back(1);
+	nbr_visible_drawcalls++;
+	if (!box.IsEmpty())
+		bounds.Expand(box);
+}
+
+unsigned Model::Cull(const mat4f& ModelToClipMatrix, CullStats* stats)
+{
+	const Frustum frustum = Frustum::FromMatrix(ModelToClipMatrix);
+	const unsigned nbr_drawcalls = (unsigned)drawcall_bounds.Size();
+	unsigned nbr_visible = 0;
+
+	// Test the whole model first, then its drawcalls
+	if (frustum.TestAABB(bounds))
+		nbr_visible = FrustumCull(frustum, drawcall_bounds, drawcall_visible.data());
+	else
+		std::fill(drawcall_visible.begin(), drawcall_visible.end(), 0);
+
+	if (stats)
+	{
+		stats->tested += nbr_drawcalls;
+		stats->visible += nbr_visible;
+	}
+	nbr_visible_drawcalls = nbr_visible;
+	return nbr_visible;
+}
+
+void Model::HideAllDrawcalls()
+{
+	std::fill(drawcall_visible.begin(), drawcall_visible.end(), 0);
+	nbr_visible_drawcalls = 0;
+}
+
+void Model::ShowDrawcall(unsigned i)
+{
+	if (!drawcall_visible[i])
+	{
+		drawcall_visible[i] = 1;
+		nbr_visible_drawcalls++;
+	}
+}
+
+void Model::HideDrawcall(unsigned i)
+{
+	if (drawcall_visible[i])
+	{
+		drawcall_visible[i] = 0;
+		nbr_visible_drawcalls--;
+	}
+}
+
+//
+// Quad geometry, built at compile time
+//
+static constexpr Vertex QuadVertices[] =
+{
+	// Pos, Normal, Tangent, Binormal, TexCoord
+	{ { -0.5f, -0.5f, 0.0f }, { 0, 0, 1 }, {}, {}, { 0, 0 } },
+	{ {  0.5f, -0.5f, 0.0f }, { 0, 0, 1 }, {}, {}, { 0, 1 } },
+	{ {  0.5f,  0.5f, 0.0f }, { 0, 0, 1 }, {}, {}, { 1, 1 } },
+	{ { -0.5f,  0.5f, 0.0f }, { 0, 0, 1 }, {}, {}, { 1, 0 } },
+};
+
+// Two triangles
+static constexpr unsigned QuadIndices[] =
+{
+	0, 1, 3,
+	1, 2, 3,
+};
+
+static constexpr unsigned QuadIndexCount = sizeof(QuadIndices) / sizeof(QuadIndices[0]);
+
 QuadModel::QuadModel(
 	ID3D11Device* dxdevice,
 	ID3D11DeviceContext* dxdevice_context)
 	: Model(dxdevice, dxdevice_context)
 {
-	// Vertex and index arrays
-	// Once their data is loaded to GPU buffers, they are not needed anymore
-	std::vector<Vertex> vertices;
-	std::vector<unsigned> indices;
-
-	// Populate the vertex array with 4 vertices
-	Vertex v0, v1, v2, v3;
-	v0.Pos = { -0.5, -0.5f, 0.0f };
-	v0.Normal = { 0, 0, 1 };
-	v0.TexCoord = { 0, 0 };
-	v1.Pos = { 0.5, -0.5f, 0.0f };
-	v1.Normal = { 0, 0, 1 };
-	v1.TexCoord = { 0, 1 };
-	v2.Pos = { 0.5, 0.5f, 0.0f };
-	v2.Normal = { 0, 0, 1 };
-	v2.TexCoord = { 1, 1 };
-	v3.Pos = { -0.5, 0.5f, 0.0f };
-	v3.Normal = { 0, 0, 1 };
-	v3.TexCoord = { 1, 0 };
-	vertices.push_back(v0);
-	vertices.push_back(v1);
-	vertices.push_back(v2);
-	vertices.push_back(v3);
-
-	// Populate the index array with two triangles
-	// Triangle #1
-	indices.push_back(0);
-	indices.push_back(1);
-	indices.push_back(3);
-	// Triangle #2
-	indices.push_back(1);
-	indices.push_back(2);
-	indices.push_back(3);
-
 	// Vertex array descriptor
 	D3D11_BUFFER_DESC vbufferDesc = { 0 };
 	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbufferDesc.CPUAccessFlags = 0;
 	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = (UINT)(vertices.size()*sizeof(Vertex));
+	vbufferDesc.ByteWidth = (UINT)sizeof(QuadVertices);
 	// Data resource
 	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
+	vdata.pSysMem = QuadVertices;
 	// Create vertex buffer on device using descriptor & data
 	const HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
 	SETNAME(vertex_buffer, "VertexBuffer");
@@ -65,232 +108,192 @@ QuadModel::QuadModel(
 	ibufferDesc.CPUAccessFlags = 0;
 	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = (UINT)(indices.size()*sizeof(unsigned));
+	ibufferDesc.ByteWidth = (UINT)sizeof(QuadIndices);
 	// Data resource
 	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
+	idata.pSysMem = QuadIndices;
 	// Create index buffer on device using descriptor & data
 	const HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
 	SETNAME(index_buffer, "IndexBuffer");
     
-	nbr_indices = (unsigned int)indices.size();
+	nbr_indices = QuadIndexCount;
 	material = new Material();
+
+	// Bounds for culling (a single drawcall)
+	AABB box;
+	BoundingSphere sphere;
+	ComputeBounds(&QuadVertices[0].Pos, sizeof(Vertex), QuadIndices, QuadIndexCount, box, sphere);
+	AddDrawcallBounds(box, sphere);
+	occluder.AppendRange(&QuadVertices[0].Pos, sizeof(Vertex), QuadIndices, QuadIndexCount);
 }
 
 
-void QuadModel::Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate) const
+void QuadModel::Render(ID3D11DeviceContext* context, MaterialBinder* material_binder) const
 {
+	if (!drawcall_visible[0])
+		return;
+
 	// Bind our vertex buffer
 	const UINT32 stride = sizeof(Vertex); //  sizeof(float) * 8;
 	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// Bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
 
-	if (material)
+	if (material && material_binder)
 	{
-		if (phongBufferUpdate)
-			phongBufferUpdate(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), 200);
-
-		if (material->diffuse_texture && material->diffuse_texture.texture_SRV)
-			dxdevice_context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
+		material_binder->BindPhong(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), 200);
+		material_binder->BindMaterial(*material);
 	}
+	else if (material && material->diffuse_texture && material->diffuse_texture.texture_SRV)
+		context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
 
 	// Make the drawcall
-	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
+	context->DrawIndexed(nbr_indices, 0, 0);
 }
 
 
+//
+// Cube geometry, built at compile time: each corner is stored
+// three times, once per face, with the normal of that face
+//
+static constexpr Vertex CubeVertices[] =
+{
+	// Bottom Back Left
+	{ { -0.5f, -0.5f, -0.5f }, {  0,  0, -1 }, {}, {}, { 0, 1 } },	// 0
+	{ { -0.5f, -0.5f, -0.5f }, { -1,  0,  0 }, {}, {}, { 0, 0 } },	// 1
+	{ { -0.5f, -0.5f, -0.5f }, {  0, -1,  0 }, {}, {}, { 1, 1 } },	// 2
+	// Bottom Back Right
+	{ {  0.5f, -0.5f, -0.5f }, {  0,  0, -1 }, {}, {}, { 0, 0 } },	// 3
+	{ {  0.5f, -0.5f, -0.5f }, {  1,  0,  0 }, {}, {}, { 0, 1 } },	// 4
+	{ {  0.5f, -0.5f, -0.5f }, {  0, -1,  0 }, {}, {}, { 1, 0 } },	// 5
+	// Top Back Left
+	{ { -0.5f,  0.5f, -0.5f }, {  0,  0, -1 }, {}, {}, { 1, 1 } },	// 6
+	{ { -0.5f,  0.5f, -0.5f }, { -1,  0,  0 }, {}, {}, { 1, 0 } },	// 7
+	{ { -0.5f,  0.5f, -0.5f }, {  0,  1,  0 }, {}, {}, { 1, 0 } },	// 8
+	// Top Back Right
+	{ {  0.5f,  0.5f, -0.5f }, {  0,  0, -1 }, {}, {}, { 1, 0 } },	// 9
+	{ {  0.5f,  0.5f, -0.5f }, {  1,  0,  0 }, {}, {}, { 1, 1 } },	// 10
+	{ {  0.5f,  0.5f, -0.5f }, {  0,  1,  0 }, {}, {}, { 1, 1 } },	// 11
+	// Bottom Front Left
+	{ { -0.5f, -0.5f,  0.5f }, {  0,  0,  1 }, {}, {}, { 0, 0 } },	// 12
+	{ { -0.5f, -0.5f,  0.5f }, { -1,  0,  0 }, {}, {}, { 0, 1 } },	// 13
+	{ { -0.5f, -0.5f,  0.5f }, {  0, -1,  0 }, {}, {}, { 0, 1 } },	// 14
+	// Bottom Front Right
+	{ {  0.5f, -0.5f,  0.5f }, {  0,  0,  1 }, {}, {}, { 0, 1 } },	// 15
+	{ {  0.5f, -0.5f,  0.5f }, {  1,  0,  0 }, {}, {}, { 0, 0 } },	// 16
+	{ {  0.5f, -0.5f,  0.5f }, {  0, -1,  0 }, {}, {}, { 0, 0 } },	// 17
+	// Top Front Left
+	{ { -0.5f,  0.5f,  0.5f }, {  0,  0,  1 }, {}, {}, { 1, 0 } },	// 18
+	{ { -0.5f,  0.5f,  0.5f }, { -1,  0,  0 }, {}, {}, { 1, 1 } },	// 19
+	{ { -0.5f,  0.5f,  0.5f }, {  0,  1,  0 }, {}, {}, { 0, 0 } },	// 20
+	// Top Front Right
+	{ {  0.5f,  0.5f,  0.5f }, {  0,  0,  1 }, {}, {}, { 1, 1 } },	// 21
+	{ {  0.5f,  0.5f,  0.5f }, {  1,  0,  0 }, {}, {}, { 1, 0 } },	// 22
+	{ {  0.5f,  0.5f,  0.5f }, {  0,  1,  0 }, {}, {}, { 0, 1 } },	// 23
+};
+
+// 12 triangles (2 for each side)
+static constexpr unsigned CubeIndices[] =
+{
+	3, 0, 6,	3, 6, 9,	// back
+	14, 2, 17,	17, 2, 5,	// bottom
+	15, 21, 18,	15, 18, 12,	// front
+	8, 20, 11,	11, 20, 23,	// top
+	16, 4, 10,	16, 10, 22,	// right
+	13, 19, 7,	13, 7, 1,	// left
+};
+
+static constexpr unsigned CubeIndexCount = sizeof(CubeIndices) / sizeof(CubeIndices[0]);
+
 CubeModel::CubeModel(ID3D11Device* dxdevice, ID3D11DeviceContext* dxdevice_context)	: Model(dxdevice, dxdevice_context)
 {
-	// Vertex and index arrays
-	// Once their data is loaded to GPU buffers, they are not needed anymore
-	std::vector<Vertex> vertices;
-	std::vector<unsigned> indices;
+	// Vertex array descriptor
+	D3D11_BUFFER_DESC vbufferDesc = { 0 };
+	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbufferDesc.CPUAccessFlags = 0;
+	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vbufferDesc.MiscFlags = 0;
+	vbufferDesc.ByteWidth = (UINT)sizeof(CubeVertices);
+	// Data resource
+	D3D11_SUBRESOURCE_DATA vdata;
+	vdata.pSysMem = CubeVertices;
+	// Create vertex buffer on device using descriptor & data
+	const HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	SETNAME(vertex_buffer, "VertexBuffer");
 
-	// Populate the vertex array with 24 vertices
-	Vertex vbbl0, vbbl1, vbbl2, vbbr0, vbbr1, vbbr2, vtbl0, vtbl1, vtbl2, vtbr0, vtbr1, vtbr2, vbfl0, vbfl1, vbfl2, vbfr0, vbfr1, vbfr2, vtfl0, vtfl1, vtfl2, vtfr0, vtfr1, vtfr2;
-	// Bottom Back Left:
-	vbbl0.Pos = vbbl1.Pos = vbbl2.Pos = { -0.5f, -0.5f, -0.5f };
-	vbbl0.Normal = { 0, 0, -1 };
-	vbbl0.TexCoord = { 0, 1 };
+	//  Index array descriptor
+	D3D11_BUFFER_DESC ibufferDesc = { 0 };
+	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibufferDesc.CPUAccessFlags = 0;
+	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	ibufferDesc.MiscFlags = 0;
+	ibufferDesc.ByteWidth = (UINT)sizeof(CubeIndices);
+	// Data resource
+	D3D11_SUBRESOURCE_DATA idata;
+	idata.pSysMem = CubeIndices;
+	// Create index buffer on device using descriptor & data
+	const HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	SETNAME(index_buffer, "IndexBuffer");
 
-	vbbl1.Normal = { -1, 0, 0 };
-	vbbl1.TexCoord = { 0, 0 };
+	nbr_indices = CubeIndexCount;
+	material = new Material();
 
-	vbbl2.Normal = { 0, -1, 0 };
-	vbbl2.TexCoord = { 1, 1 };
+	// Bounds for culling (a single drawcall)
+	AABB box;
+	BoundingSphere sphere;
+	ComputeBounds(&CubeVertices[0].Pos, sizeof(Vertex), CubeIndices, CubeIndexCount, box, sphere);
+	AddDrawcallBounds(box, sphere);
+	occluder.AppendRange(&CubeVertices[0].Pos, sizeof(Vertex), CubeIndices, CubeIndexCount);
+}
 
-	// Bottom Back Right:
-	vbbr0.Pos = vbbr1.Pos = vbbr2.Pos = { 0.5f, -0.5f, -0.5f };
-	vbbr0.Normal = { 0, 0, -1 };
-	vbbr0.TexCoord = { 0, 0 };
+void CubeModel::Render(ID3D11DeviceContext* context, MaterialBinder* material_binder) const
+{
+	if (!drawcall_visible[0])
+		return;
 
-	vbbr1.Normal = { 1, 0, 0 };
-	vbbr1.TexCoord = { 0, 1 };
+	// Bind our vertex buffer
+	const UINT32 stride = sizeof(Vertex); //  sizeof(float) * 8;
+	const UINT32 offset = 0;
+	context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
-	vbbr2.Normal = { 0, -1, 0 };
-	vbbr2.TexCoord = { 1, 0 };
+	// Bind our index buffer
+	context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
 
-	// Top Back Left:
-	vtbl0.Pos = vtbl1.Pos = vtbl2.Pos = { -0.5f, 0.5f, -0.5f };
-	vtbl0.Normal = { 0, 0, -1 };
-	vtbl0.TexCoord = { 1, 1 };
+	if (material && material_binder)
+	{
+		material_binder->BindPhong(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), 200);
+		material_binder->BindMaterial(*material);
+	}
+	else if (material && material->diffuse_texture && material->diffuse_texture.texture_SRV)
+		context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
 
-	vtbl1.Normal = { -1, 0, 0 };
-	vtbl1.TexCoord = { 1, 0 };
+	// Make the drawcall
+	context->DrawIndexed(nbr_indices, 0, 0);
+}
 
-	vtbl2.Normal = { 0, 1, 0 };
-	vtbl2.TexCoord = { 1, 0 };
-
-	// Top Back Right:
-	vtbr0.Pos = vtbr1.Pos = vtbr2.Pos = { 0.5f, 0.5f, -0.5f };
-	vtbr0.Normal = { 0, 0, -1 };
-	vtbr0.TexCoord = { 1, 0 };
-
-	vtbr1.Normal = { 1, 0, 0 };
-	vtbr1.TexCoord = { 1, 1 };
-
-	vtbr2.Normal = { 0, 1, 0 };
-	vtbr2.TexCoord = { 1, 1 };
-
-	// Bottom Front Left:
-	vbfl0.Pos = vbfl1.Pos = vbfl2.Pos = { -0.5f, -0.5f, 0.5f };
-	vbfl0.Normal = { 0, 0, 1 };
-	vbfl0.TexCoord = { 0, 0 };
-
-	vbfl1.Normal = { -1, 0, 0 };
-	vbfl1.TexCoord = { 0, 1 };
-
-	vbfl2.Normal = { 0, -1, 0 };
-	vbfl2.TexCoord = { 0, 1 };
-
-	// Bottom Front Right:
-	vbfr0.Pos = vbfr1.Pos = vbfr2.Pos = { 0.5f, -0.5f, 0.5f };
-	vbfr0.Normal = { 0, 0, 1 };
-	vbfr0.TexCoord = { 0, 1 };
-
-	vbfr1.Normal = { 1, 0, 0 };
-	vbfr1.TexCoord = { 0, 0 };
-
-	vbfr2.Normal = { 0, -1, 0 };
-	vbfr2.TexCoord = { 0, 0 };
-
-	// Top Front Left:
-	vtfl0.Pos = vtfl1.Pos = vtfl2.Pos = { -0.5f, 0.5f, 0.5f };
-	vtfl0.Normal = { 0, 0, 1 };
-	vtfl0.TexCoord = { 1, 0 };
-
-	vtfl1.Normal = { -1, 0, 0 };
-	vtfl1.TexCoord = { 1, 1 };
-
-	vtfl2.Normal = { 0, 1, 0 };
-	vtfl2.TexCoord = { 0, 0 };
-
-	// Top Front Right:
-	vtfr0.Pos = vtfr1.Pos = vtfr2.Pos = { 0.5f, 0.5f, 0.5f };
-	vtfr0.Normal = { 0, 0, 1 };
-	vtfr0.TexCoord = { 1, 1 };
-
-	vtfr1.Normal = { 1, 0, 0 };
-	vtfr1.TexCoord = { 1, 0 };
-
-	vtfr2.Normal = { 0, 1, 0 };
-	vtfr2.TexCoord = { 0, 1 };
-
-	vertices.push_back(vbbl0); // 0.
-	vertices.push_back(vbbl1); // 1.
-	vertices.push_back(vbbl2); // 2.
-
-	vertices.push_back(vbbr0); // 3.
-	vertices.push_back(vbbr1); // 4.
-	vertices.push_back(vbbr2); // 5.
-
-	vertices.push_back(vtbl0); // 6.
-	vertices.push_back(vtbl1); // 7.
-	vertices.push_back(vtbl2); // 8.
-
-	vertices.push_back(vtbr0); // 9.
-	vertices.push_back(vtbr1); // 10.
-	vertices.push_back(vtbr2); // 11.
-
-	vertices.push_back(vbfl0); // 12.
-	vertices.push_back(vbfl1); // 13.
-	vertices.push_back(vbfl2); // 14.
-
-	vertices.push_back(vbfr0); // 15.
-	vertices.push_back(vbfr1); // 16.
-	vertices.push_back(vbfr2); // 17.
-
-	vertices.push_back(vtfl0); // 18.
-	vertices.push_back(vtfl1); // 19.
-	vertices.push_back(vtfl2); // 20.
-
-	vertices.push_back(vtfr0); // 21.
-	vertices.push_back(vtfr1); // 22.
-	vertices.push_back(vtfr2); // 23.
-
-	// Populate the index array with 12 triangles (2 for each side)
-	// Triangle #1
-	indices.push_back(3);
-	indices.push_back(0);
-	indices.push_back(6);
-	// Triangle #2
-	indices.push_back(3);
-	indices.push_back(6);
-	indices.push_back(9);
-	// Triangle #3
-	indices.push_back(14);
-	indices.push_back(2);
-	indices.push_back(17);
-	// Triangle #4
-	indices.push_back(17);
-	indices.push_back(2);
-	indices.push_back(5);
-	// Triangle #5
-	indices.push_back(15);
-	indices.push_back(21);
-	indices.push_back(18);
-	// Triangle #6
-	indices.push_back(15);
-	indices.push_back(18);
-	indices.push_back(12);
-	// Triangle #7
-	indices.push_back(8);
-	indices.push_back(20);
-	indices.push_back(11);
-	// Triangle #8
-	indices.push_back(11);
-	indices.push_back(20);
-	indices.push_back(23);
-	// Triangle #9
-	indices.push_back(16);
-	indices.push_back(4);
-	indices.push_back(10);
-	// Triangle #10
-	indices.push_back(16);
-	indices.push_back(10);
-	indices.push_back(22);
-	// Triangle #11
-	indices.push_back(13);
-	indices.push_back(19);
-	indices.push_back(7);
-	// Triangle #12
-	indices.push_back(13);
-	indices.push_back(7);
-	indices.push_back(1);
 
+PrimitiveModel::PrimitiveModel(
+	const Vertex* vertices,
+	unsigned nbr_vertices,
+	const unsigned* indices,
+	unsigned nbr_indices,
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context)
+	: Model(dxdevice, dxdevice_context),
+	nbr_indices(nbr_indices)
+{
 	// Vertex array descriptor
 	D3D11_BUFFER_DESC vbufferDesc = { 0 };
 	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbufferDesc.CPUAccessFlags = 0;
 	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = (UINT)(vertices.size() * sizeof(Vertex));
+	vbufferDesc.ByteWidth = (UINT)(nbr_vertices * sizeof(Vertex));
 	// Data resource
 	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
+	vdata.pSysMem = vertices;
 	// Create vertex buffer on device using descriptor & data
 	const HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
 	SETNAME(vertex_buffer, "VertexBuffer");
@@ -301,52 +304,116 @@ CubeModel::CubeModel(ID3D11Device* dxdevice, ID3D11DeviceContext* dxdevice_conte
 	ibufferDesc.CPUAccessFlags = 0;
 	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
 	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = (UINT)(indices.size() * sizeof(unsigned));
+	ibufferDesc.ByteWidth = (UINT)(nbr_indices * sizeof(unsigned));
 	// Data resource
 	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
+	idata.pSysMem = indices;
 	// Create index buffer on device using descriptor & data
 	const HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
 	SETNAME(index_buffer, "IndexBuffer");
 
-	nbr_indices = (unsigned int)indices.size();
 	material = new Material();
+
+	// Bounds for culling (a single drawcall)
+	AABB box;
+	BoundingSphere sphere;
+	ComputeBounds(&vertices[0].Pos, sizeof(Vertex), indices, nbr_indices, box, sphere);
+	AddDrawcallBounds(box, sphere);
+	occluder.AppendRange(&vertices[0].Pos, sizeof(Vertex), indices, nbr_indices);
 }
 
-void CubeModel::Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate) const
+void PrimitiveModel::Render(ID3D11DeviceContext* context, MaterialBinder* material_binder) const
 {
+	if (!drawcall_visible[0])
+		return;
+
 	// Bind our vertex buffer
-	const UINT32 stride = sizeof(Vertex); //  sizeof(float) * 8;
+	const UINT32 stride = sizeof(Vertex);
 	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// Bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
 
-	if (material)
+	if (material && material_binder)
 	{
-		if (phongBufferUpdate)
-			phongBufferUpdate(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), 200);
-
-		if (material->diffuse_texture && material->diffuse_texture.texture_SRV)
-			dxdevice_context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
+		material_binder->BindPhong(material->Ka.xyz1(), material->Kd.xyz1(), material->Ks.xyz1(), 200);
+		material_binder->BindMaterial(*material);
 	}
+	else if (material && material->diffuse_texture && material->diffuse_texture.texture_SRV)
+		context->PSSetShaderResources(0, 1, &material->diffuse_texture.texture_SRV);
 
 	// Make the drawcall
-	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
+	context->DrawIndexed(nbr_indices, 0, 0);
 }
 
 
 OBJModel::OBJModel(
 	const std::string& objfile,
 	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
+	ID3D11DeviceContext* dxdevice_context,
+	JobSystem* jobs)
 	: Model(dxdevice, dxdevice_context)
 {
 	// Load the OBJ
 	OBJLoader* mesh = new OBJLoader();
 	mesh->Load(objfile);
 
+	// Copy materials from mesh
+	append_materials(mesh->materials);
+
+	// Go through materials and load textures (if any) to device.
+	// Only the device is used, which is thread-safe, so materials can
+	// be loaded in parallel; results are printed afterwards.
+	const unsigned nbr_texture_types = 4;
+	std::vector<HRESULT> results(materials.size() * nbr_texture_types, S_OK);
+	auto load_textures = [&](unsigned begin, unsigned end)
+	{
+		for (unsigned i = begin; i < end; i++)
+		{
+			Material& mtl = materials[i];
+			const std::string* filenames[nbr_texture_types] =
+			{
+				&mtl.Kd_texture_filename,
+				&mtl.normal_texture_filename,
+				&mtl.Ks_texture_filename,
+				&mtl.mask_texture_filename
+			};
+			Texture* textures[nbr_texture_types] =
+			{
+				&mtl.diffuse_texture,
+				&mtl.normal_texture,
+				&mtl.specular_texture,
+				&mtl.mask_texture
+			};
+
+			for (unsigned k = 0; k < nbr_texture_types; k++)
+				if (filenames[k]->size())
+					results[i * nbr_texture_types + k] = LoadTextureFromFile(
+						dxdevice,
+						filenames[k]->c_str(),
+						textures[k]);
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(0, (unsigned)materials.size(), 1, load_textures);
+	else
+		load_textures(0, (unsigned)materials.size());
+
+	// Order the drawcalls by pixel shader permutation, then material, so
+	// that rendering switches shaders and textures as seldom as possible.
+	// The textures decide the permutation, so they are loaded first.
+	auto drawcall_permutation = [&](const Drawcall& dc)
+	{
+		return dc.mtl_index > -1 ? GetMaterialPermutation(materials[dc.mtl_index]) : 0u;
+	};
+	std::stable_sort(mesh->drawcalls.begin(), mesh->drawcalls.end(),
+		[&](const Drawcall& a, const Drawcall& b)
+		{
+			const unsigned pa = drawcall_permutation(a), pb = drawcall_permutation(b);
+			return pa != pb ? pa < pb : a.mtl_index < b.mtl_index;
+		});
+
 	// Load and organize indices in ranges per drawcall (material)
 
 	std::vector<unsigned> indices;
@@ -363,9 +430,28 @@ OBJModel::OBJModel(
 		int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
 		index_ranges.push_back({ i_ofs, i_size, 0, mtl_index });
 
+		// Bounds of the drawcall, for culling
+		AABB box;
+		BoundingSphere sphere;
+		ComputeBounds(&mesh->vertices[0].Pos, sizeof(Vertex), indices.data() + i_ofs, i_size, box, sphere);
+		AddDrawcallBounds(box, sphere);
+
 		i_ofs = (unsigned int)indices.size();
 	}
 
+	// Use the drawcalls that are large relative to the whole model as occluders,
+	// e.g. walls and floors of a building, up to a triangle budget
+	const unsigned max_occluder_tris = 8192;
+	const float min_occluder_size = 0.25f * bounds.Extents().norm2();
+	for (unsigned i = 0; i < (unsigned)index_ranges.size(); i++)
+	{
+		const IndexRange& irange = index_ranges[i];
+		if (GetDrawcallBounds(i).Extents().norm2() < min_occluder_size ||
+			occluder.indices.size() + irange.size > max_occluder_tris * 3)
+			continue;
+		occluder.AppendRange(&mesh->vertices[0].Pos, sizeof(Vertex), indices.data() + irange.start, irange.size);
+	}
+
 	// Vertex array descriptor
 	D3D11_BUFFER_DESC vbufferDesc = { 0 };
 	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
@@ -394,70 +480,81 @@ OBJModel::OBJModel(
 	HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
 	SETNAME(index_buffer, "IndexBuffer");
     
-	// Copy materials from mesh
-	append_materials(mesh->materials);
-
-	// Go through materials and load textures (if any) to device
-	std::cout << "Loading textures..." << std::endl;
-	for (auto& mtl : materials)
+	// In one piece, since other models may be loading concurrently
+	std::ostringstream log;
+	log << "Loaded " << objfile << ", textures:" << std::endl;
+	for (size_t i = 0; i < materials.size(); i++)
 	{
-		HRESULT hr;
-
-		// Load Diffuse texture
-		//
-		if (mtl.Kd_texture_filename.size()) {
-
-			hr = LoadTextureFromFile(
-				dxdevice,
-				mtl.Kd_texture_filename.c_str(), 
-				&mtl.diffuse_texture);
-			std::cout << "\t" << mtl.Kd_texture_filename 
-				<< (SUCCEEDED(hr) ? " - OK" : "- FAILED") << std::endl;
-		}
-
-		// + other texture types here - see Material class
-		// ...
+		const std::string* filenames[nbr_texture_types] =
+		{
+			&materials[i].Kd_texture_filename,
+			&materials[i].normal_texture_filename,
+			&materials[i].Ks_texture_filename,
+			&materials[i].mask_texture_filename
+		};
+		for (unsigned k = 0; k < nbr_texture_types; k++)
+			if (filenames[k]->size())
+				log << "\t" << *filenames[k]
+					<< (SUCCEEDED(results[i * nbr_texture_types + k]) ? " - OK" : "- FAILED") << std::endl;
 	}
-	std::cout << "Done." << std::endl;
+	std::cout << log.str();
 
 	SAFE_DELETE(mesh);
 }
 
 
-void OBJModel::Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate) const
+void OBJModel::Render(ID3D11DeviceContext* context, MaterialBinder* material_binder) const
 {
 	// Bind vertex buffer
 	const UINT32 stride = sizeof(Vertex);
 	const UINT32 offset = 0;
-	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+	context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// Bind index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
 
 	// Iterate drawcalls
-	for (auto& irange : index_ranges)
+	for (size_t i = 0; i < index_ranges.size(); i++)
 	{
+		// Skip drawcalls culled by Cull()
+		if (!drawcall_visible[i])
+			continue;
+
+		const IndexRange& irange = index_ranges[i];
+
 		// Fetch material
 		const Material& mtl = materials[irange.mtl_index];
 
-		if (phongBufferUpdate)
-			phongBufferUpdate(mtl.Ka.xyz1(), mtl.Kd.xyz1(), mtl.Ks.xyz1(), 5);
-
-		// Bind diffuse texture to slot t0 of the PS
-		dxdevice_context->PSSetShaderResources(0, 1, &mtl.diffuse_texture.texture_SRV);
-		// + bind other textures here, e.g. a normal map, to appropriate slots
+		if (material_binder)
+		{
+			material_binder->BindPhong(mtl.Ka.xyz1(), mtl.Kd.xyz1(), mtl.Ks.xyz1(), 5);
+			material_binder->BindMaterial(mtl);
+		}
+		else
+		{
+			// Bind diffuse texture to slot t0 of the PS
+			context->PSSetShaderResources(0, 1, &mtl.diffuse_texture.texture_SRV);
+		}
 
 		// Make the drawcall
-		dxdevice_context->DrawIndexed(irange.size, irange.start, 0);
+		context->DrawIndexed(irange.size, irange.start, 0);
 	}
 }
 
+unsigned OBJModel::GetPermutation() const
+{
+	if (index_ranges.empty() || index_ranges[0].mtl_index < 0)
+		return 0;
+	return GetMaterialPermutation(materials[index_ranges[0].mtl_index]);
+}
+
 OBJModel::~OBJModel()
 {
 	for (auto& material : materials)
 	{
 		SAFE_RELEASE(material.diffuse_texture.texture_SRV);
-
-		// Release other used textures ...
+		SAFE_RELEASE(material.normal_texture.texture_SRV);
+		SAFE_RELEASE(material.specular_texture.texture_SRV);
+		SAFE_RELEASE(material.mask_texture.texture_SRV);
 	}
 }
\ No newline at end of file
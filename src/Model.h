@@ -11,13 +11,15 @@
 
 #include "stdafx.h"
 #include <vector>
-#include "vec\vec.h"
-#include "vec\mat.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
 #include "ShaderBuffers.h"
 #include "Drawcall.h"
 #include "OBJLoader.h"
-#include "Texture.h"
-#include <functional>
+#include "TextureLoader.h"
+#include "OcclusionCuller.h"
+#include "MaterialBinder.h"
+#include "JobSystem.h"
 
 using namespace linalg;
 
@@ -32,12 +34,23 @@ protected:
 	ID3D11Buffer* vertex_buffer = nullptr;
 	ID3D11Buffer* index_buffer = nullptr;
 
-public:
-	// Transformation values
-	vec3f position = vec3f_zero;
-	vec3f eulerAngles = vec3f_zero;
-	vec3f scale = vec3f_zero;
+	// Local-space bounds of the model and of each of its drawcalls
+	AABB bounds;
+	BoundsSoA drawcall_bounds;
+
+	// Culling result per drawcall, written by Cull() or an external
+	// culler (e.g. a BVH) and read by Render()
+	std::vector<unsigned char> drawcall_visible;
+	unsigned nbr_visible_drawcalls = 0;
+
+	// Add the bounds of a drawcall (in drawcall order)
+	void AddDrawcallBounds(const AABB& box, const BoundingSphere& sphere);
 
+	// Simplified geometry rasterized for occlusion culling; empty if the
+	// model is not a good occluder
+	OccluderMesh occluder;
+
+public:
 	Model(
 		ID3D11Device* dxdevice, 
 		ID3D11DeviceContext* dxdevice_context) 
@@ -46,9 +59,47 @@ public:
 	{ }
 
 	//
-	// Abstract render method: must be implemented by derived classes
+	// View-frustum cull the drawcalls of this model.
+	// ModelToClipMatrix is Projection * View * ModelToWorld.
+	// Returns the number of drawcalls that may be visible; the
+	// remaining drawcalls are skipped by Render().
+	//
+	unsigned Cull(const mat4f& ModelToClipMatrix, CullStats* stats = nullptr);
+
+	const AABB& GetBounds() const { return bounds; }
+
+	unsigned GetDrawcallCount() const { return (unsigned)drawcall_bounds.Size(); }
+
+	AABB GetDrawcallBounds(unsigned i) const { return drawcall_bounds.GetAABB(i); }
+
+	//
+	// Visibility for external cullers: hide all drawcalls, then show the visible ones
 	//
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate = nullptr) const = 0;
+	void HideAllDrawcalls();
+
+	void ShowDrawcall(unsigned i);
+
+	void HideDrawcall(unsigned i);
+
+	const OccluderMesh& GetOccluderMesh() const { return occluder; }
+
+	bool IsDrawcallVisible(unsigned i) const { return drawcall_visible[i] != 0; }
+
+	unsigned GetVisibleDrawcallCount() const { return nbr_visible_drawcalls; }
+
+	bool IsVisible() const { return nbr_visible_drawcalls > 0; }
+
+	//
+	// Abstract render method: must be implemented by derived classes.
+	// Records the drawcalls into context, the immediate or a deferred one.
+	// Materials are bound through material_binder, which must belong to
+	// the same context; with a null binder the currently bound material
+	// parameters are used.
+	//
+	virtual void Render(ID3D11DeviceContext* context, MaterialBinder* material_binder = nullptr) const = 0;
+
+	// Pixel shader permutation of the first drawcall, for sorting draws
+	virtual unsigned GetPermutation() const { return 0; }
 
 	//
 	// Destructor
@@ -74,7 +125,9 @@ public:
 
 	void SetMaterial(const Material& mat) { *material = mat; }
 
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate = nullptr) const;
+	virtual void Render(ID3D11DeviceContext* context, MaterialBinder* material_binder = nullptr) const;
+
+	unsigned GetPermutation() const { return GetMaterialPermutation(*material); }
 
 	~QuadModel() { }
 };
@@ -93,11 +146,41 @@ public:
 
 	void SetMaterial(const Material& mat) { *material = mat; }
 
-	void Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate = nullptr) const;
+	void Render(ID3D11DeviceContext* context, MaterialBinder* material_binder = nullptr) const;
+
+	unsigned GetPermutation() const { return GetMaterialPermutation(*material); }
 
 	~CubeModel() { }
 };
 
+//
+// A single-drawcall model built from generated geometry, e.g. from Primitives.h
+//
+class PrimitiveModel : public Model
+{
+	unsigned nbr_indices = 0;
+
+	Material* material;
+
+public:
+
+	PrimitiveModel(
+		const Vertex* vertices,
+		unsigned nbr_vertices,
+		const unsigned* indices,
+		unsigned nbr_indices,
+		ID3D11Device* dx3ddevice,
+		ID3D11DeviceContext* dx3ddevice_context);
+
+	void SetMaterial(const Material& mat) { *material = mat; }
+
+	void Render(ID3D11DeviceContext* context, MaterialBinder* material_binder = nullptr) const;
+
+	unsigned GetPermutation() const { return GetMaterialPermutation(*material); }
+
+	~PrimitiveModel() { }
+};
+
 class OBJModel : public Model
 {
 	// index ranges, representing drawcalls, within an index array
@@ -119,12 +202,20 @@ class OBJModel : public Model
 
 public:
 
+	//
+	// Load an OBJ and its textures. With jobs, the textures are decoded
+	// in parallel, and the constructor may itself run as a job.
+	//
 	OBJModel(
 		const std::string& objfile,
 		ID3D11Device* dxdevice,
-		ID3D11DeviceContext* dxdevice_context);
+		ID3D11DeviceContext* dxdevice_context,
+		JobSystem* jobs = nullptr);
+
+	virtual void Render(ID3D11DeviceContext* context, MaterialBinder* material_binder = nullptr) const;
 
-	virtual void Render(std::function<void(vec4f, vec4f, vec4f, float)> phongBufferUpdate = nullptr) const;
+	// Drawcalls are ordered by permutation; the first one's
+	unsigned GetPermutation() const;
 
 	~OBJModel();
 };
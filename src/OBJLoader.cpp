@@ -7,12 +7,25 @@
 
 #include <fstream>
 #include <algorithm>
+#include <cstring>
+#include <memory_resource>
+#include <stdexcept>
 #include "OBJLoader.h"
 #include "vec/vec.h"
 #include "parseutil.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
 
 using namespace linalg;
 
+// Intermediate data lives in an arena per load, and is freed all at once
+// when the load is done. The arena's chunks are mesh-load memory.
+template <class T>
+using LoadVector = std::pmr::vector<T>;
+
+// First chunk of the arena; later ones grow geometrically
+static const size_t ArenaInitialSize = 256 * 1024;
+
 //
 // Auxiliary structs for raw file data
 //
@@ -20,11 +33,15 @@ struct unwelded_triangle_t { int vi[9]; };
 struct unwelded_quad_t { int vi[12]; };
 struct unwelded_drawcall_t
 {
-	std::string mtl_name;
-	std::string group_name;
-	std::vector<unwelded_triangle_t> tris;
-	std::vector<unwelded_quad_t> quads;
+	std::pmr::string mtl_name;
+	std::pmr::string group_name;
+	LoadVector<unwelded_triangle_t> tris;
+	LoadVector<unwelded_quad_t> quads;
 	int v_ofs = 0;
+
+	// Copies would not be in the arena: move these instead
+	explicit unwelded_drawcall_t(std::pmr::memory_resource* arena) :
+		mtl_name(arena), group_name(arena), tris(arena), quads(arena) { }
 };
 
 //
@@ -35,13 +52,12 @@ struct unwelded_drawcall_t
 // to create them. Works best for relatively smooth models.
 //
 void GenerateNormals(
-	const std::vector<vec3f>& v, 
-	std::vector<vec3f>& vn, 
-	std::vector<unwelded_drawcall_t>& drawcalls)
+	const LoadVector<vec3f>& v, 
+	LoadVector<vec3f>& vn, 
+	LoadVector<unwelded_drawcall_t>& drawcalls)
 {
-	std::vector<vec3f>* v_bin = new std::vector<vec3f>[v.size()];
-
-	// bin normals from all faces to vertex bins
+	// sum the normals of all faces at each vertex, in face order
+	vn.assign(v.size(), vec3f_zero);
 	for (unwelded_drawcall_t& dc : drawcalls)
 		for (unwelded_triangle_t& tri : dc.tris)
 		{
@@ -49,27 +65,16 @@ void GenerateNormals(
 			vec3f v0 = v[a], v1 = v[b], v2 = v[c];
 			vec3f n = linalg::normalize((v1 - v0) % (v2 - v0));
 
-			v_bin[a].push_back(n);
-			v_bin[b].push_back(n);
-			v_bin[c].push_back(n);
+			vn[a] += n;
+			vn[b] += n;
+			vn[c] += n;
 
 			memcpy(tri.vi + 3, tri.vi, 3 * sizeof(int));
 		}
 
-	// average binned normals and add to array
-	for (size_t i = 0; i < v.size(); i++)
-	{
-		vec3f n = vec3f_zero;
-		for (size_t j = 0; j < v_bin[i].size(); j++)
-		{
-			n += v_bin[i][j];
-		}
+	// and average them
+	for (vec3f& n : vn)
 		n = linalg::normalize(n);
-
-		vn.push_back(n);
-	}
-
-	delete[] v_bin;
 }
 
 void OBJLoader::LoadMaterials(
@@ -82,7 +87,8 @@ void OBJLoader::LoadMaterials(
     std::ifstream in(fullpath.c_str());
     if (!in)
         throw std::runtime_error(std::string("Failed to open ") + fullpath);
-    std::cout << "Opened " << fullpath << "\n";
+    if (verbose)
+        std::cout << "Opened " << fullpath << "\n";
     
     std::string line;
     Material *current_mtl = NULL;
@@ -97,7 +103,7 @@ void OBJLoader::LoadMaterials(
         if (sscanf_s(line.c_str(), "newmtl %s", str0, MaxChars) == 1)
         {
             // check for duplicate
-            if (mtl_hash.find(str0) != mtl_hash.end() ) printf("Warning: duplicate material '%s'\n", str0);
+            if (mtl_hash.find(str0) != mtl_hash.end() && verbose) printf("Warning: duplicate material '%s'\n", str0);
             
             mtl_hash[str0] = Material();
             current_mtl = &mtl_hash[str0];
@@ -117,6 +123,24 @@ void OBJLoader::LoadMaterials(
             else
                 throw std::runtime_error(std::string("Error: no allowed format found for 'map_Kd' in material ") + current_mtl->name);
         }
+        else if (sscanf_s(line.c_str(), "map_Ks %[^\n]", str0, MaxChars) == 1)
+        {
+            // search for the image file and ignore the rest
+            std::string mapfile;
+			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
+                current_mtl->Ks_texture_filename = path + mapfile;
+            else
+                throw std::runtime_error(std::string("Error: no allowed format found for 'map_Ks' in material ") + current_mtl->name);
+        }
+        else if (line.compare(0, 6, "map_d ") == 0 && sscanf_s(line.c_str(), "map_d %[^\n]", str0, MaxChars) == 1)
+        {
+            // search for the image file and ignore the rest
+            std::string mapfile;
+			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
+                current_mtl->mask_texture_filename = path + mapfile;
+            else
+                throw std::runtime_error(std::string("Error: no allowed format found for 'map_d' in material ") + current_mtl->name);
+        }
         else if (sscanf_s(line.c_str(), "map_bump %[^\n]", str0, MaxChars) == 1)
         {
             // search for the image file and ignore the rest
@@ -156,24 +180,36 @@ void OBJLoader::Load(
 	bool auto_generate_normals,
 	bool triangulate)
 {
-	std::string parentdir = get_parentdir(filename);
-
 	std::ifstream in(filename.c_str());
 	if (!in) throw std::runtime_error(std::string("Failed to open ") + filename);
-	std::cout << "Opened " << filename << "\n";
+	if (verbose) std::cout << "Opened " << filename << "\n";
+
+	Load(in, get_parentdir(filename), auto_generate_normals, triangulate);
+}
+
+void OBJLoader::Load(
+	std::istream& in,
+	const std::string& parentdir,
+	bool auto_generate_normals,
+	bool triangulate)
+{
+	ProfileZone parse_zone("OBJ parse");
+
+	static TaggedMemoryResource mesh_load_memory(MemoryTag::MeshLoad);
+	std::pmr::monotonic_buffer_resource arena(ArenaInitialSize, &mesh_load_memory);
 
 	// raw data from obj
-	std::vector<vec3f> file_vertices, file_normals;
-	std::vector<vec2f> file_texcoords;
-	std::vector<unwelded_drawcall_t> file_drawcalls;
+	LoadVector<vec3f> file_vertices(&arena), file_normals(&arena);
+	LoadVector<vec2f> file_texcoords(&arena);
+	LoadVector<unwelded_drawcall_t> file_drawcalls(&arena);
 	MaterialHash file_materials;
 
-	std::string current_group_name;
-	unwelded_drawcall_t default_drawcall;
+	std::pmr::string current_group_name(&arena);
+	unwelded_drawcall_t default_drawcall(&arena);
 	unwelded_drawcall_t* current_drawcall = &default_drawcall;
 	int last_ofs = 0; bool face_section = false; // info for skin weight mapping
 
-	std::string line;
+	std::pmr::string line(&arena);
 	while (getline(in, line))
 	{
 		const int MaxChars = 1024;
@@ -191,11 +227,11 @@ void OBJLoader::Load(
 		//
 		else if (sscanf_s(line.c_str(), "usemtl %s", str, MaxChars) == 1)
 		{
-			unwelded_drawcall_t udc;
+			unwelded_drawcall_t udc(&arena);
 			udc.mtl_name = str;
 			udc.group_name = current_group_name;
 			udc.v_ofs = last_ofs; face_section = true; // skinning: set current vertex offset and mark beginning of a face-section
-			file_drawcalls.push_back(udc);
+			file_drawcalls.push_back(std::move(udc));
 			current_drawcall = &file_drawcalls.back();
 		}
 		else if (sscanf_s(line.c_str(), "g %s", str, MaxChars) == 1)
@@ -313,32 +349,34 @@ void OBJLoader::Load(
 
 		}
 	}
-	in.close();
+	parse_zone.End();
 
 	// use defualt drawcall if no instance of usemtl
 	if (!file_drawcalls.size())
-		file_drawcalls.push_back(default_drawcall);
+		file_drawcalls.push_back(std::move(default_drawcall));
 
 	has_normals = (bool)file_normals.size();
 	has_texcoords = (bool)file_texcoords.size();
 
-	printf("Loaded:\n\t%d vertices\n\t%d texels\n\t%d normals\n\t%d drawcalls\n",
+	if (verbose) printf("Loaded:\n\t%d vertices\n\t%d texels\n\t%d normals\n\t%d drawcalls\n",
 		(int)file_vertices.size(), (int)file_texcoords.size(), (int)file_normals.size(), (int)file_drawcalls.size());
 
 #if 1
 	// auto-generate normals
 	if (!has_normals && auto_generate_normals)
 	{
+		PROFILE_ZONE("OBJ normals");
 		GenerateNormals(file_vertices, file_normals, file_drawcalls);
 		has_normals = true;
-		printf("Auto-generated %d normals\n", (int)file_normals.size());
+		if (verbose) printf("Auto-generated %d normals\n", (int)file_normals.size());
 	}
 #endif
 
 #if 1
-	printf("Welding vertex array...");
+	ProfileZone weld_zone("OBJ weld");
+	if (verbose) printf("Welding vertex array...");
 
-	std::unordered_map<std::string, unsigned> mtl_to_index_hash;
+	std::pmr::unordered_map<std::pmr::string, unsigned> mtl_to_index_hash(&arena);
 
 	// hash function for int3
 	struct int3_hashfunction {
@@ -350,9 +388,9 @@ void OBJLoader::Load(
 	for (auto &dc : file_drawcalls)
 	{
 		Drawcall wdc;
-		wdc.group_name = dc.group_name;
+		wdc.group_name.assign(dc.group_name.data(), dc.group_name.size());
 
-		std::unordered_map<int3, unsigned, int3_hashfunction> index3_to_index_hash;
+		std::pmr::unordered_map<int3, unsigned, int3_hashfunction> index3_to_index_hash(&arena);
 
 		// material
 		//
@@ -363,10 +401,11 @@ void OBJLoader::Load(
 			auto mtl_index = mtl_to_index_hash.find(dc.mtl_name);
 			if (mtl_index == mtl_to_index_hash.end())
 			{
-				auto mtl = file_materials.find(dc.mtl_name);
+				const std::string mtl_name(dc.mtl_name.data(), dc.mtl_name.size());
+				auto mtl = file_materials.find(mtl_name);
 
 				if (mtl == file_materials.end())
-					throw std::runtime_error(std::string("Error: used material ") + dc.mtl_name + " not found\n");
+					throw std::runtime_error(std::string("Error: used material ") + mtl_name + " not found\n");
 
 				wdc.mtl_index = (unsigned)materials.size();
 				mtl_to_index_hash[dc.mtl_name] = (unsigned)materials.size();
@@ -450,7 +489,8 @@ void OBJLoader::Load(
 
 		drawcalls.push_back(wdc);
 	}
-	printf("Done\n");
+	weld_zone.End();
+	if (verbose) printf("Done\n");
 
 	// Produce and print some stats
 	//
@@ -459,11 +499,14 @@ void OBJLoader::Load(
 		tris += (int)dc.tris.size();
 		quads += (int)dc.quads.size();
 	}
-	printf("\t%d vertices\n\t%d drawcalls\n\t%d triangles\n\t%d quads\n",
-		(int)vertices.size(), (int)drawcalls.size(), tris, quads);
-	printf("Loaded materials:\n");
-	for (auto &mtl : materials)
-		printf("\t%s\n", mtl.name.c_str());
+	if (verbose)
+	{
+		printf("\t%d vertices\n\t%d drawcalls\n\t%d triangles\n\t%d quads\n",
+			(int)vertices.size(), (int)drawcalls.size(), tris, quads);
+		printf("Loaded materials:\n");
+		for (auto &mtl : materials)
+			printf("\t%s\n", mtl.name.c_str());
+	}
 
 #ifdef MESH_FORCE_CCW
     // Force counter-clockwise: 
@@ -489,7 +532,7 @@ void OBJLoader::Load(
 	// rendered back-to-back to make the number of texture binds (which are slow)
 	// as low as possible
     std::sort(drawcalls.begin(), drawcalls.end());
-	printf("Sorted drawcalls\n");
+	if (verbose) printf("Sorted drawcalls\n");
 #endif
     
 #endif
@@ -8,6 +8,7 @@
 #ifndef OBJLOADER_H
 #define OBJLOADER_H
 
+#include <istream>
 #include <vector>
 #include <string>
 #include "Drawcall.h"
@@ -42,6 +43,19 @@ public:
         bool auto_generate_normals = true,
         bool triangulate = true);
 
+    //
+    // Load from a stream, e.g. a file already read into memory.
+    // Material files are read from parentdir.
+    //
+    void Load(
+        std::istream& in,
+        const std::string& parentdir,
+        bool auto_generate_normals = true,
+        bool triangulate = true);
+
+    // Print progress and statistics to stdout
+    bool verbose = true;
+
     bool has_normals = false;
     bool has_texcoords = false;
 
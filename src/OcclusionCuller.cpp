@@ -0,0 +1,284 @@
+//
+//  OcclusionCuller.cpp
+//
+//	Software occlusion culling with a low-resolution CPU depth buffer
+//
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include "OcclusionCuller.h"
+#include "vec/batch.h"
+
+void OccluderMesh::AppendRange(
+	const vec3f* src_positions,
+	size_t stride,
+	const unsigned* src_indices,
+	size_t index_count)
+{
+	const unsigned char* base = (const unsigned char*)src_positions;
+	std::unordered_map<unsigned, unsigned> remap;
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		const unsigned src = src_indices[i];
+		auto it = remap.find(src);
+		if (it == remap.end())
+		{
+			it = remap.insert({ src, (unsigned)positions.size() }).first;
+			positions.push_back(*(const vec3f*)(base + src * stride));
+		}
+		indices.push_back(it->second);
+	}
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+	SetResolution(width, height);
+}
+
+void OcclusionCuller::SetResolution(int w, int h)
+{
+	width = (w + TileSize - 1) / TileSize * TileSize;
+	height = (h + TileSize - 1) / TileSize * TileSize;
+	tiles_x = width / TileSize;
+	tiles_y = height / TileSize;
+	depth.assign((size_t)width * height, 1.0f);
+	tile_max.assign((size_t)tiles_x * tiles_y, 1.0f);
+}
+
+void OcclusionCuller::BeginFrame()
+{
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	nbr_rasterized = 0;
+}
+
+void OcclusionCuller::RenderOccluder(const OccluderMesh& mesh, const mat4f& ModelToClipMatrix)
+{
+	if (mesh.IsEmpty())
+		return;
+
+	// Occluder vertices are shared between triangles: project each vertex once
+	clip_positions.resize(mesh.positions.size());
+	transform_points(ModelToClipMatrix, mesh.positions.data(), clip_positions.data(), mesh.positions.size());
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		RasterizeTriangle(
+			clip_positions[mesh.indices[i + 0]],
+			clip_positions[mesh.indices[i + 1]],
+			clip_positions[mesh.indices[i + 2]]);
+	}
+}
+
+void OcclusionCuller::RenderOccluder(
+	const vec3f* positions,
+	size_t stride,
+	const unsigned* indices,
+	size_t index_count,
+	const mat4f& ModelToClipMatrix)
+{
+	const unsigned char* base = (const unsigned char*)positions;
+
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		const vec3f& p0 = *(const vec3f*)(base + indices[i + 0] * stride);
+		const vec3f& p1 = *(const vec3f*)(base + indices[i + 1] * stride);
+		const vec3f& p2 = *(const vec3f*)(base + indices[i + 2] * stride);
+
+		RasterizeTriangle(
+			ModelToClipMatrix * p0.xyz1(),
+			ModelToClipMatrix * p1.xyz1(),
+			ModelToClipMatrix * p2.xyz1());
+	}
+}
+
+// Vertices this close to the eye plane are considered crossing the near plane
+static const float MinW = 1e-5f;
+
+static inline bool InFrontOfNearPlane(const vec4f& v)
+{
+	return v.w > MinW && v.z >= -v.w;
+}
+
+void OcclusionCuller::RasterizeTriangle(const vec4f& c0, const vec4f& c1, const vec4f& c2)
+{
+	// Occluders crossing the near plane are skipped rather than clipped,
+	// which only makes culling less aggressive
+	if (!InFrontOfNearPlane(c0) || !InFrontOfNearPlane(c1) || !InFrontOfNearPlane(c2))
+		return;
+
+	// Screen-space positions (pixel centers at i+0.5) and depths
+	const float hw = 0.5f * width, hh = 0.5f * height;
+	float x0 = (c0.x / c0.w + 1.0f) * hw, y0 = (c0.y / c0.w + 1.0f) * hh, z0 = c0.z / c0.w;
+	float x1 = (c1.x / c1.w + 1.0f) * hw, y1 = (c1.y / c1.w + 1.0f) * hh, z1 = c1.z / c1.w;
+	float x2 = (c2.x / c2.w + 1.0f) * hw, y2 = (c2.y / c2.w + 1.0f) * hh, z2 = c2.z / c2.w;
+
+	// Occluders are rasterized regardless of facing: make the winding counter-clockwise
+	float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (std::abs(area) < 1e-8f)
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2); std::swap(y1, y2); std::swap(z1, z2);
+		area = -area;
+	}
+
+	// Bounding rectangle, clamped to the buffer. x starts at a multiple of 4.
+	int xmin = (int)std::floor(std::min<float>(x0, std::min<float>(x1, x2)));
+	int xmax = (int)std::ceil(std::max<float>(x0, std::max<float>(x1, x2)));
+	int ymin = (int)std::floor(std::min<float>(y0, std::min<float>(y1, y2)));
+	int ymax = (int)std::ceil(std::max<float>(y0, std::max<float>(y1, y2)));
+	xmin = std::max<int>(xmin, 0) & ~3;
+	ymin = std::max<int>(ymin, 0);
+	xmax = std::min<int>(xmax, width - 1);
+	ymax = std::min<int>(ymax, height - 1);
+	if (xmin > xmax || ymin > ymax)
+		return;
+
+	nbr_rasterized++;
+
+	// Edge functions E(x,y) = A*x + B*y + C, positive inside
+	const float A01 = y0 - y1, B01 = x1 - x0, C01 = -(A01 * x0 + B01 * y0);
+	const float A12 = y1 - y2, B12 = x2 - x1, C12 = -(A12 * x1 + B12 * y1);
+	const float A20 = y2 - y0, B20 = x0 - x2, C20 = -(A20 * x2 + B20 * y2);
+
+	// Depth plane: z = (E12*z0 + E20*z1 + E01*z2) / area
+	const float inv_area = 1.0f / area;
+	const float zA = (A12 * z0 + A20 * z1 + A01 * z2) * inv_area;
+	const float zB = (B12 * z0 + B20 * z1 + B01 * z2) * inv_area;
+	const float zC = (C12 * z0 + C20 * z1 + C01 * z2) * inv_area;
+
+#ifdef LINALG_SSE
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 vA01 = _mm_set1_ps(A01), vA12 = _mm_set1_ps(A12), vA20 = _mm_set1_ps(A20);
+	const __m128 vzA = _mm_set1_ps(zA);
+
+	for (int y = ymin; y <= ymax; y++)
+	{
+		const float py = y + 0.5f;
+		const __m128 r01 = _mm_set1_ps(B01 * py + C01);
+		const __m128 r12 = _mm_set1_ps(B12 * py + C12);
+		const __m128 r20 = _mm_set1_ps(B20 * py + C20);
+		const __m128 rz = _mm_set1_ps(zB * py + zC);
+		float* row = depth.data() + (size_t)y * width;
+
+		for (int x = xmin; x <= xmax; x += 4)
+		{
+			const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+			const __m128 e01 = _mm_add_ps(_mm_mul_ps(vA01, px), r01);
+			const __m128 e12 = _mm_add_ps(_mm_mul_ps(vA12, px), r12);
+			const __m128 e20 = _mm_add_ps(_mm_mul_ps(vA20, px), r20);
+			const __m128 inside = _mm_and_ps(_mm_and_ps(
+				_mm_cmpge_ps(e01, zero),
+				_mm_cmpge_ps(e12, zero)),
+				_mm_cmpge_ps(e20, zero));
+			if (!_mm_movemask_ps(inside))
+				continue;
+
+			const __m128 z = _mm_add_ps(_mm_mul_ps(vzA, px), rz);
+			const __m128 d = _mm_loadu_ps(row + x);
+			const __m128 zmin = _mm_min_ps(d, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, zmin), _mm_andnot_ps(inside, d)));
+		}
+	}
+#else
+	for (int y = ymin; y <= ymax; y++)
+	{
+		const float py = y + 0.5f;
+		float* row = depth.data() + (size_t)y * width;
+
+		for (int x = xmin; x <= xmax; x++)
+		{
+			const float px = x + 0.5f;
+			if (A01 * px + B01 * py + C01 < 0.0f ||
+				A12 * px + B12 * py + C12 < 0.0f ||
+				A20 * px + B20 * py + C20 < 0.0f)
+				continue;
+			const float z = zA * px + zB * py + zC;
+			row[x] = std::min<float>(row[x], z);
+		}
+	}
+#endif
+}
+
+void OcclusionCuller::EndFrame()
+{
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			float zmax = 0.0f;
+			for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++)
+			{
+				const float* row = depth.data() + (size_t)y * width + tx * TileSize;
+				for (int x = 0; x < TileSize; x++)
+					zmax = std::max<float>(zmax, row[x]);
+			}
+			tile_max[(size_t)ty * tiles_x + tx] = zmax;
+		}
+	}
+}
+
+bool OcclusionCuller::TestAABB(const AABB& box, const mat4f& ModelToClipMatrix) const
+{
+	// Screen rectangle and nearest depth of the projected box
+	vec3f corners[8];
+	vec4f clip_corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = vec3f(
+			i & 1 ? box.max.x : box.min.x,
+			i & 2 ? box.max.y : box.min.y,
+			i & 4 ? box.max.z : box.min.z);
+	}
+	transform_points(ModelToClipMatrix, corners, clip_corners, 8);
+
+	float xmin = FLT_MAX, xmax = -FLT_MAX, ymin = FLT_MAX, ymax = -FLT_MAX, zmin = FLT_MAX;
+	for (const vec4f& c : clip_corners)
+	{
+		// Boxes crossing the near plane may cover the whole screen
+		if (!InFrontOfNearPlane(c))
+			return true;
+
+		const float iw = 1.0f / c.w;
+		xmin = std::min<float>(xmin, c.x * iw);
+		xmax = std::max<float>(xmax, c.x * iw);
+		ymin = std::min<float>(ymin, c.y * iw);
+		ymax = std::max<float>(ymax, c.y * iw);
+		zmin = std::min<float>(zmin, c.z * iw);
+	}
+
+	const float hw = 0.5f * width, hh = 0.5f * height;
+	const int px0 = std::max<int>((int)std::floor((xmin + 1.0f) * hw), 0);
+	const int px1 = std::min<int>((int)std::ceil((xmax + 1.0f) * hw), width - 1);
+	const int py0 = std::max<int>((int)std::floor((ymin + 1.0f) * hh), 0);
+	const int py1 = std::min<int>((int)std::ceil((ymax + 1.0f) * hh), height - 1);
+
+	// Entirely off-screen
+	if (px0 > px1 || py0 > py1)
+		return false;
+
+	// Coarse test against the per-tile farthest depth, then refine per
+	// pixel in the tiles where the box may be in front of something
+	for (int ty = py0 / TileSize; ty <= py1 / TileSize; ty++)
+	{
+		for (int tx = px0 / TileSize; tx <= px1 / TileSize; tx++)
+		{
+			if (tile_max[(size_t)ty * tiles_x + tx] < zmin)
+				continue;
+
+			const int y0 = std::max<int>(py0, ty * TileSize), y1 = std::min<int>(py1, (ty + 1) * TileSize - 1);
+			const int x0 = std::max<int>(px0, tx * TileSize), x1 = std::min<int>(px1, (tx + 1) * TileSize - 1);
+			for (int y = y0; y <= y1; y++)
+			{
+				const float* row = depth.data() + (size_t)y * width;
+				for (int x = x0; x <= x1; x++)
+					if (row[x] >= zmin)
+						return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,104 @@
+//
+//  OcclusionCuller.h
+//
+//	Software occlusion culling with a low-resolution CPU depth buffer
+//
+
+#pragma once
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+#include "Culling.h"
+
+//
+// Triangles used as occluders, in model space
+//
+struct OccluderMesh
+{
+	std::vector<vec3f> positions;
+	std::vector<unsigned> indices;
+
+	bool IsEmpty() const { return indices.empty(); }
+
+	//
+	// Append the triangles of an index range. Indices refer to positions
+	// read with a byte stride (e.g. from a Vertex array); only the
+	// referenced vertices are copied.
+	//
+	void AppendRange(
+		const vec3f* src_positions,
+		size_t stride,
+		const unsigned* src_indices,
+		size_t index_count);
+};
+
+//
+// Occlusion culler in the spirit of Masked Occlusion Culling (Hasselgren et al. 2016):
+// chosen occluders are rasterized into a small depth buffer, four pixels at a
+// time, which is then reduced to a hierarchical buffer holding the farthest depth
+// per tile. Bounding boxes are tested conservatively against it: a box is occluded
+// only if its nearest depth is behind the farthest occluder depth of every tile,
+// or pixel, that it covers.
+//
+// Depth is clip z/w, which is linear in screen space. Geometry crossing the near
+// plane is skipped when rasterizing occluders and treated as visible when testing.
+//
+class OcclusionCuller
+{
+public:
+	static const int TileSize = 8;
+
+	OcclusionCuller(int width = 320, int height = 160);
+
+	//
+	// Width is rounded up to a multiple of TileSize (and thereby of the SIMD width)
+	//
+	void SetResolution(int width, int height);
+
+	//
+	// Clear the depth buffer to the far plane
+	//
+	void BeginFrame();
+
+	//
+	// Rasterize an occluder. ModelToClipMatrix is Projection * View * Model.
+	//
+	void RenderOccluder(const OccluderMesh& mesh, const mat4f& ModelToClipMatrix);
+
+	void RenderOccluder(
+		const vec3f* positions,
+		size_t stride,
+		const unsigned* indices,
+		size_t index_count,
+		const mat4f& ModelToClipMatrix);
+
+	//
+	// Build the hierarchical depth buffer; call after all occluders are rendered
+	//
+	void EndFrame();
+
+	//
+	// Returns false if the box is certainly hidden behind the occluders
+	//
+	bool TestAABB(const AABB& box, const mat4f& ModelToClipMatrix) const;
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+	const float* GetDepthBuffer() const { return depth.data(); }
+
+	unsigned GetRasterizedTriangleCount() const { return nbr_rasterized; }
+
+private:
+	int width, height;
+	int tiles_x, tiles_y;
+	std::vector<float> depth;		// Per pixel, nearest occluder depth
+	std::vector<float> tile_max;	// Per tile, farthest depth among its pixels
+	unsigned nbr_rasterized = 0;
+	std::vector<vec4f> clip_positions;	// Scratch for projected occluder vertices
+
+	void RasterizeTriangle(const vec4f& v0, const vec4f& v1, const vec4f& v2);
+};
+
+#endif
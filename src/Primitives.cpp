@@ -0,0 +1,319 @@
+//
+//  Primitives.cpp
+//
+//	Procedural primitive meshes: sphere, cylinder, torus, grid and cube
+//
+
+#include <climits>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "vec/math.h"
+#include "Primitives.h"
+
+static void Require(bool condition, const char* message)
+{
+	if (!condition)
+		throw std::runtime_error(message);
+}
+
+static PrimitiveCounts MakeCounts(unsigned long long vertices, unsigned long long indices)
+{
+	Require(vertices <= UINT_MAX && indices <= UINT_MAX, "Primitives: tessellation too high for 32-bit indices");
+
+	PrimitiveCounts counts;
+	counts.vertices = (unsigned)vertices;
+	counts.indices = (unsigned)indices;
+	return counts;
+}
+
+//
+// Two triangles per cell of a (rows+1) x (cols+1) vertex lattice, stored
+// row by row. Rows advance along v and columns along u, so with the
+// Binormal x Tangent = Normal convention the triangles face outwards.
+//
+static unsigned* EmitPatch(unsigned* indices, unsigned first, unsigned rows, unsigned cols)
+{
+	const unsigned stride = cols + 1;
+	for (unsigned i = 0; i < rows; i++)
+	{
+		for (unsigned j = 0; j < cols; j++)
+		{
+			const unsigned a = first + i * stride + j, b = a + stride;
+			*indices++ = a; *indices++ = b; *indices++ = a + 1;
+			*indices++ = a + 1; *indices++ = b; *indices++ = b + 1;
+		}
+	}
+	return indices;
+}
+
+//
+// sin/cos of n+1 angles evenly spaced over [0, range]. For a full turn the
+// last pair is copied from the first, so seam vertices match exactly.
+//
+static void SinCosTable(unsigned n, float range, bool full_turn, std::vector<float>& s, std::vector<float>& c)
+{
+	s.resize(n + 1);
+	c.resize(n + 1);
+	for (unsigned i = 0; i <= n; i++)
+	{
+		const float a = range * i / n;
+		s[i] = std::sin(a);
+		c[i] = std::cos(a);
+	}
+	if (full_turn)
+	{
+		s[n] = s[0];
+		c[n] = c[0];
+	}
+}
+
+PrimitiveCounts SphereCounts(unsigned slices, unsigned stacks)
+{
+	Require(slices >= 3 && stacks >= 2, "Primitives: a sphere needs at least 3 slices and 2 stacks");
+	return MakeCounts(
+		(slices + 1ull) * (stacks + 1ull),
+		6ull * slices * (stacks - 1ull));
+}
+
+void GenerateSphere(
+	float radius,
+	unsigned slices,
+	unsigned stacks,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex)
+{
+	SphereCounts(slices, stacks);
+
+	// theta around y (u), phi from the north pole (v)
+	std::vector<float> st, ct, sp, cp;
+	SinCosTable(slices, 2 * fPI, true, st, ct);
+	SinCosTable(stacks, fPI, false, sp, cp);
+
+	Vertex* v = vertices;
+	for (unsigned i = 0; i <= stacks; i++)
+	{
+		for (unsigned j = 0; j <= slices; j++, v++)
+		{
+			v->Normal = vec3f(sp[i] * st[j], cp[i], sp[i] * ct[j]);
+			v->Pos = v->Normal * radius;
+			v->Tangent = vec3f(ct[j], 0, -st[j]);
+			v->Binormal = vec3f(cp[i] * st[j], -sp[i], cp[i] * ct[j]);
+			v->TexCoord = vec2f((float)j / slices, (float)i / stacks);
+		}
+	}
+
+	// The first and last stacks have one vertex position at the pole:
+	// skip the triangle of each cell that would be degenerate there
+	const unsigned stride = slices + 1;
+	for (unsigned i = 0; i < stacks; i++)
+	{
+		for (unsigned j = 0; j < slices; j++)
+		{
+			const unsigned a = base_vertex + i * stride + j, b = a + stride;
+			if (i != 0)
+			{
+				*indices++ = a; *indices++ = b; *indices++ = a + 1;
+			}
+			if (i != stacks - 1)
+			{
+				*indices++ = a + 1; *indices++ = b; *indices++ = b + 1;
+			}
+		}
+	}
+}
+
+PrimitiveCounts CylinderCounts(unsigned slices, unsigned stacks)
+{
+	Require(slices >= 3 && stacks >= 1, "Primitives: a cylinder needs at least 3 slices and 1 stack");
+	return MakeCounts(
+		(slices + 1ull) * (stacks + 1ull) + 2ull * (slices + 1ull),
+		6ull * slices * stacks + 6ull * slices);
+}
+
+void GenerateCylinder(
+	float radius,
+	float height,
+	unsigned slices,
+	unsigned stacks,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex)
+{
+	CylinderCounts(slices, stacks);
+
+	std::vector<float> st, ct;
+	SinCosTable(slices, 2 * fPI, true, st, ct);
+
+	// Side, from the top down
+	Vertex* v = vertices;
+	for (unsigned i = 0; i <= stacks; i++)
+	{
+		const float y = height * (0.5f - (float)i / stacks);
+		for (unsigned j = 0; j <= slices; j++, v++)
+		{
+			v->Normal = vec3f(st[j], 0, ct[j]);
+			v->Pos = vec3f(radius * st[j], y, radius * ct[j]);
+			v->Tangent = vec3f(ct[j], 0, -st[j]);
+			v->Binormal = vec3f(0, -1, 0);
+			v->TexCoord = vec2f((float)j / slices, (float)i / stacks);
+		}
+	}
+	indices = EmitPatch(indices, base_vertex, stacks, slices);
+
+	// Caps: a center vertex and a rim, mapped to the unit square from above
+	for (int cap = 0; cap < 2; cap++)
+	{
+		const float sign = cap == 0 ? 1.0f : -1.0f;
+		const unsigned center = base_vertex + (unsigned)(v - vertices);
+
+		for (unsigned j = 0; j <= slices; j++, v++)
+		{
+			// Vertex 0 is the center, 1..slices the rim
+			const float s = j == 0 ? 0.0f : st[j - 1], c = j == 0 ? 0.0f : ct[j - 1];
+			v->Normal = vec3f(0, sign, 0);
+			v->Pos = vec3f(radius * s, 0.5f * sign * height, radius * c);
+			v->Tangent = vec3f(1, 0, 0);
+			v->Binormal = vec3f(0, 0, sign);
+			v->TexCoord = vec2f(0.5f + 0.5f * s, 0.5f + 0.5f * sign * c);
+		}
+
+		for (unsigned j = 0; j < slices; j++)
+		{
+			const unsigned r0 = center + 1 + j, r1 = center + 1 + (j + 1) % slices;
+			*indices++ = center;
+			*indices++ = cap == 0 ? r0 : r1;
+			*indices++ = cap == 0 ? r1 : r0;
+		}
+	}
+}
+
+PrimitiveCounts TorusCounts(unsigned segments, unsigned sides)
+{
+	Require(segments >= 3 && sides >= 3, "Primitives: a torus needs at least 3 segments and 3 sides");
+	return MakeCounts(
+		(segments + 1ull) * (sides + 1ull),
+		6ull * segments * sides);
+}
+
+void GenerateTorus(
+	float major_radius,
+	float minor_radius,
+	unsigned segments,
+	unsigned sides,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex)
+{
+	TorusCounts(segments, sides);
+
+	// theta around y (u), phi around the tube (v), starting at the
+	// outer equator and turning downwards
+	std::vector<float> st, ct, sp, cp;
+	SinCosTable(segments, 2 * fPI, true, st, ct);
+	SinCosTable(sides, 2 * fPI, true, sp, cp);
+
+	Vertex* v = vertices;
+	for (unsigned i = 0; i <= sides; i++)
+	{
+		for (unsigned j = 0; j <= segments; j++, v++)
+		{
+			v->Normal = vec3f(cp[i] * st[j], -sp[i], cp[i] * ct[j]);
+			v->Pos = vec3f(major_radius * st[j], 0, major_radius * ct[j]) + v->Normal * minor_radius;
+			v->Tangent = vec3f(ct[j], 0, -st[j]);
+			v->Binormal = vec3f(-sp[i] * st[j], -cp[i], -sp[i] * ct[j]);
+			v->TexCoord = vec2f((float)j / segments, (float)i / sides);
+		}
+	}
+	EmitPatch(indices, base_vertex, sides, segments);
+}
+
+PrimitiveCounts GridCounts(unsigned nx, unsigned nz)
+{
+	Require(nx >= 1 && nz >= 1, "Primitives: a grid needs at least 1x1 cells");
+	return MakeCounts(
+		(nx + 1ull) * (nz + 1ull),
+		6ull * nx * nz);
+}
+
+void GenerateGrid(
+	float width,
+	float depth,
+	unsigned nx,
+	unsigned nz,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex)
+{
+	GridCounts(nx, nz);
+
+	Vertex* v = vertices;
+	for (unsigned i = 0; i <= nz; i++)
+	{
+		const float tz = (float)i / nz;
+		for (unsigned j = 0; j <= nx; j++, v++)
+		{
+			const float tx = (float)j / nx;
+			v->Pos = vec3f(width * (tx - 0.5f), 0, depth * (tz - 0.5f));
+			v->Normal = vec3f(0, 1, 0);
+			v->Tangent = vec3f(1, 0, 0);
+			v->Binormal = vec3f(0, 0, 1);
+			v->TexCoord = vec2f(tx, tz);
+		}
+	}
+	EmitPatch(indices, base_vertex, nz, nx);
+}
+
+PrimitiveCounts CubeCounts(unsigned n)
+{
+	Require(n >= 1, "Primitives: a cube needs at least 1x1 cells per face");
+	return MakeCounts(
+		6ull * (n + 1ull) * (n + 1ull),
+		36ull * n * n);
+}
+
+void GenerateCube(
+	float size,
+	unsigned n,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex)
+{
+	CubeCounts(n);
+
+	// Normal, Tangent (u) and Binormal (v) of each face
+	static const vec3f faces[6][3] =
+	{
+		{ {  0,  0,  1 }, {  1, 0,  0 }, { 0, -1,  0 } },
+		{ {  0,  0, -1 }, { -1, 0,  0 }, { 0, -1,  0 } },
+		{ {  1,  0,  0 }, {  0, 0, -1 }, { 0, -1,  0 } },
+		{ { -1,  0,  0 }, {  0, 0,  1 }, { 0, -1,  0 } },
+		{ {  0,  1,  0 }, {  1, 0,  0 }, { 0,  0,  1 } },
+		{ {  0, -1,  0 }, {  1, 0,  0 }, { 0,  0, -1 } },
+	};
+
+	Vertex* v = vertices;
+	for (int f = 0; f < 6; f++)
+	{
+		const vec3f& N = faces[f][0];
+		const vec3f& U = faces[f][1];
+		const vec3f& V = faces[f][2];
+		const unsigned first = base_vertex + (unsigned)(v - vertices);
+
+		for (unsigned i = 0; i <= n; i++)
+		{
+			const float tv = (float)i / n;
+			for (unsigned j = 0; j <= n; j++, v++)
+			{
+				const float tu = (float)j / n;
+				v->Pos = (N * 0.5f + U * (tu - 0.5f) + V * (tv - 0.5f)) * size;
+				v->Normal = N;
+				v->Tangent = U;
+				v->Binormal = V;
+				v->TexCoord = vec2f(tu, tv);
+			}
+		}
+		indices = EmitPatch(indices, first, n, n);
+	}
+}
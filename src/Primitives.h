@@ -0,0 +1,91 @@
+//
+//  Primitives.h
+//
+//	Procedural primitive meshes: sphere, cylinder, torus, grid and cube
+//
+
+#pragma once
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include "Vertex.h"
+
+//
+// Number of vertices and indices a primitive writes, for preallocation
+//
+struct PrimitiveCounts
+{
+	unsigned vertices = 0;
+	unsigned indices = 0;
+};
+
+//
+// Each generator writes exactly the counts returned by its *Counts function
+// into caller-provided arrays, as an indexed triangle list. Indices are
+// offset by base_vertex, so several primitives can share one vertex array.
+//
+// Primitives are centered at the origin with y up. Triangles are
+// counter-clockwise around the outward normal. Tangent and Binormal point
+// along increasing TexCoord u and v, with v increasing downwards.
+//
+// Too low tessellation throws std::runtime_error.
+//
+
+// UV sphere: slices around y (>= 3), stacks from pole to pole (>= 2)
+PrimitiveCounts SphereCounts(unsigned slices, unsigned stacks);
+
+void GenerateSphere(
+	float radius,
+	unsigned slices,
+	unsigned stacks,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex = 0);
+
+// Capped cylinder along y: slices around y (>= 3), stacks along the side (>= 1)
+PrimitiveCounts CylinderCounts(unsigned slices, unsigned stacks);
+
+void GenerateCylinder(
+	float radius,
+	float height,
+	unsigned slices,
+	unsigned stacks,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex = 0);
+
+// Torus in the xz-plane: segments around y (>= 3), sides around the tube (>= 3)
+PrimitiveCounts TorusCounts(unsigned segments, unsigned sides);
+
+void GenerateTorus(
+	float major_radius,
+	float minor_radius,
+	unsigned segments,
+	unsigned sides,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex = 0);
+
+// Grid in the xz-plane facing +y: nx by nz cells (>= 1)
+PrimitiveCounts GridCounts(unsigned nx, unsigned nz);
+
+void GenerateGrid(
+	float width,
+	float depth,
+	unsigned nx,
+	unsigned nz,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex = 0);
+
+// Cube with n by n cells per face (>= 1), each face textured [0,1]^2
+PrimitiveCounts CubeCounts(unsigned n);
+
+void GenerateCube(
+	float size,
+	unsigned n,
+	Vertex* vertices,
+	unsigned* indices,
+	unsigned base_vertex = 0);
+
+#endif
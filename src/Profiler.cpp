@@ -0,0 +1,330 @@
+//
+//  Profiler.cpp
+//
+//	CPU zone profiler with rolling statistics and Chrome trace export
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "Profiler.h"
+
+// Ids of profilers, so that a thread's cached ring is never used with
+// another profiler at the same address
+static std::atomic<unsigned> next_profiler_id(1);
+
+// The ring of the current thread in the profiler it last recorded to
+static thread_local unsigned cached_profiler = 0;
+static thread_local ProfileEventRing* cached_ring = nullptr;
+static thread_local unsigned cached_thread_index = 0;
+
+// Open ProfileZones of the current thread
+static thread_local unsigned zone_depth = 0;
+
+bool ProfileEventRing::Push(const ProfileEvent& event)
+{
+	const unsigned t = tail.load(std::memory_order_relaxed);
+	if (t - head.load(std::memory_order_acquire) >= Capacity)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	events[t & (Capacity - 1)] = event;
+	tail.store(t + 1, std::memory_order_release);
+	return true;
+}
+
+bool ProfileEventRing::Pop(ProfileEvent& event)
+{
+	const unsigned h = head.load(std::memory_order_relaxed);
+	if (h == tail.load(std::memory_order_acquire))
+		return false;
+
+	event = events[h & (Capacity - 1)];
+	head.store(h + 1, std::memory_order_release);
+	return true;
+}
+
+Profiler::Profiler() :
+	id(next_profiler_id.fetch_add(1, std::memory_order_relaxed)),
+	start(std::chrono::steady_clock::now())
+{
+	trace.reserve(TraceFrames);
+}
+
+Profiler::~Profiler()
+{
+	for (ThreadRing* ring : rings)
+		delete ring;
+}
+
+Profiler& Profiler::Instance()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+unsigned long long Profiler::Now() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+ProfileEventRing& Profiler::GetThreadRing(unsigned& thread_index)
+{
+	if (cached_profiler != id)
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+
+		const std::thread::id thread = std::this_thread::get_id();
+		ThreadRing* found = nullptr;
+		for (ThreadRing* ring : rings)
+			if (ring->thread == thread)
+				found = ring;
+
+		if (!found)
+		{
+			found = new ThreadRing;
+			found->thread = thread;
+			found->index = (unsigned)rings.size();
+			rings.push_back(found);
+		}
+
+		cached_profiler = id;
+		cached_ring = &found->ring;
+		cached_thread_index = found->index;
+	}
+
+	thread_index = cached_thread_index;
+	return *cached_ring;
+}
+
+void Profiler::Record(const char* name, unsigned long long begin, unsigned long long end, unsigned depth)
+{
+	ProfileEvent event;
+	ProfileEventRing& ring = GetThreadRing(event.thread);
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	event.depth = depth;
+	ring.Push(event);
+}
+
+void Profiler::RecordGpu(const char* name, unsigned long long begin, unsigned long long end)
+{
+	unsigned thread_index;
+	ProfileEventRing& ring = GetThreadRing(thread_index);
+
+	ProfileEvent event;
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	event.thread = GpuThread;
+	ring.Push(event);
+}
+
+Profiler::Zone& Profiler::GetZone(const char* name)
+{
+	auto cached = zone_index_by_pointer.find(name);
+	if (cached != zone_index_by_pointer.end())
+		return zones[cached->second];
+
+	// Equal names at different addresses, e.g. in different files, are one zone
+	auto found = zone_index.find(name);
+	unsigned index;
+	if (found != zone_index.end())
+		index = found->second;
+	else
+	{
+		index = (unsigned)zones.size();
+		zones.push_back(Zone());
+		zones.back().name = name;
+		zones.back().history.reserve(WindowFrames);
+		zone_index[name] = index;
+	}
+	zone_index_by_pointer[name] = index;
+	return zones[index];
+}
+
+void Profiler::EndFrame()
+{
+	// Reuse the storage of the oldest frame once the trace is full, so a
+	// frame does not allocate in steady state
+	if (trace.size() < TraceFrames)
+		trace.emplace_back();
+	std::vector<ProfileEvent>& events = trace[trace_next];
+	trace_next = (trace_next + 1) % TraceFrames;
+	events.clear();
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		ProfileEvent event;
+		for (ThreadRing* ring : rings)
+			while (ring->ring.Pop(event))
+				events.push_back(event);
+	}
+
+	for (const ProfileEvent& event : events)
+	{
+		Zone& zone = GetZone(event.name);
+		zone.frame_time += event.end > event.begin ? event.end - event.begin : 0;
+		zone.ran = true;
+	}
+
+	for (Zone& zone : zones)
+	{
+		if (!zone.ran)
+			continue;
+
+		const float ms = (float)(zone.frame_time * 1e-6);
+		if (zone.history.size() < WindowFrames)
+			zone.history.push_back(ms);
+		else
+			zone.history[zone.next] = ms;
+		zone.next = (zone.next + 1) % WindowFrames;
+
+		zone.frame_time = 0;
+		zone.ran = false;
+	}
+
+	nbr_frames++;
+}
+
+void Profiler::ResetStats()
+{
+	for (Zone& zone : zones)
+	{
+		zone.history.clear();
+		zone.next = 0;
+	}
+}
+
+bool Profiler::GetZoneStats(const std::string& name, ZoneStats& stats) const
+{
+	auto found = zone_index.find(name);
+	if (found == zone_index.end() || zones[found->second].history.empty())
+		return false;
+
+	std::vector<float> times = zones[found->second].history;
+	std::sort(times.begin(), times.end());
+
+	double sum = 0;
+	for (float t : times)
+		sum += t;
+
+	// Nearest-rank percentile
+	const size_t rank = (size_t)std::ceil(0.99 * times.size());
+
+	stats.frames = (unsigned)times.size();
+	stats.min = times.front();
+	stats.avg = sum / times.size();
+	stats.p99 = times[std::max<size_t>(rank, 1) - 1];
+	return true;
+}
+
+unsigned long long Profiler::GetDroppedCount() const
+{
+	std::lock_guard<std::mutex> lock(rings_mutex);
+	unsigned long long dropped = 0;
+	for (const ThreadRing* ring : rings)
+		dropped += ring->ring.GetDroppedCount();
+	return dropped;
+}
+
+void Profiler::Report(std::ostream& out) const
+{
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	ZoneStats stats;
+	for (const Zone& zone : zones)
+	{
+		if (!GetZoneStats(zone.name, stats))
+			continue;
+		out << zone.name
+			<< ": avg " << stats.avg
+			<< " ms, min " << stats.min
+			<< " ms, p99 " << stats.p99
+			<< " ms (" << stats.frames << " frames)" << std::endl;
+	}
+
+	const unsigned long long dropped = GetDroppedCount();
+	if (dropped)
+		out << "profiler: " << dropped << " events dropped" << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+static void WriteJsonString(std::ostream& out, const char* s)
+{
+	out << '"';
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			out << '\\' << *s;
+		else if ((unsigned char)*s < 0x20)
+			out << ' ';
+		else
+			out << *s;
+	}
+	out << '"';
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out) const
+{
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	// CPU threads are process 0, the GPU is process 1
+	out << "{\"traceEvents\":[" << std::endl;
+	out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+	out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		for (const ThreadRing* ring : rings)
+			out << "," << std::endl << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << ring->index
+				<< ",\"args\":{\"name\":\"Thread " << ring->index << "\"}}";
+	}
+
+	// Timestamps and durations in microseconds
+	for (size_t i = 0; i < trace.size(); i++)
+	{
+		for (const ProfileEvent& event : trace[(trace_next + i) % trace.size()])
+		{
+			const bool gpu = event.thread == GpuThread;
+			out << "," << std::endl << "{\"ph\":\"X\",\"name\":";
+			WriteJsonString(out, event.name);
+			out << ",\"pid\":" << (gpu ? 1 : 0)
+				<< ",\"tid\":" << (gpu ? 0 : event.thread)
+				<< ",\"ts\":" << event.begin * 1e-3
+				<< ",\"dur\":" << (event.end > event.begin ? event.end - event.begin : 0) * 1e-3 << "}";
+		}
+	}
+	out << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+ProfileZone::ProfileZone(const char* name) :
+	name(name),
+	begin(Profiler::Instance().Now()),
+	depth(zone_depth++)
+{ }
+
+ProfileZone::~ProfileZone()
+{
+	End();
+}
+
+void ProfileZone::End()
+{
+	if (ended)
+		return;
+	ended = true;
+	zone_depth--;
+	Profiler& profiler = Profiler::Instance();
+	profiler.Record(name, begin, profiler.Now(), depth);
+}
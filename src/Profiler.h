@@ -0,0 +1,189 @@
+//
+//  Profiler.h
+//
+//	CPU zone profiler with rolling statistics and Chrome trace export
+//
+
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//
+// A timed zone, in nanoseconds since the profiler was created
+//
+struct ProfileEvent
+{
+	const char* name = nullptr;		// Must outlive the profiler, e.g. a string literal
+	unsigned long long begin = 0;
+	unsigned long long end = 0;
+	unsigned thread = 0;			// Profiler thread index, or Profiler::GpuThread
+	unsigned depth = 0;				// Number of enclosing zones on the thread
+};
+
+//
+// Single-producer, single-consumer ring of events: the owning thread
+// pushes, the profiler pops. Events pushed to a full ring are dropped.
+//
+class ProfileEventRing
+{
+public:
+	static const unsigned Capacity = 4096;
+
+	ProfileEventRing() : head(0), tail(0), dropped(0) { }
+
+	// Owner only
+	bool Push(const ProfileEvent& event);
+
+	// Consumer only
+	bool Pop(ProfileEvent& event);
+
+	unsigned long long GetDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	// Kept on separate cache lines: the consumer writes head, the owner tail
+	std::atomic<unsigned> head;
+	char pad0[64];
+	std::atomic<unsigned> tail;
+	char pad1[64];
+	std::atomic<unsigned long long> dropped;
+	ProfileEvent events[Capacity];
+};
+
+//
+// Collects the zones of all threads into frames. Zones are recorded
+// lock-free into a ring per thread; EndFrame() drains the rings and keeps
+// per-zone statistics over the last WindowFrames frames, and the events of
+// the last TraceFrames frames for export.
+//
+// EndFrame() and the queries must be called from one thread at a time.
+//
+class Profiler
+{
+public:
+	// Thread index of zones timed on the GPU
+	static const unsigned GpuThread = ~0u;
+
+	static const unsigned WindowFrames = 256;
+	static const unsigned TraceFrames = 120;
+
+	//
+	// Statistics of the time per frame spent in a zone, in milliseconds,
+	// over the frames of the window in which the zone ran
+	//
+	struct ZoneStats
+	{
+		unsigned frames = 0;
+		double min = 0;
+		double avg = 0;
+		double p99 = 0;
+	};
+
+	Profiler();
+
+	~Profiler();
+
+	// The profiler used by ProfileZone
+	static Profiler& Instance();
+
+	// Nanoseconds since the profiler was created
+	unsigned long long Now() const;
+
+	// Record a zone of the calling thread that ran from begin to end
+	void Record(const char* name, unsigned long long begin, unsigned long long end, unsigned depth);
+
+	// Record a zone timed on the GPU, converted to this profiler's clock
+	void RecordGpu(const char* name, unsigned long long begin, unsigned long long end);
+
+	// Close the frame: collect the zones recorded since the previous call
+	void EndFrame();
+
+	unsigned GetFrameCount() const { return nbr_frames; }
+
+	// False if the zone has not run in the window
+	bool GetZoneStats(const std::string& name, ZoneStats& stats) const;
+
+	// Events dropped because a ring was full
+	unsigned long long GetDroppedCount() const;
+
+	// Forget the statistics of all zones, e.g. between benchmark runs
+	void ResetStats();
+
+	// One line of statistics per zone, in order of first appearance
+	void Report(std::ostream& out) const;
+
+	// The retained frames in Chrome's trace event format (chrome://tracing)
+	void WriteChromeTrace(std::ostream& out) const;
+
+private:
+	struct ThreadRing
+	{
+		std::thread::id thread;
+		unsigned index;
+		ProfileEventRing ring;
+	};
+
+	struct Zone
+	{
+		std::string name;
+		unsigned long long frame_time = 0;	// Time in the zone this frame
+		bool ran = false;					// Ran this frame
+		std::vector<float> history;			// ms per frame, a ring of up to WindowFrames
+		unsigned next = 0;
+	};
+
+	const unsigned id;		// Tells apart the profilers cached by threads
+	const std::chrono::steady_clock::time_point start;
+
+	mutable std::mutex rings_mutex;
+	std::vector<ThreadRing*> rings;
+
+	std::vector<Zone> zones;
+	std::unordered_map<std::string, unsigned> zone_index;
+	std::unordered_map<const char*, unsigned> zone_index_by_pointer;	// Cache of zone_index
+	std::vector<std::vector<ProfileEvent>> trace;	// A ring of up to TraceFrames frames
+	unsigned trace_next = 0;
+	unsigned nbr_frames = 0;
+
+	ProfileEventRing& GetThreadRing(unsigned& thread_index);
+
+	Zone& GetZone(const char* name);
+};
+
+//
+// Times the enclosing scope as a zone of Profiler::Instance()
+//
+class ProfileZone
+{
+	const char* name;
+	unsigned long long begin;
+	unsigned depth;
+	bool ended = false;
+
+public:
+	explicit ProfileZone(const char* name);
+
+	~ProfileZone();
+
+	// End the zone before the scope does. Zones still end innermost first.
+	void End();
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Time the rest of the scope as the zone name, a string literal
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+#endif
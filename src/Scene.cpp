@@ -1,9 +1,93 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <random>
 #include "Scene.h"
+#include "MemoryTracker.h"
+#include "Primitives.h"
+#include "Profiler.h"
 
 //#define Trojan
 //#define Cubes
 //#define Sponza
 //#define Sphere;
+//#define Primitives
+
+// Cull drawcalls with a scene-wide BVH instead of per model
+#define BVH_CULLING
+
+// Cull drawcalls hidden behind large occluders, using a CPU depth buffer
+#define OCCLUSION_CULLING
+
+// Record drawcalls on worker threads into D3D11 deferred contexts
+#define DEFERRED_CONTEXTS
+
+// Update the next frame on a job thread while the current one is rendered
+#define PIPELINED_UPDATE
+
+// Record the camera to CameraPathFile, or replay it with a fixed timestep
+// and report the frame times (one or none of these)
+//#define RECORD_CAMERA_PATH
+//#define REPLAY_CAMERA_PATH
+
+// Colored point and spot lights circling around the scene, besides the
+// main light, binned into clusters for the pixel shader
+#define MANY_LIGHTS
+
+// Throw once a frame allocates from the heap after the first
+// HeapCheckWarmupFrames frames, to check that the frame loop does not allocate.
+// Counts operator new through HeapCounting.cpp, which eduRend.vcxproj compiles.
+//#define ASSERT_NO_HEAP_ALLOCATIONS
+
+static const char* CameraPathFile = "camera_path.bin";
+static const float ReplayTimestep = 1.0f / 60;
+
+// Frames that may allocate while caches and pools warm up
+static const unsigned HeapCheckWarmupFrames = 300;
+
+// At most one context per job thread, up to this many
+static const unsigned MaxDeferredContexts = 8;
+
+// Draw lists with fewer drawcalls per context are not split further
+static const unsigned MinDrawcallsPerContext = 64;
+
+// Width of the occlusion depth buffer; its height follows the window's aspect
+static const int OcclusionWidth = 320;
+
+// The main light reaches the whole scene; the others are small and many
+static const float MainLightRange = 1000.0f;
+static const unsigned NbrExtraLights = 1024;
+
+// Fixed colors of the Trojan and Sphere models, instead of their materials
+static const PhongParams TrojanPhong = { vec4f(0.0f, 0.0f, 0.3f, 1), vec4f(0.8f, 0.0f, 0.8f, 1), vec4f(1.0f, 0.5f, 1.0f, 1.0f), 0.5f };
+static const PhongParams SpherePhong = { vec4f(0.0f, 0.0f, 0.3f, 1), vec4f(0.8f, 0.0f, 0.8f, 1), vec4f(1.0f, 0.5f, 1.0f, 1.0f), 200 };
+
+//
+// Records ranges of the scene's draw list, one deferred context per range
+//
+class OurTestScene::DeferredRecorder : public CommandRecorder
+{
+	const OurTestScene& scene;
+
+public:
+	DeferredRecorder(const OurTestScene& scene) : scene(scene) { }
+
+	unsigned GetContextCount() const override { return scene.deferred_contexts->Size(); }
+
+	void Record(unsigned context, const DrawRange& range) override
+	{
+		PROFILE_ZONE("Record");
+		ID3D11DeviceContext* deferred_context = scene.deferred_contexts->Begin(context);
+		scene.RenderDraws(deferred_context, scene.deferred_contexts->GetMaterialBinder(context), range);
+		scene.deferred_contexts->Finish(context);
+	}
+
+	void Submit(unsigned context) override
+	{
+		scene.deferred_contexts->Execute(context);
+	}
+};
 
 Scene::Scene(
 	ID3D11Device* dxdevice,
@@ -33,7 +117,18 @@ OurTestScene::OurTestScene(
 { 
 	InitTransformationBuffer();
 	InitLightBuffer();
-	InitPhongBuffer();
+	material_binder = new D3D11MaterialBinder(dxdevice, dxdevice_context);
+	pixel_shaders = new PixelShaderPermutations(dxdevice, "shaders/pixel_shader.hlsl", "PS_main");
+	material_binder->SetPixelShaders(pixel_shaders);
+
+	// One job thread per hardware thread, this one included
+	jobs = new JobSystem();
+
+	deferred_contexts = new DeferredContexts(
+		dxdevice,
+		dxdevice_context,
+		std::min<unsigned>(MaxDeferredContexts, jobs->GetThreadCount()));
+	deferred_contexts->SetPixelShaders(pixel_shaders);
 	// + init other CBuffers
 
 	HRESULT hr;
@@ -68,6 +163,34 @@ void OurTestScene::Init()
 	// Move camera to (0,0,5)
 	camera->moveTo({ 0, 0, 5 });
 
+	lightPosition = vec4f(0, 100, 0, 1);
+	lights.push_back(Light::Point(lightPosition.xyz(), MainLightRange, vec3f(1, 1, 1)));
+
+#ifdef MANY_LIGHTS
+	// Spread over the floor of the scene, every fourth a spot light pointing down
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> x(-30, 30), y(-5, 15), z(-20, 10), hue(0, 1);
+	for (unsigned i = 0; i < NbrExtraLights; i++)
+	{
+		const vec3f origin(x(rng), y(rng), z(rng));
+		const vec3f color(hue(rng), hue(rng), hue(rng));
+		light_origins.push_back(origin);
+		if (i % 4)
+			lights.push_back(Light::Point(origin, 3.0f, color));
+		else
+			lights.push_back(Light::Spot(origin, vec3f(0, -1, 0), 8.0f, 0.3f, 0.5f, color * 2));
+	}
+#endif // MANY_LIGHTS
+
+#ifdef REPLAY_CAMERA_PATH
+	camera_path.Load(CameraPathFile);
+	camera_replay = new CameraReplay(camera_path, ReplayTimestep);
+	std::cout << "replaying " << CameraPathFile << ", " << camera_replay->GetFrameCount() << " frames" << std::endl;
+#endif
+
+	// Occlusion depth buffer with the aspect ratio of the window
+	occlusion_culler.SetResolution(OcclusionWidth, OcclusionWidth * window_height / window_width);
+
 	// Create objects
 	Material mat;
 	mat.Ka = vec3f(0.1f, 0.1f, 0.1f);
@@ -76,11 +199,62 @@ void OurTestScene::Init()
 	mat.Kd_texture_filename = "textures/yroadcrossing.png";
 	LoadTextureFromFile(dxdevice, mat.Kd_texture_filename.c_str(), &mat.diffuse_texture);
 
+	// Set object transformations, relative to the parent entity if any.
+	// The transformation is composed in the T*R*S order; i.e. scale,
+	// then rotate, and then translate.
+
+	// Load the OBJ models in parallel; each also decodes its textures in parallel
+	struct OBJFile
+	{
+		const char* filename;
+		OBJModel** model;
+	};
+	std::vector<OBJFile> obj_files;
+#ifdef Trojan
+	obj_files.push_back({ "Trojan/Trojan.obj", &trojan });
+#endif // Trojan
+#ifdef Sponza
+	obj_files.push_back({ "crytek-sponza/sponza.obj", &sponza });
+#endif // Sponza
+#ifdef Sphere
+	obj_files.push_back({ "sphere/sphere.obj", &sphere });
+#endif // Sphere
+
+	std::vector<std::exception_ptr> load_errors(obj_files.size());
+	jobs->ParallelFor(0, (unsigned)obj_files.size(), 1, [&](unsigned begin, unsigned end)
+	{
+		for (unsigned i = begin; i < end; i++)
+		{
+			// Jobs must not throw: pass load errors on to this thread
+			try
+			{
+				*obj_files[i].model = new OBJModel(obj_files[i].filename, dxdevice, dxdevice_context, jobs);
+			}
+			catch (...)
+			{
+				load_errors[i] = std::current_exception();
+			}
+		}
+	});
+	for (const std::exception_ptr& error : load_errors)
+		if (error)
+			std::rethrow_exception(error);
+
+	// What the loaders peaked at, and what stays resident
+	std::cout << "memory after loading:" << std::endl;
+	MemoryTracker::Instance().Report(std::cout);
+
 	quad = new QuadModel(dxdevice, dxdevice_context);
 	quad->SetMaterial(mat);
+	quad_entity = AddEntity(quad);
+	entities.SetLocal(quad_entity,
+		vec3f(0, -6, -5),
+		quatf::rotation(-fPI / 2, 1.0f, 0.0f, 0.0f),	// Lay it down in the xz-plane
+		vec3f(100, 100, 100));
 
 #ifdef Trojan
-	trojan = new OBJModel("Trojan/Trojan.obj", dxdevice, dxdevice_context);
+	trojan_entity = AddEntity(trojan);
+	entities.SetLocal(trojan_entity, vec3f(0, -1, -15), quatf_identity, vec3f(0.5f, 0.5f, 0.5f));
 #endif // Trojan
 
 #ifdef Cubes
@@ -90,229 +264,589 @@ void OurTestScene::Init()
 	mat.Kd_texture_filename = "textures/crate.png";
 	LoadTextureFromFile(dxdevice, mat.Kd_texture_filename.c_str(), &mat.diffuse_texture);
 
-	AddModel(new CubeModel(dxdevice, dxdevice_context));
-	((CubeModel*)h_models[0])->SetMaterial(mat);
-	AddModel(new CubeModel(dxdevice, dxdevice_context));
-	((CubeModel*)h_models[1])->SetMaterial(mat);
-	AddModel(new CubeModel(dxdevice, dxdevice_context));
-	((CubeModel*)h_models[2])->SetMaterial(mat);
+	// Each cube is a child of the previous one
+	for (int i = 0; i < 3; ++i)
+	{
+		cubes.push_back(new CubeModel(dxdevice, dxdevice_context));
+		cubes.back()->SetMaterial(mat);
+		cube_entities.push_back(AddEntity(cubes.back(), i > 0 ? cube_entities.back() : EntityHandle()));
+	}
 #endif // !Trojan
 
 #ifdef Sponza
-	sponza = new OBJModel("crytek-sponza/sponza.obj", dxdevice, dxdevice_context);
+	sponza_entity = AddEntity(sponza);
+	entities.SetLocal(sponza_entity,
+		vec3f(0, -2, 0),								// Move down 2 units
+		quatf::rotation(fPI / 2, 0.0f, 1.0f, 0.0f),	// Rotate pi/2 radians (90 degrees) around y
+		vec3f(0.05f, 0.05f, 0.05f));					// The scene is quite large so scale it down to 5%
 #endif // Sponza
 
 #ifdef Sphere
-	AddModel(new OBJModel("sphere/sphere.obj", dxdevice, dxdevice_context));
+	sphere_entity = AddEntity(sphere);
+	entities.SetPosition(sphere_entity, vec3f(0, 0, -10));
 #endif // Sphere
+
+#ifdef Primitives
+	// Generated sphere, cylinder and torus in a row
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned> indices;
+		auto add_primitive = [&](PrimitiveCounts counts, const vec3f& position)
+		{
+			primitives.push_back(new PrimitiveModel(vertices.data(), counts.vertices, indices.data(), counts.indices, dxdevice, dxdevice_context));
+			primitives.back()->SetMaterial(mat);
+			primitive_entities.push_back(AddEntity(primitives.back()));
+			entities.SetPosition(primitive_entities.back(), position);
+		};
+		PrimitiveCounts counts;
+
+		counts = SphereCounts(32, 16);
+		vertices.resize(counts.vertices);
+		indices.resize(counts.indices);
+		GenerateSphere(1.0f, 32, 16, vertices.data(), indices.data());
+		add_primitive(counts, vec3f(-3, 0, -10));
+
+		counts = CylinderCounts(32, 1);
+		vertices.resize(counts.vertices);
+		indices.resize(counts.indices);
+		GenerateCylinder(1.0f, 2.0f, 32, 1, vertices.data(), indices.data());
+		add_primitive(counts, vec3f(0, 0, -10));
+
+		counts = TorusCounts(48, 16);
+		vertices.resize(counts.vertices);
+		indices.resize(counts.indices);
+		GenerateTorus(1.0f, 0.3f, 48, 16, vertices.data(), indices.data());
+		add_primitive(counts, vec3f(3, 0, -10));
+	}
+#endif // Primitives
+
+	// The initial state is rendered in the first frame
+	entities.Update(jobs);
+	WriteSnapshot(frames.GetRendered(), true);
+}
+
+EntityHandle OurTestScene::AddEntity(Model* model, EntityHandle parent)
+{
+	const EntityHandle entity = entities.Create(model, model->GetBounds(), parent);
+	AddToCulling(entity);
+	return entity;
 }
 
 //
-// Called every frame
+// Called every frame, before rendering the previous update
 // dt (seconds) is time elapsed since the previous frame
 //
-void OurTestScene::Update(
+void OurTestScene::BeginUpdate(
 	float dt,
 	InputHandler* input_handler)
 {
-	// Basic camera control
-	if (input_handler->IsKeyPressed(Keys::Up) || input_handler->IsKeyPressed(Keys::W))
-		camera->move({ 0.0f, 0.0f, -camera_vel * dt });
-	if (input_handler->IsKeyPressed(Keys::Down) || input_handler->IsKeyPressed(Keys::S))
-		camera->move({ 0.0f, 0.0f, camera_vel * dt });
-	if (input_handler->IsKeyPressed(Keys::Right) || input_handler->IsKeyPressed(Keys::D))
-		camera->move({ camera_vel * dt, 0.0f, 0.0f });
-	if (input_handler->IsKeyPressed(Keys::Left) || input_handler->IsKeyPressed(Keys::A))
-		camera->move({ -camera_vel * dt, 0.0f, 0.0f });
-	if (input_handler->IsKeyPressed(Keys::Space))
-		camera->move({ 0.0f, camera_vel * dt, 0.0f });
-	if (input_handler->IsKeyPressed(Keys::Ctrl))
-		camera->move({ 0.0f, -camera_vel * dt, 0.0f });
+	update_dt = dt;
+	update_input = input_handler;
+#ifdef PIPELINED_UPDATE
+	frames.BeginFrame(jobs, &UpdateJob, this);
+#else
+	frames.BeginFrame(nullptr, &UpdateJob, this);
+#endif
+}
+
+void OurTestScene::EndUpdate()
+{
+	frames.EndFrame();
+}
+
+void OurTestScene::UpdateJob(void* scene)
+{
+	OurTestScene& s = *(OurTestScene*)scene;
+	s.Update(s.update_dt, s.update_input, s.frames.GetUpdated());
+}
+
+//
+// Runs concurrently with Render(), so it must not use the device
+// context: all it passes on to rendering goes through snapshot
+//
+void OurTestScene::Update(
+	float dt,
+	InputHandler* input_handler,
+	FrameSnapshot& snapshot)
+{
+	PROFILE_ZONE("Update");
+	const float frame_time = dt;
 
 	if (input_handler->IsKeyPressed(Keys::One))
+		sampler_filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+	if (input_handler->IsKeyPressed(Keys::Two))
+		sampler_filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	if (input_handler->IsKeyPressed(Keys::Three))
+		sampler_filter = D3D11_FILTER_ANISOTROPIC;
+
+	if (camera_replay && !camera_replay->IsDone())
 	{
-		HRESULT hr;
-		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-		ASSERT(hr = dxdevice->CreateSamplerState(&samplerDesc, &samplerState));
-		dxdevice_context->PSSetSamplers(0, 1, &samplerState);
+		// Replayed frames advance the scene by a fixed timestep
+		camera_replay->AddFrameTime(dt);
+		camera_replay->NextFrame(camera->position, camera->rotation);
+		if (camera_replay->IsDone())
+			ReportReplay();
+		dt = camera_replay->GetTimestep();
 	}
-	if (input_handler->IsKeyPressed(Keys::Two))
+	else
 	{
-		HRESULT hr;
-		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-		ASSERT(hr = dxdevice->CreateSamplerState(&samplerDesc, &samplerState));
-		dxdevice_context->PSSetSamplers(0, 1, &samplerState);
+		// Basic camera control
+		if (input_handler->IsKeyPressed(Keys::Up) || input_handler->IsKeyPressed(Keys::W))
+			camera->move({ 0.0f, 0.0f, -camera_vel * dt });
+		if (input_handler->IsKeyPressed(Keys::Down) || input_handler->IsKeyPressed(Keys::S))
+			camera->move({ 0.0f, 0.0f, camera_vel * dt });
+		if (input_handler->IsKeyPressed(Keys::Right) || input_handler->IsKeyPressed(Keys::D))
+			camera->move({ camera_vel * dt, 0.0f, 0.0f });
+		if (input_handler->IsKeyPressed(Keys::Left) || input_handler->IsKeyPressed(Keys::A))
+			camera->move({ -camera_vel * dt, 0.0f, 0.0f });
+		if (input_handler->IsKeyPressed(Keys::Space))
+			camera->move({ 0.0f, camera_vel * dt, 0.0f });
+		if (input_handler->IsKeyPressed(Keys::Ctrl))
+			camera->move({ 0.0f, -camera_vel * dt, 0.0f });
+
+		float sensitivity = 0.1f;
+
+		long mouseX = input_handler->GetMouseDeltaX();
+		long mouseY = input_handler->GetMouseDeltaY();
+
+		camera->rotate(vec3f(-mouseY, -mouseX, 0) * sensitivity * dt);
 	}
-	if (input_handler->IsKeyPressed(Keys::Three))
+
+#ifdef RECORD_CAMERA_PATH
+	camera_path.Add(camera->position, camera->rotation, dt);
+#endif
+
+	lightPosition = vec4f(std::cos(time) * 10, 2, std::sin(time) * 10, 1);
+	lightPosition = vec4f(0, 100, 0, 1);
+	lights[0].position = lightPosition.xyz();
+	for (size_t i = 0; i < light_origins.size(); i++)
+	{
+		const float phase = time + i;
+		lights[i + 1].position = light_origins[i] + vec3f(std::cos(phase), 0, std::sin(phase)) * 2;
+	}
+
+#ifdef Cubes
+	// Cube transforms. Each cube orbits its parent with an offset in world
+	// axes and has its own world scale; only the rotations accumulate down
+	// the chain.
+	const quatf rotations[3] = {
+		quatf::rotation(-angle * 0.2f, 0, 0, 1),
+		quatf::rotation(-angle * 0.5f, 0, 0, 1),
+		quatf::rotation(angle * 0.8f, 0, 0, 1) };
+	float speed = -0.5f;
+	vec3f position1 = vec3f(std::cos(time * speed), std::sin(time * speed), 0) * 4;
+	vec3f scale1(0.7f, 0.7f, 0.7f);
+	TransformHierarchy::ToParentSpace(rotations[0], 1, position1, scale1);
+	speed = 2;
+	vec3f position2 = vec3f(std::cos(time * speed), std::sin(time * speed), 0) * 2;
+	vec3f scale2(0.3f, 0.3f, 0.3f);
+	TransformHierarchy::ToParentSpace(rotations[0] * rotations[1], 0.7f, position2, scale2);
+
+	entities.SetLocal(cube_entities[0], vec3f(0, 0, -10), rotations[0], vec3f(1, 1, 1));
+	entities.SetLocal(cube_entities[1], position1, rotations[1], scale1);
+	entities.SetLocal(cube_entities[2], position2, rotations[2], scale2);
+#endif // !Trojan
+
+	// Recompute the world matrices and bounds of the entities that moved
+	entities.Update(jobs);
+
+	// Increase the amount of time passed.
+	time += dt;
+	// Increment the rotation angle.
+	angle += angle_vel * dt;
+
+	// Transforms are final for this frame: pass them on to rendering
+	snapshot.dt = frame_time;
+	WriteSnapshot(snapshot, false);
+}
+
+void OurTestScene::ReportReplay() const
+{
+	const FrameStats::Summary summary = camera_replay->GetStats().GetSummary();
+	std::cout << "replay of " << summary.frames << " frames: ms avg " << summary.avg
+		<< ", p50 " << summary.p50
+		<< ", p95 " << summary.p95
+		<< ", p99 " << summary.p99
+		<< ", max " << summary.max
+		<< ", hitches " << summary.hitches << std::endl;
+
+	std::ofstream csv("replay_times.csv");
+	camera_replay->GetStats().WriteCSV(csv);
+}
+
+void OurTestScene::WriteSnapshot(FrameSnapshot& snapshot, bool all_entities) const
+{
+	snapshot.Mview = camera->get_WorldToViewMatrix();
+	snapshot.Mproj = camera->get_ProjectionMatrix();
+	snapshot.camera_position = camera->position.xyz1();
+	snapshot.lights = lights;
+	snapshot.sampler_filter = sampler_filter;
+
+	snapshot.moved.clear();
+	snapshot.world_matrices.clear();
+	snapshot.normal_matrices.clear();
+	snapshot.world_bounds.clear();
+	for (unsigned i = 0; i < entities.Size(); i++)
+	{
+		if (!entities.IsAlive(i) || !(all_entities || entities.WasUpdated(i)))
+			continue;
+		snapshot.moved.push_back(i);
+		snapshot.world_matrices.push_back(entities.GetWorldMatrix(i));
+		snapshot.normal_matrices.push_back(entities.GetNormalMatrix(i));
+		snapshot.world_bounds.push_back(entities.GetWorldBounds(i));
+	}
+}
+
+void OurTestScene::ApplySnapshot(const FrameSnapshot& snapshot)
+{
+	PROFILE_ZONE("Apply snapshot");
+
+	Mview = snapshot.Mview;
+	Mproj = snapshot.Mproj;
+
+	rendered_world_matrices.resize(entities.Size());
+	rendered_normal_matrices.resize(entities.Size());
+	rendered_world_bounds.resize(entities.Size());
+	for (size_t i = 0; i < snapshot.moved.size(); i++)
+	{
+		const unsigned entity = snapshot.moved[i];
+		rendered_world_matrices[entity] = snapshot.world_matrices[i];
+		rendered_normal_matrices[entity] = snapshot.normal_matrices[i];
+		rendered_world_bounds[entity] = snapshot.world_bounds[i];
+	}
+
+	if (snapshot.sampler_filter != samplerDesc.Filter)
 	{
 		HRESULT hr;
-		samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+		samplerDesc.Filter = snapshot.sampler_filter;
+		SAFE_RELEASE(samplerState);
 		ASSERT(hr = dxdevice->CreateSamplerState(&samplerDesc, &samplerState));
 		dxdevice_context->PSSetSamplers(0, 1, &samplerState);
 	}
 
-	float sensitivity = 0.1f;
-
-	long mouseX = input_handler->GetMouseDeltaX();
-	long mouseY = input_handler->GetMouseDeltaY();
+	// Transforms are final for this frame: update the culling BVH
+	UpdateCulling(snapshot.moved);
+}
 
-	camera->rotate(vec3f(-mouseY, -mouseX, 0) * sensitivity * dt);
+//
+// Called every frame, concurrently with the update of the next frame
+//
+void OurTestScene::Render()
+{
+	frame_allocator.BeginFrame();
 
-	lightPosition = vec4f(std::cos(time) * 10, 2, std::sin(time) * 10, 1);
-	lightPosition = vec4f(0, 100, 0, 1);
+	const FrameSnapshot& frame = frames.GetRendered();
+	ApplySnapshot(frame);
 
-	// Now set/update object transformations
-	// This can be done using any sequence of transformation matrices,
-	// but the T*R*S order is most common; i.e. scale, then rotate, and then translate.
-	// If no transformation is desired, an identity matrix can be obtained 
-	// via e.g. Mquad = linalg::mat4f_identity; 
+	// Bind transformation_buffer to slot b0 of the VS
+	dxdevice_context->VSSetConstantBuffers(0, 1, &transformation_buffer);
+	// Bind light_Buffer to slot b0 of the PS
+	dxdevice_context->PSSetConstantBuffers(0, 1, &light_Buffer);
+	// Bind the Phong CBuffer to slot b1 of the PS
+	material_binder->BeginFrame();
+	pixel_shaders->HotReload(dxdevice);
+
+	const mat4f Mviewproj = Mproj * Mview;
+
+	// Cull all drawcalls against the view frustum and the occluders
+	CullScene(Mviewproj);
+
+	UpdateLightClusters(frame.lights);
+	UpdateLightBuffer(frame.camera_position);
+
+	// Print frame time statistics
+	frame_stats.AddFrame(frame.dt);
+#ifdef ASSERT_NO_HEAP_ALLOCATIONS
+	if (frame_stats.GetFrameCount() == HeapCheckWarmupFrames)
+		MemoryTracker::Instance().SetAssertNoHeapAllocations(true);
+#endif
+	stats_cooldown -= frame.dt;
+	if (stats_cooldown < 0.0)
+	{
+		const FrameStats::Summary summary = frame_stats.GetSummary();
+		std::cout << "frame ms p50 " << summary.p50
+			<< ", p95 " << summary.p95
+			<< ", p99 " << summary.p99
+			<< ", max " << summary.max
+			<< ", hitches " << summary.hitches
+			<< ", drawcalls visible " << cull_stats.visible
+			<< ", culled " << cull_stats.Culled()
+			<< " (occluded " << cull_stats.occluded << ")"
+			<< ", lights binned " << light_clusters.GetBinnedLightCount()
+			<< " (indices " << light_clusters.GetLightIndexCount() << ")"
+			<< ", material uploads " << material_binder->GetUploadCount() + deferred_contexts->GetUploadCount()
+			<< " (skipped " << material_binder->GetSkippedCount() + deferred_contexts->GetSkippedCount() << ")"
+			<< ", shader switches " << material_binder->GetShaderSwitchCount() + deferred_contexts->GetShaderSwitchCount()
+			<< ", tagged allocations " << MemoryTracker::Instance().GetFrameAllocations() << std::endl;
+		stats_cooldown = 2.0;
+	}
 
-	// Quad model-to-world transformation
-	Mquad = mat4f::translation(0, -6, -5) *			// No translation
-		mat4f::rotation(-PI / 2, 1.0f, 0.0f, 0.0f) *	// Rotate continuously around the y-axis
-		mat4f::scaling(100.0, 100.0, 100.0);				// Scale uniformly to 150%
+	// Collect the visible models in render order. The lists of the last
+	// frame expire, so they are replaced rather than cleared.
+	draw_list = FrameVector<DrawItem>(frame_allocator);
+	draw_costs = FrameVector<unsigned>(frame_allocator);
+	draw_list.reserve(entities.Size());
+	draw_costs.reserve(entities.Size());
+	AddDraw(quad_entity, quad);
 
 #ifdef Trojan
-	Mtrojan = mat4f::translation(0, -1, -15) *
-		mat4f::rotation(0, 0, 1, 0) *
-		mat4f::scaling(0.5, 0.5, 0.5);
+	AddDraw(trojan_entity, trojan, &TrojanPhong);
 #endif // Trojan
 
 #ifdef Cubes
-	// Cubes position update.
-	float speed = 2;
-	h_models[0]->position = vec3f(std::cos(time * speed) * 0, 0, -10);
-	h_models[0]->eulerAngles = vec3f(0, 0, -angle * 0.2f);
-	h_models[0]->scale = vec3f(1, 1, 1);
+	for (size_t i = 0; i < cubes.size(); ++i)
+		AddDraw(cube_entities[i], cubes[i]);
+#endif // !Trojan
 
-	speed = -0.5f;
-	h_models[1]->position = vec3f(std::cos(time * speed), std::sin(time * speed), 0) * 4;
-	h_models[1]->eulerAngles = vec3f(0, 0, -angle * 0.5f);
-	h_models[1]->scale = vec3f(0.7f, 0.7f, 0.7f);
+#ifdef Sponza
+	AddDraw(sponza_entity, sponza);
+#endif // Sponza
 
-	speed = 2;
-	h_models[2]->position = vec3f(std::cos(time * speed), std::sin(time * speed), 0) * 2;
-	h_models[2]->eulerAngles = vec3f(0, 0, angle * 0.8f);
-	h_models[2]->scale = vec3f(0.3f, 0.3f, 0.3f);
+#ifdef Sphere
+	AddDraw(sphere_entity, sphere, &SpherePhong);
+#endif // Sphere
 
-	// Cube model-to-world transformation.
-	mat4f currentTranslation;
-	mat4f currentRotation;
+#ifdef Primitives
+	for (size_t i = 0; i < primitives.size(); ++i)
+		AddDraw(primitive_entities[i], primitives[i]);
+#endif // Primitives
+
+	// Group the draws by pixel shader permutation, keeping the order within
+	// one, so that few switches are recorded per context. A counting sort,
+	// as stable_sort would take its buffer from the heap.
+	unsigned offsets[ShaderPermutationCount + 1] = {};
+	for (const DrawItem& item : draw_list)
+		offsets[item.permutation + 1]++;
+	for (unsigned i = 0; i < ShaderPermutationCount; i++)
+		offsets[i + 1] += offsets[i];
+	FrameVector<DrawItem> sorted(draw_list.size(), DrawItem(), frame_allocator);
+	for (const DrawItem& item : draw_list)
+		sorted[offsets[item.permutation]++] = item;
+	draw_list = std::move(sorted);
+	for (const DrawItem& item : draw_list)
+		draw_costs.push_back(item.cost);
+
+#ifdef DEFERRED_CONTEXTS
+	// Split the draw list over the deferred contexts
+	DrawRange* ranges = frame_allocator.AllocateArray<DrawRange>(deferred_contexts->Size());
+	const unsigned nbr_ranges = PartitionDraws(
+		draw_costs.data(),
+		(unsigned)draw_costs.size(),
+		deferred_contexts->Size(),
+		MinDrawcallsPerContext,
+		ranges);
+
+	if (nbr_ranges > 1)
+	{
+		deferred_contexts->Capture();
+		DeferredRecorder recorder(*this);
+		RecordAndSubmit(*jobs, recorder, ranges, nbr_ranges, frame_allocator);
+		return;
+	}
+#endif
 
-	mat4f hierarchicalTranslation = mat4f_identity;
-	mat4f hierarchicalRotation = mat4f_identity;
+	// Render the whole list on the immediate context
+	DrawRange all;
+	all.end = (unsigned)draw_list.size();
+	RenderDraws(dxdevice_context, material_binder, all);
+}
+
+void OurTestScene::AddDraw(EntityHandle entity, const Model* model, const PhongParams* phong_override)
+{
+	if (!model->IsVisible())
+		return;
+
+	DrawItem item;
+	item.entity = entities.GetIndex(entity);
+	item.model = model;
+	item.phong_override = phong_override;
+	item.permutation = model->GetPermutation();
+	item.cost = model->GetVisibleDrawcallCount();
+	draw_list.push_back(item);
+}
+
+void OurTestScene::RenderDraws(ID3D11DeviceContext* context, MaterialBinder* binder, const DrawRange& range) const
+{
+	PROFILE_ZONE("Draw");
 
-	for (size_t i = 0; i < h_models.size(); ++i)
+	for (unsigned i = range.begin; i < range.end; i++)
 	{
-		currentTranslation = mat4f::translation(h_models[i]->position);
-		currentRotation = mat4f::rotation(h_models[i]->eulerAngles.x, 1, 0, 0) *
-			mat4f::rotation(h_models[i]->eulerAngles.y, 0, 1, 0) *
-			mat4f::rotation(h_models[i]->eulerAngles.z, 0, 0, 1);
+		const DrawItem& item = draw_list[i];
 
-		Mh_models[i] = hierarchicalTranslation * currentTranslation *
-			hierarchicalRotation * currentRotation *
-			mat4f::scaling(h_models[i]->scale);
+		// Load matrices + the model's transformation to the device and render it
+		UpdateTransformationBuffer(context, rendered_world_matrices[item.entity], rendered_normal_matrices[item.entity], Mview, Mproj);
 
-		hierarchicalTranslation = hierarchicalTranslation * currentTranslation;
-		hierarchicalRotation = hierarchicalRotation * currentRotation;
+		if (item.phong_override)
+			binder->SetPhongOverride(*item.phong_override);
+
+		item.model->Render(context, binder);
+
+		if (item.phong_override)
+			binder->ClearPhongOverride();
 	}
-#endif // !Trojan
+}
 
-#ifdef Sponza
-	// Sponza model-to-world transformation
-	Msponza = mat4f::translation(0, -2, 0) *		 // Move down 5 units
-		mat4f::rotation(fPI / 2, 0.0f, 1.0f, 0.0f) * // Rotate pi/2 radians (90 degrees) around y
-		mat4f::scaling(0.05f);						 // The scene is quite large so scale it down to 5%
-#endif // Sponza
+void OurTestScene::AddToCulling(EntityHandle entity)
+{
+	CullEntry entry;
+	entry.entity = entities.GetIndex(entity);
+	entry.first_item = (unsigned)bvh_item_bounds.size();
+	cull_entries.push_back(entry);
 
-#ifdef Sphere
-	h_models[0]->position = vec3f(0, 0, -10);
-	h_models[0]->eulerAngles = vec3f(0, 0, 0);
-	h_models[0]->scale = vec3f(1, 1, 1);
+	if (entity_cull_entry.size() <= entry.entity)
+		entity_cull_entry.resize(entry.entity + 1, TransformHierarchy::InvalidIndex);
+	entity_cull_entry[entry.entity] = (unsigned)cull_entries.size() - 1;
 
-	mat4f rotation = mat4f::rotation(h_models[0]->eulerAngles.x, 1, 0, 0) *
-		mat4f::rotation(h_models[0]->eulerAngles.y, 0, 1, 0) *
-		mat4f::rotation(h_models[0]->eulerAngles.z, 0, 0, 1);
+	// One BVH item per drawcall
+	for (unsigned i = 0; i < entities.GetModel(entry.entity)->GetDrawcallCount(); i++)
+	{
+		bvh_item_bounds.push_back(AABB());
+		bvh_item_entry.push_back((unsigned)cull_entries.size() - 1);
+	}
+	bvh_built = false;
+}
 
-	Mh_models[0] = mat4f::translation(h_models[0]->position) * rotation * mat4f::scaling(h_models[0]->scale);
-#endif // Sphere
+void OurTestScene::UpdateCulling(const std::vector<unsigned>& moved)
+{
+#ifdef BVH_CULLING
+	// World-space bounds of the drawcalls of an entry
+	auto update_bounds = [this](const CullEntry& e)
+	{
+		const Model* model = entities.GetModel(e.entity);
+		const mat4f& M = rendered_world_matrices[e.entity];
+		for (unsigned i = 0; i < model->GetDrawcallCount(); i++)
+			bvh_item_bounds[e.first_item + i] = TransformAABB(M, model->GetDrawcallBounds(i));
+	};
 
-	// Increase the amount of time passed.
-	time += dt;
-	// Increment the rotation angle.
-	angle += angle_vel * dt;
+	if (!bvh_built)
+	{
+		for (auto& e : cull_entries)
+			update_bounds(e);
+		bvh.Build(bvh_item_bounds.data(), bvh_item_bounds.size());
+		bvh_built = true;
+		return;
+	}
 
-	// Print fps
-	fps_cooldown -= dt;
-	if (fps_cooldown < 0.0)
+	// Drawcalls of entities that did not move keep their bounds, others are refit in place
+	for (unsigned entity : moved)
 	{
-		std::cout << "fps " << (int)(1.0f / dt) << std::endl;
-//		printf("fps %i\n", (int)(1.0f / dt));
-		fps_cooldown = 2.0;
+		if (entity >= entity_cull_entry.size() || entity_cull_entry[entity] == TransformHierarchy::InvalidIndex)
+			continue;
+		const CullEntry& e = cull_entries[entity_cull_entry[entity]];
+		update_bounds(e);
+		for (unsigned i = 0; i < entities.GetModel(e.entity)->GetDrawcallCount(); i++)
+			bvh.UpdateItem(e.first_item + i, bvh_item_bounds[e.first_item + i]);
 	}
+#endif
 }
 
-//
-// Called every frame, after update
-//
-void OurTestScene::Render()
+void OurTestScene::CullScene(const mat4f& Mviewproj)
 {
-	// Bind transformation_buffer to slot b0 of the VS
-	dxdevice_context->VSSetConstantBuffers(0, 1, &transformation_buffer);
-	// Bind light_Buffer to slot b0 of the PS
-	dxdevice_context->PSSetConstantBuffers(0, 1, &light_Buffer);
-	dxdevice_context->PSSetConstantBuffers(1, 1, &phong_Buffer);
+	PROFILE_ZONE("Cull");
 
-	// Obtain the matrices needed for rendering from the camera
-	Mview = camera->get_WorldToViewMatrix();
-	Mproj = camera->get_ProjectionMatrix();
+	cull_stats.Reset();
 
-	UpdateLightBuffer(lightPosition, camera->position.xyz1());
+#ifdef BVH_CULLING
+	for (auto& e : cull_entries)
+		entities.GetModel(e.entity)->HideAllDrawcalls();
 
-	auto phongLambda = [this](vec4f ka, vec4f kd, vec4f ks, float s) { UpdatePhongBuffer(ka, kd, ks, s); };
+	bvh_visible_items.clear();
+	bvh.QueryFrustum(Frustum::FromMatrix(Mviewproj), bvh_visible_items);
 
-	// Load matrices + the Quad's transformation to the device and render it
-	UpdateTransformationBuffer(Mquad, Mview, Mproj);
-	quad->Render(phongLambda);
+	for (unsigned item : bvh_visible_items)
+	{
+		const CullEntry& e = cull_entries[bvh_item_entry[item]];
+		entities.GetModel(e.entity)->ShowDrawcall(item - e.first_item);
+	}
 
-#ifdef Trojan
-	// Load matricies + Trojan's transformation to the device and render it
-	UpdateTransformationBuffer(Mtrojan, Mview, Mproj);
-	UpdatePhongBuffer(vec4f(0.0f, 0.0f, 0.3f, 1), vec4f(0.8f, 0.0f, 0.8f, 1), vec4f(1.0f, 0.5f, 1.0f, 1.0f), 0.5f);
-	trojan->Render();
-#endif // Trojan
+	cull_stats.tested = (unsigned)bvh_item_bounds.size();
+	cull_stats.visible = (unsigned)bvh_visible_items.size();
+#else
+	for (auto& e : cull_entries)
+		entities.GetModel(e.entity)->Cull(Mviewproj * rendered_world_matrices[e.entity], &cull_stats);
+#endif
 
-#ifdef Cubes
-	// Load matricies + the Cube's transformation to the device and reander it
-	for (size_t i = 0; i < h_models.size(); ++i)
+#ifdef OCCLUSION_CULLING
+	OcclusionCull(Mviewproj);
+#endif
+}
+
+void OurTestScene::OcclusionCull(const mat4f& Mviewproj)
+{
+	PROFILE_ZONE("Occlusion cull");
+
+	// Rasterize the occluders of models in view
+	occlusion_culler.BeginFrame();
+	for (auto& e : cull_entries)
 	{
-		UpdateTransformationBuffer(Mh_models[i], Mview, Mproj);
-		h_models[i]->Render(phongLambda);
+		const Model* model = entities.GetModel(e.entity);
+		if (model->IsVisible() && !model->GetOccluderMesh().IsEmpty())
+			occlusion_culler.RenderOccluder(model->GetOccluderMesh(), Mviewproj * rendered_world_matrices[e.entity]);
 	}
-#endif // !Trojan
-
-#ifdef Sponza
-	// Load matrices + Sponza's transformation to the device and render it
-	UpdateTransformationBuffer(Msponza, Mview, Mproj);
-	sponza->Render(phongLambda);
-#endif // Sponza
+	occlusion_culler.EndFrame();
 
-#ifdef Sphere
-	UpdateTransformationBuffer(Mh_models[0], Mview, Mproj);
-	UpdatePhongBuffer(vec4f(0.0f, 0.0f, 0.3f, 1), vec4f(0.8f, 0.0f, 0.8f, 1), vec4f(1.0f, 0.5f, 1.0f, 1.0f), 200);
-	h_models[0]->Render();
-#endif // Sphere
+	// Test the drawcalls that survived frustum culling, whole entities first
+	for (auto& e : cull_entries)
+	{
+		Model* model = entities.GetModel(e.entity);
+		if (!model->IsVisible())
+			continue;
+
+		if (!occlusion_culler.TestAABB(rendered_world_bounds[e.entity], Mviewproj))
+		{
+			cull_stats.visible -= model->GetVisibleDrawcallCount();
+			cull_stats.occluded += model->GetVisibleDrawcallCount();
+			model->HideAllDrawcalls();
+			continue;
+		}
+
+		const mat4f Mmodelproj = Mviewproj * rendered_world_matrices[e.entity];
+		for (unsigned i = 0; i < model->GetDrawcallCount(); i++)
+		{
+			if (!model->IsDrawcallVisible(i) ||
+				occlusion_culler.TestAABB(model->GetDrawcallBounds(i), Mmodelproj))
+				continue;
+			model->HideDrawcall(i);
+			cull_stats.visible--;
+			cull_stats.occluded++;
+		}
+	}
 }
 
 void OurTestScene::Release()
 {
-	SAFE_DELETE(quad);
-	SAFE_DELETE(sponza);
+	// Frame times of the session, for comparing runs
+	std::ofstream csv("frame_times.csv");
+	frame_stats.WriteCSV(csv);
+
+#ifdef RECORD_CAMERA_PATH
+	camera_path.Save(CameraPathFile);
+	std::cout << "recorded " << camera_path.Size() << " frames to " << CameraPathFile << std::endl;
+#endif
+	SAFE_DELETE(camera_replay);
+
+	// Entities hold the render handles of all models
+	for (unsigned i = 0; i < entities.Size(); i++)
+	{
+		if (!entities.IsAlive(i))
+			continue;
+		Model* model = entities.GetModel(i);
+		SAFE_DELETE(model);
+	}
 	SAFE_DELETE(camera);
 
 	SAFE_RELEASE(transformation_buffer);
 	SAFE_RELEASE(light_Buffer);
-	SAFE_RELEASE(phong_Buffer);
+	for (StructuredBuffer* buffer : { &lights_buffer, &clusters_buffer, &light_indices_buffer })
+	{
+		SAFE_RELEASE(buffer->SRV);
+		SAFE_RELEASE(buffer->buffer);
+	}
+	SAFE_RELEASE(samplerState);
+	SAFE_DELETE(material_binder);
+	SAFE_DELETE(deferred_contexts);
+	SAFE_DELETE(pixel_shaders);
+	SAFE_DELETE(jobs);
 	// + release other CBuffers
 }
 
@@ -321,6 +855,10 @@ void OurTestScene::WindowResize(int window_width, int window_height)
 	if (camera)
 		camera->aspect = float(window_width) / window_height;
 
+	// A minimized window has no area; keep the last resolution
+	if (window_width > 0 && window_height > 0)
+		occlusion_culler.SetResolution(OcclusionWidth, OcclusionWidth * window_height / window_width);
+
 	Scene::WindowResize(window_width, window_height);
 }
 
@@ -337,16 +875,17 @@ void OurTestScene::InitTransformationBuffer()
 	ASSERT(hr = dxdevice->CreateBuffer(&MatrixBuffer_desc, nullptr, &transformation_buffer));
 }
 
-void OurTestScene::UpdateTransformationBuffer(mat4f ModelToWorldMatrix, mat4f WorldToViewMatrix, mat4f ProjectionMatrix)
+void OurTestScene::UpdateTransformationBuffer(ID3D11DeviceContext* context, mat4f ModelToWorldMatrix, mat4f NormalMatrix, mat4f WorldToViewMatrix, mat4f ProjectionMatrix) const
 {
 	// Map the resource buffer, obtain a pointer and then write our matrices to it
 	D3D11_MAPPED_SUBRESOURCE resource;
-	dxdevice_context->Map(transformation_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	context->Map(transformation_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	TransformationBuffer* matrix_buffer_ = (TransformationBuffer*)resource.pData;
 	matrix_buffer_->ModelToWorldMatrix = ModelToWorldMatrix;
 	matrix_buffer_->WorldToViewMatrix = WorldToViewMatrix;
 	matrix_buffer_->ProjectionMatrix = ProjectionMatrix;
-	dxdevice_context->Unmap(transformation_buffer, 0);
+	matrix_buffer_->NormalMatrix = NormalMatrix;
+	context->Unmap(transformation_buffer, 0);
 }
 
 void OurTestScene::InitLightBuffer()
@@ -362,37 +901,64 @@ void OurTestScene::InitLightBuffer()
 	ASSERT(hr = dxdevice->CreateBuffer(&positionBuffer_Desc, nullptr, &light_Buffer));
 }
 
-void OurTestScene::UpdateLightBuffer(vec4f lightPosition, vec4f cameraPosition)
+void OurTestScene::UpdateLightBuffer(vec4f cameraPosition)
 {
 	D3D11_MAPPED_SUBRESOURCE resource;
 	dxdevice_context->Map(light_Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
 	LightBuffer* positionBuffer = (LightBuffer*)resource.pData;
-	positionBuffer->lightPosition = lightPosition;
 	positionBuffer->cameraPosition = cameraPosition;
+	positionBuffer->clusterDims[0] = light_clusters.GetTilesX();
+	positionBuffer->clusterDims[1] = light_clusters.GetTilesY();
+	positionBuffer->clusterDims[2] = light_clusters.GetSlices();
+	positionBuffer->clusterDims[3] = 0;
+	positionBuffer->clusterParams = vec4f(
+		light_clusters.GetSliceScale(),
+		light_clusters.GetSliceBias(),
+		1.0f / window_width,
+		1.0f / window_height);
 	dxdevice_context->Unmap(light_Buffer, 0);
 }
 
-void OurTestScene::InitPhongBuffer()
+void OurTestScene::UpdateStructuredBuffer(StructuredBuffer& buffer, const void* data, unsigned count, unsigned stride)
 {
-	HRESULT hr;
-	D3D11_BUFFER_DESC phongBuffer_Desc = { 0 };
-	phongBuffer_Desc.Usage = D3D11_USAGE_DYNAMIC;
-	phongBuffer_Desc.ByteWidth = sizeof(PhongBuffer);
-	phongBuffer_Desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	phongBuffer_Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	phongBuffer_Desc.MiscFlags = 0;
-	phongBuffer_Desc.StructureByteStride = 0;
-	ASSERT(hr = dxdevice->CreateBuffer(&phongBuffer_Desc, nullptr, &phong_Buffer));
+	if (count > buffer.capacity || !buffer.buffer)
+	{
+		SAFE_RELEASE(buffer.SRV);
+		SAFE_RELEASE(buffer.buffer);
+		buffer.capacity = std::max(std::max(count, 2 * buffer.capacity), 64u);
+
+		HRESULT hr;
+		D3D11_BUFFER_DESC desc = { 0 };
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = buffer.capacity * stride;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		ASSERT(hr = dxdevice->CreateBuffer(&desc, nullptr, &buffer.buffer));
+		// A null description views the whole buffer
+		ASSERT(hr = dxdevice->CreateShaderResourceView(buffer.buffer, nullptr, &buffer.SRV));
+	}
+
+	D3D11_MAPPED_SUBRESOURCE resource;
+	dxdevice_context->Map(buffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	if (count)
+		memcpy(resource.pData, data, (size_t)count * stride);
+	dxdevice_context->Unmap(buffer.buffer, 0);
 }
 
-void OurTestScene::UpdatePhongBuffer(vec4f ambient, vec4f diffuse, vec4f specular, float shininess)
+void OurTestScene::UpdateLightClusters(const std::vector<Light>& frame_lights)
 {
-	D3D11_MAPPED_SUBRESOURCE resource;
-	dxdevice_context->Map(phong_Buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	PhongBuffer* materialBuffer = (PhongBuffer*)resource.pData;
-	materialBuffer->ambientColor = ambient;
-	materialBuffer->diffuseColor = diffuse;
-	materialBuffer->specularColor = specular;
-	materialBuffer->shininess = shininess;
-	dxdevice_context->Unmap(phong_Buffer, 0);
+	{
+		PROFILE_ZONE("Light binning");
+		light_clusters.Build(frame_lights.data(), (unsigned)frame_lights.size(), Mview, Mproj, jobs);
+	}
+
+	UpdateStructuredBuffer(lights_buffer, frame_lights.data(), (unsigned)frame_lights.size(), sizeof(Light));
+	UpdateStructuredBuffer(clusters_buffer, light_clusters.GetClusters(), light_clusters.GetClusterCount(), sizeof(LightCluster));
+	UpdateStructuredBuffer(light_indices_buffer, light_clusters.GetLightIndices(), light_clusters.GetLightIndexCount(), sizeof(unsigned));
+
+	// Bind the buffers to slots t4-t6 of the PS; deferred contexts capture them
+	ID3D11ShaderResourceView* SRVs[] = { lights_buffer.SRV, clusters_buffer.SRV, light_indices_buffer.SRV };
+	dxdevice_context->PSSetShaderResources(4, 3, SRVs);
 }
\ No newline at end of file
@@ -7,14 +7,19 @@
 #include "InputHandler.h"
 #include "Camera.h"
 #include "Model.h"
-#include "Texture.h"
-
-// New files
-// Material
-// Texture <- stb
-
-// TEMP
-
+#include "TextureLoader.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "EntityStore.h"
+#include "CommandRecording.h"
+#include "D3D11MaterialBinder.h"
+#include "DeferredContexts.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
+#include "FrameStats.h"
+#include "FrameAllocator.h"
+#include "CameraPath.h"
+#include "LightClusters.h"
 
 class Scene
 {
@@ -34,9 +39,17 @@ public:
 
 	virtual void Init() = 0;
 
-	virtual void Update(
+	//
+	// Start updating the next frame. The update may run on another thread
+	// until EndUpdate(), concurrently with Render() of the current frame,
+	// and reads input_handler meanwhile.
+	//
+	virtual void BeginUpdate(
 		float dt,
 		InputHandler* input_handler) = 0;
+
+	// Wait for the update started by BeginUpdate()
+	virtual void EndUpdate() = 0;
 	
 	virtual void Render() = 0;
 	
@@ -56,9 +69,20 @@ class OurTestScene : public Scene
 	// CBuffer for transformation matrices
 	ID3D11Buffer* transformation_buffer = nullptr;
 	ID3D11Buffer* light_Buffer = nullptr;
-	ID3D11Buffer* phong_Buffer = nullptr;
 	// + other CBuffers
 
+	// Owns the Phong CBuffer, bound per drawcall by the models
+	D3D11MaterialBinder* material_binder = nullptr;
+
+	// The pixel shader per combination of material textures
+	PixelShaderPermutations* pixel_shaders = nullptr;
+
+	// Worker threads for loading, updating and recording the scene
+	JobSystem* jobs = nullptr;
+
+	// Contexts for recording the draw list on worker threads
+	DeferredContexts* deferred_contexts = nullptr;
+
 	ID3D11SamplerState* samplerState = nullptr;
 
 	// 
@@ -71,68 +95,218 @@ class OurTestScene : public Scene
 		mat4f ModelToWorldMatrix;
 		mat4f WorldToViewMatrix;
 		mat4f ProjectionMatrix;
+		mat4f NormalMatrix;
 	};
 
 	struct LightBuffer
 	{
-		vec4f lightPosition;
 		vec4f cameraPosition;
+		unsigned clusterDims[4];	// Tiles in x and y, depth slices
+		vec4f clusterParams;		// Slice scale and bias, 1 / viewport width and height
 	};
 
-	struct alignas(16) PhongBuffer
+	// A dynamic structured buffer, recreated larger when it runs out
+	struct StructuredBuffer
 	{
-		vec4f ambientColor;
-		vec4f diffuseColor;
-		vec4f specularColor;
-		alignas(16) float shininess;
+		ID3D11Buffer* buffer = nullptr;
+		ID3D11ShaderResourceView* SRV = nullptr;
+		unsigned capacity = 0;		// Elements
 	};
 
 	D3D11_SAMPLER_DESC samplerDesc;
 
+	//
+	// Everything rendering needs from an update. The update of the next
+	// frame writes one snapshot while the current frame renders another.
+	//
+	struct FrameSnapshot
+	{
+		float dt = 0;				// Measured, even when the update used a fixed timestep
+		mat4f Mview;
+		mat4f Mproj;
+		vec4f camera_position;
+		std::vector<Light> lights;
+		D3D11_FILTER sampler_filter = D3D11_FILTER_ANISOTROPIC;
+
+		// Entities that moved in the update, and their new world state
+		std::vector<unsigned> moved;
+		std::vector<mat4f> world_matrices;
+		std::vector<mat4f> normal_matrices;
+		std::vector<AABB> world_bounds;
+	};
+	FramePipeline<FrameSnapshot> frames;
+
+	// Arguments of the update in flight
+	float update_dt = 0;
+	InputHandler* update_input = nullptr;
+
 	//
 	// Scene content
 	//
 	Camera* camera;
 
+	// Lights and texture filtering, as set by the update. The first light
+	// is the main light at lightPosition.
 	vec4f lightPosition;
+	std::vector<Light> lights;
+	std::vector<vec3f> light_origins;	// The other lights circle around these
+	D3D11_FILTER sampler_filter = D3D11_FILTER_ANISOTROPIC;
 
 	QuadModel* quad;
-	std::vector<Model*> h_models;
 	OBJModel* sponza;
 	OBJModel* trojan;
+	OBJModel* sphere;
+	std::vector<CubeModel*> cubes;
+	std::vector<PrimitiveModel*> primitives;
+
+	// Transforms, world matrices and bounds of the models above
+	EntityStore entities;
+	EntityHandle quad_entity;
+	EntityHandle sponza_entity;
+	EntityHandle trojan_entity;
+	EntityHandle sphere_entity;
+	std::vector<EntityHandle> cube_entities;
+	std::vector<EntityHandle> primitive_entities;
 
-	// Model-to-world transformation matrices
-	mat4f Msponza;
-	std::vector<mat4f> Mh_models;
-	mat4f Mquad;
-	mat4f Mtrojan;
+	//
+	// Rendering state, owned by Render(): world state of the entities as of
+	// the rendered frame, kept up to date from the snapshots
+	//
+	std::vector<mat4f> rendered_world_matrices;
+	std::vector<mat4f> rendered_normal_matrices;
+	std::vector<AABB> rendered_world_bounds;
 
 	// World-to-view matrix
 	mat4f Mview;
 	// Projection matrix
 	mat4f Mproj;
 
+	// Culling counters of the last rendered frame
+	CullStats cull_stats;
+
+	// The rendered frame's lights, binned into clusters, and their buffers
+	// in slots t4-t6 of the PS
+	LightClusters light_clusters;
+	StructuredBuffer lights_buffer;
+	StructuredBuffer clusters_buffer;
+	StructuredBuffer light_indices_buffer;
+
+	// Scratch memory of the rendered frame, e.g. the draw list
+	FrameAllocator frame_allocator;
+
+	//
+	// Visible models of the frame in render order, rebuilt after culling
+	// in frame_allocator
+	//
+	struct DrawItem
+	{
+		unsigned entity;					// Entity slot
+		const Model* model;
+		const PhongParams* phong_override;	// Fixed color, or null to use the model's materials
+		unsigned permutation;				// Pixel shader permutation, the sort key
+		unsigned cost;
+	};
+	FrameVector<DrawItem> draw_list{ frame_allocator };
+	FrameVector<unsigned> draw_costs{ frame_allocator };	// Visible drawcalls per item
+
+	class DeferredRecorder;
+
+	//
+	// Culling: entities are registered with their model, and each of
+	// its drawcalls becomes an item in a scene-wide BVH
+	//
+	struct CullEntry
+	{
+		unsigned entity;		// Entity slot
+		unsigned first_item;	// BVH item of the first drawcall
+	};
+	std::vector<CullEntry> cull_entries;
+	std::vector<unsigned> entity_cull_entry;	// Cull entry per entity slot
+	std::vector<AABB> bvh_item_bounds;		// World-space bounds per item
+	std::vector<unsigned> bvh_item_entry;	// Cull entry per item
+	std::vector<unsigned> bvh_visible_items;
+	BVH bvh;
+	bool bvh_built = false;
+
+	// Depth buffer of the occluders, rebuilt every frame
+	OcclusionCuller occlusion_culler;
+
 	// Misc
 	float time = 0;
 	float angle = 0;			// A per-frame updated rotation angle (radians)...
 	float angle_vel = fPI / 2;	// ...and its velocity (radians/sec)
 	float camera_vel = 5.0f;	// Camera movement velocity in units/s
-	float fps_cooldown = 0;
+
+	// Camera path being recorded or replayed, and the replay if any
+	CameraPath camera_path;
+	CameraReplay* camera_replay = nullptr;
+
+	// Frame times of the rendered frames, printed every few seconds
+	FrameStats frame_stats{ 1 << 14 };
+	float stats_cooldown = 0;
+
+	//
+	// Create an entity for a model and register it for culling
+	//
+	EntityHandle AddEntity(Model* model, EntityHandle parent = EntityHandle());
+
+	void AddToCulling(EntityHandle entity);
+
+	// Update the scene into the snapshot of the next frame
+	void Update(
+		float dt,
+		InputHandler* input_handler,
+		FrameSnapshot& snapshot);
+
+	static void UpdateJob(void* scene);
+
+	// Print the frame times of the finished replay and write them to a CSV
+	void ReportReplay() const;
+
+	// Copy the camera, light and the entities that moved (or all) to snapshot
+	void WriteSnapshot(FrameSnapshot& snapshot, bool all_entities) const;
+
+	// Bring the rendering state up to date with snapshot
+	void ApplySnapshot(const FrameSnapshot& snapshot);
+
+	// Build or refit the BVH after the entities in moved have been applied
+	void UpdateCulling(const std::vector<unsigned>& moved);
+
+	// Set the visibility of all registered drawcalls
+	void CullScene(const mat4f& Mviewproj);
+
+	// Hide drawcalls that passed the frustum test but are behind occluders
+	void OcclusionCull(const mat4f& Mviewproj);
+
+	// Append a model to the draw list if any of its drawcalls is visible
+	void AddDraw(EntityHandle entity, const Model* model, const PhongParams* phong_override = nullptr);
+
+	//
+	// Record a range of the draw list into context, binding materials with
+	// binder. Safe to call concurrently for different contexts.
+	//
+	void RenderDraws(ID3D11DeviceContext* context, MaterialBinder* binder, const DrawRange& range) const;
 
 	void InitTransformationBuffer();
 
+	// NormalMatrix is the inverse-transpose of ModelToWorldMatrix, used for normals
 	void UpdateTransformationBuffer(
+		ID3D11DeviceContext* context,
 		mat4f ModelToWorldMatrix,
+		mat4f NormalMatrix,
 		mat4f WorldToViewMatrix,
-		mat4f ProjectionMatrix);
+		mat4f ProjectionMatrix) const;
 
 	void InitLightBuffer();
 
-	void UpdateLightBuffer(vec4f light, vec4f camera);
+	void UpdateLightBuffer(vec4f camera);
 
-	void InitPhongBuffer();
+	// Copy count elements to buffer, growing it if needed
+	void UpdateStructuredBuffer(StructuredBuffer& buffer, const void* data, unsigned count, unsigned stride);
+
+	// Bin the lights of the rendered frame and upload them with the clusters
+	void UpdateLightClusters(const std::vector<Light>& frame_lights);
 
-	void UpdatePhongBuffer(vec4f ambient, vec4f diffuse, vec4f specular, float shininess);
 
 public:
 	OurTestScene(
@@ -143,16 +317,12 @@ public:
 
 	void Init() override;
 
-	void AddModel(Model* toAdd)
-	{
-		h_models.push_back(toAdd);
-		Mh_models.push_back(mat4f_zero);
-	}
-
-	void Update(
+	void BeginUpdate(
 		float dt,
 		InputHandler* input_handler) override;
 
+	void EndUpdate() override;
+
 	void Render() override;
 
 	void Release() override;
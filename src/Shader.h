@@ -11,6 +11,7 @@
 #define _SHADER_H
 
 #include <D3D11.h>
+#include "ShaderCache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +65,14 @@ extern "C" {
 	/// @return Code describing the result of the creation, returns SR_OK on success.
 	/// 
 	SHADER_RESULT create_shader(ID3D11Device* pDevice, const SCHAR* pPath, const char* pEntrypoint, SHADER_TYPE type, const D3D11_INPUT_ELEMENT_DESC* pLayout, uint32_t layoutcount, shader_data** pShader);
+
+	/// 
+	/// Create a shader as create_shader does, compiled with preprocessor defines, e.g. to select a permutation.
+	/// 
+	/// @param pDefines Defines ending with an entry with a NULL name, or NULL. Not copied: they must outlive the shader, which is recompiled with them on hot reload.
+	/// @see create_shader()
+	/// 
+	SHADER_RESULT create_shader_with_defines(ID3D11Device* pDevice, const SCHAR* pPath, const char* pEntrypoint, SHADER_TYPE type, const shader_define* pDefines, const D3D11_INPUT_ELEMENT_DESC* pLayout, uint32_t layoutcount, shader_data** pShader);
 	
 	///
 	/// Deletes a shader created using create_shader.
@@ -3,8 +3,8 @@
 #ifndef MATRIXBUFFERS_H
 #define MATRIXBUFFERS_H
 
-#include "vec\vec.h"
-#include "vec\mat.h"
+#include "vec/vec.h"
+#include "vec/mat.h"
 
 using namespace linalg;
 
@@ -13,6 +13,7 @@ struct MatrixBuffer_t
 	mat4f ModelToWorldMatrix;
 	mat4f WorldToViewMatrix;
 	mat4f ProjectionMatrix;
+	mat4f NormalMatrix;
 };
 
 #endif
\ No newline at end of file
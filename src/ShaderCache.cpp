@@ -0,0 +1,274 @@
+//
+//  ShaderCache.cpp
+//
+//	On-disk cache of compiled shader bytecode
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include "ShaderCache.h"
+
+// Start of every cache file; the version changes with the layout
+static const uint32_t CacheMagic = 0x43535245;	// "ERSC"
+static const uint32_t CacheVersion = 1;
+
+// Directory of the cache of the C interface, relative to the working directory
+static const char* DefaultDirectory = "shader_cache";
+
+// Numbers the temporary files, so that concurrent stores do not share one
+static std::atomic<unsigned> nbr_temporaries(0);
+
+//
+// 64-bit FNV-1a, the same on every platform and run. Strings are hashed
+// with their length, so that "ab" + "c" differs from "a" + "bc".
+//
+class Hasher
+{
+public:
+	uint64_t hash = 14695981039346656037ull;
+
+	void Add(const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	void Add(uint64_t value) { Add(&value, sizeof(value)); }
+
+	void Add(const std::string& s)
+	{
+		Add((uint64_t)s.size());
+		Add(s.data(), s.size());
+	}
+};
+
+// The header in front of the bytecode in a cache file
+struct CacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;
+	uint64_t checksum;		// Hash of the bytecode
+};
+
+static bool ReadFile(const std::filesystem::path& path, std::string& contents)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	std::ostringstream buffer;
+	buffer << in.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+//
+// Hash the files included by text, which was read from file, and theirs.
+// Every #include line counts, also those a define would skip.
+//
+static void HashIncludes(const std::filesystem::path& file, const std::string& text, Hasher& hasher, std::set<std::string>& visited)
+{
+	std::istringstream lines(text);
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#')
+			continue;
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+			continue;
+		const size_t open = line.find_first_of("\"<", i + 7);
+		if (open == std::string::npos)
+			continue;
+		const size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos)
+			continue;
+
+		const std::string name = line.substr(open + 1, close - open - 1);
+		hasher.Add(name);
+
+		// A file included twice is hashed once
+		const std::filesystem::path included = (file.parent_path() / name).lexically_normal();
+		if (!visited.insert(included.string()).second)
+			continue;
+		std::string contents;
+		if (ReadFile(included, contents))
+		{
+			hasher.Add(contents);
+			HashIncludes(included, contents, hasher, visited);
+		}
+	}
+}
+
+ShaderCache::ShaderCache(const std::string& directory) :
+	directory(directory)
+{ }
+
+uint64_t ShaderCache::ComputeKey(const ShaderSource& source)
+{
+	Hasher hasher;
+	hasher.Add((uint64_t)CacheVersion);
+	hasher.Add(source.text);
+
+	std::set<std::string> visited;
+	HashIncludes(source.path, source.text, hasher, visited);
+
+	hasher.Add((uint64_t)source.defines.size());
+	for (const auto& define : source.defines)
+	{
+		hasher.Add(define.first);
+		hasher.Add(define.second);
+	}
+	hasher.Add(source.entry_point);
+	hasher.Add(source.target);
+	hasher.Add((uint64_t)source.flags);
+	hasher.Add(source.compiler);
+	return hasher.hash;
+}
+
+std::string ShaderCache::GetFilename(const ShaderSource& source) const
+{
+	// Everything but the source, which only changes the key
+	Hasher hasher;
+	hasher.Add(source.path);
+	hasher.Add((uint64_t)source.defines.size());
+	for (const auto& define : source.defines)
+	{
+		hasher.Add(define.first);
+		hasher.Add(define.second);
+	}
+	hasher.Add(source.entry_point);
+	hasher.Add(source.target);
+	hasher.Add((uint64_t)source.flags);
+
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hasher.hash);
+	const std::string stem = std::filesystem::path(source.path).stem().string();
+	return (std::filesystem::path(directory) / (stem + "_" + hex + ".cso")).string();
+}
+
+bool ShaderCache::Load(const ShaderSource& source, std::vector<char>& bytecode)
+{
+	std::ifstream in(GetFilename(source), std::ios::binary);
+	CacheHeader header;
+	if (!in || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		header.magic != CacheMagic ||
+		header.version != CacheVersion ||
+		header.key != ComputeKey(source))
+	{
+		nbr_misses++;
+		return false;
+	}
+
+	// Check the size against the file before allocating it
+	const std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	if (in.tellg() - start != (std::streamoff)header.size)
+	{
+		nbr_misses++;
+		return false;
+	}
+	in.seekg(start);
+
+	bytecode.resize((size_t)header.size);
+	Hasher checksum;
+	if (in.read(bytecode.data(), bytecode.size()))
+		checksum.Add(bytecode.data(), bytecode.size());
+	if (!in || checksum.hash != header.checksum)
+	{
+		bytecode.clear();
+		nbr_misses++;
+		return false;
+	}
+
+	nbr_hits++;
+	return true;
+}
+
+bool ShaderCache::Store(const ShaderSource& source, const void* bytecode, size_t size)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	CacheHeader header;
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.key = ComputeKey(source);
+	header.size = size;
+	Hasher checksum;
+	checksum.Add(bytecode, size);
+	header.checksum = checksum.hash;
+
+	// Write aside and rename, so a reader never sees half a file
+	const std::string filename = GetFilename(source);
+	const std::string temporary = filename + "." + std::to_string(nbr_temporaries.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+	{
+		// Writes to a failed stream do nothing, and close() fails if flushing does
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(static_cast<const char*>(bytecode), size);
+		out.close();
+		if (!out)
+		{
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+	std::filesystem::rename(temporary, filename, error);
+	if (error)
+	{
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+static ShaderCache& GetDefaultCache()
+{
+	static ShaderCache cache(DefaultDirectory);
+	return cache;
+}
+
+static ShaderSource MakeSource(const char* path, const char* source, size_t source_size, const shader_define* defines,
+	const char* entrypoint, const char* target, unsigned flags, const char* compiler)
+{
+	ShaderSource shader;
+	shader.path = path;
+	shader.text.assign(source, source_size);
+	for (const shader_define* define = defines; define && define->name; define++)
+		shader.defines.emplace_back(define->name, define->value ? define->value : "");
+	shader.entry_point = entrypoint;
+	shader.target = target;
+	shader.flags = flags;
+	shader.compiler = compiler ? compiler : "";
+	return shader;
+}
+
+void* shader_cache_load(const char* path, const char* source, size_t source_size, const shader_define* defines,
+	const char* entrypoint, const char* target, unsigned flags, const char* compiler, size_t* size)
+{
+	std::vector<char> bytecode;
+	if (!GetDefaultCache().Load(MakeSource(path, source, source_size, defines, entrypoint, target, flags, compiler), bytecode))
+		return nullptr;
+
+	void* data = std::malloc(bytecode.size() ? bytecode.size() : 1);
+	if (!data)
+		return nullptr;
+	std::memcpy(data, bytecode.data(), bytecode.size());
+	*size = bytecode.size();
+	return data;
+}
+
+int shader_cache_store(const char* path, const char* source, size_t source_size, const shader_define* defines,
+	const char* entrypoint, const char* target, unsigned flags, const char* compiler, const void* bytecode, size_t size)
+{
+	return GetDefaultCache().Store(MakeSource(path, source, source_size, defines, entrypoint, target, flags, compiler), bytecode, size) ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+//
+//  ShaderCache.h
+//
+//	On-disk cache of compiled shader bytecode
+//
+
+#pragma once
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// A shader as given to the compiler: everything that decides its bytecode
+//
+struct ShaderSource
+{
+	std::string path;			// Includes are resolved relative to it
+	std::string text;
+	std::vector<std::pair<std::string, std::string>> defines;	// Name and value
+	std::string entry_point;
+	std::string target;			// e.g. "ps_5_0"
+	unsigned flags = 0;			// Compiler flags
+	std::string compiler;		// Compiler and version, e.g. "d3dcompiler_47.dll"
+};
+
+//
+// Compiled bytecode in a directory, one file per path, defines, entry point
+// and target. Each file keeps the key of the source it was compiled from;
+// a lookup whose key differs, e.g. after the source or one of its includes
+// changed, misses, and the next Store() replaces the file.
+//
+// Needs no compiler, so lookup and invalidation work and test anywhere.
+// Load() and Store() may be called from several threads, as the C interface
+// is when shaders are created or reloaded concurrently. Concurrent stores of
+// the same shader in a process each write their own temporary file, and the
+// last rename wins.
+//
+class ShaderCache
+{
+public:
+	explicit ShaderCache(const std::string& directory);
+
+	//
+	// Hash of the source text, the files it includes (recursively), the
+	// defines, entry point, target, flags and compiler. Includes that cannot
+	// be read are hashed by name only.
+	//
+	static uint64_t ComputeKey(const ShaderSource& source);
+
+	std::string GetFilename(const ShaderSource& source) const;
+
+	//
+	// The cached bytecode of source, if there is one with its current key.
+	// Truncated or corrupt files miss.
+	//
+	bool Load(const ShaderSource& source, std::vector<char>& bytecode);
+
+	//
+	// Write the bytecode of source, replacing what was cached for it. On
+	// failure the cache keeps what it had and no partial file is left.
+	//
+	bool Store(const ShaderSource& source, const void* bytecode, size_t size);
+
+	unsigned GetHitCount() const { return nbr_hits.load(std::memory_order_relaxed); }
+
+	unsigned GetMissCount() const { return nbr_misses.load(std::memory_order_relaxed); }
+
+private:
+	const std::string directory;
+	std::atomic<unsigned> nbr_hits{ 0 };
+	std::atomic<unsigned> nbr_misses{ 0 };
+};
+
+extern "C" {
+#endif // __cplusplus
+
+//
+// C interface for shader.c, on a cache in the directory shader_cache
+//
+
+typedef struct shader_define
+{
+	const char* name;
+	const char* value;
+} shader_define;	// Arrays end with a null name, as D3D_SHADER_MACRO
+
+//
+// The cached bytecode, allocated with malloc, or NULL on a miss. defines
+// may be NULL. compiler names the compiler and its version.
+//
+void* shader_cache_load(const char* path, const char* source, size_t source_size, const shader_define* defines,
+	const char* entrypoint, const char* target, unsigned flags, const char* compiler, size_t* size);
+
+// Returns nonzero on success
+int shader_cache_store(const char* path, const char* source, size_t source_size, const shader_define* defines,
+	const char* entrypoint, const char* target, unsigned flags, const char* compiler, const void* bytecode, size_t size);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif
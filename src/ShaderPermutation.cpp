@@ -0,0 +1,52 @@
+//
+//  ShaderPermutation.cpp
+//
+//	Pixel shader variants, selected by the textures of a material
+//
+
+#include "ShaderPermutation.h"
+
+static const char* FeatureDefines[ShaderFeatureCount] = { "HAS_DIFFUSE_MAP", "HAS_NORMAL_MAP", "HAS_SPECULAR_MAP", "ALPHA_TEST" };
+static const char* FeatureNames[ShaderFeatureCount] = { "diffuse", "normal", "specular", "alpha-test" };
+
+const char* GetShaderFeatureDefine(unsigned i)
+{
+	return i < ShaderFeatureCount ? FeatureDefines[i] : "";
+}
+
+std::vector<std::pair<std::string, std::string>> GetPermutationDefines(unsigned permutation)
+{
+	std::vector<std::pair<std::string, std::string>> defines;
+	for (unsigned i = 0; i < ShaderFeatureCount; i++)
+		if (permutation & (1 << i))
+			defines.emplace_back(FeatureDefines[i], "1");
+	return defines;
+}
+
+std::string GetPermutationName(unsigned permutation)
+{
+	std::string name;
+	for (unsigned i = 0; i < ShaderFeatureCount; i++)
+	{
+		if (!(permutation & (1 << i)))
+			continue;
+		if (!name.empty())
+			name += "+";
+		name += FeatureNames[i];
+	}
+	return name.empty() ? "none" : name;
+}
+
+unsigned GetMaterialPermutation(const Material& material)
+{
+	unsigned permutation = 0;
+	if (material.diffuse_texture.texture_SRV)
+		permutation |= ShaderFeature_DiffuseMap;
+	if (material.normal_texture.texture_SRV)
+		permutation |= ShaderFeature_NormalMap;
+	if (material.specular_texture.texture_SRV)
+		permutation |= ShaderFeature_SpecularMap;
+	if (material.mask_texture.texture_SRV)
+		permutation |= ShaderFeature_AlphaTest;
+	return permutation;
+}
@@ -0,0 +1,46 @@
+//
+//  ShaderPermutation.h
+//
+//	Pixel shader variants, selected by the textures of a material
+//
+
+#pragma once
+#ifndef SHADERPERMUTATION_H
+#define SHADERPERMUTATION_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "Drawcall.h"
+
+//
+// Optional features of the pixel shader, one bit each. A permutation is a
+// set of them, each compiled in by a define.
+//
+enum ShaderFeature
+{
+	ShaderFeature_DiffuseMap = 1 << 0,		// HAS_DIFFUSE_MAP, t0
+	ShaderFeature_NormalMap = 1 << 1,		// HAS_NORMAL_MAP, t1
+	ShaderFeature_SpecularMap = 1 << 2,		// HAS_SPECULAR_MAP, t2
+	ShaderFeature_AlphaTest = 1 << 3,		// ALPHA_TEST, with the mask in t3
+};
+
+static const unsigned ShaderFeatureCount = 4;
+static const unsigned ShaderPermutationCount = 1 << ShaderFeatureCount;
+
+// Define of feature bit i, e.g. "HAS_DIFFUSE_MAP"
+const char* GetShaderFeatureDefine(unsigned i);
+
+// The define of each feature of permutation, set to "1"
+std::vector<std::pair<std::string, std::string>> GetPermutationDefines(unsigned permutation);
+
+// The features as "diffuse+normal", or "none", for logs
+std::string GetPermutationName(unsigned permutation);
+
+//
+// The features a material can use: one per texture loaded to the device.
+// Textures that failed to load are not sampled.
+//
+unsigned GetMaterialPermutation(const Material& material);
+
+#endif
@@ -1,19 +1,15 @@
 //
-// Texture loaders
-// Adapted from:
-// https://github-wiki-see.page/m/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples
+//  Texture.h
+//
+//	Device texture handles and image decoding, without D3D headers
 //
 
 #pragma once
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
-#include <utility>
-#include <vector>
-//#include <wrl/client.h>
-#include "stdafx.h"
-
-//using Microsoft::WRL::ComPtr;
+// Defined by D3D11.h; only a pointer is held here
+struct ID3D11ShaderResourceView;
 
 struct Texture
 {
@@ -25,27 +21,45 @@ struct Texture
 	operator bool() { return (bool)texture_SRV && width && height; }
 };
 
-/// <summary>
-/// Load a texture from file.
-/// </summary>
-HRESULT LoadTextureFromFile(
-	ID3D11Device* dxdevice,
-	const char* filename,
-	Texture* texture_out);
-
-/// <summary>
-/// Load a texture from file. A mip map is generated if 
-/// dxdevice_context is not null and valid.
-/// </summary>
-HRESULT LoadTextureFromFile(
-	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context,
-	const char* filename,
-	Texture* texture_out);
-
-HRESULT LoadCubeTextureFromFile(
-	ID3D11Device* dxdevice,
-	const char** filenames,
-	Texture* texture_out);
-
-#endif
\ No newline at end of file
+//
+// An image decoded to 8-bit RGBA (stb_image), flipped so that the first
+// row is the bottom one, as textures are sampled. Move-only.
+//
+class Image
+{
+	int width = 0;
+	int height = 0;
+	unsigned char* pixels = nullptr;
+
+public:
+	Image() = default;
+
+	Image(const Image&) = delete;
+
+	Image& operator=(const Image&) = delete;
+
+	Image(Image&& other);
+
+	Image& operator=(Image&& other);
+
+	~Image();
+
+	//
+	// Decode an image file, replacing the current image.
+	// Returns false, and leaves the image empty, on failure.
+	//
+	bool Load(const char* filename);
+
+	void Clear();
+
+	int GetWidth() const { return width; }
+
+	int GetHeight() const { return height; }
+
+	// width * height * 4 bytes, row by row
+	const unsigned char* GetPixels() const { return pixels; }
+
+	bool IsEmpty() const { return pixels == nullptr; }
+};
+
+#endif
@@ -0,0 +1,37 @@
+//
+// Texture loaders
+// Adapted from:
+// https://github-wiki-see.page/m/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples
+//
+
+#pragma once
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include "stdafx.h"
+#include "Texture.h"
+
+/// <summary>
+/// Load a texture from file.
+/// </summary>
+HRESULT LoadTextureFromFile(
+	ID3D11Device* dxdevice,
+	const char* filename,
+	Texture* texture_out);
+
+/// <summary>
+/// Load a texture from file. A mip map is generated if 
+/// dxdevice_context is not null and valid.
+/// </summary>
+HRESULT LoadTextureFromFile(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context,
+	const char* filename,
+	Texture* texture_out);
+
+HRESULT LoadCubeTextureFromFile(
+	ID3D11Device* dxdevice,
+	const char** filenames,
+	Texture* texture_out);
+
+#endif
\ No newline at end of file
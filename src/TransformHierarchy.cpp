@@ -0,0 +1,129 @@
+//
+//  TransformHierarchy.cpp
+//
+//	Scene graph of transforms with incremental world-matrix updates
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include "TransformHierarchy.h"
+
+unsigned TransformHierarchy::AddNode(unsigned parent)
+{
+	const unsigned node = (unsigned)parents.size();
+	if (parent != InvalidIndex && parent >= node)
+		throw std::runtime_error("TransformHierarchy: parent must precede its children");
+
+	parents.push_back(parent);
+	positions.push_back(vec3f_zero);
+	rotations.push_back(quatf_identity);
+	scales.push_back(vec3f(1, 1, 1));
+	world_matrices.push_back(mat4f_identity);
+	dirty.push_back(0);
+	updated.push_back(0);
+	MarkDirty(node);
+	return node;
+}
+
+void TransformHierarchy::MarkDirty(unsigned node)
+{
+	dirty[node] = 1;
+	if (!any_dirty || node < first_dirty)
+		first_dirty = node;
+	any_dirty = true;
+}
+
+void TransformHierarchy::SetParent(unsigned node, unsigned parent)
+{
+	if (parent != InvalidIndex && parent >= node)
+		throw std::runtime_error("TransformHierarchy: parent must precede its children");
+	parents[node] = parent;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetPosition(unsigned node, const vec3f& position)
+{
+	positions[node] = position;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetRotation(unsigned node, const quatf& rotation)
+{
+	rotations[node] = rotation;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetScale(unsigned node, const vec3f& scale)
+{
+	scales[node] = scale;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::SetLocal(unsigned node, const vec3f& position, const quatf& rotation, const vec3f& scale)
+{
+	positions[node] = position;
+	rotations[node] = rotation;
+	scales[node] = scale;
+	MarkDirty(node);
+}
+
+void TransformHierarchy::ToParentSpace(const quatf& parent_rotation, float parent_scale, vec3f& position, vec3f& scale)
+{
+	const float inv_scale = 1.0f / parent_scale;
+	position = parent_rotation.conjugate().rotate(position) * inv_scale;
+	scale = scale * inv_scale;
+}
+
+unsigned TransformHierarchy::Update()
+{
+	const size_t n = parents.size();
+	const size_t begin = any_dirty ? first_dirty : n;
+
+	// Flags before the sweep are not revisited: clear those set by the previous update
+	if (last_sweep_begin < begin)
+		std::fill(updated.begin() + last_sweep_begin, updated.begin() + begin, 0);
+	last_sweep_begin = begin;
+
+	// Parents precede children, so a parent's flag is final when its children are visited
+	unsigned nbr_updated = 0;
+	for (size_t i = begin; i < n; i++)
+	{
+		const unsigned parent = parents[i];
+		const bool changed = dirty[i] || (parent != InvalidIndex && updated[parent]);
+		updated[i] = changed ? 1 : 0;
+		if (!changed)
+			continue;
+
+		const mat4f local = TRS(positions[i], rotations[i], scales[i]);
+		world_matrices[i] = parent == InvalidIndex ? local : world_matrices[parent] * local;
+		dirty[i] = 0;
+		nbr_updated++;
+	}
+
+	any_dirty = false;
+	return nbr_updated;
+}
+
+void TransformHierarchy::Reserve(size_t n)
+{
+	parents.reserve(n);
+	positions.reserve(n);
+	rotations.reserve(n);
+	scales.reserve(n);
+	world_matrices.reserve(n);
+	dirty.reserve(n);
+	updated.reserve(n);
+}
+
+void TransformHierarchy::Clear()
+{
+	parents.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	world_matrices.clear();
+	dirty.clear();
+	updated.clear();
+	first_dirty = last_sweep_begin = 0;
+	any_dirty = false;
+}
@@ -0,0 +1,105 @@
+//
+//  TransformHierarchy.h
+//
+//	Scene graph of transforms with incremental world-matrix updates
+//
+
+#pragma once
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+#include <vector>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
+#include "MemoryTracker.h"
+
+using namespace linalg;
+
+//
+// Transform hierarchy stored as flat arrays indexed by node. Parents always
+// precede their children (a node's parent is given when it is added), so the
+// world matrices can be updated in a single forward sweep.
+//
+// Local transforms are translation, rotation and scale, composed as T*R*S.
+// Setting a local transform marks the node dirty; Update() recomputes the
+// world matrices of dirty nodes and their descendants only.
+//
+class TransformHierarchy
+{
+public:
+	static const unsigned InvalidIndex = ~0u;
+
+	//
+	// Add a node with an identity local transform. The parent must already
+	// exist; InvalidIndex makes the node a root. Returns the node index.
+	//
+	unsigned AddNode(unsigned parent = InvalidIndex);
+
+	//
+	// Attach a node to another parent, which must precede it
+	//
+	void SetParent(unsigned node, unsigned parent);
+
+	void SetPosition(unsigned node, const vec3f& position);
+	void SetRotation(unsigned node, const quatf& rotation);
+	void SetScale(unsigned node, const vec3f& scale);
+	void SetLocal(unsigned node, const vec3f& position, const quatf& rotation, const vec3f& scale);
+
+	//
+	// Turn a child's offset from its parent's origin and its scale, both given
+	// in world axes and units, into a local position and scale. Undoes the
+	// parent's world rotation and uniform world scale, so the child neither
+	// turns its offset with the parent nor inherits the parent's scale.
+	//
+	static void ToParentSpace(const quatf& parent_rotation, float parent_scale, vec3f& position, vec3f& scale);
+
+	const vec3f& GetPosition(unsigned node) const { return positions[node]; }
+	const quatf& GetRotation(unsigned node) const { return rotations[node]; }
+	const vec3f& GetScale(unsigned node) const { return scales[node]; }
+	unsigned GetParent(unsigned node) const { return parents[node]; }
+
+	//
+	// World matrix as of the last Update(). References stay valid until nodes are added.
+	//
+	const mat4f& GetWorldMatrix(unsigned node) const { return world_matrices[node]; }
+
+	const mat4f* GetWorldMatrices() const { return world_matrices.data(); }
+
+	//
+	// Recompute the world matrices of dirty subtrees.
+	// Returns the number of nodes that were recomputed.
+	//
+	unsigned Update();
+
+	//
+	// True if the world matrix of the node changed in the last Update()
+	//
+	bool WasUpdated(unsigned node) const { return updated[node] != 0; }
+
+	size_t Size() const { return parents.size(); }
+
+	void Reserve(size_t n);
+
+	void Clear();
+
+private:
+	TaggedVector<unsigned, MemoryTag::Scene> parents;
+	TaggedVector<vec3f, MemoryTag::Scene> positions;
+	TaggedVector<quatf, MemoryTag::Scene> rotations;
+	TaggedVector<vec3f, MemoryTag::Scene> scales;
+	TaggedVector<mat4f, MemoryTag::Scene> world_matrices;
+	TaggedVector<unsigned char, MemoryTag::Scene> dirty;	// Local transform changed since the last update
+	TaggedVector<unsigned char, MemoryTag::Scene> updated;	// World matrix changed in the last update
+
+	// Lowest dirty node: the update sweep starts here
+	size_t first_dirty = 0;
+	bool any_dirty = false;
+
+	// Start of the previous sweep; updated[] is only valid from here on
+	size_t last_sweep_begin = 0;
+
+	void MarkDirty(unsigned node);
+};
+
+#endif
@@ -0,0 +1,22 @@
+//
+//  Vertex.h
+//
+//	Vertex layout shared by models, loaders and mesh generators
+//
+
+#pragma once
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include "vec/vec.h"
+
+using namespace linalg;
+
+struct Vertex
+{
+	vec3f Pos;
+	vec3f Normal, Tangent, Binormal;
+	vec2f TexCoord;
+};
+
+#endif
@@ -9,9 +9,44 @@
 #ifndef parseutil_h
 #define parseutil_h
 
+#include <cstdio>
 #include <string>
 #include <vector>
 
+#ifndef _MSC_VER
+//
+// sscanf_s is MSVC-only. Elsewhere, calls without strings map to sscanf,
+// and calls scanning one string (%s or %[) into a sized buffer get the
+// size as field width, which is what sscanf_s checks.
+//
+template <class... Args>
+inline int sscanf_s(const char* buffer, const char* format, Args*... args)
+{
+    return std::sscanf(buffer, format, args...);
+}
+
+inline int sscanf_s(const char* buffer, const char* format, char* str, unsigned size)
+{
+    if (size == 0)
+        return 0;
+
+    std::string sized_format(format);
+    for (size_t i = 0; i + 1 < sized_format.size(); i++)
+    {
+        if (sized_format[i] != '%')
+            continue;
+        if (sized_format[i + 1] == '%')
+        {
+            i++;
+            continue;
+        }
+        sized_format.insert(i + 1, std::to_string(size - 1));
+        break;
+    }
+    return std::sscanf(buffer, sized_format.c_str(), str);
+}
+#endif
+
 inline std::string& rtrim(std::string& str)
 {
     str.erase(str.find_last_not_of(" \n\r\t")+1);
@@ -26,6 +26,7 @@ typedef struct shader_data
 	};
 	const SCHAR* file_path;
 	const char* entrypoint;
+	const shader_define* defines;
 	FILETIME last_write;
 } shader_data;
 
@@ -72,14 +73,42 @@ error:
 	return FALSE;
 }
 
-static ID3DBlob* compile_shader(SHADER_TYPE type, const char* pCode, uint32_t codeSize, const char* pEntrypoint)
+#define SHADER_COMPILE_FLAGS (D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_IEEE_STRICTNESS)
+
+/* The compiler DLL, named after D3D_COMPILER_VERSION: bytecode of another compiler version is not reused */
+#define SHADER_COMPILER D3DCOMPILER_DLL_A
+
+/*
+* Bytecode of the shader: from the shader cache if it was compiled from the same source, includes and settings
+* before, otherwise compiled and then cached. Includes are resolved relative to pPath.
+*/
+static ID3DBlob* compile_shader(SHADER_TYPE type, const char* pCode, uint32_t codeSize, const SCHAR* pPath, const char* pEntrypoint, const shader_define* pDefines)
 {
 	ID3DBlob* shader;
 	ID3DBlob* error;
+	const char* target = type == SHADER_VERTEX ? "vs_5_0" : "ps_5_0";
+
+#ifndef SHADER_USE_WIDECHAR
+	size_t cachedSize = 0;
+	void* cached = shader_cache_load(pPath, pCode, codeSize, pDefines, pEntrypoint, target, SHADER_COMPILE_FLAGS, SHADER_COMPILER, &cachedSize);
+	if (cached)
+	{
+		shader = NULL;
+		if (SUCCEEDED(D3DCreateBlob(cachedSize, &shader)))
+			memcpy(shader->lpVtbl->GetBufferPointer(shader), cached, cachedSize);
+		free(cached);
+		if (shader)
+			return shader;
+	}
+	const char* sourceName = pPath;
+#else
+	const char* sourceName = NULL;
+#endif
 
-	HRESULT hr = D3DCompile(pCode, codeSize, NULL, NULL, NULL, pEntrypoint,
-		type == SHADER_VERTEX ? "vs_5_0" : "ps_5_0",
-		D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_IEEE_STRICTNESS,
+	// shader_define has the layout of D3D_SHADER_MACRO
+	HRESULT hr = D3DCompile(pCode, codeSize, sourceName, (const D3D_SHADER_MACRO*)pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, pEntrypoint,
+		target,
+		SHADER_COMPILE_FLAGS,
 		0,
 		&shader,
 		&error
@@ -90,6 +119,11 @@ static ID3DBlob* compile_shader(SHADER_TYPE type, const char* pCode, uint32_t co
 		error->lpVtbl->Release(error);
 		return NULL;
 	}
+
+#ifndef SHADER_USE_WIDECHAR
+	shader_cache_store(pPath, pCode, codeSize, pDefines, pEntrypoint, target, SHADER_COMPILE_FLAGS, SHADER_COMPILER,
+		shader->lpVtbl->GetBufferPointer(shader), shader->lpVtbl->GetBufferSize(shader));
+#endif
 	return shader;
 }
 
@@ -106,6 +140,11 @@ static inline BOOL create_vertex_Shader(ID3D11Device* pDevice, ID3DBlob* pCode,
 }
 
 SHADER_RESULT create_shader(ID3D11Device* pDevice, const SCHAR* pPath, const char* pEntrypoint, SHADER_TYPE type, const D3D11_INPUT_ELEMENT_DESC* pLayout, uint32_t layoutcount, shader_data** pShader)
+{
+	return create_shader_with_defines(pDevice, pPath, pEntrypoint, type, NULL, pLayout, layoutcount, pShader);
+}
+
+SHADER_RESULT create_shader_with_defines(ID3D11Device* pDevice, const SCHAR* pPath, const char* pEntrypoint, SHADER_TYPE type, const shader_define* pDefines, const D3D11_INPUT_ELEMENT_DESC* pLayout, uint32_t layoutcount, shader_data** pShader)
 {
 	SHADER_RESULT result = { 0 };
 	FILETIME lastWrite = { 0 };
@@ -126,7 +165,7 @@ SHADER_RESULT create_shader(ID3D11Device* pDevice, const SCHAR* pPath, const cha
 		goto error;
 	}
 
-	ID3DBlob* shaderByteCode = compile_shader(type, codeBuffer, fileSize, pEntrypoint);
+	ID3DBlob* shaderByteCode = compile_shader(type, codeBuffer, fileSize, pPath, pEntrypoint, pDefines);
 
 	free(codeBuffer);
 
@@ -155,6 +194,7 @@ SHADER_RESULT create_shader(ID3D11Device* pDevice, const SCHAR* pPath, const cha
 	memcpy((char*)data->entrypoint, pEntrypoint, entrypointSize);
 
 	data->type = type;
+	data->defines = pDefines;
 	data->last_write = lastWrite;
 
 	switch (type)
@@ -249,7 +289,7 @@ void bind_shader(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, sha
 			{
 				if (fileSize > 0)
 				{
-					ID3DBlob* shaderByteCode = compile_shader(pShader->type, codeBuffer, fileSize, pShader->entrypoint);
+					ID3DBlob* shaderByteCode = compile_shader(pShader->type, codeBuffer, fileSize, pShader->file_path, pShader->entrypoint, pShader->defines);
 
 					if (shaderByteCode != NULL)
 					{
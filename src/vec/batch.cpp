@@ -0,0 +1,242 @@
+
+//
+// Batch transforms: arrays of points/vectors by one matrix
+//
+// All kernels sum the terms in the same order as mat4::operator*(vec4),
+// so results are identical to transforming the elements one at a time,
+// provided the compiler does not contract a*b + c into FMAs (the CMake
+// build passes -ffp-contract=off; MSVC only contracts with /fp:contract).
+//
+
+#include "batch.h"
+#include "simd.h"
+
+namespace linalg
+{
+    namespace
+    {
+        inline const vec3f& at(const vec3f* base, size_t stride, size_t i)
+        {
+            return *(const vec3f*)((const unsigned char*)base + i*stride);
+        }
+
+        inline vec3f& at(vec3f* base, size_t stride, size_t i)
+        {
+            return *(vec3f*)((unsigned char*)base + i*stride);
+        }
+
+#ifdef LINALG_SSE
+        struct sse_cols
+        {
+            __m128 c0, c1, c2, c3;
+
+            sse_cols(const mat4f& M) :
+                c0(_mm_loadu_ps(M.col[0].vec)),
+                c1(_mm_loadu_ps(M.col[1].vec)),
+                c2(_mm_loadu_ps(M.col[2].vec)),
+                c3(_mm_loadu_ps(M.col[3].vec))
+            { }
+        };
+
+        //
+        // load/store x,y,z without touching the memory after z
+        //
+        inline __m128 load3(const vec3f& v)
+        {
+            const __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&v.x);
+            return _mm_movelh_ps(xy, _mm_load_ss(&v.z));
+        }
+
+        inline void store3(vec3f& v, __m128 r)
+        {
+            _mm_storel_pi((__m64*)&v.x, r);
+            _mm_store_ss(&v.z, _mm_movehl_ps(r, r));
+        }
+
+        inline __m128 xform_vector(const sse_cols& m, __m128 v)
+        {
+            __m128 r = _mm_mul_ps(m.c0, LINALG_SPLAT(v, 0));
+            r = _mm_add_ps(r, _mm_mul_ps(m.c1, LINALG_SPLAT(v, 1)));
+            return _mm_add_ps(r, _mm_mul_ps(m.c2, LINALG_SPLAT(v, 2)));
+        }
+
+        inline __m128 xform_point(const sse_cols& m, __m128 v)
+        {
+            return _mm_add_ps(xform_vector(m, v), m.c3);
+        }
+#endif
+
+#ifdef LINALG_AVX2
+        //
+        // Two elements per register: each 128-bit half holds one element,
+        // and in-lane permutes broadcast its components
+        //
+        struct avx_cols
+        {
+            __m256 c0, c1, c2, c3;
+
+            avx_cols(const mat4f& M) :
+                c0(_mm256_broadcast_ps((const __m128*)M.col[0].vec)),
+                c1(_mm256_broadcast_ps((const __m128*)M.col[1].vec)),
+                c2(_mm256_broadcast_ps((const __m128*)M.col[2].vec)),
+                c3(_mm256_broadcast_ps((const __m128*)M.col[3].vec))
+            { }
+        };
+
+        inline __m256 xform_vector2(const avx_cols& m, __m256 v)
+        {
+            __m256 r = _mm256_mul_ps(m.c0, _mm256_permute_ps(v, 0x00));
+            r = _mm256_add_ps(r, _mm256_mul_ps(m.c1, _mm256_permute_ps(v, 0x55)));
+            return _mm256_add_ps(r, _mm256_mul_ps(m.c2, _mm256_permute_ps(v, 0xAA)));
+        }
+
+        inline __m256 xform_point2(const avx_cols& m, __m256 v)
+        {
+            return _mm256_add_ps(xform_vector2(m, v), m.c3);
+        }
+
+        //
+        // Two packed vec3 starting at p. Reads one float past the second
+        // element, so the caller must ensure a third element follows.
+        //
+        inline __m256 load3x2(const float* p)
+        {
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 3), 1);
+        }
+#endif
+
+        //
+        // Strided kernels, used directly and for the tails of the packed ones
+        //
+        template<bool is_point>
+        void transform3_strided(const mat4f& M, const vec3f* in, size_t in_stride, vec3f* out, size_t out_stride, size_t begin, size_t n)
+        {
+#ifdef LINALG_SSE
+            const sse_cols m(M);
+            for (size_t i = begin; i < n; i++)
+            {
+                const __m128 v = load3(at(in, in_stride, i));
+                store3(at(out, out_stride, i), is_point ? xform_point(m, v) : xform_vector(m, v));
+            }
+#else
+            for (size_t i = begin; i < n; i++)
+                at(out, out_stride, i) = (M * vec4f(at(in, in_stride, i), is_point ? 1.0f : 0.0f)).xyz();
+#endif
+        }
+
+        template<bool is_point>
+        void transform3(const mat4f& M, const vec3f* in, vec3f* out, size_t n)
+        {
+            size_t i = 0;
+#ifdef LINALG_AVX2
+            const avx_cols m(M);
+            for (; i + 3 <= n; i += 2)
+            {
+                const __m256 v = load3x2(&in[i].x);
+                const __m256 r = is_point ? xform_point2(m, v) : xform_vector2(m, v);
+                store3(out[i], _mm256_castps256_ps128(r));
+                store3(out[i + 1], _mm256_extractf128_ps(r, 1));
+            }
+#endif
+            transform3_strided<is_point>(M, in, sizeof(vec3f), out, sizeof(vec3f), i, n);
+        }
+    }
+
+    void transform_points(const mat4f& M, const vec3f* in, vec3f* out, size_t n)
+    {
+        transform3<true>(M, in, out, n);
+    }
+
+    void transform_vectors(const mat4f& M, const vec3f* in, vec3f* out, size_t n)
+    {
+        transform3<false>(M, in, out, n);
+    }
+
+    void transform_points(const mat4f& M, const vec3f* in, size_t in_stride, vec3f* out, size_t out_stride, size_t n)
+    {
+        transform3_strided<true>(M, in, in_stride, out, out_stride, 0, n);
+    }
+
+    void transform_vectors(const mat4f& M, const vec3f* in, size_t in_stride, vec3f* out, size_t out_stride, size_t n)
+    {
+        transform3_strided<false>(M, in, in_stride, out, out_stride, 0, n);
+    }
+
+    void transform(const mat4f& M, const vec4f* in, vec4f* out, size_t n)
+    {
+        size_t i = 0;
+#ifdef LINALG_AVX2
+        const avx_cols m(M);
+        for (; i + 2 <= n; i += 2)
+        {
+            const __m256 v = _mm256_loadu_ps(in[i].vec);
+            const __m256 r = _mm256_add_ps(xform_vector2(m, v), _mm256_mul_ps(m.c3, _mm256_permute_ps(v, 0xFF)));
+            _mm256_storeu_ps(out[i].vec, r);
+        }
+#endif
+        for (; i < n; i++)
+            out[i] = M * in[i];
+    }
+
+    void transform_points(const mat4f& M, const vec3f* in, vec4f* out, size_t n)
+    {
+        size_t i = 0;
+#ifdef LINALG_AVX2
+        const avx_cols m(M);
+        for (; i + 3 <= n; i += 2)
+            _mm256_storeu_ps(out[i].vec, xform_point2(m, load3x2(&in[i].x)));
+#endif
+#ifdef LINALG_SSE
+        const sse_cols ms(M);
+        for (; i < n; i++)
+            _mm_storeu_ps(out[i].vec, xform_point(ms, load3(in[i])));
+#else
+        for (; i < n; i++)
+            out[i] = M * in[i].xyz1();
+#endif
+    }
+
+    void transform_points(const mat4f& M,
+                          const float* x, const float* y, const float* z,
+                          float* out_x, float* out_y, float* out_z, size_t n)
+    {
+        size_t i = 0;
+#if defined(LINALG_AVX2)
+        const __m256 m11 = _mm256_set1_ps(M.m11), m12 = _mm256_set1_ps(M.m12), m13 = _mm256_set1_ps(M.m13), m14 = _mm256_set1_ps(M.m14);
+        const __m256 m21 = _mm256_set1_ps(M.m21), m22 = _mm256_set1_ps(M.m22), m23 = _mm256_set1_ps(M.m23), m24 = _mm256_set1_ps(M.m24);
+        const __m256 m31 = _mm256_set1_ps(M.m31), m32 = _mm256_set1_ps(M.m32), m33 = _mm256_set1_ps(M.m33), m34 = _mm256_set1_ps(M.m34);
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+            const __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m11, vx), _mm256_mul_ps(m12, vy)), _mm256_mul_ps(m13, vz)), m14);
+            const __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m21, vx), _mm256_mul_ps(m22, vy)), _mm256_mul_ps(m23, vz)), m24);
+            const __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m31, vx), _mm256_mul_ps(m32, vy)), _mm256_mul_ps(m33, vz)), m34);
+            _mm256_storeu_ps(out_x + i, rx);
+            _mm256_storeu_ps(out_y + i, ry);
+            _mm256_storeu_ps(out_z + i, rz);
+        }
+#endif
+#ifdef LINALG_SSE
+        const __m128 s11 = _mm_set1_ps(M.m11), s12 = _mm_set1_ps(M.m12), s13 = _mm_set1_ps(M.m13), s14 = _mm_set1_ps(M.m14);
+        const __m128 s21 = _mm_set1_ps(M.m21), s22 = _mm_set1_ps(M.m22), s23 = _mm_set1_ps(M.m23), s24 = _mm_set1_ps(M.m24);
+        const __m128 s31 = _mm_set1_ps(M.m31), s32 = _mm_set1_ps(M.m32), s33 = _mm_set1_ps(M.m33), s34 = _mm_set1_ps(M.m34);
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+            const __m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s11, vx), _mm_mul_ps(s12, vy)), _mm_mul_ps(s13, vz)), s14);
+            const __m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s21, vx), _mm_mul_ps(s22, vy)), _mm_mul_ps(s23, vz)), s24);
+            const __m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s31, vx), _mm_mul_ps(s32, vy)), _mm_mul_ps(s33, vz)), s34);
+            _mm_storeu_ps(out_x + i, rx);
+            _mm_storeu_ps(out_y + i, ry);
+            _mm_storeu_ps(out_z + i, rz);
+        }
+#endif
+        for (; i < n; i++)
+        {
+            const float px = x[i], py = y[i], pz = z[i];
+            out_x[i] = M.m11*px + M.m12*py + M.m13*pz + M.m14;
+            out_y[i] = M.m21*px + M.m22*py + M.m23*pz + M.m24;
+            out_z[i] = M.m31*px + M.m32*py + M.m33*pz + M.m34;
+        }
+    }
+}
@@ -0,0 +1,50 @@
+
+//
+// Batch transforms: arrays of points/vectors by one matrix
+//
+
+#pragma once
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+    //
+    // AoS: contiguous arrays
+    //
+    // Points are transformed with w = 1 and vectors (directions, normals) with w = 0.
+    // The vec3 variants drop the resulting w, i.e. they assume an affine matrix.
+    // out may be the same array as in.
+    //
+    void transform_points(const mat4f& M, const vec3f* in, vec3f* out, size_t n);
+
+    void transform_vectors(const mat4f& M, const vec3f* in, vec3f* out, size_t n);
+
+    void transform(const mat4f& M, const vec4f* in, vec4f* out, size_t n);
+
+    //
+    // points to homogeneous coordinates, e.g. to clip space
+    //
+    void transform_points(const mat4f& M, const vec3f* in, vec4f* out, size_t n);
+
+    //
+    // Strided: elements are read and written with a byte stride, e.g.
+    // the positions of a Vertex array (&vertices[0].Pos, sizeof(Vertex))
+    //
+    void transform_points(const mat4f& M, const vec3f* in, size_t in_stride, vec3f* out, size_t out_stride, size_t n);
+
+    void transform_vectors(const mat4f& M, const vec3f* in, size_t in_stride, vec3f* out, size_t out_stride, size_t n);
+
+    //
+    // SoA: separate x, y and z arrays
+    //
+    void transform_points(const mat4f& M,
+                          const float* x, const float* y, const float* z,
+                          float* out_x, float* out_y, float* out_z, size_t n);
+}
+
+#endif /* BATCH_H */
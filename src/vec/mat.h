@@ -105,40 +105,36 @@ namespace linalg
 		//
 		// row-major per-element constructor
 		//
-		mat3(const T& _m11, const T& _m12, const T& _m13,
+		constexpr mat3(const T& _m11, const T& _m12, const T& _m13,
 			const T& _m21, const T& _m22, const T& _m23,
-			const T& _m31, const T& _m32, const T& _m33)
-		{
-			m11 = _m11; m12 = _m12; m13 = _m13;
-			m21 = _m21; m22 = _m22; m23 = _m23;
-			m31 = _m31; m32 = _m32; m33 = _m33;
-		}
+			const T& _m31, const T& _m32, const T& _m33) :
+			m11(_m11), m21(_m21), m31(_m31),
+			m12(_m12), m22(_m22), m32(_m32),
+			m13(_m13), m23(_m23), m33(_m33)
+		{ }
         
 		//
         // constructor: equal diagonal elements
         //
-        mat3(const T& d) : mat3(d,d,d) { }
+        constexpr mat3(const T& d) : mat3(d,d,d) { }
         
 		//
         // constructor: diagonal elements (scaling matrix)
         //
-        mat3(const T& d0, const T& d1, const T& d2)
-        {
-            m11 = d0;
-            m22 = d1;
-            m33 = d2;
-            m12 = m13 = m21 = m23 = m31 = m32 = 0.0;
-        }
+        constexpr mat3(const T& d0, const T& d1, const T& d2) :
+            mat3(d0, 0, 0,
+                 0, d1, 0,
+                 0, 0, d2)
+        { }
         
         //
         // from basis vectors
         //
-        mat3(const vec3<T>& e0, const vec3<T>& e1, const vec3<T>& e2)
-        {
-            col[0] = e0;
-            col[1] = e1;
-            col[2] = e2;
-        }
+        constexpr mat3(const vec3<T>& e0, const vec3<T>& e1, const vec3<T>& e2) :
+            mat3(e0.x, e1.x, e2.x,
+                 e0.y, e1.y, e2.y,
+                 e0.z, e1.z, e2.z)
+        { }
         
         vec3<T> column(int i)
         {
@@ -211,7 +207,7 @@ namespace linalg
             col[2] = m.col[2];
         }
         
-        T determinant() const
+        constexpr T determinant() const
         {
             return m11*m22*m33 + m12*m23*m31 + m13*m21*m32 - m11*m23*m32 - m12*m21*m33 - m13*m22*m31;
         }
@@ -221,21 +217,21 @@ namespace linalg
         //
         void normalize();
         
-        mat3<T> operator * (const T& s) const
+        constexpr mat3<T> operator * (const T& s) const
         {
             return mat3<T>(m11*s, m12*s, m13*s,
                            m21*s, m22*s, m23*s,
                            m31*s, m32*s, m33*s);
         }
         
-        mat3<T> operator +(const mat3<T>& m) const
+        constexpr mat3<T> operator +(const mat3<T>& m) const
         {
             return mat3<T>(m11+m.m11, m12+m.m12, m13+m.m13,
                            m21+m.m21, m22+m.m22, m23+m.m23,
                            m31+m.m31, m32+m.m32, m33+m.m33);
         }
         
-        mat3<T> operator -(const mat3<T>& m) const
+        constexpr mat3<T> operator -(const mat3<T>& m) const
         {
             return mat3(m11-m.m11, m12-m.m12, m13-m.m13,
                         m21-m.m21, m22-m.m22, m23-m.m23,
@@ -260,7 +256,7 @@ namespace linalg
             return *this;
         }
         
-        mat3<T> operator *(const mat3<T>& m) const
+        constexpr mat3<T> operator *(const mat3<T>& m) const
         {
             return mat3<T>(m11*m.m11+m12*m.m21+m13*m.m31, m11*m.m12+m12*m.m22+m13*m.m32, m11*m.m13+m12*m.m23+m13*m.m33,
                            m21*m.m11+m22*m.m21+m23*m.m31, m21*m.m12+m22*m.m22+m23*m.m32, m21*m.m13+m22*m.m23+m23*m.m33,
@@ -314,21 +310,19 @@ namespace linalg
 
         constexpr mat4(T d) : mat4(d, d, d, d) { }
 
-        constexpr mat4(const T& d0, const T& d1, const T& d2, const T& d3)
-        {
-            m11 = d0;  m12 = 0.0; m13 = 0.0; m14 = 0.0;
-            m21 = 0.0; m22 = d1;  m23 = 0.0; m24 = 0.0;
-            m31 = 0.0; m32 = 0.0; m33 = d2;  m34 = 0.0;
-            m41 = 0.0; m42 = 0.0; m43 = 0.0; m44 = d3;
-        }
+        constexpr mat4(const T& d0, const T& d1, const T& d2, const T& d3) :
+            mat4(d0, 0,  0,  0,
+                 0,  d1, 0,  0,
+                 0,  0,  d2, 0,
+                 0,  0,  0,  d3)
+        { }
 
-        constexpr mat4(const mat3<T>& m)
-        {
-            m11 = m.m11; m12 = m.m12; m13 = m.m13; m14 = 0.0;
-            m21 = m.m21; m22 = m.m22; m23 = m.m23; m24 = 0.0;
-            m31 = m.m31; m32 = m.m32; m33 = m.m33; m34 = 0.0;
-            m41 = 0.0;   m42 = 0.0;   m43 = 0.0;   m44 = 1.0;
-        }
+        constexpr mat4(const mat3<T>& m) :
+            mat4(m.m11, m.m12, m.m13, 0,
+                 m.m21, m.m22, m.m23, 0,
+                 m.m31, m.m32, m.m33, 0,
+                 0,     0,     0,     1)
+        { }
 
         /**
          * row-major per-element constructor
@@ -336,18 +330,17 @@ namespace linalg
         constexpr mat4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
             const T& _m21, const T& _m22, const T& _m23, const T& _m24,
             const T& _m31, const T& _m32, const T& _m33, const T& _m34,
-            const T& _m41, const T& _m42, const T& _m43, const T& _m44)
-        {
-            m11 = _m11; m12 = _m12; m13 = _m13; m14 = _m14;
-            m21 = _m21; m22 = _m22; m23 = _m23; m24 = _m24;
-            m31 = _m31; m32 = _m32; m33 = _m33; m34 = _m34;
-            m41 = _m41; m42 = _m42; m43 = _m43; m44 = _m44;
-        }
+            const T& _m41, const T& _m42, const T& _m43, const T& _m44) :
+            m11(_m11), m21(_m21), m31(_m31), m41(_m41),
+            m12(_m12), m22(_m22), m32(_m32), m42(_m42),
+            m13(_m13), m23(_m23), m33(_m33), m43(_m43),
+            m14(_m14), m24(_m24), m34(_m34), m44(_m44)
+        { }
         
 		//
 		// get the upper-left submatrix
 		//
-        mat3<T> get_3x3() const
+        constexpr mat3<T> get_3x3() const
         {
             return mat3<T>(m11, m12, m13, m21, m22, m23, m31, m32, m33);
         }
@@ -387,7 +380,47 @@ namespace linalg
             
             return M*idet;
         }
-        
+
+		//
+		// inverse of an affine matrix [A t; 0 1] = [A^(-1) -A^(-1)*t; 0 1]
+		//
+		// much cheaper than inverse(); the last row is assumed to be (0,0,0,1)
+		//
+        mat4<T> affine_inverse() const
+        {
+            // rows of A^(-1) are cross products of the columns of A, over det(A)
+            const vec3<T> c0 = col[0].xyz(), c1 = col[1].xyz(), c2 = col[2].xyz(), t = col[3].xyz();
+            const vec3<T> r0 = c1 % c2, r1 = c2 % c0, r2 = c0 % c1;
+            T det = dot(c0, r0);
+            assert(abs(det) > 1e-8);
+            T idet = 1.0/det;
+
+            return mat4<T>(r0.x*idet, r0.y*idet, r0.z*idet, -dot(r0, t)*idet,
+                           r1.x*idet, r1.y*idet, r1.z*idet, -dot(r1, t)*idet,
+                           r2.x*idet, r2.y*idet, r2.z*idet, -dot(r2, t)*idet,
+                           0.0,       0.0,       0.0,       1.0);
+        }
+
+		//
+		// normal matrix: inverse-transpose of the upper-left 3x3 submatrix,
+		// which keeps normals perpendicular to surfaces under non-uniform scaling.
+		// Returned as a 4x4 with no translation, e.g. for a constant buffer.
+		//
+        mat4<T> normal_matrix() const
+        {
+            // (A^(-1))^T has the cross products as columns
+            const vec3<T> c0 = col[0].xyz(), c1 = col[1].xyz(), c2 = col[2].xyz();
+            const vec3<T> r0 = c1 % c2, r1 = c2 % c0, r2 = c0 % c1;
+            T det = dot(c0, r0);
+            assert(abs(det) > 1e-8);
+            T idet = 1.0/det;
+
+            return mat4<T>(r0.x*idet, r1.x*idet, r2.x*idet, 0.0,
+                           r0.y*idet, r1.y*idet, r2.y*idet, 0.0,
+                           r0.z*idet, r1.z*idet, r2.z*idet, 0.0,
+                           0.0,       0.0,       0.0,       1.0);
+        }
+
         T determinant() const
         {
             return
@@ -423,7 +456,7 @@ namespace linalg
             return array[i];
         }
         
-        mat4<T> operator *(const T& s) const
+        constexpr mat4<T> operator *(const T& s) const
         {
             return mat4<T>(m11*s, m12*s, m13*s, m14*s,
                            m21*s, m22*s, m23*s, m24*s,
@@ -452,7 +485,7 @@ namespace linalg
             return n;
         }
         
-        mat4<T> operator *(const mat4<T>& m) const
+        constexpr mat4<T> operator *(const mat4<T>& m) const
         {
             return mat4<T>(m11 * m.m11 + m12 * m.m21 + m13 * m.m31 + m14 * m.m41,
                            m11 * m.m12 + m12 * m.m22 + m13 * m.m32 + m14 * m.m42,
@@ -475,37 +508,43 @@ namespace linalg
                            m41 * m.m14 + m42 * m.m24 + m43 * m.m34 + m44 * m.m44);
         }
         
-        vec4<T> operator *(const vec4<T> &v) const;
+        //
+        // summed column by column: col[0]*v.x + col[1]*v.y + col[2]*v.z + col[3]*v.w
+        //
+        constexpr vec4<T> operator *(const vec4<T> &v) const
+        {
+            return vec4<T>(m11*v.x + m12*v.y + m13*v.z + m14*v.w,
+                           m21*v.x + m22*v.y + m23*v.z + m24*v.w,
+                           m31*v.x + m32*v.y + m33*v.z + m34*v.w,
+                           m41*v.x + m42*v.y + m43*v.z + m44*v.w);
+        }
         
-        static mat4<T> translation(const vec3<T>& p)
+        static constexpr mat4<T> translation(const vec3<T>& p)
         {
             return translation(p.x, p.y, p.z);
         }
         
-        static mat4<T> translation(const T& x, const T& y, const T& z)
+        static constexpr mat4<T> translation(const T& x, const T& y, const T& z)
         {
-            mat4<T> M;
-            M.m11 = 1.0; M.m12 = 0.0; M.m13 = 0; M.m14 = x;
-            M.m21 = 0.0; M.m22 = 1.0; M.m23 = 0; M.m24 = y;
-            M.m31 = 0.0; M.m32 = 0.0; M.m33 = 1; M.m34 = z;
-            M.m41 = 0.0; M.m42 = 0.0; M.m43 = 0; M.m44 = 1.0;
-            
-            return M;
+            return mat4<T>(1, 0, 0, x,
+                           0, 1, 0, y,
+                           0, 0, 1, z,
+                           0, 0, 0, 1);
         }
         
-        static mat4<T> scaling(const T& s)
+        static constexpr mat4<T> scaling(const T& s)
         {
-            return scaling({s,s,s});
+            return scaling(s, s, s);
         }
         
-        static mat4<T> scaling(float sx, float sy, float sz)
+        static constexpr mat4<T> scaling(const T& sx, const T& sy, const T& sz)
         {
-            return mat4<T>(sx, sy, sz, 1.0);
+            return mat4<T>(sx, sy, sz, 1);
         }
         
-        static mat4<T> scaling(const vec3<T> &sv)
+        static constexpr mat4<T> scaling(const vec3<T> &sv)
         {
-            return mat4<T>(sv.x, sv.y, sv.z, 1.0);
+            return mat4<T>(sv.x, sv.y, sv.z, 1);
         }
         
         static mat4<T> rotation(const T& theta, const vec3<T> &v)
@@ -651,6 +690,197 @@ namespace linalg
         return out;
     }
 
+#ifdef LINALG_SSE
+    //
+    // SSE specializations for mat4<float>
+    //
+    // Products are summed in the same order as the scalar templates, so the
+    // results are identical. The products take the scalar path in constant
+    // expressions, where intrinsics cannot be evaluated. Columns are loaded unaligned: mat4f is passed by
+    // value in places, which rules out alignas(16) on 32-bit MSVC (C2719),
+    // and unaligned loads of aligned data are as fast on current CPUs.
+    //
+    template<>
+    inline LINALG_SIMD_CONSTEXPR vec4<float> mat4<float>::operator *(const vec4<float>& v) const
+    {
+        if (LINALG_IS_CONSTANT_EVALUATED())
+        {
+            return vec4<float>(m11*v.x + m12*v.y + m13*v.z + m14*v.w,
+                               m21*v.x + m22*v.y + m23*v.z + m24*v.w,
+                               m31*v.x + m32*v.y + m33*v.z + m34*v.w,
+                               m41*v.x + m42*v.y + m43*v.z + m44*v.w);
+        }
+
+        vec4<float> r;
+        _mm_storeu_ps(r.vec, simd_combine(
+            _mm_loadu_ps(col[0].vec),
+            _mm_loadu_ps(col[1].vec),
+            _mm_loadu_ps(col[2].vec),
+            _mm_loadu_ps(col[3].vec),
+            _mm_loadu_ps(v.vec)));
+        return r;
+    }
+
+    template<>
+    inline LINALG_SIMD_CONSTEXPR mat4<float> mat4<float>::operator *(const mat4<float>& m) const
+    {
+        if (LINALG_IS_CONSTANT_EVALUATED())
+        {
+            const vec4<float> r0 = *this * vec4<float>(m.m11, m.m21, m.m31, m.m41);
+            const vec4<float> r1 = *this * vec4<float>(m.m12, m.m22, m.m32, m.m42);
+            const vec4<float> r2 = *this * vec4<float>(m.m13, m.m23, m.m33, m.m43);
+            const vec4<float> r3 = *this * vec4<float>(m.m14, m.m24, m.m34, m.m44);
+            return mat4<float>(r0.x, r1.x, r2.x, r3.x,
+                               r0.y, r1.y, r2.y, r3.y,
+                               r0.z, r1.z, r2.z, r3.z,
+                               r0.w, r1.w, r2.w, r3.w);
+        }
+
+        const __m128 c0 = _mm_loadu_ps(col[0].vec);
+        const __m128 c1 = _mm_loadu_ps(col[1].vec);
+        const __m128 c2 = _mm_loadu_ps(col[2].vec);
+        const __m128 c3 = _mm_loadu_ps(col[3].vec);
+
+        mat4<float> r;
+        _mm_storeu_ps(r.col[0].vec, simd_combine(c0, c1, c2, c3, _mm_loadu_ps(m.col[0].vec)));
+        _mm_storeu_ps(r.col[1].vec, simd_combine(c0, c1, c2, c3, _mm_loadu_ps(m.col[1].vec)));
+        _mm_storeu_ps(r.col[2].vec, simd_combine(c0, c1, c2, c3, _mm_loadu_ps(m.col[2].vec)));
+        _mm_storeu_ps(r.col[3].vec, simd_combine(c0, c1, c2, c3, _mm_loadu_ps(m.col[3].vec)));
+        return r;
+    }
+
+    template<>
+    inline void mat4<float>::transpose()
+    {
+        __m128 c0 = _mm_loadu_ps(col[0].vec);
+        __m128 c1 = _mm_loadu_ps(col[1].vec);
+        __m128 c2 = _mm_loadu_ps(col[2].vec);
+        __m128 c3 = _mm_loadu_ps(col[3].vec);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(col[0].vec, c0);
+        _mm_storeu_ps(col[1].vec, c1);
+        _mm_storeu_ps(col[2].vec, c2);
+        _mm_storeu_ps(col[3].vec, c3);
+    }
+
+    //
+    // Block-wise inversion with 2x2 submatrices,
+    //
+    //  M = | A B |   M^(-1) = 1/det(M) * | X Y |
+    //      | C D |                       | Z W |
+    //
+    // The blocks are built from the columns, i.e. this inverts M^T, and the
+    // result written back by columns is the transpose of that: M^(-1).
+    //
+    template<>
+    inline mat4<float> mat4<float>::inverse() const
+    {
+        const __m128 c0 = _mm_loadu_ps(col[0].vec);
+        const __m128 c1 = _mm_loadu_ps(col[1].vec);
+        const __m128 c2 = _mm_loadu_ps(col[2].vec);
+        const __m128 c3 = _mm_loadu_ps(col[3].vec);
+
+        const __m128 A = _mm_movelh_ps(c0, c1);
+        const __m128 B = _mm_movehl_ps(c1, c0);
+        const __m128 C = _mm_movelh_ps(c2, c3);
+        const __m128 D = _mm_movehl_ps(c3, c2);
+
+        // (det(A), det(B), det(C), det(D))
+        const __m128 det_sub = _mm_sub_ps(
+            _mm_mul_ps(LINALG_SHUFFLE(c0, c2, 0, 2, 0, 2), LINALG_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+            _mm_mul_ps(LINALG_SHUFFLE(c0, c2, 1, 3, 1, 3), LINALG_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+        const __m128 detA = LINALG_SPLAT(det_sub, 0);
+        const __m128 detB = LINALG_SPLAT(det_sub, 1);
+        const __m128 detC = LINALG_SPLAT(det_sub, 2);
+        const __m128 detD = LINALG_SPLAT(det_sub, 3);
+
+        const __m128 D_C = simd_mat2_adj_mul(D, C);
+        const __m128 A_B = simd_mat2_adj_mul(A, B);
+
+        // adjugates of the blocks of the inverse
+        __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), simd_mat2_mul(B, D_C));
+        __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), simd_mat2_mul(C, A_B));
+        __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), simd_mat2_mul_adj(D, A_B));
+        __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), simd_mat2_mul_adj(A, D_C));
+
+        // det(M) = det(A)*det(D) + det(B)*det(C) - trace(adj(A)*B*adj(D)*C)
+        const __m128 tr = simd_hsum(_mm_mul_ps(A_B, LINALG_SWIZZLE(D_C, 0, 2, 1, 3)));
+        const __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+        assert(abs(_mm_cvtss_f32(det)) > 1e-8);
+
+        // 1/det with the signs of the 2x2 adjugate
+        const __m128 idet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+        X = _mm_mul_ps(X, idet);
+        Y = _mm_mul_ps(Y, idet);
+        Z = _mm_mul_ps(Z, idet);
+        W = _mm_mul_ps(W, idet);
+
+        // take the adjugates and rearrange the blocks into columns
+        mat4<float> r;
+        _mm_storeu_ps(r.col[0].vec, LINALG_SHUFFLE(X, Y, 3, 1, 3, 1));
+        _mm_storeu_ps(r.col[1].vec, LINALG_SHUFFLE(X, Y, 2, 0, 2, 0));
+        _mm_storeu_ps(r.col[2].vec, LINALG_SHUFFLE(Z, W, 3, 1, 3, 1));
+        _mm_storeu_ps(r.col[3].vec, LINALG_SHUFFLE(Z, W, 2, 0, 2, 0));
+        return r;
+    }
+
+    template<>
+    inline mat4<float> mat4<float>::affine_inverse() const
+    {
+        const __m128 c0 = _mm_loadu_ps(col[0].vec);
+        const __m128 c1 = _mm_loadu_ps(col[1].vec);
+        const __m128 c2 = _mm_loadu_ps(col[2].vec);
+        const __m128 t = _mm_loadu_ps(col[3].vec);
+
+        // rows of A^(-1), with w = 0
+        __m128 r0 = simd_cross3(c1, c2);
+        __m128 r1 = simd_cross3(c2, c0);
+        __m128 r2 = simd_cross3(c0, c1);
+        const __m128 det = simd_hsum(_mm_mul_ps(c0, r0));
+        assert(abs(_mm_cvtss_f32(det)) > 1e-8);
+
+        const __m128 idet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        r0 = _mm_mul_ps(r0, idet);
+        r1 = _mm_mul_ps(r1, idet);
+        r2 = _mm_mul_ps(r2, idet);
+        __m128 r3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        // translation -A^(-1)*t, with w = 1
+        const __m128 At = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(r0, LINALG_SPLAT(t, 0)),
+            _mm_mul_ps(r1, LINALG_SPLAT(t, 1))),
+            _mm_mul_ps(r2, LINALG_SPLAT(t, 2)));
+
+        mat4<float> r;
+        _mm_storeu_ps(r.col[0].vec, r0);
+        _mm_storeu_ps(r.col[1].vec, r1);
+        _mm_storeu_ps(r.col[2].vec, r2);
+        _mm_storeu_ps(r.col[3].vec, _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), At));
+        return r;
+    }
+
+    template<>
+    inline mat4<float> mat4<float>::normal_matrix() const
+    {
+        const __m128 c0 = _mm_loadu_ps(col[0].vec);
+        const __m128 c1 = _mm_loadu_ps(col[1].vec);
+        const __m128 c2 = _mm_loadu_ps(col[2].vec);
+
+        const __m128 r0 = simd_cross3(c1, c2);
+        const __m128 det = simd_hsum(_mm_mul_ps(c0, r0));
+        assert(abs(_mm_cvtss_f32(det)) > 1e-8);
+        const __m128 idet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        mat4<float> r;
+        _mm_storeu_ps(r.col[0].vec, _mm_mul_ps(r0, idet));
+        _mm_storeu_ps(r.col[1].vec, _mm_mul_ps(simd_cross3(c2, c0), idet));
+        _mm_storeu_ps(r.col[2].vec, _mm_mul_ps(simd_cross3(c0, c1), idet));
+        _mm_storeu_ps(r.col[3].vec, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+        return r;
+    }
+#endif
+
     template<class T>
     inline mat4<T> transpose(const mat4<T>& m)
     {
@@ -658,7 +888,25 @@ namespace linalg
 		n.transpose();
 		return n;
     }
-    
+
+    template<class T>
+    inline mat4<T> inverse(const mat4<T>& m)
+    {
+        return m.inverse();
+    }
+
+    template<class T>
+    inline mat4<T> affine_inverse(const mat4<T>& m)
+    {
+        return m.affine_inverse();
+    }
+
+    template<class T>
+    inline mat4<T> normal_matrix(const mat4<T>& m)
+    {
+        return m.normal_matrix();
+    }
+
     typedef mat2<float> mat2f;
     typedef mat3<float> mat3f;
     typedef mat4<float> mat4f;
@@ -667,11 +915,11 @@ namespace linalg
     // compile-time instances
     //
     const mat2f mat2f_zero = mat2f(0.0f);
-    const mat3f mat3f_zero = mat3f(0.0f);
-    const mat4f mat4f_zero = mat4f(0.0f);
+    constexpr mat3f mat3f_zero = mat3f(0.0f);
+    constexpr mat4f mat4f_zero = mat4f(0.0f);
     const mat2f mat2f_identity = mat2f(1.0f);
-    const mat3f mat3f_identity = mat3f(1.0f);
-    const mat4f mat4f_identity = mat4f(1.0f);
+    constexpr mat3f mat3f_identity = mat3f(1.0f);
+    constexpr mat4f mat4f_identity = mat4f(1.0f);
 }
 
 #endif /* MAT_H */
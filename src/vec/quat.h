@@ -0,0 +1,258 @@
+
+//
+// Quaternion lib
+//
+
+#pragma once
+#ifndef QUAT_H
+#define QUAT_H
+
+#include "math.h"
+#include "vec.h"
+#include "mat.h"
+
+namespace linalg
+{
+
+    //
+    // Quaternion q = w + xi + yj + zk, used for rotations
+    //
+    // Unit quaternions represent rotations; q and -q represent the same rotation
+    //
+    template<class T> class quat
+    {
+    public:
+        T x, y, z;  // vector part
+        T w;        // scalar part
+
+        //
+        // The identity rotation
+        //
+        constexpr quat() : x(0), y(0), z(0), w(1) { }
+
+        constexpr quat(const T& x, const T& y, const T& z, const T& w) : x(x), y(y), z(z), w(w) { }
+
+        //
+        // From a rotation matrix (Shepperd's method: the largest of w, x, y, z
+        // is computed first, which keeps the divisions well-conditioned)
+        // notes: R should be orthonormal. Not constexpr, as sqrt is not.
+        //
+        explicit quat(const mat3<T>& R)
+        {
+            const T tr = R.m11 + R.m22 + R.m33;
+
+            if (tr > 0)
+            {
+                const T s = sqrt(tr + 1) * 2;
+                set((R.m32 - R.m23) / s, (R.m13 - R.m31) / s, (R.m21 - R.m12) / s, s / 4);
+            }
+            else if (R.m11 > R.m22 && R.m11 > R.m33)
+            {
+                const T s = sqrt(1 + R.m11 - R.m22 - R.m33) * 2;
+                set(s / 4, (R.m12 + R.m21) / s, (R.m13 + R.m31) / s, (R.m32 - R.m23) / s);
+            }
+            else if (R.m22 > R.m33)
+            {
+                const T s = sqrt(1 + R.m22 - R.m11 - R.m33) * 2;
+                set((R.m12 + R.m21) / s, s / 4, (R.m23 + R.m32) / s, (R.m13 - R.m31) / s);
+            }
+            else
+            {
+                const T s = sqrt(1 + R.m33 - R.m11 - R.m22) * 2;
+                set((R.m13 + R.m31) / s, (R.m23 + R.m32) / s, s / 4, (R.m21 - R.m12) / s);
+            }
+        }
+
+        //
+        // From the rotation in the upper-left 3x3 submatrix
+        //
+        explicit quat(const mat4<T>& M) : quat(M.get_3x3())
+        {
+
+        }
+
+        //
+        // Rotation theta around vector u=(x,y,z)
+        // notes: u should be normalized. Not constexpr, as sin and cos are not
+        // before C++26; constant rotations can use the quat(x, y, z, w) form.
+        //
+        static quat<T> rotation(const T& theta, const T& x, const T& y, const T& z)
+        {
+            const T s = sin(theta * (T)0.5);
+            return quat<T>(x*s, y*s, z*s, cos(theta * (T)0.5));
+        }
+
+        static quat<T> rotation(const T& theta, const vec3<T>& u)
+        {
+            return rotation(theta, u.x, u.y, u.z);
+        }
+
+        constexpr T norm2squared() const
+        {
+            return x*x + y*y + z*z + w*w;
+        }
+
+        T norm2() const
+        {
+            return sqrt(norm2squared());
+        }
+
+        quat<T>& normalize()
+        {
+            T normSquared = norm2squared();
+
+            if( normSquared < 1e-8 )
+                set(0, 0, 0, 1);
+            else
+            {
+                T inorm = (T)(1.0 / sqrt(normSquared));
+                set(x*inorm, y*inorm, z*inorm, w*inorm);
+            }
+            return *this;
+        }
+
+        constexpr void set(const T& x, const T& y, const T& z, const T& w)
+        {
+            this->x = x; this->y = y; this->z = z; this->w = w;
+        }
+
+        //
+        // conjugate: the inverse rotation, for unit quaternions
+        //
+        constexpr quat<T> conjugate() const
+        {
+            return quat<T>(-x, -y, -z, w);
+        }
+
+        constexpr quat<T> operator -() const
+        {
+            return quat<T>(-x, -y, -z, -w);
+        }
+
+        constexpr quat<T> operator +(const quat<T>& q) const
+        {
+            return quat<T>(x + q.x, y + q.y, z + q.z, w + q.w);
+        }
+
+        constexpr quat<T> operator *(const T& s) const
+        {
+            return quat<T>(x*s, y*s, z*s, w*s);
+        }
+
+        //
+        // Hamilton product: the rotation rhs followed by this
+        //
+        constexpr quat<T> operator *(const quat<T>& q) const
+        {
+            return quat<T>(w*q.x + x*q.w + y*q.z - z*q.y,
+                           w*q.y - x*q.z + y*q.w + z*q.x,
+                           w*q.z + x*q.y - y*q.x + z*q.w,
+                           w*q.w - x*q.x - y*q.y - z*q.z);
+        }
+
+        //
+        // rotate a vector: v' = q v q*, expanded as
+        // v' = v + 2w (u x v) + 2 u x (u x v), u = (x,y,z)
+        //
+        constexpr vec3<T> rotate(const vec3<T>& v) const
+        {
+            const vec3<T> u(x, y, z);
+            const vec3<T> t = (u % v) * (T)2;
+            return v + t * w + (u % t);
+        }
+
+        //
+        // rotation matrix of a unit quaternion
+        //
+        constexpr mat3<T> get_mat3() const
+        {
+            const T xx = x*x, yy = y*y, zz = z*z;
+            const T xy = x*y, xz = x*z, yz = y*z;
+            const T wx = w*x, wy = w*y, wz = w*z;
+
+            return mat3<T>(1 - 2*(yy + zz), 2*(xy - wz),     2*(xz + wy),
+                           2*(xy + wz),     1 - 2*(xx + zz), 2*(yz - wx),
+                           2*(xz - wy),     2*(yz + wx),     1 - 2*(xx + yy));
+        }
+
+        constexpr mat4<T> get_mat4() const
+        {
+            return mat4<T>(get_mat3());
+        }
+
+        void debugPrint() const
+        {
+            printf("(%f,%f,%f,%f)\n", x, y, z, w);
+        }
+    };
+
+    template<class T>
+    constexpr T dot(const quat<T>& a, const quat<T>& b)
+    {
+        return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+    }
+
+    //
+    // Normalized linear interpolation along the shorter arc
+    //
+    // Cheap, and close to slerp for small angles, but the angular speed is not
+    // constant over t in [0,1]
+    //
+    template<class T>
+    inline quat<T> nlerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        const quat<T> bb = dot(a, b) < 0 ? -b : b;
+        return (a * (1 - t) + bb * t).normalize();
+    }
+
+    //
+    // Spherical linear interpolation along the shorter arc, at constant angular speed
+    // notes: a and b should be normalized
+    //
+    template<class T>
+    inline quat<T> slerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T c = dot(a, b);
+        quat<T> bb = b;
+        if (c < 0)
+        {
+            c = -c;
+            bb = -b;
+        }
+
+        // Nearly parallel: sin(theta) -> 0, and nlerp is exact enough
+        if (c > (T)0.9995)
+            return nlerp(a, bb, t);
+
+        const T theta = acos(c);
+        const T is = 1 / sin(theta);
+        return a * (sin((1 - t) * theta) * is) + bb * (sin(t * theta) * is);
+    }
+
+    //
+    // Translation * Rotation * Scaling, written directly as an affine matrix
+    //
+    // Equivalent to translation(t) * q.get_mat4() * scaling(s), without the
+    // two matrix products: the columns are the scaled rotation axes
+    // notes: q should be normalized
+    //
+    template<class T>
+    constexpr mat4<T> TRS(const vec3<T>& t, const quat<T>& q, const vec3<T>& s)
+    {
+        const T x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+        const T xx = q.x*x2, yy = q.y*y2, zz = q.z*z2;
+        const T xy = q.x*y2, xz = q.x*z2, yz = q.y*z2;
+        const T wx = q.w*x2, wy = q.w*y2, wz = q.w*z2;
+
+        return mat4<T>((1 - (yy + zz))*s.x, (xy - wz)*s.y,       (xz + wy)*s.z,       t.x,
+                       (xy + wz)*s.x,       (1 - (xx + zz))*s.y, (yz - wx)*s.z,       t.y,
+                       (xz - wy)*s.x,       (yz + wx)*s.y,       (1 - (xx + yy))*s.z, t.z,
+                       0,                   0,                   0,                   1);
+    }
+
+    typedef quat<float> quatf;
+
+    constexpr quatf quatf_identity = quatf(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+#endif /* QUAT_H */
@@ -0,0 +1,124 @@
+
+//
+// SIMD backend selection for the linalg lib
+//
+// SSE is always available on x64, and on x86 when /arch:SSE or higher is set.
+// Define LINALG_NO_SIMD to force the scalar templates (e.g. to compare results).
+//
+
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+#if !defined(LINALG_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define LINALG_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(LINALG_SSE) && !defined(LINALG_NO_AVX) && defined(__AVX2__)
+#define LINALG_AVX2
+#include <immintrin.h>
+#endif
+
+//
+// SIMD specializations of constexpr templates check for constant evaluation
+// and fall back to scalar code there. Without the builtin (before MSVC 2019
+// 16.5) they are runtime-only.
+//
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define LINALG_HAS_IS_CONSTANT_EVALUATED
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1925
+#define LINALG_HAS_IS_CONSTANT_EVALUATED
+#endif
+
+#ifdef LINALG_HAS_IS_CONSTANT_EVALUATED
+#define LINALG_SIMD_CONSTEXPR constexpr
+#define LINALG_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#define LINALG_SIMD_CONSTEXPR
+#define LINALG_IS_CONSTANT_EVALUATED() false
+#endif
+
+#ifdef LINALG_SSE
+namespace linalg
+{
+    //
+    // broadcast lane i of v to all lanes
+    //
+    #define LINALG_SPLAT(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(i, i, i, i))
+
+    //
+    // lanes of v in the order x, y, z, w (note: the reverse of _MM_SHUFFLE)
+    //
+    #define LINALG_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(w, z, y, x))
+
+    //
+    // lanes x, y of a followed by lanes z, w of b
+    //
+    #define LINALG_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE(w, z, y, x))
+
+    //
+    // horizontal sum, returned in all lanes
+    //
+    inline __m128 simd_hsum(__m128 v)
+    {
+        __m128 s = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    //
+    // linear combination of four columns: c0*v.x + c1*v.y + c2*v.z + c3*v.w
+    //
+    // summed left to right like the scalar templates, so results are identical
+    //
+    inline __m128 simd_combine(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v)
+    {
+        __m128 r = _mm_mul_ps(c0, LINALG_SPLAT(v, 0));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, LINALG_SPLAT(v, 1)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, LINALG_SPLAT(v, 2)));
+        return _mm_add_ps(r, _mm_mul_ps(c3, LINALG_SPLAT(v, 3)));
+    }
+
+    //
+    // cross product of the xyz lanes; w is a.w*b.w - a.w*b.w, i.e. 0
+    //
+    inline __m128 simd_cross3(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(
+            _mm_mul_ps(LINALG_SWIZZLE(a, 1, 2, 0, 3), LINALG_SWIZZLE(b, 2, 0, 1, 3)),
+            _mm_mul_ps(LINALG_SWIZZLE(a, 2, 0, 1, 3), LINALG_SWIZZLE(b, 1, 2, 0, 3)));
+    }
+
+    //
+    // 2x2 matrices packed row-major in one register, for block-wise 4x4 inversion
+    //
+
+    // A*B
+    inline __m128 simd_mat2_mul(__m128 a, __m128 b)
+    {
+        return _mm_add_ps(
+            _mm_mul_ps(a, LINALG_SWIZZLE(b, 0, 3, 0, 3)),
+            _mm_mul_ps(LINALG_SWIZZLE(a, 1, 0, 3, 2), LINALG_SWIZZLE(b, 2, 1, 2, 1)));
+    }
+
+    // adjugate(A)*B
+    inline __m128 simd_mat2_adj_mul(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(
+            _mm_mul_ps(LINALG_SWIZZLE(a, 3, 3, 0, 0), b),
+            _mm_mul_ps(LINALG_SWIZZLE(a, 1, 1, 2, 2), LINALG_SWIZZLE(b, 2, 3, 0, 1)));
+    }
+
+    // A*adjugate(B)
+    inline __m128 simd_mat2_mul_adj(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(
+            _mm_mul_ps(a, LINALG_SWIZZLE(b, 3, 0, 3, 0)),
+            _mm_mul_ps(LINALG_SWIZZLE(a, 1, 0, 3, 2), LINALG_SWIZZLE(b, 2, 1, 2, 1)));
+    }
+}
+#endif
+
+#endif /* SIMD_H */
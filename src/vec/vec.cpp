@@ -11,22 +11,6 @@
 namespace linalg
 {
     
-    template <class T>
-    vec4<T> vec3<T>::xyz0() const
-    {
-        return vec4<T>(x, y, z, 0.0);
-    }
-    // explicit template specialisation for <float>
-    template vec4<float> vec3<float>::xyz0() const;
-    
-    template <class T>
-    vec4<T> vec3<T>::xyz1() const
-    {
-        return vec4<T>(x, y, z, 1.0);
-    }
-    // explicit template specialisation for <float>
-    template vec4<float> vec3<float>::xyz1() const;
-    
     //
     // row vector * matrix = row vector
     //
@@ -12,9 +12,32 @@
 #include <cmath>
 #include <cstdio>
 #include <ostream>
+#include "simd.h"
 
 namespace linalg
 {
+    //
+    // sqrt, also in constant expressions: there Newton's method, which
+    // converges from above to within an ulp (exactly for perfect squares)
+    //
+    inline LINALG_SIMD_CONSTEXPR double constexpr_sqrt(double a)
+    {
+        if (!LINALG_IS_CONSTANT_EVALUATED())
+            return std::sqrt(a);
+        if (!(a > 0))
+            return 0;
+
+        double x = a > 1 ? a : 1;
+        for (int i = 0; i < 2048; i++)
+        {
+            const double next = (x + a / x) * 0.5;
+            if (next >= x)
+                break;
+            x = next;
+        }
+        return x;
+    }
+
     //
     // 2D vector
     //
@@ -27,25 +50,17 @@ namespace linalg
             struct { T x, y; };
         };
         
-        vec2()
-        {
-            x = 0.0f;
-            y = 0.0f;
-        }
+        constexpr vec2() : x(0), y(0) { }
         
-        vec2(const T& x, const T& y)
-        {
-            this->x = x;
-            this->y = y;
-        }
+        constexpr vec2(const T& x, const T& y) : x(x), y(y) { }
         
-        void set(const T &x, const T &y)
+        constexpr void set(const T &x, const T &y)
         {
             this->x = x;
             this->y = y;
         }
         
-        float dot(const vec2<T> &u) const
+        constexpr float dot(const vec2<T> &u) const
         {
             return x*u.x + y*u.y;
         }
@@ -78,7 +93,7 @@ namespace linalg
         //
         // project on v: v * u.v/v.v
         //
-        vec2<T> project(vec2<T> &v) const
+        constexpr vec2<T> project(vec2<T> &v) const
         {
             T vnormSquared = v.x*v.x + v.y*v.y;
             return v * (this->dot(v) / vnormSquared);
@@ -94,80 +109,80 @@ namespace linalg
             return acos( un.dot(vn) );
         }
         
-        vec2<T>& operator =(const vec2<T> &v)
+        constexpr vec2<T>& operator =(const vec2<T> &v)
         {
             x = v.x;
             y = v.y;
             return *this;
         }
         
-        vec2<T>& operator +=(const vec2<T> &v)
+        constexpr vec2<T>& operator +=(const vec2<T> &v)
         {
             x += v.x;
             y += v.y;
             return *this;
         }
         
-        vec2<T>& operator -=(const vec2<T> &v)
+        constexpr vec2<T>& operator -=(const vec2<T> &v)
         {
             x -= v.x;
             y -= v.y;
             return *this;
         }
         
-        vec2<T>& operator *=(const T &s)
+        constexpr vec2<T>& operator *=(const T &s)
         {
             x *= s;
             y *= s;
             return *this;
         }
         
-        vec2<T>& operator *=(const vec2<T> &v)
+        constexpr vec2<T>& operator *=(const vec2<T> &v)
         {
             x *= v.x;
             y *= v.y;
             return *this;
         }
         
-        vec2<T>& operator /=(const T &v)
+        constexpr vec2<T>& operator /=(const T &v)
         {
             x /= v;
             y /= v;
             return *this;
         }
         
-        vec2<T> operator -() const
+        constexpr vec2<T> operator -() const
         {
             return vec2<T>(-x, -y);
         }
         
-        vec2<T> operator *(const T &s) const
+        constexpr vec2<T> operator *(const T &s) const
         {
             return vec2<T>(x * s, y * s);
         }
 
-        vec2<T> operator *(const vec2<T> &v) const
+        constexpr vec2<T> operator *(const vec2<T> &v) const
         {
             return vec2<T>(x * v.x, y * v.y);
         }
         
-        vec2<T> operator /(const T &v) const
+        constexpr vec2<T> operator /(const T &v) const
         {
             T iv = 1.0 / v;
             return vec2(x * iv, y * iv);
         }
         
-        vec2<T> operator +(const vec2<T> &v) const
+        constexpr vec2<T> operator +(const vec2<T> &v) const
         {
             return vec2<T>(x + v.x, y + v.y);
         }
         
-        vec2<T> operator -(const vec2<T> &v) const
+        constexpr vec2<T> operator -(const vec2<T> &v) const
         {
             return vec2<T>(x - v.x, y - v.y);
         }
         
-        T operator %(const vec2<T> &v) const
+        constexpr T operator %(const vec2<T> &v) const
         {
             return x * v.y - y * v.x;
         }
@@ -195,32 +210,22 @@ namespace linalg
             struct { T x, y, z; };
         };
         
-        vec3()
-        {
-            x = 0.0;
-            y = 0.0;
-            z = 0.0;
-        }
+        constexpr vec3() : x(0), y(0), z(0) { }
         
-        vec3(const T &x, const T &y, const T &z)
-        {
-            this->x = x;
-            this->y = y;
-            this->z = z;
-        }
+        constexpr vec3(const T &x, const T &y, const T &z) : x(x), y(y), z(z) { }
         
-        vec4<T> xyz0() const;
+        constexpr vec4<T> xyz0() const;
         
-        vec4<T> xyz1() const;
+        constexpr vec4<T> xyz1() const;
         
-        void set(const T &x, const T &y, const T &z)
+        constexpr void set(const T &x, const T &y, const T &z)
         {
             this->x = x;
             this->y = y;
             this->z = z;
         }
         
-        T dot(const vec3<T> &u) const
+        constexpr T dot(const vec3<T> &u) const
         {
             return x*u.x + y*u.y + z*u.z;
         }
@@ -259,7 +264,7 @@ namespace linalg
         //
         // project on v: v * u.v/v.v
         //
-        vec3<T> project(const vec3<T> &v) const
+        constexpr vec3<T> project(const vec3<T> &v) const
         {
             T vnormSquared = v.x*v.x + v.y*v.y + v.z*v.z;
             return v * (this->dot(v) / vnormSquared);
@@ -275,7 +280,7 @@ namespace linalg
             return acos( un.dot(vn) );
         }
         
-        vec3<T>& operator +=(const vec3<T> &v)
+        constexpr vec3<T>& operator +=(const vec3<T> &v)
         {
             x += v.x;
             y += v.y;
@@ -283,7 +288,7 @@ namespace linalg
             return *this;
         }
         
-        vec3<T>& operator -=(const vec3<T> &v)
+        constexpr vec3<T>& operator -=(const vec3<T> &v)
         {
             x -= v.x;
             y -= v.y;
@@ -291,7 +296,7 @@ namespace linalg
             return *this;
         }
         
-        vec3<T>& operator *=(const T &s)
+        constexpr vec3<T>& operator *=(const T &s)
         {
             x *= s;
             y *= s;
@@ -299,7 +304,7 @@ namespace linalg
             return *this;
         }
         
-        vec3<T>& operator *=(const vec3<T> &v)
+        constexpr vec3<T>& operator *=(const vec3<T> &v)
         {
             x *= v.x;
             y *= v.y;
@@ -307,7 +312,7 @@ namespace linalg
             return *this;
         }
         
-        vec3<T>& operator /=(const T &v)
+        constexpr vec3<T>& operator /=(const T &v)
         {
             x /= v;
             y /= v;
@@ -315,45 +320,45 @@ namespace linalg
             return *this;
         }
         
-        vec3<T> operator -() const
+        constexpr vec3<T> operator -() const
         {
             return vec3<T>(-x, -y, -z);
         }
         
-        vec3<T> operator *(const T& s) const
+        constexpr vec3<T> operator *(const T& s) const
         {
             return vec3(x*s, y*s, z*s);
         }
         
-        vec3<T> operator *(const vec3<T>& v) const
+        constexpr vec3<T> operator *(const vec3<T>& v) const
         {
             return vec3<T>(x*v.x, y*v.y, z*v.z);
         }
         
-        vec3<T> operator /(const T& s) const
+        constexpr vec3<T> operator /(const T& s) const
         {
             T is = 1.0 / s;
             return vec3<T>(x*is, y*is, z*is);
         }
         
-        vec3<T> operator +(const vec3<T>& v) const
+        constexpr vec3<T> operator +(const vec3<T>& v) const
         {
             return vec3<T>(x+v.x, y+v.y, z+v.z);
         }
         
-        vec3<T> operator -(const vec3<T>& v) const
+        constexpr vec3<T> operator -(const vec3<T>& v) const
         {
             return vec3<T>(x-v.x, y-v.y, z-v.z);
         }
         
-        vec3<T> operator %(const vec3<T>& v) const
+        constexpr vec3<T> operator %(const vec3<T>& v) const
         {
             return vec3<T>(y*v.z-z*v.y, z*v.x-x*v.z, x*v.y-y*v.x);
         }
         
         vec3<T> operator *(const mat3<T>& m) const;
         
-        bool operator == (const vec3<T>& rhs) const
+        constexpr bool operator == (const vec3<T>& rhs) const
         {
             return x == rhs.x && y == rhs.y && z == rhs.z;
         }
@@ -384,50 +389,35 @@ namespace linalg
             struct { T x, y, z, w; };
         };
         
-        vec4()
-        {
-            x = y = z = w = 0;
-        }
+        constexpr vec4() : x(0), y(0), z(0), w(0) { }
         
-        vec4(const T &x, const T &y, const T &z, const T &w)
-        {
-            this->x = x;
-            this->y = y;
-            this->z = z;
-            this->w = w;
-        }
+        constexpr vec4(const T &x, const T &y, const T &z, const T &w) : x(x), y(y), z(z), w(w) { }
         
-        vec4(const vec3<T> &v, const T &w)
-        {
-            this->x = v.x;
-            this->y = v.y;
-            this->z = v.z;
-            this->w = w;
-        }
+        constexpr vec4(const vec3<T> &v, const T &w) : x(v.x), y(v.y), z(v.z), w(w) { }
         
-        void set(const T &x, const T &y, const T &z, const T &w){
+        constexpr void set(const T &x, const T &y, const T &z, const T &w){
             this->x = x;
             this->y = y;
             this->z = z;
             this->w = w;
         }
         
-        vec2<T> xy() const
+        constexpr vec2<T> xy() const
         {
             return vec2<T>(x, y);
         }
         
-        vec3<T> xyz() const
+        constexpr vec3<T> xyz() const
         {
             return vec3<T>(x, y, z);
         }
         
-        vec4<T> operator +(const vec4<T> &v) const
+        constexpr vec4<T> operator +(const vec4<T> &v) const
         {
             return vec4<T>(x+v.x, y+v.y, z+v.z, w+v.w);
         }
         
-        vec4<T>& operator += (const vec4<T>& v)
+        constexpr vec4<T>& operator += (const vec4<T>& v)
         {
             x += v.x;
             y += v.y;
@@ -437,59 +427,120 @@ namespace linalg
             return *this;
         }
         
-        vec4<T> operator -(const vec4<T> &v) const
+        constexpr vec4<T> operator -(const vec4<T> &v) const
         {
             return vec4<T>(x-v.x, y-v.y, z-v.z, w-v.w);
         }
         
-        vec4<T> operator *(const T &s) const
+        constexpr vec4<T> operator *(const T &s) const
         {
             return vec4<T>(x*s, y*s, z*s, w*s);
         }
         
-        bool operator == (const vec4<T>& rhs) const;
+        constexpr bool operator == (const vec4<T>& rhs) const
+        {
+            return x == rhs.x && y == rhs.y && z == rhs.z && w == rhs.w;
+        }
     };
-    
-    template<>
-    inline bool vec4<unsigned>::operator == (const vec4<unsigned>& rhs) const
+
+    template <class T>
+    constexpr vec4<T> vec3<T>::xyz0() const
     {
-        return x == rhs.x && y == rhs.y && z == rhs.z && w == rhs.w;
+        return vec4<T>(x, y, z, 0);
+    }
+
+    template <class T>
+    constexpr vec4<T> vec3<T>::xyz1() const
+    {
+        return vec4<T>(x, y, z, 1);
     }
     
     template<class T>
-    inline T dot(const vec3<T>& u, const vec3<T>& v)
+    constexpr T dot(const vec3<T>& u, const vec3<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z;
     }
     
     template<class T>
-    inline T dot(const vec4<T>& u, const vec4<T>& v)
+    constexpr T dot(const vec4<T>& u, const vec4<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
     }
     
     template<class T>
-    inline vec3<T> normalize(const vec3<T>& u)
+    inline LINALG_SIMD_CONSTEXPR vec3<T> normalize(const vec3<T>& u)
     {
         T norm2 = u.x*u.x + u.y*u.y + u.z*u.z;
         
         if( norm2 < 1.0e-8 )
             return vec3<T>(0.0, 0.0, 0.0);
         else
-            return u * (T)(1.0/sqrt(norm2));
+            return u * (T)(1.0/constexpr_sqrt(norm2));
     }
     
     template<class T>
-    inline vec4<T> normalize(const vec4<T>& u)
+    inline LINALG_SIMD_CONSTEXPR vec4<T> normalize(const vec4<T>& u)
     {
         T norm2 = u.x*u.x + u.y*u.y + u.z*u.z + u.w*u.w;
         
         if( norm2 < 1.0e-8 )
             return vec4<T>(0.0, 0.0, 0.0, 0.0);
         else
-            return u * (1.0/sqrt(norm2));
+            return u * (1.0/constexpr_sqrt(norm2));
+    }
+    
+    //
+    // vector length (2-norm): |u| = sqrt(u.u)
+    //
+    template<class T>
+    inline LINALG_SIMD_CONSTEXPR T length(const vec3<T>& u)
+    {
+        return (T)constexpr_sqrt(dot(u, u));
     }
     
+    template<class T>
+    inline LINALG_SIMD_CONSTEXPR T length(const vec4<T>& u)
+    {
+        return (T)constexpr_sqrt(dot(u, u));
+    }
+    
+#ifdef LINALG_SSE
+    //
+    // SSE overloads for vec4<float>
+    //
+    // The sum is formed pairwise, so results may differ from the scalar
+    // templates in the last bit. Constant expressions take the scalar path.
+    //
+    inline LINALG_SIMD_CONSTEXPR float dot(const vec4<float>& u, const vec4<float>& v)
+    {
+        if (LINALG_IS_CONSTANT_EVALUATED())
+            return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
+
+        const __m128 p = _mm_mul_ps(_mm_loadu_ps(u.vec), _mm_loadu_ps(v.vec));
+        return _mm_cvtss_f32(simd_hsum(p));
+    }
+
+    inline LINALG_SIMD_CONSTEXPR vec4<float> normalize(const vec4<float>& u)
+    {
+        if (LINALG_IS_CONSTANT_EVALUATED())
+        {
+            const float norm2 = u.x*u.x + u.y*u.y + u.z*u.z + u.w*u.w;
+            if( norm2 < 1.0e-8f )
+                return vec4<float>();
+            return u * (float)(1.0/constexpr_sqrt(norm2));
+        }
+
+        const __m128 a = _mm_loadu_ps(u.vec);
+        const __m128 norm2 = simd_hsum(_mm_mul_ps(a, a));
+
+        vec4<float> r;
+        if( _mm_cvtss_f32(norm2) < 1.0e-8f )
+            return r;
+        _mm_storeu_ps(r.vec, _mm_div_ps(a, _mm_sqrt_ps(norm2)));
+        return r;
+    }
+#endif
+
     template<class T>
     inline std::ostream& operator << (std::ostream &out, const vec4<T> &v)
     {
@@ -527,9 +578,9 @@ namespace linalg
     //
     // compile-time instances
     //
-    const vec2f vec2f_zero = vec2f(0, 0);
-    const vec3f vec3f_zero = vec3f(0, 0, 0);
-    const vec4f vec4f_zero = vec4f(0, 0, 0, 0);
+    constexpr vec2f vec2f_zero = vec2f(0, 0);
+    constexpr vec3f vec3f_zero = vec3f(0, 0, 0);
+    constexpr vec4f vec4f_zero = vec4f(0, 0, 0, 0);
 }
 
 #endif /* VEC_H */
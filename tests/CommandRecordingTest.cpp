@@ -0,0 +1,144 @@
+//
+//  CommandRecordingTest.cpp
+//
+//	Draw partitioning and parallel command recording
+//
+
+#include <atomic>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "CommandRecording.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+
+//
+// Records draw indices per context and submits them to one list
+//
+class LoggingRecorder : public CommandRecorder
+{
+	std::vector<std::vector<unsigned>> recorded;
+
+public:
+	std::vector<unsigned> submitted;
+
+	explicit LoggingRecorder(unsigned nbr_contexts) : recorded(nbr_contexts) { }
+
+	unsigned GetContextCount() const override { return (unsigned)recorded.size(); }
+
+	void Record(unsigned context, const DrawRange& range) override
+	{
+		for (unsigned i = range.begin; i < range.end; i++)
+			recorded[context].push_back(i);
+	}
+
+	void Submit(unsigned context) override
+	{
+		submitted.insert(submitted.end(), recorded[context].begin(), recorded[context].end());
+	}
+};
+
+TEST(CommandRecording, PartitionsAreBalancedAndSubmittedInOrder)
+{
+	JobSystem jobs(4);
+	std::mt19937 rng(1);
+
+	for (int t = 0; t < 5000; t++)
+	{
+		const unsigned n = rng() % 50;
+		const unsigned max_ranges = 1 + rng() % 9;
+		const unsigned min_cost = rng() % 4 == 0 ? 1 + rng() % 100 : 1;
+
+		std::vector<unsigned> costs(n);
+		unsigned long long total = 0;
+		unsigned max_cost = 0;
+		for (unsigned& cost : costs)
+		{
+			cost = rng() % 4 == 0 ? 0 : rng() % 100;
+			total += cost;
+			max_cost = std::max(max_cost, cost);
+		}
+
+		const std::vector<DrawRange> ranges = PartitionDraws(costs.data(), n, max_ranges, min_cost);
+		if (n == 0)
+		{
+			EXPECT_TRUE(ranges.empty());
+			continue;
+		}
+		ASSERT_FALSE(ranges.empty());
+		ASSERT_LE(ranges.size(), std::min(max_ranges, n));
+		EXPECT_EQ(ranges.front().begin, 0u);
+		EXPECT_EQ(ranges.back().end, n);
+		if (min_cost > 1 && ranges.size() > 1)
+			EXPECT_LE(ranges.size(), total / min_cost);
+
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			EXPECT_GT(ranges[i].Size(), 0u);
+			if (i > 0)
+				EXPECT_EQ(ranges[i].begin, ranges[i - 1].end);
+
+			unsigned long long cost = 0;
+			for (unsigned k = ranges[i].begin; k < ranges[i].end; k++)
+				cost += costs[k];
+			EXPECT_LE(cost, total / ranges.size() + 2 * max_cost + 1);
+		}
+
+		LoggingRecorder recorder(max_ranges);
+		RecordAndSubmit(jobs, recorder, ranges);
+		ASSERT_EQ(recorder.submitted.size(), n);
+		for (unsigned i = 0; i < n; i++)
+			ASSERT_EQ(recorder.submitted[i], i);
+	}
+}
+
+//
+// Counts the recorded draws without allocating
+//
+class CountingRecorder : public CommandRecorder
+{
+public:
+	std::atomic<unsigned> recorded{ 0 };
+	unsigned submitted = 0;
+
+	unsigned GetContextCount() const override { return 8; }
+
+	void Record(unsigned, const DrawRange& range) override { recorded += range.Size(); }
+
+	void Submit(unsigned) override { submitted++; }
+};
+
+TEST(CommandRecording, ScratchOverloadsDoNotAllocate)
+{
+	JobSystem jobs(4);
+	FrameAllocator frame_allocator;
+	CountingRecorder recorder;
+	std::vector<unsigned> costs(1000);
+	for (unsigned i = 0; i < costs.size(); i++)
+		costs[i] = i % 7;
+	const std::vector<DrawRange> expected = PartitionDraws(costs.data(), (unsigned)costs.size(), 8, 1);
+
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	for (int frame = 0; frame < 10; frame++)
+	{
+		// Allocating frames warm up the job system and the scratch memory
+		tracker.SetAssertNoHeapAllocations(frame >= 2);
+		frame_allocator.BeginFrame();
+
+		DrawRange* ranges = frame_allocator.AllocateArray<DrawRange>(8);
+		const unsigned nbr_ranges = PartitionDraws(costs.data(), (unsigned)costs.size(), 8, 1, ranges);
+		RecordAndSubmit(jobs, recorder, ranges, nbr_ranges, frame_allocator);
+		EXPECT_NO_THROW(tracker.EndFrame());
+
+		ASSERT_EQ(nbr_ranges, expected.size());
+		for (unsigned i = 0; i < nbr_ranges; i++)
+		{
+			EXPECT_EQ(ranges[i].begin, expected[i].begin);
+			EXPECT_EQ(ranges[i].end, expected[i].end);
+		}
+	}
+	tracker.SetAssertNoHeapAllocations(false);
+	EXPECT_EQ(recorder.recorded.load(), 10u * 1000);
+	EXPECT_EQ(recorder.submitted, 10u * 8);
+}
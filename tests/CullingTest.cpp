@@ -0,0 +1,226 @@
+//
+//  CullingTest.cpp
+//
+//	Frustum culling, the BVH and the occlusion culler against brute force
+//
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "vec/math.h"
+#include "BVH.h"
+#include "Culling.h"
+#include "OcclusionCuller.h"
+
+static std::vector<AABB> RandomBoxes(unsigned n, float extent, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-extent, extent), size(0.1f, 2.0f);
+	std::vector<AABB> boxes(n);
+	for (AABB& box : boxes)
+	{
+		const vec3f c(position(rng), position(rng), position(rng));
+		const float s = size(rng);
+		box.Expand(c - vec3f(s, s, s));
+		box.Expand(c + vec3f(s, s, s));
+	}
+	return boxes;
+}
+
+static Frustum TestFrustum()
+{
+	const mat4f P = mat4f::projection(45 * fTO_RAD, 1.5f, 0.1f, 100.0f);
+	const mat4f V = mat4f::rotation(0.3f, 0, 1, 0);
+	return Frustum::FromMatrix(P * V);
+}
+
+static std::vector<unsigned> BruteForceQuery(const Frustum& frustum, const std::vector<AABB>& boxes)
+{
+	std::vector<unsigned> items;
+	for (unsigned i = 0; i < boxes.size(); i++)
+		if (frustum.TestAABB(boxes[i]))
+			items.push_back(i);
+	return items;
+}
+
+TEST(Culling, SoAKernelMatchesPerVolumeTests)
+{
+	const std::vector<AABB> boxes = RandomBoxes(1003, 100, 1);
+	const Frustum frustum = TestFrustum();
+
+	BoundsSoA bounds;
+	for (const AABB& box : boxes)
+	{
+		BoundingSphere sphere;
+		sphere.center = box.Center();
+		sphere.radius = box.Extents().norm2();
+		bounds.Add(box, sphere);
+	}
+
+	std::vector<unsigned char> visible(boxes.size());
+	const unsigned nbr_visible = FrustumCull(frustum, bounds, visible.data());
+
+	unsigned count = 0;
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		BoundingSphere sphere;
+		sphere.center = boxes[i].Center();
+		sphere.radius = boxes[i].Extents().norm2();
+		const bool expected = frustum.TestAABB(boxes[i]) && frustum.TestSphere(sphere);
+		EXPECT_EQ(visible[i] != 0, expected) << "volume " << i;
+		count += visible[i];
+	}
+	EXPECT_EQ(nbr_visible, count);
+	EXPECT_GT(nbr_visible, 0u);
+	EXPECT_LT(nbr_visible, boxes.size());
+}
+
+TEST(Culling, BVHFrustumQueryMatchesBruteForce)
+{
+	std::vector<AABB> boxes = RandomBoxes(20000, 100, 2);
+	const Frustum frustum = TestFrustum();
+
+	BVH bvh;
+	bvh.Build(boxes.data(), boxes.size());
+	EXPECT_EQ(bvh.GetItemCount(), boxes.size());
+
+	std::vector<unsigned> items;
+	bvh.QueryFrustum(frustum, items);
+	std::sort(items.begin(), items.end());
+	EXPECT_EQ(items, BruteForceQuery(frustum, boxes));
+
+	// Move some items, then refit them one by one
+	std::mt19937 rng(3);
+	for (int i = 0; i < 1000; i++)
+	{
+		const unsigned k = rng() % boxes.size();
+		boxes[k].min += vec3f(5, 0, 0);
+		boxes[k].max += vec3f(5, 0, 0);
+		bvh.UpdateItem(k, boxes[k]);
+	}
+	items.clear();
+	bvh.QueryFrustum(frustum, items);
+	std::sort(items.begin(), items.end());
+	EXPECT_EQ(items, BruteForceQuery(frustum, boxes));
+
+	// And all at once
+	for (AABB& box : boxes)
+	{
+		box.min -= vec3f(0, 3, 0);
+		box.max -= vec3f(0, 3, 0);
+	}
+	bvh.Refit(boxes.data());
+	items.clear();
+	bvh.QueryFrustum(frustum, items);
+	std::sort(items.begin(), items.end());
+	EXPECT_EQ(items, BruteForceQuery(frustum, boxes));
+}
+
+TEST(Culling, BVHRaycastFindsNearestBox)
+{
+	const std::vector<AABB> boxes = RandomBoxes(20000, 100, 4);
+	BVH bvh;
+	bvh.Build(boxes.data(), boxes.size());
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> u(-1, 1);
+	for (int r = 0; r < 100; r++)
+	{
+		const vec3f origin = vec3f(u(rng), u(rng), u(rng)) * 50.0f;
+		const vec3f dir = normalize(vec3f(u(rng), u(rng), u(rng)));
+
+		// Slab test per box
+		float nearest = FLT_MAX;
+		unsigned nearest_item = BVH::InvalidIndex;
+		std::vector<unsigned> hits;
+		for (unsigned i = 0; i < boxes.size(); i++)
+		{
+			float t0 = 0, t1 = 1000;
+			for (int a = 0; a < 3; a++)
+			{
+				const float inv = 1.0f / dir.vec[a];
+				float ta = (boxes[i].min.vec[a] - origin.vec[a]) * inv;
+				float tb = (boxes[i].max.vec[a] - origin.vec[a]) * inv;
+				if (ta > tb)
+					std::swap(ta, tb);
+				t0 = std::max(t0, ta);
+				t1 = std::min(t1, tb);
+			}
+			if (t0 <= t1)
+			{
+				hits.push_back(i);
+				if (t0 < nearest)
+				{
+					nearest = t0;
+					nearest_item = i;
+				}
+			}
+		}
+
+		unsigned item;
+		float t;
+		const bool hit = bvh.Raycast(origin, dir, 1000, item, t);
+		ASSERT_EQ(hit, nearest_item != BVH::InvalidIndex);
+		if (hit)
+			EXPECT_NEAR(t, nearest, 1e-3f);
+
+		std::vector<unsigned> items;
+		bvh.QueryRay(origin, dir, 1000, items);
+		std::sort(items.begin(), items.end());
+		EXPECT_EQ(items, hits);
+	}
+}
+
+TEST(Culling, BVHRaycastIncludesTmax)
+{
+	// Entered at exactly t = 4 along +x
+	AABB boxes[1];
+	boxes[0].Expand(vec3f(4, -1, -1));
+	boxes[0].Expand(vec3f(5, 1, 1));
+	BVH bvh;
+	bvh.Build(boxes, 1);
+
+	unsigned item = BVH::InvalidIndex;
+	float t = 0;
+	ASSERT_TRUE(bvh.Raycast(vec3f(0, 0, 0), vec3f(1, 0, 0), 4, item, t));
+	EXPECT_EQ(item, 0u);
+	EXPECT_EQ(t, 4.0f);
+	EXPECT_FALSE(bvh.Raycast(vec3f(0, 0, 0), vec3f(1, 0, 0), 3.99f, item, t));
+
+	std::vector<unsigned> items;
+	bvh.QueryRay(vec3f(0, 0, 0), vec3f(1, 0, 0), 4, items);
+	EXPECT_EQ(items.size(), 1u);
+}
+
+TEST(Culling, OcclusionCullerHidesBoxesBehindOccluder)
+{
+	OcclusionCuller culler(320, 160);
+	const mat4f P = mat4f::projection(0.785f, 2.0f, 0.5f, 100.0f);
+
+	// A quad at z = -5, facing the camera and covering the middle of the view
+	const std::vector<vec3f> positions = { { -1, -1, -5 }, { 1, -1, -5 }, { 1, 1, -5 }, { -1, 1, -5 } };
+	const std::vector<unsigned> indices = { 0, 1, 2, 0, 2, 3 };
+	OccluderMesh mesh;
+	mesh.AppendRange(positions.data(), sizeof(vec3f), indices.data(), indices.size());
+
+	culler.BeginFrame();
+	culler.RenderOccluder(mesh, P);
+	culler.EndFrame();
+	EXPECT_EQ(culler.GetRasterizedTriangleCount(), 2u);
+
+	AABB behind, in_front, beside, crossing_near;
+	behind.Expand(vec3f(-0.5f, -0.5f, -20));
+	behind.Expand(vec3f(0.5f, 0.5f, -19));
+	in_front.Expand(vec3f(-0.5f, -0.5f, -3));
+	in_front.Expand(vec3f(0.5f, 0.5f, -2));
+	beside.Expand(vec3f(8, -0.5f, -20));
+	beside.Expand(vec3f(9, 0.5f, -19));
+	crossing_near.Expand(vec3f(-0.5f, -0.5f, -20));
+	crossing_near.Expand(vec3f(0.5f, 0.5f, 1));
+
+	EXPECT_FALSE(culler.TestAABB(behind, P));
+	EXPECT_TRUE(culler.TestAABB(in_front, P));
+	EXPECT_TRUE(culler.TestAABB(beside, P));
+	EXPECT_TRUE(culler.TestAABB(crossing_near, P));
+}
@@ -0,0 +1,151 @@
+//
+//  JobSystemTest.cpp
+//
+//	Job system stress tests
+//
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "JobSystem.h"
+
+class JobSystemTest : public ::testing::TestWithParam<unsigned> { };
+
+static std::atomic<unsigned long long> leaf_sum(0);
+
+static void LeafJob(void* data)
+{
+	leaf_sum.fetch_add((unsigned long long)(size_t)data, std::memory_order_relaxed);
+}
+
+struct ForkJoin
+{
+	JobSystem* jobs;
+	int depth;
+};
+
+// Binary fork/join tree: every job waits for its two children
+static void ForkJoinJob(void* data)
+{
+	const ForkJoin& node = *(ForkJoin*)data;
+	if (node.depth == 0)
+	{
+		leaf_sum.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	JobCounter counter;
+	ForkJoin children[2] = { { node.jobs, node.depth - 1 }, { node.jobs, node.depth - 1 } };
+	node.jobs->Run(&ForkJoinJob, &children[0], &counter);
+	node.jobs->Run(&ForkJoinJob, &children[1], &counter);
+	node.jobs->Wait(counter);
+}
+
+TEST_P(JobSystemTest, ManyLeafJobs)
+{
+	JobSystem jobs(GetParam());
+	for (int rep = 0; rep < 20; rep++)
+	{
+		leaf_sum = 0;
+		JobCounter counter;
+		for (size_t i = 1; i <= 10000; i++)
+			jobs.Run(&LeafJob, (void*)i, &counter);
+		jobs.Wait(counter);
+		ASSERT_EQ(leaf_sum.load(), 10000ull * 10001 / 2);
+	}
+}
+
+TEST_P(JobSystemTest, NestedForkJoin)
+{
+	JobSystem jobs(GetParam());
+	leaf_sum = 0;
+	ForkJoin root = { &jobs, 14 };
+	ForkJoinJob(&root);
+	EXPECT_EQ(leaf_sum.load(), 1ull << 14);
+}
+
+TEST_P(JobSystemTest, ParallelForCoversEveryIndexOnce)
+{
+	JobSystem jobs(GetParam());
+	std::vector<int> visits(1000003, 0);
+	for (unsigned rep = 0; rep < 10; rep++)
+		jobs.ParallelFor(0, (unsigned)visits.size(), 1000 + rep * 77, [&visits](unsigned begin, unsigned end)
+		{
+			for (unsigned i = begin; i < end; i++)
+				visits[i]++;
+		});
+	for (size_t i = 0; i < visits.size(); i++)
+		ASSERT_EQ(visits[i], 10) << "index " << i;
+}
+
+struct GraphNode
+{
+	std::atomic<unsigned>* clock;
+	unsigned stamp;
+};
+
+static void GraphNodeJob(void* data)
+{
+	GraphNode& node = *(GraphNode*)data;
+	node.stamp = node.clock->fetch_add(1);
+}
+
+TEST_P(JobSystemTest, TaskGraphRespectsDependencies)
+{
+	JobSystem jobs(GetParam());
+	std::mt19937 rng(GetParam());
+	const unsigned N = 64;
+
+	for (int rep = 0; rep < 50; rep++)
+	{
+		std::atomic<unsigned> clock(0);
+		std::vector<GraphNode> nodes(N);
+		TaskGraph graph;
+		for (GraphNode& node : nodes)
+		{
+			node.clock = &clock;
+			graph.AddTask(&GraphNodeJob, &node);
+		}
+
+		// Random DAG: edges only point back to earlier tasks
+		std::vector<std::pair<unsigned, unsigned>> edges;
+		for (unsigned i = 1; i < N; i++)
+			for (unsigned k = rng() % 4; k > 0; k--)
+				edges.push_back({ i, (unsigned)(rng() % i) });
+		for (const auto& edge : edges)
+			graph.AddDependency(edge.first, edge.second);
+
+		for (int run = 0; run < 3; run++)
+		{
+			clock = 0;
+			graph.Run(jobs);
+			ASSERT_EQ(clock.load(), N);
+			for (const auto& edge : edges)
+				ASSERT_GT(nodes[edge.first].stamp, nodes[edge.second].stamp);
+		}
+	}
+}
+
+static void RecordThreadJob(void* data)
+{
+	*(std::thread::id*)data = std::this_thread::get_id();
+}
+
+TEST_P(JobSystemTest, RunOnWorkerLeavesTheCallingThread)
+{
+	JobSystem jobs(GetParam());
+	for (int rep = 0; rep < 100; rep++)
+	{
+		std::thread::id ran_on;
+		JobCounter counter;
+		jobs.RunOnWorker(&RecordThreadJob, &ran_on, &counter);
+		jobs.Wait(counter);
+		if (GetParam() == 1)
+			ASSERT_EQ(ran_on, std::this_thread::get_id());
+		else
+			ASSERT_NE(ran_on, std::this_thread::get_id());
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, JobSystemTest, ::testing::Values(1u, 2u, 4u, 8u));
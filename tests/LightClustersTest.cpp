@@ -0,0 +1,185 @@
+//
+//  LightClustersTest.cpp
+//
+//	Binning of point and spot lights into the clusters of a camera's frustum
+//
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "vec/math.h"
+#include "LightClusters.h"
+
+// Lights spread around a camera at the origin, some of them behind it
+static std::vector<Light> RandomLights(unsigned n, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-40, 40), range(0.5f, 8), angle(0.1f, 1.4f), unit(-1, 1);
+	std::vector<Light> lights;
+	for (unsigned i = 0; i < n; i++)
+	{
+		const vec3f p(position(rng), position(rng), position(rng) - 30);
+		if (i % 3)
+			lights.push_back(Light::Point(p, range(rng), vec3f(1, 1, 1)));
+		else
+		{
+			const float outer = angle(rng);
+			lights.push_back(Light::Spot(p, vec3f(unit(rng), unit(rng), unit(rng) + 0.01f), range(rng), outer * 0.5f, outer, vec3f(1, 1, 1)));
+		}
+	}
+	return lights;
+}
+
+static Camera TestCamera()
+{
+	Camera camera(45 * fTO_RAD, 16.0f / 9, 0.1f, 100);
+	camera.moveTo({ 1, 2, 3 });
+	camera.rotate({ 0.2f, 0.4f, 0 });
+	return camera;
+}
+
+TEST(LightClusters, SlicesSpanTheFrustum)
+{
+	LightClusters clusters(16, 9, 24);
+	const Light light = Light::Point(vec3f(0, 0, -5), 1, vec3f(1, 1, 1));
+	clusters.Build(&light, 1, TestCamera());
+
+	EXPECT_NEAR(clusters.GetSliceDepth(0), 0.1f, 1e-6f);
+	EXPECT_NEAR(clusters.GetSliceDepth(24), 100.0f, 1e-3f);
+	for (unsigned i = 0; i < 24; i++)
+	{
+		// Exponential: each slice the same factor deeper than the last
+		EXPECT_NEAR(clusters.GetSliceDepth(i + 1) / clusters.GetSliceDepth(i), std::pow(1000.0f, 1.0f / 24), 1e-4f);
+		const float middle = std::sqrt(clusters.GetSliceDepth(i) * clusters.GetSliceDepth(i + 1));
+		EXPECT_EQ(clusters.GetSlice(middle), i);
+	}
+	EXPECT_EQ(clusters.GetSlice(0.01f), 0u);
+	EXPECT_EQ(clusters.GetSlice(1000.0f), 23u);
+}
+
+TEST(LightClusters, SpotBoundsContainTheCone)
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> u(0, 1);
+	for (float angle : { 0.2f, 0.7f, 0.8f, 1.4f, 2.0f })
+	{
+		const Light spot = Light::Spot(vec3f(1, 2, 3), vec3f(0, -1, 1), 10, angle * 0.5f, angle, vec3f(1, 1, 1));
+		vec3f center;
+		float radius;
+		spot.GetBoundingSphere(center, radius);
+		EXPECT_LE(radius, 10.0f + 1e-4f);
+
+		// Points of the cone, the tip and the rim of its cap included
+		const vec3f d = spot.direction;
+		vec3f t = vec3f(1, 0, 0) % d;
+		t.normalize();
+		const vec3f b = d % t;
+		for (int i = 0; i < 1000; i++)
+		{
+			const float a = u(rng) * std::min(angle, fPI), phi = u(rng) * 2 * fPI, dist = i % 10 ? u(rng) * 10 : 10.0f;
+			const vec3f p = spot.position + (d * std::cos(a) + (t * std::cos(phi) + b * std::sin(phi)) * std::sin(a)) * dist;
+			EXPECT_LE((p - center).norm2(), radius * 1.0001f) << angle;
+		}
+	}
+}
+
+TEST(LightClusters, BinningIsConservative)
+{
+	const std::vector<Light> lights = RandomLights(1001, 1);
+	const Camera camera = TestCamera();
+	LightClusters clusters(16, 9, 24);
+	clusters.Build(lights.data(), (unsigned)lights.size(), camera);
+
+	const LightCluster* cluster_ranges = clusters.GetClusters();
+	const unsigned* indices = clusters.GetLightIndices();
+
+	// The lists are packed one after the other, in light order
+	unsigned total = 0;
+	for (unsigned c = 0; c < clusters.GetClusterCount(); c++)
+	{
+		EXPECT_EQ(cluster_ranges[c].offset, total);
+		for (unsigned k = 1; k < cluster_ranges[c].count; k++)
+			EXPECT_LT(indices[cluster_ranges[c].offset + k - 1], indices[cluster_ranges[c].offset + k]);
+		total += cluster_ranges[c].count;
+	}
+	EXPECT_EQ(clusters.GetLightIndexCount(), total);
+	EXPECT_GT(total, 0u);
+	EXPECT_LT(clusters.GetBinnedLightCount(), lights.size());
+
+	// Points in the frustum, looked up as the pixel shader does: every light
+	// whose bounding sphere holds the point is in its cluster
+	const float tan_y = std::tan(camera.vfov / 2), tan_x = tan_y * camera.aspect;
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> ndc(-0.999f, 0.999f), log_depth(std::log(0.1f), std::log(100.0f));
+	for (int i = 0; i < 20000; i++)
+	{
+		const float nx = ndc(rng), ny = ndc(rng), depth = std::exp(log_depth(rng));
+		const vec3f view(nx * tan_x * depth, ny * tan_y * depth, -depth);
+		const vec3f world = camera.position + camera.get_Orientation().rotate(view);
+
+		const unsigned tx = (unsigned)((nx + 1) * 0.5f * clusters.GetTilesX());
+		const unsigned ty = (unsigned)((1 - ny) * 0.5f * clusters.GetTilesY());
+		const LightCluster& cluster = cluster_ranges[clusters.GetClusterIndex(tx, ty, clusters.GetSlice(depth))];
+		const unsigned* begin = indices + cluster.offset;
+		const unsigned* end = begin + cluster.count;
+
+		for (unsigned l = 0; l < lights.size(); l++)
+		{
+			vec3f center;
+			float radius;
+			lights[l].GetBoundingSphere(center, radius);
+			if ((world - center).norm2() < radius * 0.999f)
+				ASSERT_TRUE(std::binary_search(begin, end, l)) << "light " << l << " at depth " << depth;
+		}
+	}
+}
+
+TEST(LightClusters, ParallelBuildMatchesSerial)
+{
+	const std::vector<Light> lights = RandomLights(4099, 5);
+	const Camera camera = TestCamera();
+	LightClusters serial, parallel;
+	JobSystem jobs(4);
+	serial.Build(lights.data(), (unsigned)lights.size(), camera);
+	parallel.Build(lights.data(), (unsigned)lights.size(), camera, &jobs);
+
+	ASSERT_EQ(parallel.GetLightIndexCount(), serial.GetLightIndexCount());
+	EXPECT_EQ(parallel.GetBinnedLightCount(), serial.GetBinnedLightCount());
+	for (unsigned c = 0; c < serial.GetClusterCount(); c++)
+	{
+		ASSERT_EQ(parallel.GetClusters()[c].offset, serial.GetClusters()[c].offset);
+		ASSERT_EQ(parallel.GetClusters()[c].count, serial.GetClusters()[c].count);
+	}
+	EXPECT_TRUE(std::equal(serial.GetLightIndices(), serial.GetLightIndices() + serial.GetLightIndexCount(), parallel.GetLightIndices()));
+}
+
+TEST(LightClusters, RebuildsWithoutHeapAllocations)
+{
+	std::vector<Light> lights = RandomLights(2000, 7);
+	Camera camera = TestCamera();
+	LightClusters clusters;
+	JobSystem jobs(4);
+
+	// Lights and camera moving back and forth; the first frames grow the lists
+	auto frame = [&](int i)
+	{
+		const float step = i % 2 ? 0.5f : -0.5f;
+		for (Light& light : lights)
+			light.position.y += step;
+		camera.rotate({ 0, step * 0.1f, 0 });
+		clusters.Build(lights.data(), (unsigned)lights.size(), camera, &jobs);
+	};
+	for (int i = 0; i < 2; i++)
+		frame(i);
+
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.SetAssertNoHeapAllocations(true);
+	for (int i = 0; i < 10; i++)
+	{
+		frame(i);
+		EXPECT_NO_THROW(tracker.EndFrame());
+	}
+	tracker.SetAssertNoHeapAllocations(false);
+}
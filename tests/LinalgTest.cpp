@@ -0,0 +1,330 @@
+//
+//  LinalgTest.cpp
+//
+//	SIMD linalg against the scalar templates and double-precision references
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "vec/vec.h"
+#include "vec/mat.h"
+#include "vec/quat.h"
+#include "vec/batch.h"
+#include "Camera.h"
+
+using namespace linalg;
+
+// Unit roundoff of float
+static const double Roundoff = FLT_EPSILON / 2;
+
+// Distance in units in the last place; 0 for equal values of either sign
+static unsigned UlpDistance(float a, float b)
+{
+	int32_t ia, ib;
+	std::memcpy(&ia, &a, sizeof(float));
+	std::memcpy(&ib, &b, sizeof(float));
+	if (ia < 0)
+		ia = INT32_MIN - ia;
+	if (ib < 0)
+		ib = INT32_MIN - ib;
+	return (unsigned)std::abs((long long)ia - (long long)ib);
+}
+
+static float MaxDiff(const mat4f& a, const mat4f& b)
+{
+	float diff = 0;
+	for (int i = 0; i < 16; i++)
+		diff = std::max(diff, std::abs(a.array[i] - b.array[i]));
+	return diff;
+}
+
+static float MaxDiff(const quatf& a, const quatf& b)
+{
+	return std::max(std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)), std::max(std::abs(a.z - b.z), std::abs(a.w - b.w)));
+}
+
+static bool BitwiseEqual(const mat4f& a, const mat4f& b)
+{
+	return std::memcmp(a.array, b.array, sizeof(a.array)) == 0;
+}
+
+static bool BitwiseEqual(const vec4f& a, const vec4f& b)
+{
+	return std::memcmp(a.vec, b.vec, sizeof(a.vec)) == 0;
+}
+
+static mat4<double> ToDouble(const mat4f& M)
+{
+	mat4<double> Md;
+	for (int i = 0; i < 16; i++)
+		Md.array[i] = M.array[i];
+	return Md;
+}
+
+// Max row sum
+static double NormInf(const mat4<double>& M)
+{
+	double norm = 0;
+	for (int i = 0; i < 4; i++)
+		norm = std::max(norm, std::abs(M.mat[0][i]) + std::abs(M.mat[1][i]) + std::abs(M.mat[2][i]) + std::abs(M.mat[3][i]));
+	return norm;
+}
+
+//
+// Error of an inverse I against the exact inverse of M, in units of the
+// condition number times the roundoff: a stable inverse stays below a small
+// constant, however ill-conditioned M is
+//
+static double InverseError(const mat4f& I, const mat4<double>& M, const mat4<double>& exact)
+{
+	mat4<double> diff = ToDouble(I);
+	for (int i = 0; i < 16; i++)
+		diff.array[i] -= exact.array[i];
+	const double condition = NormInf(M) * NormInf(exact);
+	return NormInf(diff) / NormInf(exact) / (condition * Roundoff);
+}
+
+static mat4f RandomMatrix(std::mt19937& rng, float range)
+{
+	std::uniform_real_distribution<float> u(-range, range);
+	mat4f M;
+	for (int i = 0; i < 16; i++)
+		M.array[i] = u(rng);
+	return M;
+}
+
+static mat4f RandomAffine(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> u(-1, 1);
+	const quatf q = quatf::rotation(u(rng) * 3, vec3f(u(rng), u(rng), u(rng)).normalize());
+	const vec3f s(1 + u(rng) * 0.5f, 1.5f + u(rng), 0.6f + u(rng) * 0.3f);
+	return TRS(vec3f(u(rng), u(rng), u(rng)) * 10.0f, q, s);
+}
+
+TEST(Linalg, MatrixProductMatchesScalar)
+{
+	std::mt19937 rng(3);
+	for (int n = 0; n < 10000; n++)
+	{
+		const mat4f a = RandomMatrix(rng, 10), b = RandomMatrix(rng, 10);
+
+		// As the scalar template: each element summed left to right
+		mat4f ref;
+		for (int j = 0; j < 4; j++)
+			for (int i = 0; i < 4; i++)
+				ref.mat[j][i] = a.mat[0][i] * b.mat[j][0] + a.mat[1][i] * b.mat[j][1] + a.mat[2][i] * b.mat[j][2] + a.mat[3][i] * b.mat[j][3];
+		ASSERT_TRUE(BitwiseEqual(a * b, ref)) << "product " << n;
+	}
+}
+
+TEST(Linalg, VectorOpsMatchScalar)
+{
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> u(-10, 10), positive(0.01f, 10);
+	for (int n = 0; n < 10000; n++)
+	{
+		const mat4f a = RandomMatrix(rng, 10);
+		const vec4f v(u(rng), u(rng), u(rng), u(rng));
+
+		// The matrix-vector product is summed as the scalar template does
+		const vec4f w = a * v;
+		ASSERT_TRUE(BitwiseEqual(w, a.col[0] * v.x + a.col[1] * v.y + a.col[2] * v.z + a.col[3] * v.w)) << "product " << n;
+
+		mat4f t = a;
+		t.transpose();
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				ASSERT_EQ(t.mat[i][j], a.mat[j][i]);
+
+		// dot sums pairwise: without cancellation, within an ulp or two of
+		// the template's sum; with it, within the error bound of a 4-term
+		// dot product of the exact sum
+		const vec4f p(positive(rng), positive(rng), positive(rng), positive(rng));
+		const vec4f r(positive(rng), positive(rng), positive(rng), positive(rng));
+		EXPECT_LE(UlpDistance(dot(p, r), dot<float>(p, r)), 2u);
+
+		const double exact = (double)v.x * w.x + (double)v.y * w.y + (double)v.z * w.z + (double)v.w * w.w;
+		const double magnitude = std::abs((double)v.x * w.x) + std::abs((double)v.y * w.y) + std::abs((double)v.z * w.z) + std::abs((double)v.w * w.w);
+		EXPECT_LE(std::abs(dot(v, w) - exact), 4 * Roundoff * magnitude);
+
+		const vec4f normalized = normalize(v), ref = normalize<float>(v);
+		for (int i = 0; i < 4; i++)
+			EXPECT_LE(UlpDistance(normalized.vec[i], ref.vec[i]), 4u) << "component " << i;
+	}
+}
+
+TEST(Linalg, InverseMatchesDouble)
+{
+	std::mt19937 rng(5);
+	double err = 0;
+	for (int n = 0; n < 10000; n++)
+	{
+		const mat4f M = RandomMatrix(rng, 1);
+		const mat4<double> Md = ToDouble(M);
+		err = std::max(err, InverseError(inverse(M), Md, Md.inverse()));
+	}
+	EXPECT_LT(err, 8);
+}
+
+TEST(Linalg, AffineInverseAndNormalMatrix)
+{
+	std::mt19937 rng(6);
+	double inverse_err = 0, normal_err = 0;
+	for (int n = 0; n < 10000; n++)
+	{
+		const mat4f A = RandomAffine(rng);
+		const mat4<double> Ad = ToDouble(A), Id = Ad.inverse();
+		inverse_err = std::max(inverse_err, InverseError(affine_inverse(A), Ad, Id));
+
+		// Of the upper-left 3x3 alone
+		const mat4<double> A3(Ad.get_3x3()), N3(transpose(Id).get_3x3());
+		normal_err = std::max(normal_err, InverseError(normal_matrix(A), A3, N3));
+
+		const mat4f N = normal_matrix(A);
+		EXPECT_EQ(N.m14, 0);
+		EXPECT_EQ(N.m41, 0);
+		EXPECT_EQ(N.m44, 1);
+	}
+	EXPECT_LT(inverse_err, 8);
+	EXPECT_LT(normal_err, 8);
+}
+
+TEST(Linalg, QuaternionTransforms)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> u(-1, 1);
+	for (int n = 0; n < 10000; n++)
+	{
+		const vec3f axis = vec3f(u(rng), u(rng), u(rng)).normalize();
+		const float theta = u(rng) * 3.1f;
+		const vec3f t(u(rng) * 5, u(rng) * 5, u(rng) * 5), s(u(rng) + 2, u(rng) + 2, u(rng) + 2);
+		const quatf q = quatf::rotation(theta, axis);
+
+		EXPECT_LT(MaxDiff(TRS(t, q, s), mat4f::TRS(t, theta, axis, s)), 1e-4f);
+
+		quatf from_matrix(q.get_mat4());
+		if (dot(from_matrix, q) < 0)
+			from_matrix = -from_matrix;
+		EXPECT_LT(MaxDiff(from_matrix, q), 1e-4f);
+
+		// About a common axis, slerp is linear in the angle
+		const float a0 = u(rng) * 1.5f, a1 = u(rng) * 1.5f, x = (u(rng) + 1) / 2;
+		quatf slerped = slerp(quatf::rotation(a0, axis), quatf::rotation(a1, axis), x);
+		const quatf ref = quatf::rotation(a0 + (a1 - a0) * x, axis);
+		if (dot(slerped, ref) < 0)
+			slerped = -slerped;
+		EXPECT_LT(MaxDiff(slerped, ref), 1e-4f);
+		EXPECT_LT(MaxDiff(nlerp(quatf::rotation(a0, axis), quatf::rotation(a1, axis), 0.0f), quatf::rotation(a0, axis)), 1e-5f);
+	}
+}
+
+TEST(Linalg, QuaternionsInConstantExpressions)
+{
+	// A quarter turn about z, spelled out since rotation() is runtime-only
+	constexpr float h = 0.70710678f;
+	constexpr quatf q(0, 0, h, h);
+	constexpr vec3f v = q.rotate(vec3f(1, 0, 0));
+	constexpr mat4f M = TRS(vec3f(1, 2, 3), q * quatf_identity, vec3f(2, 2, 2));
+	static_assert(v.y > 0.999f && v.x < 1e-6f && v.x > -1e-6f, "rotate");
+	static_assert(M.m14 == 1 && M.m24 == 2 && M.m34 == 3 && M.m44 == 1, "TRS translation");
+	static_assert(M.m21 > 1.999f && M.m12 < -1.999f, "TRS rotation and scale");
+	static_assert(dot(q.conjugate() * q, quatf()) > 0.999f, "conjugate");
+
+	EXPECT_LT(MaxDiff(M, TRS(vec3f(1, 2, 3), quatf::rotation(fPI / 2, 0, 0, 1), vec3f(2, 2, 2))), 1e-6f);
+	EXPECT_LT(MaxDiff(q.get_mat4(), quatf::rotation(fPI / 2, 0, 0, 1).get_mat4()), 1e-6f);
+}
+
+#ifdef LINALG_HAS_IS_CONSTANT_EVALUATED
+TEST(Linalg, VectorFunctionsInConstantExpressions)
+{
+	// Also the SSE overloads for vec4f, which take their scalar path here
+	constexpr vec4f u(1, 2, 2, 4);
+	constexpr vec4f n = normalize(u);
+	static_assert(dot(u, vec4f(1, 1, 1, 1)) == 9, "dot");
+	static_assert(length(u) == 5, "length");
+	static_assert(length(vec3f(2, 3, 6)) == 7, "length of vec3");
+	static_assert(n.w > 0.7999f && n.w < 0.8001f && n.x > 0.1999f && n.x < 0.2001f, "normalize");
+	static_assert(normalize(vec4f()) == vec4f(), "normalize zero");
+	static_assert(length(n) > 0.9999f && length(n) < 1.0001f, "unit length");
+
+	// And agree with the runtime versions
+	const vec4f runtime = normalize(u);
+	EXPECT_FLOAT_EQ(length(u), 5);
+	EXPECT_FLOAT_EQ(dot(u, u), 25);
+	for (int i = 0; i < 4; i++)
+		EXPECT_FLOAT_EQ(runtime.vec[i], n.vec[i]);
+}
+#endif
+
+TEST(Linalg, CameraViewMatrix)
+{
+	std::mt19937 rng(8);
+	std::uniform_real_distribution<float> u(-1, 1);
+	for (int n = 0; n < 1000; n++)
+	{
+		Camera camera(1, 1, 1, 100);
+		camera.position = vec3f(u(rng), u(rng), u(rng)) * 10.0f;
+		camera.rotation = vec3f(u(rng) * 1.5f, u(rng) * 3, 0);
+
+		mat4f R = mat4f::rotation(camera.rotation.y, 0, 1, 0) * mat4f::rotation(camera.rotation.x, 1, 0, 0);
+		R.transpose();
+		EXPECT_LT(MaxDiff(camera.get_WorldToViewMatrix(), R * mat4f::translation(-camera.position)), 1e-4f);
+	}
+}
+
+struct BatchVertex
+{
+	vec3f Pos, Normal;
+	vec2f TexCoord;
+};
+
+TEST(Linalg, BatchTransformsMatchPerElement)
+{
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> u(-10, 10);
+	const mat4f M = RandomMatrix(rng, 10);
+
+	for (size_t n : { 0, 1, 2, 3, 4, 7, 8, 9, 33, 1001 })
+	{
+		std::vector<vec3f> p(n), points(n), vectors(n), in_place(n);
+		std::vector<vec4f> q(n), transformed(n), homogeneous(n);
+		std::vector<float> x(n), y(n), z(n), ox(n), oy(n), oz(n);
+		std::vector<BatchVertex> vertices(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			p[i] = vec3f(u(rng), u(rng), u(rng));
+			q[i] = vec4f(u(rng), u(rng), u(rng), u(rng));
+			x[i] = p[i].x; y[i] = p[i].y; z[i] = p[i].z;
+			vertices[i].Pos = p[i];
+			vertices[i].Normal = vec3f(7, 7, 7);
+		}
+		in_place = p;
+
+		transform_points(M, p.data(), points.data(), n);
+		transform_vectors(M, p.data(), vectors.data(), n);
+		transform(M, q.data(), transformed.data(), n);
+		transform_points(M, p.data(), homogeneous.data(), n);
+		transform_points(M, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), n);
+		vec3f* positions = n ? &vertices[0].Pos : nullptr;
+		transform_points(M, positions, sizeof(BatchVertex), positions, sizeof(BatchVertex), n);
+		transform_points(M, in_place.data(), in_place.data(), n);
+
+		for (size_t i = 0; i < n; i++)
+		{
+			const vec4f point = M * p[i].xyz1();
+			EXPECT_TRUE(points[i] == point.xyz());
+			EXPECT_TRUE(vectors[i] == (M * p[i].xyz0()).xyz());
+			EXPECT_TRUE(BitwiseEqual(transformed[i], M * q[i]));
+			EXPECT_TRUE(BitwiseEqual(homogeneous[i], point));
+			EXPECT_TRUE(ox[i] == point.x && oy[i] == point.y && oz[i] == point.z);
+			EXPECT_TRUE(vertices[i].Pos == point.xyz());
+			EXPECT_TRUE(vertices[i].Normal == vec3f(7, 7, 7));
+			EXPECT_TRUE(in_place[i] == point.xyz());
+		}
+	}
+}
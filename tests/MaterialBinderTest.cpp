@@ -0,0 +1,132 @@
+//
+//  MaterialBinderTest.cpp
+//
+//	Material binding through a backend that counts the device calls
+//
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "MaterialBinder.h"
+
+//
+// Logs the device calls of the binder instead of making them
+//
+class CountingBinder : public MaterialBinder
+{
+protected:
+	void UploadPhong(const PhongParams& phong) override
+	{
+		uploaded.push_back(phong);
+	}
+
+	void SetTexture(unsigned slot, ID3D11ShaderResourceView* SRV) override
+	{
+		texture_binds[slot]++;
+		textures[slot] = SRV;
+	}
+
+	void SetPixelShader(unsigned permutation) override
+	{
+		shaders.push_back(permutation);
+	}
+
+public:
+	std::vector<PhongParams> uploaded;
+	unsigned texture_binds[ShaderFeatureCount] = {};
+	ID3D11ShaderResourceView* textures[ShaderFeatureCount] = {};
+	std::vector<unsigned> shaders;
+
+	explicit CountingBinder(bool permutations) { SelectPermutations(permutations); }
+};
+
+// Distinct non-null views; never dereferenced
+static ID3D11ShaderResourceView* FakeSRV(size_t i)
+{
+	return (ID3D11ShaderResourceView*)(i * 16 + 16);
+}
+
+TEST(MaterialBinder, SkipsRepeatedPhongParameters)
+{
+	CountingBinder binder(false);
+	binder.BeginFrame();
+
+	// 100 draws sorted by material, 4 materials
+	for (unsigned i = 0; i < 100; i++)
+	{
+		const float k = (float)(i / 25);
+		binder.BindPhong(vec4f(k, 0, 0, 1), vec4f(0, k, 0, 1), vec4f(1, 1, 1, 1), 10 + k);
+	}
+	EXPECT_EQ(binder.GetUploadCount(), 4u);
+	EXPECT_EQ(binder.GetSkippedCount(), 96u);
+	ASSERT_EQ(binder.uploaded.size(), 4u);
+	EXPECT_EQ(binder.uploaded[3].diffuse, vec4f(0, 3, 0, 1));
+	EXPECT_EQ(binder.uploaded[3].shininess, 13.0f);
+
+	// Any differing value uploads
+	binder.BindPhong(vec4f(3, 0, 0, 1), vec4f(0, 3, 0, 1), vec4f(1, 1, 1, 1), 13.5f);
+	EXPECT_EQ(binder.GetUploadCount(), 5u);
+
+	// A new frame forgets what was bound, and resets the counters
+	binder.BeginFrame();
+	binder.BindPhong(vec4f(3, 0, 0, 1), vec4f(0, 3, 0, 1), vec4f(1, 1, 1, 1), 13.5f);
+	EXPECT_EQ(binder.GetUploadCount(), 1u);
+	EXPECT_EQ(binder.GetSkippedCount(), 0u);
+	EXPECT_EQ(binder.uploaded.size(), 6u);
+}
+
+TEST(MaterialBinder, OverrideIgnoresMaterials)
+{
+	CountingBinder binder(false);
+	binder.BeginFrame();
+
+	const PhongParams fixed = { vec4f(0, 0, 0.3f, 1), vec4f(0.8f, 0, 0.8f, 1), vec4f(1, 0.5f, 1, 1), 0.5f };
+	binder.SetPhongOverride(fixed);
+	for (unsigned i = 0; i < 10; i++)
+		binder.BindPhong(vec4f((float)i, 0, 0, 1), vec4f(0, 0, 0, 1), vec4f(0, 0, 0, 1), 1);
+	EXPECT_EQ(binder.GetUploadCount(), 1u);
+	ASSERT_EQ(binder.uploaded.size(), 1u);
+	EXPECT_EQ(binder.uploaded[0].diffuse, fixed.diffuse);
+
+	binder.ClearPhongOverride();
+	binder.BindPhong(vec4f(1, 0, 0, 1), vec4f(0, 0, 0, 1), vec4f(0, 0, 0, 1), 1);
+	EXPECT_EQ(binder.GetUploadCount(), 2u);
+}
+
+TEST(MaterialBinder, BindsTexturesAndPermutationsOnChange)
+{
+	CountingBinder binder(true);
+	binder.BeginFrame();
+
+	Material diffuse_only, diffuse_normal, other_diffuse, untextured;
+	diffuse_only.diffuse_texture.texture_SRV = FakeSRV(0);
+	diffuse_normal.diffuse_texture.texture_SRV = FakeSRV(0);
+	diffuse_normal.normal_texture.texture_SRV = FakeSRV(1);
+	other_diffuse.diffuse_texture.texture_SRV = FakeSRV(2);
+
+	for (const Material* material : { &diffuse_only, &diffuse_only, &diffuse_normal, &diffuse_normal, &other_diffuse, &untextured, &diffuse_only })
+		binder.BindMaterial(*material);
+
+	// Only the slots a permutation samples are bound, each when it changes
+	EXPECT_EQ(binder.texture_binds[0], 3u);
+	EXPECT_EQ(binder.texture_binds[1], 1u);
+	EXPECT_EQ(binder.texture_binds[2], 0u);
+	EXPECT_EQ(binder.textures[0], FakeSRV(0));
+	EXPECT_EQ(binder.textures[1], FakeSRV(1));
+
+	const std::vector<unsigned> expected = {
+		ShaderFeature_DiffuseMap,
+		ShaderFeature_DiffuseMap | ShaderFeature_NormalMap,
+		ShaderFeature_DiffuseMap,
+		0,
+		ShaderFeature_DiffuseMap };
+	EXPECT_EQ(binder.shaders, expected);
+	EXPECT_EQ(binder.GetShaderSwitchCount(), 5u);
+
+	// Without permutations, the pixel shader is left alone
+	CountingBinder fixed_shader(false);
+	fixed_shader.BeginFrame();
+	fixed_shader.BindMaterial(diffuse_normal);
+	EXPECT_TRUE(fixed_shader.shaders.empty());
+	EXPECT_EQ(fixed_shader.GetShaderSwitchCount(), 0u);
+	EXPECT_EQ(fixed_shader.texture_binds[1], 1u);
+}
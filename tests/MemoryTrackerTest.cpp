@@ -0,0 +1,268 @@
+//
+//  MemoryTrackerTest.cpp
+//
+//	Tagged memory accounting, heap allocation checks and frame scratch memory
+//
+
+#include <limits>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "OBJLoader.h"
+#include "Texture.h"
+#include "TransformHierarchy.h"
+
+TEST(MemoryTracker, TaggedVectorCountsBytes)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	const MemoryTracker::TagStats before = tracker.GetStats(MemoryTag::Transient);
+	{
+		TaggedVector<int, MemoryTag::Transient> v;
+		v.reserve(1000);
+		const MemoryTracker::TagStats during = tracker.GetStats(MemoryTag::Transient);
+		EXPECT_EQ(during.current_bytes, before.current_bytes + 1000 * sizeof(int));
+		EXPECT_GE(during.peak_bytes, during.current_bytes);
+		EXPECT_EQ(during.allocations, before.allocations + 1);
+	}
+	const MemoryTracker::TagStats after = tracker.GetStats(MemoryTag::Transient);
+	EXPECT_EQ(after.current_bytes, before.current_bytes);
+	EXPECT_EQ(after.frees, before.frees + 1);
+
+	// Over-aligned elements
+	TaggedVector<mat4f, MemoryTag::Transient> matrices(3, mat4f_identity);
+	EXPECT_EQ((size_t)matrices.data() % alignof(mat4f), 0u);
+}
+
+TEST(MemoryTracker, MallocReallocFree)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.ResetPeaks();
+	const size_t base = tracker.GetStats(MemoryTag::Textures).current_bytes;
+
+	void* p = TaggedMalloc(MemoryTag::Textures, 100);
+	ASSERT_NE(p, nullptr);
+	EXPECT_EQ((size_t)p % alignof(std::max_align_t), 0u);
+	p = TaggedRealloc(MemoryTag::Textures, p, 5000);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).current_bytes, base + 5000);
+	p = TaggedRealloc(MemoryTag::Textures, p, 10);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).current_bytes, base + 10);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).peak_bytes, base + 5000);
+	TaggedFree(MemoryTag::Textures, p);
+	TaggedFree(MemoryTag::Textures, nullptr);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).current_bytes, base);
+
+	tracker.ResetPeaks();
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).peak_bytes, base);
+}
+
+TEST(MemoryTracker, FrameAllocations)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.EndFrame();
+	for (int i = 0; i < 5; i++)
+		TaggedFree(MemoryTag::Transient, TaggedMalloc(MemoryTag::Transient, 16));
+	tracker.EndFrame();
+	EXPECT_EQ(tracker.GetFrameAllocations(), 5u);
+	tracker.EndFrame();
+	EXPECT_EQ(tracker.GetFrameAllocations(), 0u);
+
+	std::ostringstream report;
+	tracker.Report(report);
+	for (const char* name : { "mesh-load", "textures", "scene", "transient" })
+		EXPECT_NE(report.str().find(name), std::string::npos) << name;
+}
+
+TEST(MemoryTracker, SubsystemsAreTagged)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+
+	// The loader's intermediate data is in one arena chunk, gone after loading
+	const MemoryTracker::TagStats before = tracker.GetStats(MemoryTag::MeshLoad);
+	const size_t mesh_load = before.current_bytes;
+	tracker.ResetPeaks();
+	{
+		std::istringstream in("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+		OBJLoader loader;
+		loader.verbose = false;
+		loader.Load(in, "");
+	}
+	EXPECT_GT(tracker.GetStats(MemoryTag::MeshLoad).peak_bytes, mesh_load);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::MeshLoad).current_bytes, mesh_load);
+	EXPECT_EQ(tracker.GetStats(MemoryTag::MeshLoad).allocations, before.allocations + 1);
+
+	// Decoded images stay until cleared
+	const size_t textures = tracker.GetStats(MemoryTag::Textures).current_bytes;
+	Image image;
+	ASSERT_TRUE(image.Load(EDUREND_ASSET_DIR "textures/brick_diffuse.png"));
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).current_bytes, textures + 512 * 256 * 4);
+	image.Clear();
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Textures).current_bytes, textures);
+
+	const size_t scene = tracker.GetStats(MemoryTag::Scene).current_bytes;
+	{
+		TransformHierarchy h;
+		h.Reserve(100);
+		EXPECT_GE(tracker.GetStats(MemoryTag::Scene).current_bytes, scene + 100 * sizeof(mat4f));
+	}
+	EXPECT_EQ(tracker.GetStats(MemoryTag::Scene).current_bytes, scene);
+}
+
+TEST(MemoryTracker, CountsAndAssertsHeapAllocations)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	tracker.SetCountHeapAllocations(true);
+	{
+		std::vector<int> v(10);
+		std::string s(100, 'x');
+		TaggedFree(MemoryTag::Transient, TaggedMalloc(MemoryTag::Transient, 16));
+	}
+	tracker.EndFrame();
+	EXPECT_EQ(tracker.GetFrameHeapAllocations(), 3u);
+	tracker.EndFrame();
+	EXPECT_EQ(tracker.GetFrameHeapAllocations(), 0u);
+	tracker.SetCountHeapAllocations(false);
+
+	// Not counted while off
+	{
+		std::vector<int> v(10);
+	}
+	tracker.EndFrame();
+	EXPECT_EQ(tracker.GetFrameHeapAllocations(), 0u);
+
+	tracker.SetAssertNoHeapAllocations(true);
+	EXPECT_NO_THROW(tracker.EndFrame());
+	{
+		std::vector<double> v(100);
+	}
+	EXPECT_THROW(tracker.EndFrame(), std::runtime_error);
+	EXPECT_EQ(tracker.GetFrameHeapAllocations(), 1u);
+	tracker.SetAssertNoHeapAllocations(false);
+	{
+		std::vector<int> v(10);
+	}
+	EXPECT_NO_THROW(tracker.EndFrame());
+}
+
+static unsigned nbr_new_handler_calls = 0;
+
+// Gives up on the second call, so that operator new throws
+static void CountingNewHandler()
+{
+	if (++nbr_new_handler_calls == 2)
+		std::set_new_handler(nullptr);
+}
+
+TEST(MemoryTracker, OperatorNewCallsTheNewHandler)
+{
+	// More than malloc can ever return
+	const size_t huge = std::numeric_limits<size_t>::max() / 2;
+
+	nbr_new_handler_calls = 0;
+	const std::new_handler previous = std::set_new_handler(&CountingNewHandler);
+	EXPECT_THROW(::operator delete(::operator new(huge)), std::bad_alloc);
+	EXPECT_EQ(nbr_new_handler_calls, 2u);
+
+	nbr_new_handler_calls = 0;
+	std::set_new_handler(&CountingNewHandler);
+	EXPECT_EQ(::operator new(huge, std::nothrow), nullptr);
+	EXPECT_EQ(nbr_new_handler_calls, 2u);
+	std::set_new_handler(previous);
+}
+
+TEST(FrameAllocator, AlignedAndDoubleBuffered)
+{
+	FrameAllocator frame_allocator(1024);
+	frame_allocator.BeginFrame();
+
+	char* c = frame_allocator.AllocateArray<char>(3);
+	mat4f* m = frame_allocator.AllocateArray<mat4f>(2);
+	void* page = frame_allocator.Allocate(10, 256);
+	EXPECT_EQ((size_t)m % alignof(mat4f), 0u);
+	EXPECT_EQ((size_t)page % 256, 0u);
+	EXPECT_GE((char*)m, c + 3);
+	EXPECT_EQ(frame_allocator.GetFrameBytes(), 3 + 2 * sizeof(mat4f) + 10);
+
+	// Frame 1's memory is untouched by frame 2, and reused by frame 3
+	int* first = frame_allocator.AllocateArray<int>(4);
+	for (int i = 0; i < 4; i++)
+		first[i] = i;
+	frame_allocator.BeginFrame();
+	EXPECT_EQ(frame_allocator.GetFrameBytes(), 0u);
+	int* second = frame_allocator.AllocateArray<int>(4);
+	for (int i = 0; i < 4; i++)
+		second[i] = -1;
+	for (int i = 0; i < 4; i++)
+		EXPECT_EQ(first[i], i);
+	frame_allocator.BeginFrame();
+	EXPECT_EQ((void*)frame_allocator.AllocateArray<char>(3), (void*)c);
+
+	FrameVector<int> v(frame_allocator);
+	v.assign(100, 7);
+	EXPECT_EQ(v.back(), 7);
+}
+
+TEST(FrameAllocator, GrowsThenStopsAllocating)
+{
+	MemoryTracker& tracker = MemoryTracker::Instance();
+	FrameAllocator frame_allocator(256);
+
+	// The first frames chain blocks; the buffers merge them when reused
+	for (int frame = 0; frame < 2 * (int)FrameAllocator::FramesInFlight; frame++)
+	{
+		frame_allocator.BeginFrame();
+		for (int i = 0; i < 100; i++)
+			frame_allocator.Allocate(100);
+	}
+	const size_t capacity = frame_allocator.GetCapacity();
+
+	tracker.SetAssertNoHeapAllocations(true);
+	for (int frame = 0; frame < 10; frame++)
+	{
+		frame_allocator.BeginFrame();
+		for (int i = 0; i < 100; i++)
+			frame_allocator.Allocate(100);
+		EXPECT_NO_THROW(tracker.EndFrame());
+	}
+	tracker.SetAssertNoHeapAllocations(false);
+	EXPECT_EQ(frame_allocator.GetCapacity(), capacity);
+	EXPECT_EQ(frame_allocator.GetFrameBytes(), 100u * 100);
+}
+
+TEST(FrameAllocator, SubArenaPerThread)
+{
+	JobSystem jobs(4);
+	FrameAllocator frame_allocator(4096);
+	const unsigned N = 10000;
+	std::vector<unsigned*> allocations(N);
+
+	for (int frame = 0; frame < 3; frame++)
+	{
+		frame_allocator.BeginFrame();
+		jobs.ParallelFor(0, N, 16, [&](unsigned begin, unsigned end)
+		{
+			for (unsigned i = begin; i < end; i++)
+			{
+				allocations[i] = frame_allocator.AllocateArray<unsigned>(3);
+				for (unsigned k = 0; k < 3; k++)
+					allocations[i][k] = i;
+			}
+		});
+
+		// No allocation overlaps another
+		std::set<unsigned*> distinct;
+		for (unsigned i = 0; i < N; i++)
+		{
+			for (unsigned k = 0; k < 3; k++)
+				ASSERT_EQ(allocations[i][k], i);
+			distinct.insert(allocations[i]);
+		}
+		EXPECT_EQ(distinct.size(), N);
+		EXPECT_EQ(frame_allocator.GetFrameBytes(), N * 3 * sizeof(unsigned));
+	}
+}
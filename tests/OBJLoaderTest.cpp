@@ -0,0 +1,154 @@
+//
+//  OBJLoaderTest.cpp
+//
+//	OBJ/MTL parsing, welding and normal generation
+//
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include "OBJLoader.h"
+#include "parseutil.h"
+
+// Unit cube: 8 positions, one normal per face and 4 texcoords
+static const char* CubeOBJ =
+	"v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\n"
+	"v -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+	"vn 0 0 -1\nvn 0 0 1\nvn -1 0 0\nvn 1 0 0\nvn 0 -1 0\nvn 0 1 0\n"
+	"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+	"g cube\n"
+	"f 1/1/1 4/4/1 3/3/1 2/2/1\n"
+	"f 5/1/2 6/2/2 7/3/2 8/4/2\n"
+	"f 1/1/3 5/2/3 8/3/3 4/4/3\n"
+	"f 2/1/4 3/4/4 7/3/4 6/2/4\n"
+	"f 1/1/5 2/2/5 6/3/5 5/4/5\n"
+	"f 4/1/6 8/4/6 7/3/6 3/2/6\n";
+
+static void LoadString(OBJLoader& loader, const std::string& obj, const std::string& dir = "", bool generate_normals = true, bool triangulate = true)
+{
+	std::istringstream in(obj);
+	loader.verbose = false;
+	loader.Load(in, dir, generate_normals, triangulate);
+}
+
+TEST(OBJLoader, WeldsAndTriangulatesQuads)
+{
+	OBJLoader loader;
+	LoadString(loader, CubeOBJ);
+
+	EXPECT_TRUE(loader.has_normals);
+	EXPECT_TRUE(loader.has_texcoords);
+	ASSERT_EQ(loader.drawcalls.size(), 1u);
+	EXPECT_EQ(loader.drawcalls[0].group_name, "");
+	EXPECT_EQ(loader.drawcalls[0].tris.size(), 12u);
+	EXPECT_TRUE(loader.drawcalls[0].quads.empty());
+	EXPECT_EQ(loader.drawcalls[0].mtl_index, -1);
+
+	// Each corner of each face is a distinct position/normal pair
+	EXPECT_EQ(loader.vertices.size(), 24u);
+
+	// Triangles face along their vertex normals
+	for (const Triangle& tri : loader.drawcalls[0].tris)
+	{
+		const Vertex& a = loader.vertices[tri.vi[0]];
+		const Vertex& b = loader.vertices[tri.vi[1]];
+		const Vertex& c = loader.vertices[tri.vi[2]];
+		EXPECT_GT(dot((b.Pos - a.Pos) % (c.Pos - a.Pos), a.Normal), 0);
+	}
+}
+
+TEST(OBJLoader, KeepsQuadsWithoutTriangulation)
+{
+	OBJLoader loader;
+	LoadString(loader, CubeOBJ, "", true, false);
+	ASSERT_EQ(loader.drawcalls.size(), 1u);
+	EXPECT_TRUE(loader.drawcalls[0].tris.empty());
+	EXPECT_EQ(loader.drawcalls[0].quads.size(), 6u);
+}
+
+TEST(OBJLoader, GeneratesNormals)
+{
+	const std::string obj =
+		"v 0 0 0\nv 1 0 0\nv 1 0 1\nv 0 0 1\nv 0 1 0\n"
+		"f 1 4 3\nf 1 3 2\nf 1 5 2\n";
+
+	OBJLoader loader;
+	LoadString(loader, obj);
+	EXPECT_TRUE(loader.has_normals);
+	EXPECT_FALSE(loader.has_texcoords);
+	EXPECT_EQ(loader.vertices.size(), 5u);
+	for (const Vertex& v : loader.vertices)
+		EXPECT_NEAR(v.Normal.norm2(), 1, 1e-5f);
+
+	// Vertex 4 only belongs to the floor, which faces up
+	const Vertex& floor = loader.vertices[loader.drawcalls[0].tris[0].vi[1]];
+	EXPECT_NEAR(floor.Normal.y, 1, 1e-5f);
+
+	OBJLoader without;
+	LoadString(without, obj, "", false);
+	EXPECT_FALSE(without.has_normals);
+}
+
+TEST(OBJLoader, MaterialsAndSortedDrawcalls)
+{
+	const std::string dir = EDUREND_ASSET_DIR "crytek-sponza/";
+	const std::string obj =
+		std::string("mtllib sponza.mtl\n") + CubeOBJ +
+		"usemtl vase_round\nf 1 2 3\n"
+		"usemtl leaf\nf 1 3 4\nf 5 6 7\n"
+		"usemtl vase_round\nf 5 7 8\n";
+
+	OBJLoader loader;
+	LoadString(loader, obj, dir);
+
+	ASSERT_EQ(loader.materials.size(), 2u);
+	EXPECT_EQ(loader.materials[0].name, "vase_round");
+	EXPECT_EQ(loader.materials[1].name, "leaf");
+	EXPECT_EQ(loader.materials[1].Kd_texture_filename, dir + "textures/sponza_thorn_diff.png");
+	EXPECT_EQ(loader.materials[1].normal_texture_filename, dir + "textures/sponza_thorn_normal.png");
+	EXPECT_EQ(loader.materials[1].Ks_texture_filename, dir + "textures/sponza_thorn_spec.png");
+	EXPECT_EQ(loader.materials[1].mask_texture_filename, dir + "textures/sponza_thorn_mask.png");
+	EXPECT_FLOAT_EQ(loader.materials[1].Kd.x, 0.588f);
+
+	// The cube's faces come before the first usemtl, and go unused
+	for (size_t i = 1; i < loader.drawcalls.size(); i++)
+		EXPECT_LE(loader.drawcalls[i - 1].mtl_index, loader.drawcalls[i].mtl_index);
+	EXPECT_EQ(loader.drawcalls.size(), 3u);
+}
+
+TEST(OBJLoader, Errors)
+{
+	OBJLoader loader;
+	loader.verbose = false;
+	EXPECT_THROW(loader.Load(std::string("no/such/file.obj")), std::runtime_error);
+
+	OBJLoader missing_material;
+	EXPECT_THROW(LoadString(missing_material, "mtllib sphere.mtl\nv 0 0 0\nusemtl nope\nf 1 1 1\n", EDUREND_ASSET_DIR "sphere/"), std::runtime_error);
+}
+
+TEST(ParseUtil, SizedStringScans)
+{
+	// A name longer than the buffer is not written past it
+	struct
+	{
+		char name[8];
+		char guard[8];
+	} buffer = { { 0 }, { 'g', 'u', 'a', 'r', 'd' } };
+	const std::string line = "g " + std::string(100, 'x');
+	sscanf_s(line.c_str(), "g %s", buffer.name, (unsigned)sizeof(buffer.name));
+	EXPECT_LT(std::string(buffer.name).size(), sizeof(buffer.name));
+	EXPECT_EQ(std::string(buffer.guard), "guard");
+
+	char name[8] = { 0 };
+	EXPECT_EQ(sscanf_s("g short", "g %s", name, (unsigned)sizeof(name)), 1);
+	EXPECT_EQ(std::string(name), "short");
+
+	char rest[64] = { 0 };
+	EXPECT_EQ(sscanf_s("map_Kd -bm 1 textures/a b.png", "map_Kd %[^\n]", rest, (unsigned)sizeof(rest)), 1);
+	EXPECT_EQ(std::string(rest), "-bm 1 textures/a b.png");
+
+	int a = 0, b = 0;
+	EXPECT_EQ(sscanf_s("f 3//4", "f %d//%d", &a, &b), 2);
+	EXPECT_EQ(a + b, 7);
+}
@@ -0,0 +1,95 @@
+//
+//  PrimitivesTest.cpp
+//
+//	Procedural meshes: counts, index ranges, winding and tangent frames
+//
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Primitives.h"
+
+typedef std::function<void(Vertex*, unsigned*, unsigned)> Generator;
+
+static void CheckPrimitive(PrimitiveCounts counts, const Generator& generate)
+{
+	const unsigned base_vertex = 7;
+	const unsigned Guard = 0xdeadbeef;
+
+	// One guard element past each array catches overruns
+	std::vector<Vertex> vertices(counts.vertices + 1);
+	std::vector<unsigned> indices(counts.indices + 1, Guard);
+	vertices.back().Pos = vec3f(123, 0, 0);
+	generate(vertices.data(), indices.data(), base_vertex);
+	EXPECT_EQ(indices.back(), Guard);
+	EXPECT_EQ(vertices.back().Pos.x, 123);
+
+	ASSERT_EQ(counts.indices % 3, 0u);
+	for (unsigned i = 0; i < counts.indices; i++)
+	{
+		ASSERT_GE(indices[i], base_vertex);
+		ASSERT_LT(indices[i], base_vertex + counts.vertices);
+	}
+
+	// Counter-clockwise around the outward normal; degenerate triangles
+	// (at the poles) are allowed
+	for (unsigned i = 0; i < counts.indices; i += 3)
+	{
+		const Vertex& a = vertices[indices[i] - base_vertex];
+		const Vertex& b = vertices[indices[i + 1] - base_vertex];
+		const Vertex& c = vertices[indices[i + 2] - base_vertex];
+		const vec3f n = (b.Pos - a.Pos) % (c.Pos - a.Pos);
+		if (n.norm2() < 1e-9f)
+			continue;
+		EXPECT_GT(dot(n, a.Normal + b.Normal + c.Normal), 0) << "triangle " << i / 3;
+	}
+
+	// Orthonormal, right-handed tangent frames
+	for (unsigned i = 0; i < counts.vertices; i++)
+	{
+		const Vertex& v = vertices[i];
+		EXPECT_NEAR(v.Normal.norm2(), 1, 1e-4f);
+		EXPECT_NEAR(v.Tangent.norm2(), 1, 1e-4f);
+		EXPECT_NEAR(v.Binormal.norm2(), 1, 1e-4f);
+		EXPECT_NEAR(dot(v.Normal, v.Tangent), 0, 1e-4f);
+		EXPECT_NEAR(dot(v.Normal, v.Binormal), 0, 1e-4f);
+		EXPECT_GT(dot(v.Binormal % v.Tangent, v.Normal), 0.99f);
+	}
+}
+
+TEST(Primitives, Sphere)
+{
+	CheckPrimitive(SphereCounts(16, 8), [](Vertex* v, unsigned* i, unsigned b) { GenerateSphere(2, 16, 8, v, i, b); });
+	CheckPrimitive(SphereCounts(3, 2), [](Vertex* v, unsigned* i, unsigned b) { GenerateSphere(1, 3, 2, v, i, b); });
+}
+
+TEST(Primitives, Cylinder)
+{
+	CheckPrimitive(CylinderCounts(12, 3), [](Vertex* v, unsigned* i, unsigned b) { GenerateCylinder(1, 2, 12, 3, v, i, b); });
+}
+
+TEST(Primitives, Torus)
+{
+	CheckPrimitive(TorusCounts(24, 12), [](Vertex* v, unsigned* i, unsigned b) { GenerateTorus(2, 0.5f, 24, 12, v, i, b); });
+}
+
+TEST(Primitives, Grid)
+{
+	CheckPrimitive(GridCounts(5, 7), [](Vertex* v, unsigned* i, unsigned b) { GenerateGrid(3, 4, 5, 7, v, i, b); });
+}
+
+TEST(Primitives, Cube)
+{
+	CheckPrimitive(CubeCounts(3), [](Vertex* v, unsigned* i, unsigned b) { GenerateCube(2, 3, v, i, b); });
+}
+
+TEST(Primitives, TooLowTessellationThrows)
+{
+	EXPECT_THROW(SphereCounts(2, 2), std::runtime_error);
+	EXPECT_THROW(SphereCounts(3, 1), std::runtime_error);
+	EXPECT_THROW(CylinderCounts(2, 1), std::runtime_error);
+	EXPECT_THROW(TorusCounts(3, 2), std::runtime_error);
+	EXPECT_THROW(GridCounts(0, 1), std::runtime_error);
+	EXPECT_THROW(CubeCounts(0), std::runtime_error);
+}
@@ -0,0 +1,234 @@
+//
+//  ProfilerTest.cpp
+//
+//	Profiler zones, frame statistics and camera path recording
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "vec/math.h"
+#include "CameraPath.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+static void Spin(unsigned microseconds)
+{
+	const auto begin = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - begin < std::chrono::microseconds(microseconds));
+}
+
+TEST(Profiler, NestedZonesOnJobThreads)
+{
+	Profiler& profiler = Profiler::Instance();
+	JobSystem jobs(4);
+	for (unsigned frame = 0; frame < Profiler::WindowFrames + 10; frame++)
+	{
+		{
+			PROFILE_ZONE("Test frame");
+			{
+				PROFILE_ZONE("Test outer");
+				Spin(200);
+				{
+					PROFILE_ZONE("Test inner");
+					Spin(100);
+				}
+			}
+			jobs.ParallelFor(0, 64, 1, [](unsigned begin, unsigned end)
+			{
+				for (unsigned i = begin; i < end; i++)
+				{
+					PROFILE_ZONE("Test job");
+					Spin(5);
+				}
+			});
+		}
+		const unsigned long long now = profiler.Now();
+		profiler.RecordGpu("Test GPU", now, now + 500000);
+		profiler.EndFrame();
+	}
+
+	Profiler::ZoneStats stats;
+	for (const char* name : { "Test frame", "Test outer", "Test inner", "Test job", "Test GPU" })
+	{
+		ASSERT_TRUE(profiler.GetZoneStats(name, stats)) << name;
+		EXPECT_EQ(stats.frames, (unsigned)Profiler::WindowFrames) << name;
+		EXPECT_LE(stats.min, stats.avg) << name;
+		EXPECT_LE(stats.min, stats.p99) << name;
+	}
+
+	// Times are in ms, summed over the zone's instances per frame
+	profiler.GetZoneStats("Test inner", stats);
+	EXPECT_GE(stats.min, 0.1);
+	profiler.GetZoneStats("Test outer", stats);
+	EXPECT_GE(stats.min, 0.3);
+	profiler.GetZoneStats("Test job", stats);
+	EXPECT_GE(stats.min, 64 * 0.005);
+	profiler.GetZoneStats("Test GPU", stats);
+	EXPECT_NEAR(stats.avg, 0.5, 1e-3);
+	EXPECT_FALSE(profiler.GetZoneStats("Not a zone", stats));
+
+	std::ostringstream trace;
+	profiler.WriteChromeTrace(trace);
+	const std::string json = trace.str();
+	EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+	EXPECT_NE(json.find("\"Test inner\""), std::string::npos);
+	EXPECT_EQ(std::count(json.begin(), json.end(), '{'), std::count(json.begin(), json.end(), '}'));
+}
+
+TEST(Profiler, PercentilesAndOverflow)
+{
+	Profiler profiler;
+	for (int frame = 1; frame <= 100; frame++)
+	{
+		profiler.Record("Z", 0, frame * 1000000ull, 0);
+		profiler.EndFrame();
+	}
+
+	Profiler::ZoneStats stats;
+	ASSERT_TRUE(profiler.GetZoneStats("Z", stats));
+	EXPECT_EQ(stats.min, 1);
+	EXPECT_EQ(stats.avg, 50.5);
+	EXPECT_EQ(stats.p99, 99);
+
+	// Events past the ring capacity within a frame are dropped and counted
+	for (unsigned i = 0; i < ProfileEventRing::Capacity + 10; i++)
+		profiler.Record("Y", 0, 1, 0);
+	EXPECT_EQ(profiler.GetDroppedCount(), 10u);
+	profiler.EndFrame();
+
+	profiler.ResetStats();
+	EXPECT_FALSE(profiler.GetZoneStats("Z", stats));
+}
+
+TEST(FrameStats, PercentilesAndHitches)
+{
+	// Every 50th frame is a 50 ms hitch among 16 ms frames
+	FrameStats stats(100);
+	for (int i = 1; i <= 250; i++)
+		stats.AddFrame(i % 50 == 0 ? 0.050f : 0.016f);
+
+	const FrameStats::Summary summary = stats.GetSummary();
+	EXPECT_EQ(summary.frames, 100u);
+	EXPECT_EQ(summary.hitches, 2u);
+	EXPECT_EQ(stats.GetHitchCount(), 5u);
+	EXPECT_EQ(stats.GetFrameCount(), 250u);
+	EXPECT_NEAR(summary.p50, 16, 1e-3);
+	EXPECT_NEAR(summary.p95, 16, 1e-3);
+	EXPECT_NEAR(summary.p99, 50, 1e-3);
+	EXPECT_NEAR(summary.max, 50, 1e-3);
+
+	// Nearest-rank percentiles of 1..100 ms
+	FrameStats ramp(1000);
+	for (int i = 1; i <= 100; i++)
+		ramp.AddFrame(i / 1000.0f);
+	const FrameStats::Summary ramp_summary = ramp.GetSummary();
+	EXPECT_NEAR(ramp_summary.p50, 50, 1e-3);
+	EXPECT_NEAR(ramp_summary.p95, 95, 1e-3);
+	EXPECT_NEAR(ramp_summary.p99, 99, 1e-3);
+
+	// The CSV lists the ring oldest first
+	std::ostringstream csv;
+	stats.WriteCSV(csv);
+	const std::string text = csv.str();
+	EXPECT_EQ(text.find("frame,ms,hitch\n150,"), 0u);
+	EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 101);
+
+	EXPECT_THROW(FrameStats(0), std::runtime_error);
+}
+
+static CameraPath TestPath()
+{
+	CameraPath path;
+	for (int i = 0; i < 120; i++)
+		path.Add(
+			vec3f(i * 0.1f, 1, -i * 0.05f),
+			vec3f(0.01f * i, std::fmod(6.2f + 0.01f * i, 2 * fPI), 0),
+			i == 0 ? 0.5f : 1.0f / 60 + (i % 7) * 0.001f);
+	return path;
+}
+
+TEST(CameraPath, SaveLoadRoundTrip)
+{
+	const CameraPath path = TestPath();
+	std::stringstream file;
+	path.Save(file);
+	EXPECT_EQ(file.str().size(), 12u + 120 * 28);
+
+	CameraPath loaded;
+	loaded.Load(file);
+	ASSERT_EQ(loaded.Size(), path.Size());
+	EXPECT_EQ(loaded.GetDuration(), path.GetDuration());
+	for (unsigned i = 0; i < path.Size(); i++)
+	{
+		EXPECT_EQ(loaded.GetKey(i).position.x, path.GetKey(i).position.x);
+		EXPECT_EQ(loaded.GetKey(i).rotation.y, path.GetKey(i).rotation.y);
+		EXPECT_EQ(loaded.GetKey(i).dt, path.GetKey(i).dt);
+	}
+}
+
+TEST(CameraPath, SamplingClampsAndWrapsYaw)
+{
+	const CameraPath path = TestPath();
+	vec3f position, rotation;
+	path.Sample(-1, position, rotation);
+	EXPECT_EQ(position.x, 0);
+	path.Sample(1e9f, position, rotation);
+	EXPECT_NEAR(position.x, 11.9f, 1e-4f);
+
+	// Across the 2 pi boundary, yaw takes the short way
+	CameraPath wrap;
+	wrap.Add(vec3f(0, 0, 0), vec3f(0, 6.2f, 0), 0);
+	wrap.Add(vec3f(0, 0, 0), vec3f(0, 0.1f, 0), 1);
+	wrap.Sample(0.5f, position, rotation);
+	EXPECT_NEAR(rotation.y, 6.2f + (0.1f + 2 * fPI - 6.2f) * 0.5f, 1e-4f);
+}
+
+TEST(CameraPath, ReplayIsDeterministic)
+{
+	const CameraPath path = TestPath();
+	std::stringstream file;
+	path.Save(file);
+	CameraPath loaded;
+	loaded.Load(file);
+
+	vec3f position, rotation;
+	unsigned frames[2] = { 0, 0 };
+	double sums[2] = { 0, 0 };
+	const CameraPath* paths[2] = { &path, &loaded };
+	for (int k = 0; k < 2; k++)
+	{
+		CameraReplay replay(*paths[k], 1.0f / 60);
+		while (replay.NextFrame(position, rotation))
+		{
+			sums[k] += position.x + rotation.y;
+			frames[k]++;
+			replay.AddFrameTime(0.016f);
+		}
+		EXPECT_TRUE(replay.IsDone());
+		EXPECT_EQ(replay.GetStats().GetFrameCount(), frames[k]);
+	}
+	EXPECT_EQ(frames[0], (unsigned)std::floor(path.GetDuration() * 60) + 1);
+	EXPECT_EQ(frames[0], frames[1]);
+	EXPECT_EQ(sums[0], sums[1]);
+}
+
+TEST(CameraPath, ErrorsThrow)
+{
+	const CameraPath path = TestPath();
+	EXPECT_THROW(CameraReplay(path, 0), std::runtime_error);
+
+	std::stringstream junk("XXXX");
+	CameraPath loaded;
+	EXPECT_THROW(loaded.Load(junk), std::runtime_error);
+
+	std::stringstream file;
+	path.Save(file);
+	std::stringstream truncated(file.str().substr(0, 100));
+	EXPECT_THROW(loaded.Load(truncated), std::runtime_error);
+	EXPECT_THROW(loaded.Load(std::string("no/such/file.bin")), std::runtime_error);
+}
@@ -0,0 +1,293 @@
+//
+//  SceneTest.cpp
+//
+//	Transform hierarchy, entity store and frame pipeline
+//
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "EntityStore.h"
+#include "FramePipeline.h"
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+
+static float MaxDiff(const mat4f& a, const mat4f& b)
+{
+	float diff = 0;
+	for (int i = 0; i < 16; i++)
+		diff = std::max(diff, std::abs(a.array[i] - b.array[i]));
+	return diff;
+}
+
+// World matrices of all nodes, recomputed from the local transforms
+static std::vector<mat4f> BruteForceWorld(const TransformHierarchy& h)
+{
+	std::vector<mat4f> world(h.Size());
+	for (unsigned i = 0; i < h.Size(); i++)
+	{
+		const mat4f local = mat4f::translation(h.GetPosition(i)) * mat4f(h.GetRotation(i).get_mat3()) * mat4f::scaling(h.GetScale(i));
+		world[i] = h.GetParent(i) == TransformHierarchy::InvalidIndex ? local : world[h.GetParent(i)] * local;
+	}
+	return world;
+}
+
+TEST(TransformHierarchy, IncrementalUpdateMatchesFullRecompute)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> u(-1, 1);
+	const unsigned N = 100000;
+
+	TransformHierarchy h;
+	h.Reserve(N);
+	for (unsigned i = 0; i < N; i++)
+	{
+		const unsigned parent = i % 1000 == 0 ? TransformHierarchy::InvalidIndex : (unsigned)(rng() % i);
+		const unsigned node = h.AddNode(parent);
+		const vec3f axis = vec3f(u(rng), u(rng), u(rng)).normalize();
+		h.SetLocal(node, vec3f(u(rng), u(rng), u(rng)), quatf::rotation(u(rng) * 3, axis), vec3f(1, 1, 1) + vec3f(u(rng), u(rng), u(rng)) * 0.1f);
+	}
+	EXPECT_EQ(h.Update(), N);
+	EXPECT_EQ(h.Update(), 0u);
+
+	for (int frame = 0; frame < 3; frame++)
+	{
+		std::vector<unsigned> moved;
+		for (int k = 0; k < 100; k++)
+		{
+			moved.push_back(rng() % N);
+			h.SetPosition(moved.back(), vec3f(u(rng), u(rng), u(rng)));
+		}
+		const unsigned nbr_updated = h.Update();
+		EXPECT_GE(nbr_updated, 1u);
+		EXPECT_LT(nbr_updated, N);
+		for (unsigned node : moved)
+			EXPECT_TRUE(h.WasUpdated(node));
+	}
+
+	const std::vector<mat4f> world = BruteForceWorld(h);
+	float err = 0;
+	for (unsigned i = 0; i < N; i++)
+		err = std::max(err, MaxDiff(world[i], h.GetWorldMatrix(i)));
+	EXPECT_LT(err, 1e-3f);
+}
+
+TEST(TransformHierarchy, CubeChainMatchesAccumulatedTransforms)
+{
+	// The Cubes scene: offsets from the parent in world axes, world scales,
+	// and rotations about z that accumulate down the chain
+	const vec3f offsets[3] = { vec3f(0, 0, -10), vec3f(std::cos(-1.0f), std::sin(-1.0f), 0) * 4, vec3f(std::cos(4.0f), std::sin(4.0f), 0) * 2 };
+	const float angles[3] = { -0.2f, -0.5f, 0.8f };
+	const float scales[3] = { 1, 0.7f, 0.3f };
+
+	TransformHierarchy h;
+	quatf parent_rotation(0, 0, 0, 1);
+	for (unsigned i = 0; i < 3; i++)
+	{
+		const quatf rotation = quatf::rotation(angles[i], 0, 0, 1);
+		vec3f position = offsets[i], scale(scales[i], scales[i], scales[i]);
+		if (i > 0)
+			TransformHierarchy::ToParentSpace(parent_rotation, scales[i - 1], position, scale);
+		h.SetLocal(h.AddNode(i > 0 ? i - 1 : TransformHierarchy::InvalidIndex), position, rotation, scale);
+		parent_rotation = parent_rotation * rotation;
+	}
+	h.Update();
+
+	// As the cubes were composed before the hierarchy: summed translations,
+	// then the product of the rotations, then the cube's own scale
+	mat4f translation = mat4f_identity, rotation = mat4f_identity;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		translation = translation * mat4f::translation(offsets[i]);
+		rotation = rotation * mat4f::rotation(angles[i], 0, 0, 1);
+		const mat4f expected = translation * rotation * mat4f::scaling(scales[i]);
+		EXPECT_LT(MaxDiff(h.GetWorldMatrix(i), expected), 1e-5f) << "cube " << i;
+	}
+
+	// Cube 2 sits 2 units from cube 1 and is not scaled by it
+	const vec3f center1 = h.GetWorldMatrix(1).col[3].xyz(), center2 = h.GetWorldMatrix(2).col[3].xyz();
+	EXPECT_NEAR((center2 - center1).norm2(), 2.0f, 1e-5f);
+	EXPECT_NEAR(h.GetWorldMatrix(2).col[0].xyz().norm2(), 0.3f, 1e-6f);
+}
+
+TEST(EntityStore, HandlesBoundsAndSlotReuse)
+{
+	EntityStore store;
+	AABB bounds;
+	bounds.Expand(vec3f(-1, -1, -1));
+	bounds.Expand(vec3f(1, 1, 1));
+	Model* model = nullptr;
+
+	const EntityHandle a = store.Create(model, bounds);
+	const EntityHandle b = store.Create(model, bounds, a);
+	const EntityHandle c = store.Create(model, bounds, b);
+	const EntityHandle d = store.Create(model, bounds);
+
+	store.SetPosition(a, vec3f(1, 0, 0));
+	store.SetPosition(b, vec3f(0, 2, 0));
+	store.Update();
+
+	const AABB world = store.GetWorldBounds(store.GetIndex(c));
+	EXPECT_FLOAT_EQ(world.min.x, 0);
+	EXPECT_FLOAT_EQ(world.min.y, 1);
+	EXPECT_FLOAT_EQ(world.max.x, 2);
+	EXPECT_FLOAT_EQ(world.max.y, 3);
+
+	// Destroying b takes its child c along
+	store.Destroy(b);
+	EXPECT_TRUE(store.IsAlive(a));
+	EXPECT_FALSE(store.IsAlive(b));
+	EXPECT_FALSE(store.IsAlive(c));
+	EXPECT_TRUE(store.IsAlive(d));
+	EXPECT_THROW(store.GetIndex(b), std::runtime_error);
+
+	// A reused slot gets a new generation, and the stale handle stays dead
+	const EntityHandle e = store.Create(model, bounds, a);
+	EXPECT_TRUE(store.IsAlive(e));
+	if (e.index == b.index)
+		EXPECT_NE(e.generation, b.generation);
+	EXPECT_FALSE(store.IsAlive(b));
+
+	store.Update();
+	EXPECT_TRUE(store.WasUpdated(e.index));
+	EXPECT_FALSE(store.WasUpdated(a.index));
+	store.Update();
+	EXPECT_FALSE(store.WasUpdated(e.index));
+}
+
+//
+// A simulation whose update runs on a job while the previous frame
+// renders: the rendered frames must not depend on the thread count
+//
+struct PipelineSim
+{
+	struct Snapshot
+	{
+		unsigned frame = 0;
+		std::vector<unsigned long long> values;
+	};
+
+	FramePipeline<Snapshot> frames;
+	unsigned long long state = 1;
+	unsigned frame = 0;
+	unsigned long long checksum = 0;
+	unsigned nbr_torn = 0;
+
+	static void UpdateJob(void* data)
+	{
+		PipelineSim& sim = *(PipelineSim*)data;
+		sim.frame++;
+		sim.state = sim.state * 6364136223846793005ull + 1442695040888963407ull;
+
+		Snapshot& out = sim.frames.GetUpdated();
+		out.frame = sim.frame;
+		out.values.assign(64, 0);
+		for (unsigned i = 0; i < 64; i++)
+		{
+			out.values[i] = sim.state;
+			if (i % 16 == 0)
+				std::this_thread::yield();
+		}
+	}
+
+	void Render()
+	{
+		const Snapshot& in = frames.GetRendered();
+		if (in.frame != frames.GetFrameCount())
+			nbr_torn++;
+		for (unsigned long long value : in.values)
+			if (value != in.values[0])
+				nbr_torn++;
+		std::this_thread::yield();
+		checksum = checksum * 31 + (in.values.empty() ? 0 : in.values[0]) + in.frame;
+	}
+
+	void Run(JobSystem* jobs, unsigned nbr_frames)
+	{
+		for (unsigned i = 0; i < nbr_frames; i++)
+		{
+			frames.BeginFrame(jobs, &UpdateJob, this);
+			Render();
+			frames.EndFrame();
+		}
+	}
+};
+
+TEST(FramePipeline, DeterministicAcrossThreadCounts)
+{
+	PipelineSim sequential;
+	sequential.Run(nullptr, 1000);
+	EXPECT_EQ(sequential.nbr_torn, 0u);
+	EXPECT_EQ(sequential.frames.GetFrameCount(), 1000u);
+
+	for (unsigned nbr_threads : { 1u, 2u, 4u, 8u })
+	{
+		JobSystem jobs(nbr_threads);
+		PipelineSim pipelined;
+		pipelined.Run(&jobs, 1000);
+		EXPECT_EQ(pipelined.nbr_torn, 0u) << nbr_threads << " threads";
+		EXPECT_EQ(pipelined.checksum, sequential.checksum) << nbr_threads << " threads";
+	}
+}
+
+//
+// The update and Render() each wait, up to a timeout, for the other to have
+// started. They only both see the other if they run at the same time.
+//
+struct OverlapSim
+{
+	struct Snapshot { };
+
+	FramePipeline<Snapshot> frames;
+	std::atomic<bool> update_started{ false };
+	std::atomic<bool> render_started{ false };
+	bool update_saw_render = false;
+	bool render_saw_update = false;
+	std::thread::id update_thread;
+
+	static bool WaitFor(const std::atomic<bool>& flag)
+	{
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (!flag.load())
+		{
+			if (std::chrono::steady_clock::now() > timeout)
+				return false;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		return true;
+	}
+
+	static void UpdateJob(void* data)
+	{
+		OverlapSim& sim = *(OverlapSim*)data;
+		sim.update_thread = std::this_thread::get_id();
+		sim.update_started = true;
+		sim.update_saw_render = WaitFor(sim.render_started);
+	}
+
+	void Render()
+	{
+		render_started = true;
+		render_saw_update = WaitFor(update_started);
+	}
+};
+
+TEST(FramePipeline, UpdateOverlapsRender)
+{
+	JobSystem jobs(2);
+	for (int frame = 0; frame < 5; frame++)
+	{
+		OverlapSim sim;
+		sim.frames.BeginFrame(&jobs, &OverlapSim::UpdateJob, &sim);
+		sim.Render();
+		sim.frames.EndFrame();
+
+		EXPECT_NE(sim.update_thread, std::this_thread::get_id());
+		EXPECT_TRUE(sim.update_saw_render);
+		EXPECT_TRUE(sim.render_saw_update);
+	}
+}
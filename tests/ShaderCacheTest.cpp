@@ -0,0 +1,253 @@
+//
+//  ShaderCacheTest.cpp
+//
+//	Shader bytecode cache lookup and invalidation, with made-up bytecode,
+//	and pixel shader permutations
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "ShaderCache.h"
+#include "ShaderPermutation.h"
+
+class ShaderCacheTest : public ::testing::Test
+{
+protected:
+	std::filesystem::path root;
+	ShaderSource source;
+	const std::vector<char> bytecode{ 'D', 'X', 'B', 'C', 1, 2, 3, 4 };
+
+	void SetUp() override
+	{
+		// A directory per test, as tests may run in parallel
+		root = std::filesystem::temp_directory_path() / "edurend_shader_cache_test" /
+			::testing::UnitTest::GetInstance()->current_test_info()->name();
+		std::filesystem::remove_all(root);
+		std::filesystem::create_directories(root / "shaders");
+		Write("shaders/common.hlsli", "float4 Shade() { return 1; }\n");
+		Write("shaders/lights.hlsli", "#include \"common.hlsli\"\n");
+
+		source.path = (root / "shaders/pixel_shader.hlsl").string();
+		source.text = "  #  include \"lights.hlsli\"\nfloat4 PS_main() : SV_Target { return Shade(); }\n";
+		source.entry_point = "PS_main";
+		source.target = "ps_5_0";
+	}
+
+	void TearDown() override
+	{
+		std::filesystem::remove_all(root);
+	}
+
+	void Write(const std::string& name, const std::string& text)
+	{
+		std::ofstream((root / name).string(), std::ios::binary) << text;
+	}
+
+	std::string CacheDirectory() const { return (root / "cache").string(); }
+};
+
+TEST_F(ShaderCacheTest, HitsUntilTheSourceChanges)
+{
+	ShaderCache cache(CacheDirectory());
+	std::vector<char> loaded;
+	EXPECT_FALSE(cache.Load(source, loaded));
+	ASSERT_TRUE(cache.Store(source, bytecode.data(), bytecode.size()));
+	ASSERT_TRUE(cache.Load(source, loaded));
+	EXPECT_EQ(loaded, bytecode);
+
+	// Another cache on the same directory, e.g. at the next startup
+	ShaderCache next(CacheDirectory());
+	EXPECT_TRUE(next.Load(source, loaded));
+
+	source.text += "// edited\n";
+	EXPECT_FALSE(cache.Load(source, loaded));
+	EXPECT_EQ(cache.GetHitCount(), 1u);
+	EXPECT_EQ(cache.GetMissCount(), 2u);
+
+	// The new bytecode replaces the old in the same file
+	const std::vector<char> recompiled{ 'D', 'X', 'B', 'C', 5 };
+	ASSERT_TRUE(cache.Store(source, recompiled.data(), recompiled.size()));
+	ASSERT_TRUE(cache.Load(source, loaded));
+	EXPECT_EQ(loaded, recompiled);
+	size_t nbr_files = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(CacheDirectory()))
+	{
+		EXPECT_EQ(entry.path().extension(), ".cso");
+		nbr_files++;
+	}
+	EXPECT_EQ(nbr_files, 1u);
+}
+
+TEST_F(ShaderCacheTest, KeyCoversIncludesDefinesEntryTargetAndCompiler)
+{
+	const uint64_t key = ShaderCache::ComputeKey(source);
+	EXPECT_EQ(ShaderCache::ComputeKey(source), key);
+
+	// An include of an include
+	Write("shaders/common.hlsli", "float4 Shade() { return 0.5; }\n");
+	const uint64_t edited = ShaderCache::ComputeKey(source);
+	EXPECT_NE(edited, key);
+
+	ShaderSource changed = source;
+	changed.defines.emplace_back("HAS_DIFFUSE_MAP", "1");
+	EXPECT_NE(ShaderCache::ComputeKey(changed), edited);
+	changed = source;
+	changed.entry_point = "PS_other";
+	EXPECT_NE(ShaderCache::ComputeKey(changed), edited);
+	changed = source;
+	changed.target = "ps_4_0";
+	EXPECT_NE(ShaderCache::ComputeKey(changed), edited);
+	changed = source;
+	changed.flags = 1;
+	EXPECT_NE(ShaderCache::ComputeKey(changed), edited);
+	changed = source;
+	changed.compiler = "d3dcompiler_46.dll";
+	EXPECT_NE(ShaderCache::ComputeKey(changed), edited);
+
+	// Permutations are cached side by side
+	ShaderCache cache(CacheDirectory());
+	changed = source;
+	changed.defines.emplace_back("ALPHA_TEST", "1");
+	EXPECT_NE(cache.GetFilename(changed), cache.GetFilename(source));
+	ASSERT_TRUE(cache.Store(source, bytecode.data(), bytecode.size()));
+	ASSERT_TRUE(cache.Store(changed, bytecode.data(), 4));
+	std::vector<char> loaded;
+	ASSERT_TRUE(cache.Load(source, loaded));
+	EXPECT_EQ(loaded.size(), bytecode.size());
+
+	// Editing the include invalidates the cached bytecode
+	Write("shaders/lights.hlsli", "#include \"common.hlsli\"\n#define MAX_LIGHTS 8\n");
+	EXPECT_FALSE(cache.Load(source, loaded));
+}
+
+TEST_F(ShaderCacheTest, CorruptFilesMiss)
+{
+	ShaderCache cache(CacheDirectory());
+	ASSERT_TRUE(cache.Store(source, bytecode.data(), bytecode.size()));
+	const std::string filename = cache.GetFilename(source);
+	std::vector<char> loaded;
+
+	// Truncated
+	std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 1);
+	EXPECT_FALSE(cache.Load(source, loaded));
+
+	// A flipped bytecode byte
+	ASSERT_TRUE(cache.Store(source, bytecode.data(), bytecode.size()));
+	{
+		std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(-1, std::ios::end);
+		file.put('X');
+	}
+	EXPECT_FALSE(cache.Load(source, loaded));
+	EXPECT_TRUE(loaded.empty());
+
+	// Not a cache file
+	std::ofstream(filename, std::ios::binary) << "garbage";
+	EXPECT_FALSE(cache.Load(source, loaded));
+}
+
+TEST_F(ShaderCacheTest, FailedStoreLeavesNoTemporaryFile)
+{
+	// A directory in the way of the cache file makes the rename fail
+	ShaderCache cache(CacheDirectory());
+	const std::filesystem::path filename = cache.GetFilename(source);
+	std::filesystem::create_directories(filename / "in_the_way");
+
+	EXPECT_FALSE(cache.Store(source, bytecode.data(), bytecode.size()));
+	for (const auto& entry : std::filesystem::directory_iterator(CacheDirectory()))
+		EXPECT_NE(entry.path().extension(), ".tmp") << entry.path();
+	std::vector<char> loaded;
+	EXPECT_FALSE(cache.Load(source, loaded));
+}
+
+TEST_F(ShaderCacheTest, ConcurrentLoadsAndStores)
+{
+	ShaderCache cache(CacheDirectory());
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+		threads.emplace_back([&]()
+		{
+			std::vector<char> loaded;
+			for (int i = 0; i < 50; i++)
+			{
+				if (!cache.Load(source, loaded))
+					cache.Store(source, bytecode.data(), bytecode.size());
+				else
+					EXPECT_EQ(loaded, bytecode);
+			}
+		});
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(cache.GetHitCount() + cache.GetMissCount(), 200u);
+	std::vector<char> loaded;
+	ASSERT_TRUE(cache.Load(source, loaded));
+	EXPECT_EQ(loaded, bytecode);
+}
+
+TEST_F(ShaderCacheTest, MissingIncludeIsHashedByName)
+{
+	source.text = "#include \"missing.hlsli\"\n";
+	const uint64_t key = ShaderCache::ComputeKey(source);
+	source.text = "#include \"other.hlsli\"\n";
+	const uint64_t other = ShaderCache::ComputeKey(source);
+	EXPECT_NE(other, key);
+
+	// Appearing later changes the key
+	Write("shaders/other.hlsli", "static const float x = 1;\n");
+	EXPECT_NE(ShaderCache::ComputeKey(source), other);
+}
+
+TEST(ShaderPermutation, DefinesAndNames)
+{
+	EXPECT_TRUE(GetPermutationDefines(0).empty());
+	EXPECT_EQ(GetPermutationName(0), "none");
+
+	const unsigned permutation = ShaderFeature_DiffuseMap | ShaderFeature_AlphaTest;
+	const auto defines = GetPermutationDefines(permutation);
+	ASSERT_EQ(defines.size(), 2u);
+	EXPECT_EQ(defines[0].first, "HAS_DIFFUSE_MAP");
+	EXPECT_EQ(defines[1].first, "ALPHA_TEST");
+	EXPECT_EQ(defines[1].second, "1");
+	EXPECT_EQ(GetPermutationName(permutation), "diffuse+alpha-test");
+
+	// Every permutation has its own cache file
+	ShaderSource source;
+	source.path = "shaders/pixel_shader.hlsl";
+	std::vector<std::string> filenames;
+	ShaderCache cache("cache");
+	for (unsigned i = 0; i < ShaderPermutationCount; i++)
+	{
+		source.defines = GetPermutationDefines(i);
+		filenames.push_back(cache.GetFilename(source));
+	}
+	std::sort(filenames.begin(), filenames.end());
+	EXPECT_EQ(std::unique(filenames.begin(), filenames.end()), filenames.end());
+}
+
+TEST(ShaderPermutation, LoadedTexturesSelectFeatures)
+{
+	// Stand-ins for views on the device; never dereferenced
+	ID3D11ShaderResourceView* const view = reinterpret_cast<ID3D11ShaderResourceView*>(16);
+
+	Material material;
+	EXPECT_EQ(GetMaterialPermutation(material), 0u);
+
+	// A texture that failed to load has a filename, but no view
+	material.Kd_texture_filename = "missing.png";
+	EXPECT_EQ(GetMaterialPermutation(material), 0u);
+
+	material.diffuse_texture.texture_SRV = view;
+	material.specular_texture.texture_SRV = view;
+	EXPECT_EQ(GetMaterialPermutation(material), (unsigned)(ShaderFeature_DiffuseMap | ShaderFeature_SpecularMap));
+
+	material.normal_texture.texture_SRV = view;
+	material.mask_texture.texture_SRV = view;
+	EXPECT_EQ(GetMaterialPermutation(material), ShaderPermutationCount - 1);
+}
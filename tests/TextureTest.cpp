@@ -0,0 +1,53 @@
+//
+//  TextureTest.cpp
+//
+//	Image decoding of the bundled textures
+//
+
+#include <utility>
+#include <gtest/gtest.h>
+#include "Texture.h"
+
+TEST(Image, DecodesToRGBA)
+{
+	Image image;
+	ASSERT_TRUE(image.Load(EDUREND_ASSET_DIR "textures/brick_diffuse.png"));
+	EXPECT_EQ(image.GetWidth(), 512);
+	EXPECT_EQ(image.GetHeight(), 256);
+	ASSERT_FALSE(image.IsEmpty());
+
+	// Opaque texture: alpha is filled in
+	const unsigned char* pixels = image.GetPixels();
+	for (int i = 0; i < image.GetWidth() * image.GetHeight(); i++)
+		ASSERT_EQ(pixels[i * 4 + 3], 255);
+
+	ASSERT_TRUE(image.Load(EDUREND_ASSET_DIR "textures/0001CD_diffuse.jpg"));
+	EXPECT_GT(image.GetWidth(), 0);
+}
+
+TEST(Image, FailureLeavesImageEmpty)
+{
+	Image image;
+	ASSERT_TRUE(image.Load(EDUREND_ASSET_DIR "EDU_2d_s.png"));
+	EXPECT_FALSE(image.Load(EDUREND_ASSET_DIR "no/such/image.png"));
+	EXPECT_TRUE(image.IsEmpty());
+	EXPECT_EQ(image.GetWidth(), 0);
+	EXPECT_EQ(image.GetPixels(), nullptr);
+}
+
+TEST(Image, MovesOwnership)
+{
+	Image image;
+	ASSERT_TRUE(image.Load(EDUREND_ASSET_DIR "EDU_2d_s.png"));
+	const unsigned char* pixels = image.GetPixels();
+
+	Image moved(std::move(image));
+	EXPECT_TRUE(image.IsEmpty());
+	EXPECT_EQ(moved.GetPixels(), pixels);
+	EXPECT_EQ(moved.GetWidth(), 128);
+
+	Image assigned;
+	assigned = std::move(moved);
+	EXPECT_TRUE(moved.IsEmpty());
+	EXPECT_EQ(assigned.GetPixels(), pixels);
+}